@@ -0,0 +1,726 @@
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+
+#include "aio.h"
+#include "animation.h"
+#include "atlas.h"
+#include "bcn.h"
+#include "command.h"
+#include "linmath.h"
+#include "loader.h"
+#include "frustum.h"
+#include "lod.h"
+#include "mesh.h"
+#include "mesh_cache.h"
+#include "meshlet.h"
+#include "mip.h"
+#include "pak.h"
+#include "vfs.h"
+
+static double now_ms() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e3 + ts.tv_nsec * 1e-6;
+}
+
+// Lumpy sphere with position and normal, indexed so it has no seams
+static void make_sphere(Mesh *mesh, int rings, int segments) {
+    memset(mesh, 0, sizeof(*mesh));
+    mesh->stride = 6;
+    mesh->vertex_count = (rings + 1) * segments;
+    mesh->vertices =
+        (float *)malloc(mesh->vertex_count * mesh->stride * sizeof(float));
+    mesh->indices = (uint32_t *)malloc(rings * segments * 6 * sizeof(uint32_t));
+
+    for (int r = 0; r <= rings; r++) {
+        float theta = 3.1415926f * r / rings;
+        for (int s = 0; s < segments; s++) {
+            float phi = 2.0f * 3.1415926f * s / segments;
+            float n[3] = {sinf(theta) * cosf(phi), cosf(theta),
+                          sinf(theta) * sinf(phi)};
+            float bump = 1.0f + 0.05f * sinf(theta * 12.0f) * cosf(phi * 9.0f);
+            float *v = &mesh->vertices[(r * segments + s) * mesh->stride];
+            for (int k = 0; k < 3; k++) {
+                v[k] = n[k] * bump;
+                v[3 + k] = n[k];
+            }
+        }
+    }
+
+    for (int r = 0; r < rings; r++) {
+        for (int s = 0; s < segments; s++) {
+            uint32_t a = r * segments + s;
+            uint32_t b = r * segments + (s + 1) % segments;
+            uint32_t c = a + segments, d = b + segments;
+            if (r != 0) {
+                mesh->indices[mesh->index_count++] = a;
+                mesh->indices[mesh->index_count++] = b;
+                mesh->indices[mesh->index_count++] = c;
+            }
+            if (r != rings - 1) {
+                mesh->indices[mesh->index_count++] = b;
+                mesh->indices[mesh->index_count++] = d;
+                mesh->indices[mesh->index_count++] = c;
+            }
+        }
+    }
+}
+
+static void bench_lod() {
+    Mesh mesh;
+    make_sphere(&mesh, 192, 384);
+
+    double start = now_ms();
+    LodChain chain;
+    lod_chain_build(&chain, &mesh, 6, 0.4f);
+    printf("lod chain built in %.1f ms\n", now_ms() - start);
+    for (int i = 0; i < chain.level_count; i++)
+        printf("  level %d: %7d triangles, error %.5f\n", i,
+               chain.levels[i].index_count / 3, chain.levels[i].error);
+
+    // 64x64 instances on a plane, camera flying across it
+    const int grid = 64, frames = 600;
+    const float spacing = 6.0f, height = 1080.0f, fov = 1.0f;
+    int count = grid * grid;
+    int *current = (int *)calloc(count, sizeof(int));
+    mat4x4 projection, view;
+    mat4x4_perspective(projection, fov, 16.0f / 9.0f, 0.1f, 1000.0f);
+
+    long full = 0, drawn = 0, switches = 0;
+    long histogram[LOD_MAX_LEVELS] = {0};
+    start = now_ms();
+    for (int f = 0; f < frames; f++) {
+        float t = (float)f / frames;
+        vec3 eye = {t * grid * spacing, 4.0f + 6.0f * sinf(t * 6.28f),
+                    grid * spacing * 0.5f};
+        vec3 target = {eye[0] + 10.0f, 0.0f, eye[2] + 3.0f};
+        vec3 up = {0.0f, 1.0f, 0.0f};
+        mat4x4_look_at(view, eye, target, up);
+
+        for (int i = 0; i < count; i++) {
+            vec3 center = {(i % grid) * spacing, 0.0f, (i / grid) * spacing};
+            float screen = lod_screen_radius(center, chain.radius, view,
+                                             projection[1][1], height);
+            int level = lod_select(&chain, current[i], screen, 1.0f, 0.2f);
+            switches += level != current[i];
+            current[i] = level;
+            histogram[level]++;
+            full += chain.levels[0].index_count / 3;
+            drawn += chain.levels[level].index_count / 3;
+        }
+    }
+    double select_ms = (now_ms() - start) / frames;
+
+    printf("%d instances over %d frames, selection %.3f ms per frame\n", count,
+           frames, select_ms);
+    printf("triangles per frame: %ld full detail, %ld with lod (%.1f%% saved)\n",
+           full / frames, drawn / frames, 100.0 * (1.0 - (double)drawn / full));
+    printf("level switches per frame: %.1f\n", (double)switches / frames);
+    for (int i = 0; i < chain.level_count; i++)
+        printf("  level %d: %.1f%% of draws\n", i,
+               100.0 * histogram[i] / ((double)count * frames));
+
+    free(current);
+    lod_chain_free(&chain);
+    mesh_free(&mesh);
+}
+
+static void bench_meshlet() {
+    Mesh mesh;
+    make_sphere(&mesh, 192, 384);
+
+    double start = now_ms();
+    MeshletSet set;
+    meshlet_build(&set, &mesh);
+    double build_ms = now_ms() - start;
+    printf("%d triangles -> %d meshlets in %.1f ms (%.1f vertices, %.1f "
+           "triangles each)\n",
+           mesh.index_count / 3, set.meshlet_count, build_ms,
+           (double)set.vertex_count / set.meshlet_count,
+           (double)set.triangle_count / set.meshlet_count);
+
+    // Orbit close to the surface so both frustum and cone culling matter
+    const int frames = 360;
+    mat4x4 projection, view, view_proj;
+    mat4x4_perspective(projection, 1.0f, 16.0f / 9.0f, 0.1f, 100.0f);
+    MeshletRanges ranges;
+    memset(&ranges, 0, sizeof(ranges));
+    MeshletStats stats;
+    long visible = 0, frustum = 0, cone = 0, triangles = 0, draws = 0;
+
+    start = now_ms();
+    for (int f = 0; f < frames; f++) {
+        float angle = 6.2831853f * f / frames;
+        vec3 eye = {1.6f * cosf(angle), 0.5f, 1.6f * sinf(angle)};
+        vec3 target = {0.0f, 0.0f, 0.0f}, up = {0.0f, 1.0f, 0.0f};
+        mat4x4_look_at(view, eye, target, up);
+        mat4x4_mul(view_proj, projection, view);
+        Frustum frustum_planes;
+        frustum_from_matrix(&frustum_planes, view_proj);
+
+        meshlet_cull(&set, &frustum_planes, eye, &ranges, &stats);
+        visible += stats.visible;
+        frustum += stats.frustum_culled;
+        cone += stats.cone_culled;
+        triangles += stats.triangles;
+        draws += ranges.range_count;
+    }
+    double cull_ms = (now_ms() - start) / frames;
+
+    printf("culling %.3f ms per view: %.1f%% visible, %.1f%% frustum culled, "
+           "%.1f%% cone culled\n",
+           cull_ms, 100.0 * visible / ((double)set.meshlet_count * frames),
+           100.0 * frustum / ((double)set.meshlet_count * frames),
+           100.0 * cone / ((double)set.meshlet_count * frames));
+    printf("triangles submitted: %ld of %d (%.1f%%) in %.1f ranges per view\n",
+           triangles / frames, mesh.index_count / 3,
+           100.0 * triangles / ((double)mesh.index_count / 3 * frames),
+           (double)draws / frames);
+
+    meshlet_ranges_free(&ranges);
+    meshlet_set_free(&set);
+    mesh_free(&mesh);
+}
+
+// Resets the peak resident set size so it can be measured per load
+static void reset_peak_memory() {
+    FILE *f = fopen("/proc/self/clear_refs", "w");
+    if (f) {
+        fputs("5", f);
+        fclose(f);
+    }
+}
+
+static long peak_memory_kb() {
+    FILE *f = fopen("/proc/self/status", "r");
+    if (!f)
+        return 0;
+    char line[256];
+    long kb = 0;
+    while (fgets(line, sizeof(line), f))
+        if (strncmp(line, "VmHWM:", 6) == 0)
+            kb = strtol(line + 6, NULL, 10);
+    fclose(f);
+    return kb;
+}
+
+static void write_obj(const char *path, const Mesh *mesh) {
+    FILE *f = fopen(path, "w");
+    for (int i = 0; i < mesh->vertex_count; i++) {
+        const float *v = &mesh->vertices[i * mesh->stride];
+        fprintf(f, "v %f %f %f\nvn %f %f %f\n", v[0], v[1], v[2], v[3], v[4],
+                v[5]);
+    }
+    for (int i = 0; i < mesh->index_count; i += 3)
+        fprintf(f, "f %u//%u %u//%u %u//%u\n", mesh->indices[i] + 1,
+                mesh->indices[i] + 1, mesh->indices[i + 1] + 1,
+                mesh->indices[i + 1] + 1, mesh->indices[i + 2] + 1,
+                mesh->indices[i + 2] + 1);
+    fclose(f);
+}
+
+static void write_glb(const char *path, const Mesh *mesh) {
+    size_t vertex_bytes = (size_t)mesh->vertex_count * mesh->stride * sizeof(float);
+    size_t index_bytes = (size_t)mesh->index_count * sizeof(uint32_t);
+    char json[1024];
+    int length = snprintf(
+        json, sizeof(json),
+        "{\"asset\":{\"version\":\"2.0\"},\"buffers\":[{\"byteLength\":%zu}],"
+        "\"bufferViews\":[{\"buffer\":0,\"byteOffset\":0,\"byteLength\":%zu,"
+        "\"byteStride\":%d},{\"buffer\":0,\"byteOffset\":%zu,\"byteLength\":%zu}],"
+        "\"accessors\":[{\"bufferView\":0,\"componentType\":5126,\"count\":%d,"
+        "\"type\":\"VEC3\"},{\"bufferView\":0,\"byteOffset\":12,"
+        "\"componentType\":5126,\"count\":%d,\"type\":\"VEC3\"},"
+        "{\"bufferView\":1,\"componentType\":5125,\"count\":%d,"
+        "\"type\":\"SCALAR\"}],\"meshes\":[{\"primitives\":[{\"attributes\":"
+        "{\"POSITION\":0,\"NORMAL\":1},\"indices\":2}]}]}",
+        vertex_bytes + index_bytes, vertex_bytes, mesh->stride * 4, vertex_bytes,
+        index_bytes, mesh->vertex_count, mesh->vertex_count, mesh->index_count);
+    while (length % 4)
+        json[length++] = ' ';
+
+    uint32_t bin_length = (uint32_t)(vertex_bytes + index_bytes);
+    uint32_t header[5] = {0x46546C67, 2, (uint32_t)(12 + 8 + length + 8 + bin_length),
+                          (uint32_t)length, 0x4E4F534A};
+    uint32_t bin_header[2] = {bin_length, 0x004E4942};
+    FILE *f = fopen(path, "wb");
+    fwrite(header, sizeof(header), 1, f);
+    fwrite(json, length, 1, f);
+    fwrite(bin_header, sizeof(bin_header), 1, f);
+    fwrite(mesh->vertices, vertex_bytes, 1, f);
+    fwrite(mesh->indices, index_bytes, 1, f);
+    fclose(f);
+}
+
+static void bench_load_file(const char *path) {
+    size_t length = strlen(path);
+    bool glb = length > 4 && strcmp(path + length - 4, ".glb") == 0;
+
+    Mesh mesh;
+    LoadStats stats;
+    reset_peak_memory();
+    long before = peak_memory_kb();
+    bool ok = glb ? glb_load(path, &mesh, &stats) : obj_load(path, &mesh, &stats);
+    if (!ok)
+        return;
+    long peak = peak_memory_kb();
+
+    double total = stats.map_ms + stats.parse_ms;
+    printf("%s: %.1f MB, %d vertices, %d triangles\n", path,
+           stats.file_bytes / 1048576.0, mesh.vertex_count, mesh.index_count / 3);
+    printf("  load %.1f ms (%.0f MB/s), peak memory +%.1f MB\n", total,
+           stats.file_bytes / 1048576.0 / (total / 1e3), (peak - before) / 1024.0);
+    mesh_free(&mesh);
+}
+
+static void bench_load(const char *path) {
+    if (path) {
+        bench_load_file(path);
+        return;
+    }
+
+    Mesh mesh;
+    make_sphere(&mesh, 512, 1024);
+    write_obj("/tmp/ngine_bench.obj", &mesh);
+    write_glb("/tmp/ngine_bench.glb", &mesh);
+    mesh_free(&mesh);
+
+    bench_load_file("/tmp/ngine_bench.obj");
+    bench_load_file("/tmp/ngine_bench.glb");
+}
+
+// Compares startup from the text format against the cooked cache. Reading
+// every vertex and index stands in for the upload, which has to touch all
+// pages of the mapping.
+static void bench_cache() {
+    const char *obj = "/tmp/ngine_bench.obj", *cooked = "/tmp/ngine_bench.ngm";
+    FILE *f = fopen(obj, "r");
+    if (f)
+        fclose(f);
+    else
+        bench_load(NULL);
+
+    Mesh mesh;
+    LoadStats stats;
+    double start = now_ms();
+    if (!obj_load(obj, &mesh, &stats))
+        return;
+    double text_ms = now_ms() - start;
+
+    LodChain chain;
+    lod_chain_build(&chain, &mesh, 4, 0.5f);
+    MeshletSet set;
+    meshlet_build(&set, &mesh);
+    mesh_cache_write(cooked, &mesh, &chain, &set);
+    meshlet_set_free(&set);
+    lod_chain_free(&chain);
+    mesh_free(&mesh);
+
+    start = now_ms();
+    MeshCache cache;
+    if (!mesh_cache_open(&cache, cooked))
+        return;
+    double open_ms = now_ms() - start;
+    double checksum = 0.0;
+    size_t floats = (size_t)cache.mesh.vertex_count * cache.mesh.stride;
+    for (size_t i = 0; i < floats; i++)
+        checksum += cache.mesh.vertices[i];
+    for (int i = 0; i < cache.lod.index_count; i++)
+        checksum += cache.lod.indices[i];
+    double cache_ms = now_ms() - start;
+
+    printf("text load %.1f ms, cache open %.3f ms, open + read all %.1f ms "
+           "(%.0fx faster, checksum %.0f)\n",
+           text_ms, open_ms, cache_ms, text_ms / cache_ms, checksum);
+    printf("cache holds %d lod levels and %d meshlets\n", cache.lod.level_count,
+           cache.meshlets.meshlet_count);
+    mesh_cache_close(&cache);
+}
+
+static double bench_vfs_read(const char **paths, int count,
+                             unsigned long *checksum) {
+    double start = now_ms();
+    for (int i = 0; i < count; i++) {
+        VfsFile file;
+        if (!vfs_open(&file, paths[i]))
+            continue;
+        for (size_t j = 0; j < file.size; j += 4096)
+            *checksum += file.data[j];
+        vfs_close(&file);
+    }
+    return now_ms() - start;
+}
+
+static void bench_pak() {
+    const char *paths[] = {"/tmp/ngine_bench.obj", "/tmp/ngine_bench.glb"};
+    const char *stored = "/tmp/ngine_bench_store.pak", *packed = "/tmp/ngine_bench_lz4.pak";
+    FILE *f = fopen(paths[1], "r");
+    if (f)
+        fclose(f);
+    else
+        bench_load(NULL);
+
+    double start = now_ms();
+    if (!pak_write(stored, paths, paths, 2, false))
+        return;
+    double store_ms = now_ms() - start;
+    start = now_ms();
+    if (!pak_write(packed, paths, paths, 2, true))
+        return;
+    double pack_ms = now_ms() - start;
+
+    // Runs twice so the page cache is warm for every variant
+    double loose_ms = 0.0, store_read_ms = 0.0, lz4_read_ms = 0.0;
+    unsigned long checksum = 0;
+    for (int pass = 0; pass < 2; pass++) {
+        loose_ms = bench_vfs_read(paths, 2, &checksum);
+        vfs_mount(stored);
+        store_read_ms = bench_vfs_read(paths, 2, &checksum);
+        vfs_unmount_all();
+        vfs_mount(packed);
+        lz4_read_ms = bench_vfs_read(paths, 2, &checksum);
+        vfs_unmount_all();
+    }
+
+    Pak pak;
+    if (!pak_open(&pak, packed))
+        return;
+    printf("pak write %.1f ms stored, %.1f ms lz4; %.1f MB -> %.1f MB\n",
+           store_ms, pack_ms,
+           (pak.entries[0].size + pak.entries[1].size) / 1e6, pak.file.size / 1e6);
+    printf("read all: loose %.1f ms, pak stored %.1f ms (zero copy), pak lz4 %.1f ms "
+           "(%.0f MB/s, checksum %lu)\n",
+           loose_ms, store_read_ms, lz4_read_ms,
+           (pak.entries[0].size + pak.entries[1].size) / 1e3 / lz4_read_ms, checksum);
+    pak_close(&pak);
+}
+
+#define BENCH_AIO_FILES 256
+
+static void bench_aio_callback(AioResult *result) {
+    long *bytes = (long *)result->user;
+    *bytes += result->size;
+    free(result->data);
+}
+
+static void bench_aio_run(const char *name, bool uring) {
+    AsyncIo aio;
+    aio_init(&aio, BENCH_AIO_FILES, 64, 0, uring);
+    long bytes = 0;
+    char path[64];
+
+    double start = now_ms(), submit_ms = 0.0;
+    for (int i = 0; i < BENCH_AIO_FILES; i++) {
+        snprintf(path, sizeof(path), "/tmp/ngine_aio/%d.bin", i);
+        double t = now_ms();
+        aio_read_file(&aio, path, (AioPriority)(i % AIO_PRIORITY_COUNT),
+                      bench_aio_callback, &bytes);
+        submit_ms += now_ms() - t;
+    }
+    aio_flush(&aio);
+    double total_ms = now_ms() - start;
+    printf("%-8s %.1f ms, %.0f MB/s, submit %.2f us/request, %d batches\n", name,
+           total_ms, bytes / 1e3 / total_ms, submit_ms * 1e3 / BENCH_AIO_FILES,
+           aio.stats.batches);
+    aio_destroy(&aio);
+}
+
+static void bench_aio() {
+    mkdir("/tmp/ngine_aio", 0755);
+    size_t size = 1 << 20;
+    unsigned char *data = (unsigned char *)malloc(size);
+    for (size_t i = 0; i < size; i++)
+        data[i] = (unsigned char)(i * 2654435761u >> 24);
+    char path[64];
+    for (int i = 0; i < BENCH_AIO_FILES; i++) {
+        snprintf(path, sizeof(path), "/tmp/ngine_aio/%d.bin", i);
+        FILE *f = fopen(path, "wb");
+        if (!f)
+            return;
+        fwrite(data, 1, size, f);
+        fclose(f);
+    }
+    free(data);
+
+    double start = now_ms();
+    long bytes = 0;
+    for (int i = 0; i < BENCH_AIO_FILES; i++) {
+        snprintf(path, sizeof(path), "/tmp/ngine_aio/%d.bin", i);
+        FILE *f = fopen(path, "rb");
+        if (!f)
+            continue;
+        unsigned char *copy = (unsigned char *)malloc(size);
+        bytes += fread(copy, 1, size, f);
+        fclose(f);
+        free(copy);
+    }
+    double blocking_ms = now_ms() - start;
+    printf("blocking %.1f ms, %.0f MB/s (%d x 1 MB)\n", blocking_ms,
+           bytes / 1e3 / blocking_ms, BENCH_AIO_FILES);
+    bench_aio_run("uring", true);
+    bench_aio_run("threads", false);
+}
+
+static void bench_bcn() {
+    const int size = 1024;
+    unsigned char *image = (unsigned char *)malloc((size_t)size * size * 4);
+    unsigned char *decoded = (unsigned char *)malloc((size_t)size * size * 4);
+    for (int y = 0; y < size; y++) {
+        for (int x = 0; x < size; x++) {
+            unsigned char *p = &image[((size_t)y * size + x) * 4];
+            float fx = x / (float)size, fy = y / (float)size;
+            p[0] = (unsigned char)(127.5f + 127.5f * sinf(fx * 40.0f + fy * 7.0f));
+            p[1] = (unsigned char)(255.0f * fy);
+            p[2] = (unsigned char)((x ^ y) & 255);
+            p[3] = (unsigned char)(255.0f * fx);
+        }
+    }
+
+    JobSystem jobs;
+    job_system_init(&jobs, 0);
+    static const char *names[BCN_FORMAT_COUNT] = {"bc1", "bc3", "bc4", "bc5", "bc7"};
+    static const int channels[BCN_FORMAT_COUNT] = {3, 4, 1, 2, 4};
+    for (int f = 0; f < BCN_FORMAT_COUNT; f++) {
+        BcnFormat format = (BcnFormat)f;
+        unsigned char *blocks = (unsigned char *)malloc(bcn_image_size(format, size, size));
+        double start = now_ms();
+        bcn_encode_image(format, image, size, size, blocks, NULL);
+        double single_ms = now_ms() - start;
+        start = now_ms();
+        bcn_encode_image(format, image, size, size, blocks, &jobs);
+        double threaded_ms = now_ms() - start;
+
+        bcn_decode_image(format, blocks, size, size, decoded);
+        double error = 0.0;
+        for (size_t i = 0; i < (size_t)size * size; i++) {
+            for (int c = 0; c < channels[f]; c++) {
+                double d = (double)decoded[i * 4 + c] - image[i * 4 + c];
+                error += d * d;
+            }
+        }
+        error /= (double)size * size * channels[f];
+        printf("%s %dx%d: %.1f ms (%.1f Mpix/s), %d threads %.1f ms, psnr %.2f dB\n",
+               names[f], size, size, single_ms, size * size / 1e3 / single_ms,
+               jobs.thread_count, threaded_ms, 10.0 * log10(255.0 * 255.0 / error));
+        free(blocks);
+    }
+    job_system_destroy(&jobs);
+    free(decoded);
+    free(image);
+}
+
+// Full chain from 4K and 8K sources, throughput counts source pixels
+static void bench_mip() {
+    JobSystem jobs;
+    job_system_init(&jobs, 0);
+    static const int sizes[] = {4096, 8192};
+    for (int s = 0; s < 2; s++) {
+        int size = sizes[s];
+        unsigned char *image = (unsigned char *)malloc((size_t)size * size * 4);
+        for (int y = 0; y < size; y++) {
+            for (int x = 0; x < size; x++) {
+                unsigned char *p = &image[((size_t)y * size + x) * 4];
+                p[0] = (unsigned char)(x * 255 / size);
+                p[1] = (unsigned char)(y * 255 / size);
+                p[2] = (unsigned char)((x ^ y) & 255);
+                p[3] = 255;
+            }
+        }
+
+        for (int f = 0; f < MIP_FILTER_COUNT; f++) {
+            MipChain chain;
+            double start = now_ms();
+            mip_chain_build(&chain, image, size, size, 0, (MipFilter)f, true, NULL);
+            double single_ms = now_ms() - start;
+            mip_chain_free(&chain);
+            start = now_ms();
+            mip_chain_build(&chain, image, size, size, 0, (MipFilter)f, true, &jobs);
+            double threaded_ms = now_ms() - start;
+            printf("mip %s %dx%d: %d levels, %.1f ms (%.0f Mpix/s), %d threads %.1f ms "
+                   "(%.0f Mpix/s)\n",
+                   mip_filter_name((MipFilter)f), size, size, chain.level_count,
+                   single_ms, (double)size * size / 1e3 / single_ms, jobs.thread_count,
+                   threaded_ms, (double)size * size / 1e3 / threaded_ms);
+            mip_chain_free(&chain);
+        }
+        free(image);
+    }
+    job_system_destroy(&jobs);
+}
+
+// Random sprite and decal sized rectangles into 2048x2048 pages, the way the
+// texture manager fills atlas layers
+static void bench_atlas() {
+    const int count = 20000;
+    int (*sizes)[2] = (int (*)[2])malloc(count * sizeof(*sizes));
+    srand(7);
+    for (int i = 0; i < count; i++) {
+        sizes[i][0] = 16 + rand() % 241;
+        sizes[i][1] = 16 + rand() % 241;
+    }
+
+    Atlas atlas;
+    atlas_init(&atlas, 2048, 2048);
+    int pages = 1, packed = 0;
+    double occupancy = 0.0;
+    double start = now_ms();
+    for (int i = 0; i < count; i++) {
+        int x, y;
+        if (!atlas_pack(&atlas, sizes[i][0], sizes[i][1], &x, &y)) {
+            occupancy += atlas_occupancy(&atlas);
+            atlas_reset(&atlas);
+            pages++;
+            atlas_pack(&atlas, sizes[i][0], sizes[i][1], &x, &y);
+        }
+        packed++;
+    }
+    double elapsed = now_ms() - start;
+    printf("atlas: %d rects into %d 2048x2048 pages in %.1f ms (%.2f us each), "
+           "%.1f%% average occupancy of full pages\n",
+           packed, pages, elapsed, elapsed * 1e3 / packed,
+           pages > 1 ? 100.0 * occupancy / (pages - 1) : 0.0);
+    atlas_destroy(&atlas);
+    free(sizes);
+}
+
+// No GL context here, so the entry points replay uses are pointed at no-ops
+// and replay time is only the cost of decoding the buffers
+static int bench_gl_draws;
+static void GLAD_API_PTR bench_gl_name(GLuint name) {}
+static void GLAD_API_PTR bench_gl_bind_texture(GLenum target, GLuint texture) {}
+static void GLAD_API_PTR bench_gl_uniform_matrix(GLint location, GLsizei count,
+                                                 GLboolean transpose, const GLfloat *value) {}
+static void GLAD_API_PTR bench_gl_draw_arrays(GLenum mode, GLint first, GLsizei count) {
+    bench_gl_draws++;
+}
+
+typedef struct BenchScene {
+    AnimatedInstance *instances;
+    Frustum frustum;
+    float time;
+} BenchScene;
+
+// Cull, animate and record one range of the scene, the work a frame hands
+// to each thread. Materials change every 1024 objects.
+static void bench_record_scene(CommandBuffer *buffer, int begin, int end, void *user) {
+    const BenchScene *scene = (const BenchScene *)user;
+    command_bind_vertex_array(buffer, 1);
+    for (int i = begin; i < end; i++) {
+        const AnimatedInstance *instance = &scene->instances[i];
+        if (!frustum_test_sphere(&scene->frustum, instance->position, 0.87f))
+            continue;
+        int material = (i >> 10) & 7;
+        command_use_program(buffer, 1 + material);
+        command_bind_texture(buffer, 0, GL_TEXTURE_2D, 100 + (material & 3));
+        mat4x4 model;
+        animation_instance_matrix(model, instance, scene->time);
+        command_uniform_mat4(buffer, 0, (const float *)model);
+        command_draw_arrays(buffer, GL_TRIANGLES, 0, 36);
+    }
+}
+
+static void bench_commands() {
+    glad_glUseProgram = bench_gl_name;
+    glad_glBindVertexArray = bench_gl_name;
+    glad_glActiveTexture = bench_gl_name;
+    glad_glBindTexture = bench_gl_bind_texture;
+    glad_glUniformMatrix4fv = bench_gl_uniform_matrix;
+    glad_glDrawArrays = bench_gl_draw_arrays;
+
+    const int count = 200000, frames = 20;
+    BenchScene scene;
+    scene.instances = (AnimatedInstance *)malloc(count * sizeof(AnimatedInstance));
+    srand(11);
+    for (int i = 0; i < count; i++) {
+        float position[3] = {(rand() % 2000) * 0.1f - 100.0f, (rand() % 600) * 0.1f - 30.0f,
+                             -(rand() % 2000) * 0.1f};
+        float axis[3] = {(float)(rand() % 100), (float)(rand() % 100), 50.0f};
+        animation_instance_init(&scene.instances[i], position, axis,
+                                0.5f + (rand() % 100) * 0.02f, (rand() % 628) * 0.01f);
+    }
+    mat4x4 view, projection, view_proj;
+    vec3 eye = {0.0f, 0.0f, 10.0f}, center = {0.0f, 0.0f, 0.0f}, up = {0.0f, 1.0f, 0.0f};
+    mat4x4_look_at(view, eye, center, up);
+    mat4x4_perspective(projection, 1.0f, 16.0f / 9.0f, 0.1f, 200.0f);
+    mat4x4_mul(view_proj, projection, view);
+    frustum_from_matrix(&scene.frustum, view_proj);
+
+    static const int worker_counts[] = {0, 1, 2, 4, 8};
+    for (int w = 0; w < 5; w++) {
+        int workers = worker_counts[w];
+        JobSystem jobs;
+        if (workers > 0)
+            job_system_init(&jobs, workers);
+        int buffer_count = workers + 1;
+        CommandBuffer *buffers =
+            (CommandBuffer *)malloc(buffer_count * sizeof(CommandBuffer));
+        for (int i = 0; i < buffer_count; i++)
+            command_buffer_init(&buffers[i], 1 << 16);
+
+        double record_ms = 0.0, replay_ms = 0.0;
+        for (int f = 0; f < frames; f++) {
+            scene.time = f / 60.0f;
+            double start = now_ms();
+            command_record_parallel(workers > 0 ? &jobs : NULL, buffers, buffer_count,
+                                    count, bench_record_scene, &scene);
+            double recorded = now_ms();
+            bench_gl_draws = 0;
+            command_buffers_execute(buffers, buffer_count);
+            record_ms += recorded - start;
+            replay_ms += now_ms() - recorded;
+        }
+
+        int commands = 0, draws = 0;
+        size_t bytes = 0;
+        for (int i = 0; i < buffer_count; i++) {
+            commands += buffers[i].command_count;
+            draws += buffers[i].draw_count;
+            bytes += buffers[i].size * sizeof(CommandWord);
+        }
+        printf("commands %d workers: record %.2f ms, replay %.2f ms, main thread %.2f ms "
+               "per frame; %d of %d visible, %d commands in %.0f KB, %d replayed\n",
+               workers, record_ms / frames, replay_ms / frames,
+               (record_ms + replay_ms) / frames, draws, count, commands, bytes / 1024.0,
+               bench_gl_draws);
+
+        for (int i = 0; i < buffer_count; i++)
+            command_buffer_destroy(&buffers[i]);
+        free(buffers);
+        if (workers > 0)
+            job_system_destroy(&jobs);
+    }
+    free(scene.instances);
+}
+
+int main(int argc, char **argv) {
+    const char *which = argc > 1 ? argv[1] : "all";
+    bool all = strcmp(which, "all") == 0;
+
+    if (all || strcmp(which, "lod") == 0)
+        bench_lod();
+    if (all || strcmp(which, "meshlet") == 0)
+        bench_meshlet();
+    if (all || strcmp(which, "load") == 0)
+        bench_load(argc > 2 ? argv[2] : NULL);
+    if (all || strcmp(which, "cache") == 0)
+        bench_cache();
+    if (all || strcmp(which, "pak") == 0)
+        bench_pak();
+    if (all || strcmp(which, "aio") == 0)
+        bench_aio();
+    if (all || strcmp(which, "bcn") == 0)
+        bench_bcn();
+    if (all || strcmp(which, "mip") == 0)
+        bench_mip();
+    if (all || strcmp(which, "atlas") == 0)
+        bench_atlas();
+    if (all || strcmp(which, "commands") == 0)
+        bench_commands();
+
+    return 0;
+}
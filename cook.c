@@ -0,0 +1,224 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "stb_image.h"
+
+#include "bcn.h"
+#include "job.h"
+#include "ktx2.h"
+#include "loader.h"
+#include "lod.h"
+#include "mesh.h"
+#include "mesh_cache.h"
+#include "meshlet.h"
+#include "mip.h"
+#include "pak.h"
+#include "vfs.h"
+
+static double now_ms() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e3 + ts.tv_nsec * 1e-6;
+}
+
+static bool has_suffix(const char *path, const char *suffix) {
+    size_t length = strlen(path), suffix_length = strlen(suffix);
+    return length >= suffix_length &&
+           strcmp(path + length - suffix_length, suffix) == 0;
+}
+
+static void usage() {
+    fprintf(stderr, "usage: cook mesh <input.obj|input.glb> <output.ngm> "
+                    "[--lods N] [--no-meshlets]\n"
+                    "       cook pak <output.pak> [--store] <files...>\n"
+                    "       cook texture <input> <output.ktx2> "
+                    "[--format bc1|bc3|bc4|bc5|bc7] [--srgb] [--no-mips]\n"
+                    "             [--filter box|kaiser|lanczos]\n");
+    exit(EXIT_FAILURE);
+}
+
+static int cook_mesh(int argc, char **argv) {
+    if (argc < 4)
+        usage();
+    const char *input = argv[2], *output = argv[3];
+    int lods = 4;
+    bool meshlets = true;
+    for (int i = 4; i < argc; i++) {
+        if (strcmp(argv[i], "--lods") == 0 && i + 1 < argc)
+            lods = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--no-meshlets") == 0)
+            meshlets = false;
+        else
+            usage();
+    }
+
+    double start = now_ms();
+    Mesh mesh;
+    LoadStats stats;
+    bool ok = has_suffix(input, ".glb") ? glb_load(input, &mesh, &stats)
+                                        : obj_load(input, &mesh, &stats);
+    if (!ok)
+        return EXIT_FAILURE;
+    printf("loaded %s: %d vertices, %d triangles (%.1f ms)\n", input,
+           mesh.vertex_count, mesh.index_count / 3, now_ms() - start);
+
+    LodChain chain;
+    lod_chain_build(&chain, &mesh, lods > 0 ? lods : 1, 0.5f);
+    printf("lod chain: %d levels\n", chain.level_count);
+
+    MeshletSet set;
+    if (meshlets) {
+        meshlet_build(&set, &mesh);
+        printf("meshlets: %d\n", set.meshlet_count);
+    }
+
+    ok = mesh_cache_write(output, &mesh, &chain, meshlets ? &set : NULL);
+    printf("wrote %s in %.1f ms total\n", output, now_ms() - start);
+
+    if (meshlets)
+        meshlet_set_free(&set);
+    lod_chain_free(&chain);
+    mesh_free(&mesh);
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+static int cook_pak(int argc, char **argv) {
+    if (argc < 4)
+        usage();
+    const char *output = argv[2];
+    bool compress = true;
+    const char **files = (const char **)malloc(argc * sizeof(char *));
+    int count = 0;
+    for (int i = 3; i < argc; i++) {
+        if (strcmp(argv[i], "--store") == 0)
+            compress = false;
+        else
+            files[count++] = argv[i];
+    }
+
+    // Entries are named by the path they were packed from
+    double start = now_ms();
+    bool ok = pak_write(output, files, files, count, compress);
+    free(files);
+    if (!ok)
+        return EXIT_FAILURE;
+
+    Pak pak;
+    if (!pak_open(&pak, output))
+        return EXIT_FAILURE;
+    uint64_t size = 0, stored = 0;
+    int compressed = 0;
+    for (uint32_t i = 0; i < pak.header->entry_count; i++) {
+        const PakEntry *entry = &pak.entries[i];
+        size += entry->size;
+        stored += entry->stored_size;
+        compressed += (entry->flags & PAK_ENTRY_LZ4) != 0;
+    }
+    printf("wrote %s: %d entries (%d lz4), %.1f MB -> %.1f MB, %.1f MB on disk "
+           "in %.1f ms\n",
+           output, count, compressed, size / 1e6, stored / 1e6,
+           pak.file.size / 1e6, now_ms() - start);
+    pak_close(&pak);
+    return EXIT_SUCCESS;
+}
+
+static int cook_texture(int argc, char **argv) {
+    if (argc < 4)
+        usage();
+    const char *input = argv[2], *output = argv[3];
+    static const char *names[BCN_FORMAT_COUNT] = {"bc1", "bc3", "bc4", "bc5", "bc7"};
+    int format = -1;
+    MipFilter filter = MIP_FILTER_KAISER;
+    bool srgb = false, mips = true;
+    for (int i = 4; i < argc; i++) {
+        if (strcmp(argv[i], "--format") == 0 && i + 1 < argc) {
+            i++;
+            for (int f = 0; f < BCN_FORMAT_COUNT; f++)
+                if (strcmp(argv[i], names[f]) == 0)
+                    format = f;
+            if (format < 0)
+                usage();
+        } else if (strcmp(argv[i], "--filter") == 0 && i + 1 < argc) {
+            i++;
+            int f = 0;
+            while (f < MIP_FILTER_COUNT && strcmp(argv[i], mip_filter_name((MipFilter)f)) != 0)
+                f++;
+            if (f == MIP_FILTER_COUNT)
+                usage();
+            filter = (MipFilter)f;
+        } else if (strcmp(argv[i], "--srgb") == 0) {
+            srgb = true;
+        } else if (strcmp(argv[i], "--no-mips") == 0) {
+            mips = false;
+        } else {
+            usage();
+        }
+    }
+
+    double start = now_ms();
+    VfsFile file;
+    if (!vfs_open(&file, input))
+        return EXIT_FAILURE;
+    int width, height, channels;
+    unsigned char *pixels = stbi_load_from_memory(file.data, (int)file.size, &width,
+                                                  &height, &channels, 4);
+    vfs_close(&file);
+    if (!pixels) {
+        fprintf(stderr, "Error: cannot decode %s: %s\n", input, stbi_failure_reason());
+        return EXIT_FAILURE;
+    }
+
+    // Images with alpha need it kept, opaque ones fit in half the space
+    if (format < 0)
+        format = channels == 4 || channels == 2 ? BCN_BC7 : BCN_BC1;
+    if (format == BCN_BC4 || format == BCN_BC5)
+        srgb = false;
+
+    JobSystem jobs;
+    job_system_init(&jobs, 0);
+    MipChain chain;
+    mip_chain_build(&chain, pixels, width, height, mips ? KTX2_MAX_LEVELS : 1, filter,
+                    srgb, &jobs);
+
+    const uint8_t *levels[KTX2_MAX_LEVELS];
+    size_t sizes[KTX2_MAX_LEVELS];
+    int level_count = chain.level_count;
+    size_t total = 0;
+    for (int i = 0; i < level_count; i++) {
+        int w = chain.widths[i], h = chain.heights[i];
+        sizes[i] = bcn_image_size((BcnFormat)format, w, h);
+        uint8_t *blocks = (uint8_t *)malloc(sizes[i]);
+        bcn_encode_image((BcnFormat)format, chain.levels[i], w, h, blocks, &jobs);
+        levels[i] = blocks;
+        total += sizes[i];
+    }
+    mip_chain_free(&chain);
+    stbi_image_free(pixels);
+    job_system_destroy(&jobs);
+
+    bool ok = ktx2_write(output, ktx2_vk_format((BcnFormat)format, srgb), width, height,
+                         level_count, levels, sizes);
+    printf("wrote %s: %dx%d %s%s, %d %s levels, %.1f KB (%.1f KB as RGBA8) in %.1f ms\n",
+           output, width, height, names[format], srgb ? " srgb" : "", level_count,
+           mip_filter_name(filter),
+           total / 1024.0, width * height * 4 * (mips ? 4.0 / 3.0 : 1.0) / 1024.0,
+           now_ms() - start);
+    for (int i = 0; i < level_count; i++)
+        free((void *)levels[i]);
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+int main(int argc, char **argv) {
+    if (argc < 2)
+        usage();
+    if (strcmp(argv[1], "mesh") == 0)
+        return cook_mesh(argc, argv);
+    if (strcmp(argv[1], "pak") == 0)
+        return cook_pak(argc, argv);
+    if (strcmp(argv[1], "texture") == 0)
+        return cook_texture(argc, argv);
+    usage();
+    return EXIT_FAILURE;
+}
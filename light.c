@@ -3,44 +3,18 @@
 #define GLFW_INCLUDE_NONE
 #include <GLFW/glfw3.h>
 
-#define STB_IMAGE_IMPLEMENTATION
-#include "stb_image.h"
-
 #include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
 
 #include "camera.h"
+#include "csm.h"
 #include "cube.h"
 #include "linmath.h"
+#include "shader.h"
+#include "shadow.h"
 #include "window.h"
 
-static const char *vertex_shader_text =
-    "#version 330 core\n"
-    "layout (location = 0) in vec3 aPos;      // Vertex position\n"
-    "\n"
-    // "uniform mat4 model;\n"
-    // "uniform mat4 view;\n"
-    // "uniform mat4 projection;\n"
-    "\n"
-    "void main()\n"
-    "{\n"
-    // "    gl_Position = projection * view * model * vec4(aPos, 1.0);\n"
-    "    gl_Position = vec4(aPos, 1.0);\n"
-    "}\n";
-
-static const char *fragment_shader_text =
-    "#version 330 core\n"
-    "out vec4 FragColor;\n"
-    "\n"
-    // "uniform vec3 objectColor;\n"
-    // "uniform vec3 lightColor;\n"
-    "\n"
-    "void main()\n"
-    "{\n"
-    "    FragColor = vec4(1.0);\n"
-    "}\n";
-
 static void error_callback(int error, const char *description) {
     fprintf(stderr, "Error: %s\n", description);
 }
@@ -141,23 +115,41 @@ void init_buffers(unsigned int VAO, unsigned int VBO) {
     glEnableVertexAttribArray(0);
 }
 
-GLuint init_shaders() {
-    const GLuint vertex_shader = glCreateShader(GL_VERTEX_SHADER);
-    glShaderSource(vertex_shader, 1, &vertex_shader_text, NULL);
-    glCompileShader(vertex_shader);
-
-    const GLuint fragment_shader = glCreateShader(GL_FRAGMENT_SHADER);
-    glShaderSource(fragment_shader, 1, &fragment_shader_text, NULL);
-    glCompileShader(fragment_shader);
-
-    const GLuint program = glCreateProgram();
-    glAttachShader(program, vertex_shader);
-    glAttachShader(program, fragment_shader);
-    glLinkProgram(program);
-
-    glDeleteShader(fragment_shader);
-    glDeleteShader(vertex_shader);
-    return program;
+typedef struct ShadowCasters {
+    ShaderProgram *shader;
+    UniformId light_view_proj_id;
+    UniformId model_id;
+    GLuint vao;
+    vec3 *static_positions;
+    int static_count;
+    // The orbiting cube, redrawn into the atlas every frame
+    mat4x4 dynamic_model;
+} ShadowCasters;
+
+static void draw_shadow_casters(mat4x4 light_view_proj, bool dynamic,
+                                void *user) {
+    ShadowCasters *casters = (ShadowCasters *)user;
+    UniformTable *uniforms = &casters->shader->uniforms;
+    glUseProgram(casters->shader->program);
+    uniform_set_mat4(uniforms, casters->light_view_proj_id,
+                     (const float *)light_view_proj);
+    glBindVertexArray(casters->vao);
+    if (dynamic) {
+        uniform_set_mat4(uniforms, casters->model_id,
+                         (const float *)casters->dynamic_model);
+        uniform_table_upload(uniforms);
+        glDrawArrays(GL_TRIANGLES, 0, 36);
+        return;
+    }
+    for (int i = 0; i < casters->static_count; i++) {
+        mat4x4 m;
+        mat4x4_translate(m, casters->static_positions[i][0],
+                         casters->static_positions[i][1],
+                         casters->static_positions[i][2]);
+        uniform_set_mat4(uniforms, casters->model_id, (const float *)m);
+        uniform_table_upload(uniforms);
+        glDrawArrays(GL_TRIANGLES, 0, 36);
+    }
 }
 
 int main(void) {
@@ -189,7 +181,68 @@ int main(void) {
     glGenBuffers(1, &VBO);
 
     init_buffers(VAO, VBO);
-    GLuint program = init_shaders();
+    ShaderLibrary shaders;
+    shader_library_init(&shaders, "shaders", window);
+    ShaderProgram *program = shader_load(&shaders, "lit.vert", "lit.frag");
+
+    ShadowCasters casters;
+    casters.shader = shader_load(&shaders, "depth.vert", "depth.frag");
+    if (!program || !casters.shader)
+        exit(EXIT_FAILURE);
+    casters.light_view_proj_id = uniform_id("light_view_proj");
+    casters.model_id = uniform_id("model");
+    casters.vao = VAO;
+    casters.static_positions = &cube_pos;
+    casters.static_count = 1;
+
+    // The light does not move, so its tile is rendered once and then served
+    // from the cache until something calls shadow_atlas_invalidate_static.
+    ShadowAtlas shadow_atlas;
+    shadow_atlas_init(&shadow_atlas, 2048, 1024);
+    int light_tile = shadow_atlas_alloc(&shadow_atlas);
+    mat4x4 light_view, light_proj, light_view_proj;
+    vec3 light_up = {0.0f, 1.0f, 0.0f};
+    mat4x4_look_at(light_view, light_pos, cube_pos, light_up);
+    mat4x4_perspective(light_proj, 1.2f, 1.0f, 0.1f, 20.0f);
+    mat4x4_mul(light_view_proj, light_proj, light_view);
+    shadow_atlas_set_light(&shadow_atlas, light_tile, light_view_proj);
+
+    vec3 sun_dir = {-0.3f, -1.0f, -0.2f};
+    CascadedShadows sun_shadows;
+    csm_init(&sun_shadows, 3, 2048, 0.75f);
+    csm_bind_instances(&sun_shadows, VAO);
+    // The cube and the orbiting one, whose matrix is refreshed every frame
+    ShadowCaster sun_casters[2];
+    mat4x4_translate(sun_casters[0].model, cube_pos[0], cube_pos[1],
+                     cube_pos[2]);
+    vec3_dup(sun_casters[0].center, cube_pos);
+    sun_casters[0].radius = 0.87f;
+    sun_casters[1] = sun_casters[0];
+    float last_report = 0.0f;
+
+    // Receives both shadows but casts neither
+    mat4x4 ground;
+    mat4x4_translate(ground, 0.0f, -0.55f, 0.0f);
+    mat4x4_scale_aniso(ground, ground, 12.0f, 0.1f, 12.0f);
+    const float orbit_radius = 1.3f, orbit_size = 0.3f;
+    const UniformId model_id = uniform_id("model");
+    const UniformId view_id = uniform_id("view");
+    const UniformId projection_id = uniform_id("projection");
+    const UniformId object_color_id = uniform_id("objectColor");
+    const UniformId light_color_id = uniform_id("lightColor");
+    const UniformId light_pos_id = uniform_id("light_pos");
+    const UniformId shadow_atlas_id = uniform_id("shadow_atlas");
+    const UniformId light_view_proj_id = uniform_id("light_view_proj");
+    const UniformId shadow_rect_id = uniform_id("shadow_rect");
+    const UniformId sun_shadow_id = uniform_id("sun_shadow");
+    const UniformId cascade_view_proj_id = uniform_id("cascade_view_proj");
+    const UniformId cascade_far_id = uniform_id("cascade_far");
+    const UniformId cascade_count_id = uniform_id("cascade_count");
+    const UniformId sun_dir_id = uniform_id("sun_dir");
+    const UniformId sun_color_id = uniform_id("sun_color");
+    vec3 sun_color = {0.5f, 0.5f, 0.45f};
+    vec4 shadow_rect;
+    shadow_atlas_tile_rect(&shadow_atlas, light_tile, shadow_rect);
 
     mat4x4 model, view, projection;
     mat4x4_identity(model);
@@ -227,6 +280,20 @@ int main(void) {
 
     glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
     while (!glfwWindowShouldClose(window)) {
+        shader_library_poll(&shaders);
+
+        // Only tiles the orbiting cube touches are recomposited
+        float angle = (float)glfwGetTime();
+        vec3 orbit = {orbit_radius * cosf(angle), 0.2f, orbit_radius * sinf(angle)};
+        mat4x4_translate(casters.dynamic_model, orbit[0], orbit[1], orbit[2]);
+        mat4x4_scale_aniso(casters.dynamic_model, casters.dynamic_model, orbit_size,
+                           orbit_size, orbit_size);
+        shadow_atlas_touch_dynamic(&shadow_atlas, orbit, orbit_size);
+        mat4x4_dup(sun_casters[1].model, casters.dynamic_model);
+        vec3_dup(sun_casters[1].center, orbit);
+        sun_casters[1].radius = orbit_size * 0.87f;
+        shadow_atlas_update(&shadow_atlas, draw_shadow_casters, &casters);
+
         int width, height;
         glfwGetFramebufferSize(window, &width, &height);
         glViewport(0, 0, width, height);
@@ -250,15 +317,66 @@ int main(void) {
         vec3_add(tmp, camera.position, front);
         mat4x4_look_at(view, camera.position, tmp, up);
 
+        csm_update(&sun_shadows, view, zoom, width / (float)height, 0.1f,
+                   100.0f, sun_dir);
+        csm_cull(&sun_shadows, sun_casters, 2);
+        csm_render(&sun_shadows, VAO, 36);
+        if (current_frame - last_report > 1.0f) {
+            for (int c = 0; c < sun_shadows.cascade_count; c++) {
+                const Cascade *cascade = &sun_shadows.cascades[c];
+                printf("cascade %d [%.1f, %.1f]: %d casters, %.3f ms\n", c,
+                       cascade->split_near, cascade->split_far,
+                       cascade->instance_count, cascade->gpu_ms);
+            }
+            last_report = current_frame;
+        }
+
         // glUniform3f(lightLoc, lightColor[0], lightColor[1], lightColor[2]);
         // glUniform3f(colorLoc, toyColor[0], toyColor[1], toyColor[2]);
-        glUseProgram(program);
-        mat4x4 m, scaled;
-        mat4x4_identity(m);
+        UniformTable *uniforms = &program->uniforms;
+        glUseProgram(program->program);
+        int unit = uniform_texture_unit(uniforms, shadow_atlas_id);
+        if (unit >= 0) {
+            glActiveTexture(GL_TEXTURE0 + unit);
+            glBindTexture(GL_TEXTURE_2D, shadow_atlas.depth);
+        }
+        uniform_set_mat4(uniforms, view_id, (const float *)view);
+        uniform_set_mat4(uniforms, projection_id, (const float *)projection);
+        uniform_set_vec3(uniforms, light_color_id, lightColor);
+        uniform_set_vec3(uniforms, light_pos_id, light_pos);
+        uniform_set_mat4(uniforms, light_view_proj_id, (const float *)light_view_proj);
+        uniform_set_vec4(uniforms, shadow_rect_id, shadow_rect);
+
+        unit = uniform_texture_unit(uniforms, sun_shadow_id);
+        if (unit >= 0) {
+            glActiveTexture(GL_TEXTURE0 + unit);
+            glBindTexture(GL_TEXTURE_2D_ARRAY, sun_shadows.depth_array);
+        }
+        mat4x4 cascade_view_proj[CSM_MAX_CASCADES];
+        float cascade_far[CSM_MAX_CASCADES];
+        for (int c = 0; c < sun_shadows.cascade_count; c++) {
+            mat4x4_dup(cascade_view_proj[c], sun_shadows.cascades[c].view_proj);
+            cascade_far[c] = sun_shadows.cascades[c].split_far;
+        }
+        uniform_set(uniforms, cascade_view_proj_id, cascade_view_proj,
+                    sun_shadows.cascade_count * sizeof(mat4x4));
+        uniform_set(uniforms, cascade_far_id, cascade_far,
+                    sun_shadows.cascade_count * sizeof(float));
+        uniform_set_int(uniforms, cascade_count_id, sun_shadows.cascade_count);
+        uniform_set_vec3(uniforms, sun_dir_id, sun_dir);
+        uniform_set_vec3(uniforms, sun_color_id, sun_color);
+
+        mat4x4 m;
         mat4x4_translate(m, cube_pos[0], cube_pos[1], cube_pos[2]);
-
+        mat4x4 *models[3] = {&m, &casters.dynamic_model, &ground};
+        vec3 grey = {0.8f, 0.8f, 0.8f};
         glBindVertexArray(VAO);
-        glDrawArrays(GL_TRIANGLES, 0, 36);
+        for (int i = 0; i < 3; i++) {
+            uniform_set_mat4(uniforms, model_id, (const float *)*models[i]);
+            uniform_set_vec3(uniforms, object_color_id, i == 2 ? grey : toyColor);
+            uniform_table_upload(uniforms);
+            glDrawArrays(GL_TRIANGLES, 0, 36);
+        }
         // glUniformMatrix4fv(modelLoc, 1, GL_FALSE, (const GLfloat *)m);
         // glUniformMatrix4fv(viewLoc, 1, GL_FALSE, (const GLfloat *)view);
         // glUniformMatrix4fv(projectionLoc, 1, GL_FALSE,
@@ -268,9 +386,12 @@ int main(void) {
         glfwPollEvents();
     }
 
+    csm_destroy(&sun_shadows);
+    shadow_atlas_destroy(&shadow_atlas);
+    shader_library_destroy(&shaders);
+
     glDeleteVertexArrays(1, &VAO);
     glDeleteBuffers(1, &VBO);
-    glDeleteProgram(program);
 
     glfwDestroyWindow(window);
 
@@ -3,15 +3,22 @@
 #define GLFW_INCLUDE_NONE
 #include <GLFW/glfw3.h>
 
-#define STB_IMAGE_IMPLEMENTATION
-#include "stb_image.h"
-
 #include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
 
+#include "aio.h"
+#include "animation.h"
 #include "camera.h"
+#include "frame_pacer.h"
+#include "input.h"
 #include "linmath.h"
+#include "render_thread.h"
+#include "shader.h"
+#include "texture.h"
+#include "vfs.h"
 #include "window.h"
 
 typedef struct Vertex {
@@ -20,6 +27,12 @@ typedef struct Vertex {
 } Vertex;
 
 static float x = 0.0;
+// G switches between per-cube matrices on the CPU and animating on the GPU
+static bool gpu_animation = true;
+// P freezes the cubes, which lets the on demand mode go idle
+static bool animation_paused = false;
+// Set by anything that changes what is on screen
+static bool frame_dirty = true;
 
 static const Vertex vertices[8] = {
     {{-0.5f, 0.5f, 0.5f}, {1.f, 0.f, 0.f}},
@@ -32,139 +45,219 @@ static const Vertex vertices[8] = {
     {{0.5f, 0.5f, -0.5f}, {1.f, 0.f, 0.f}},
 };
 
-static const char *vertex_shader_text =
-    "#version 330 core\n"
-    "layout (location = 0) in vec3 aPos;      // Vertex position\n"
-    "layout (location = 1) in vec3 aColor;    // Color\n"
-    "layout (location = 2) in vec2 aTexCoord; // Texture coordinate\n"
-    "\n"
-    "out vec2 TexCoord;\n"
-    "uniform mat4 model;\n"
-    "uniform mat4 view;\n"
-    "uniform mat4 projection;\n"
-    "\n"
-    "void main()\n"
-    "{\n"
-    "    gl_Position = projection * view * model * vec4(aPos, 1.0);\n"
-    "    TexCoord = aTexCoord;\n"
-    "}\n";
-
-static const char *fragment_shader_text =
-    "#version 330 core\n"
-    "out vec4 FragColor;\n"
-    "in vec2 TexCoord;\n"
-    "\n"
-    "uniform sampler2D texture1;\n"
-    "uniform vec3 objectColor;\n"
-    "uniform vec3 lightColor;\n"
-    "\n"
-    "void main()\n"
-    "{\n"
-    "    FragColor = texture(texture1, TexCoord) * vec4(lightColor * objectColor, 1.0);\n"
-    "}\n";
-
-static const char *fragment_light_shader_text =
-    "#version 330 core\n"
-    "out vec4 FragColor;\n"
-    "\n"
-    "void main()\n"
-    "{\n"
-    "    FragColor = vec4(1.0);\n"
-    "}\n";
 static void error_callback(int error, const char *description) {
     fprintf(stderr, "Error: %s\n", description);
 }
 
-static void key_callback(GLFWwindow *window, int key, int scancode, int action,
-                         int mods) {
-    if (key == GLFW_KEY_Q && action == GLFW_PRESS)
+// What the bound keys and buttons do
+enum {
+    ACTION_FORWARD,
+    ACTION_BACK,
+    ACTION_LEFT,
+    ACTION_RIGHT,
+    ACTION_NUDGE_LEFT,
+    ACTION_NUDGE_RIGHT,
+    ACTION_QUIT,
+    ACTION_TOGGLE_GPU,
+    ACTION_PAUSE,
+    ACTION_PRINT_CAMERA
+};
+
+static void bind_actions(Input *input) {
+    input_bind_key(input, GLFW_KEY_W, ACTION_FORWARD);
+    input_bind_key(input, GLFW_KEY_S, ACTION_BACK);
+    input_bind_key(input, GLFW_KEY_A, ACTION_LEFT);
+    input_bind_key(input, GLFW_KEY_D, ACTION_RIGHT);
+    input_bind_key(input, GLFW_KEY_LEFT, ACTION_NUDGE_LEFT);
+    input_bind_key(input, GLFW_KEY_RIGHT, ACTION_NUDGE_RIGHT);
+    input_bind_key(input, GLFW_KEY_Q, ACTION_QUIT);
+    input_bind_key(input, GLFW_KEY_G, ACTION_TOGGLE_GPU);
+    input_bind_key(input, GLFW_KEY_P, ACTION_PAUSE);
+    input_bind_mouse_button(input, GLFW_MOUSE_BUTTON_1, ACTION_PRINT_CAMERA);
+}
+
+float yaw = 280.0f, pitch = 1.0f;
+float zoom = 1.0f;
+
+// Acts on the events the last input_update applied
+static void handle_input(const Input *input, GLFWwindow *window) {
+    if (input_pressed(input, ACTION_QUIT))
         glfwSetWindowShouldClose(window, GLFW_TRUE);
+    if (input_pressed(input, ACTION_TOGGLE_GPU)) {
+        gpu_animation = !gpu_animation;
+        printf("animation on the %s\n", gpu_animation ? "GPU" : "CPU");
+    }
+    if (input_pressed(input, ACTION_PAUSE))
+        animation_paused = !animation_paused;
+    if (input_pressed(input, ACTION_PRINT_CAMERA)) {
+        printf("yaw: %f pitch: %f\n", yaw, pitch);
+        fflush(stdout);
+    }
 
-    // Input handling
-    if (glfwGetKey(window, GLFW_KEY_LEFT) == GLFW_PRESS) {
+    if (input_down(input, ACTION_NUDGE_LEFT)) {
         // Move player left
         x -= 0.01f;
     }
-
-    if (glfwGetKey(window, GLFW_KEY_RIGHT) == GLFW_PRESS) {
+    if (input_down(input, ACTION_NUDGE_RIGHT)) {
         // Move player right
         x += 0.01f;
     }
-}
-
-float last_x = -1.0;
-float last_y = -1.0;
-float yaw = 280.0f, pitch = 1.0f;
-static void mouse_callback(GLFWwindow *window, int button, int action,
-                           int mods) {
-    if (button == GLFW_MOUSE_BUTTON_1 && action == GLFW_PRESS) {
-        printf("yaw: %f pitch: %f\n", yaw, pitch);
-        fflush(stdout);
-    }
-}
-static void cursor_callback(GLFWwindow *window, double xpos, double ypos) {
-    if (last_x < 0)
-        last_x = xpos;
-    if (last_y < 0)
-        last_y = ypos;
-    float offset_x = xpos - last_x;
-    float offset_y = ypos - last_y;
-    last_x = xpos;
-    last_y = ypos;
-
-    const float sensitivity = 0.001f;
-    offset_x += sensitivity;
-    offset_y += sensitivity;
-
-    yaw += offset_x;
-    pitch += offset_y;
 
+    yaw += input->look_x;
+    pitch += input->look_y;
     if (pitch > 89.0f)
         pitch = 89.0f;
     if (pitch < -89.0f)
         pitch = -89.0f;
-}
 
-float zoom = 1.0f;
-void scroll_callback(GLFWwindow *window, double xoffset, double yoffset) {
-    zoom -= (float)yoffset;
+    zoom -= input->scroll_y;
     if (zoom < 1.0f)
         zoom = 1.0f;
     if (zoom > 45.0f)
         zoom = 45.0f;
 }
 
-void processInput(GLFWwindow *window, float delta_time, vec3 pos, vec3 front,
+// Resizes and the window being uncovered
+static void framebuffer_size_callback(GLFWwindow *window, int width, int height) {
+    frame_dirty = true;
+}
+
+static void refresh_callback(GLFWwindow *window) {
+    frame_dirty = true;
+}
+
+// Returns true when the camera moved
+bool processInput(const Input *input, float delta_time, vec3 pos, vec3 front,
                   vec3 up) {
     const float speed = 2.5f * delta_time; // adjust accordingly
     vec3 tmp_pos, tmp_front, tmp_cross, tmp_norm;
-    if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS) {
+    if (input_down(input, ACTION_FORWARD)) {
         vec3_scale(tmp_front, front, speed);
         vec3_dup(tmp_pos, pos);
         vec3_add(pos, tmp_pos, tmp_front);
     }
-    if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS) {
+    if (input_down(input, ACTION_BACK)) {
         vec3_scale(tmp_front, front, -speed);
         vec3_dup(tmp_pos, pos);
         vec3_add(pos, tmp_pos, tmp_front);
     }
-    if (glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS) {
+    if (input_down(input, ACTION_LEFT)) {
         vec3_mul_cross(tmp_cross, front, up);
         vec3_norm(tmp_norm, tmp_cross);
         vec3_scale(tmp_front, tmp_norm, -speed);
         vec3_dup(tmp_pos, pos);
         vec3_add(pos, tmp_pos, tmp_front);
     }
-    if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS) {
+    if (input_down(input, ACTION_RIGHT)) {
         vec3_mul_cross(tmp_cross, front, up);
         vec3_norm(tmp_norm, tmp_cross);
         vec3_scale(tmp_front, tmp_norm, speed);
         vec3_dup(tmp_pos, pos);
         vec3_add(pos, tmp_pos, tmp_front);
     }
+    return input_down(input, ACTION_FORWARD) || input_down(input, ACTION_BACK) ||
+           input_down(input, ACTION_LEFT) || input_down(input, ACTION_RIGHT);
+}
+
+static float random_range(unsigned int *seed, float low, float high) {
+    *seed = *seed * 1664525u + 1013904223u;
+    return low + (high - low) * (*seed >> 8) / 16777216.0f;
+}
+
+static void on_texture_read(AioResult *result) {
+    GLuint *texture = (GLuint *)result->user;
+    if (result->status == AIO_DONE)
+        *texture = texture_from_memory(result->path, result->data, result->size);
+    free(result->data);
+}
+
+enum { DRAW_CUBES, DRAW_CUBES_ANIMATED, DRAW_LAMP };
+// Packet flags: an idle frame that only picks up finished loads
+enum { FRAME_POLL_ONLY = 1 };
+
+// How long the on demand mode sleeps without events before polling loads
+#define ON_DEMAND_TIMEOUT 0.1
+// Simulation step while recording or replaying input
+#define FIXED_TIMESTEP (1.0 / 60.0)
+
+// What render_frame draws with. Once the frame loop starts only the thread
+// that owns the context touches it.
+typedef struct Scene {
+    AsyncIo *io;
+    ShaderLibrary *shaders;
+    ShaderProgram *program;
+    ShaderProgram *light_program;
+    ShaderProgram *animated_program;
+    GLuint vao;
+    GLuint light_vao;
+    GLuint *texture;
+    vec3 light_color;
+    vec3 object_color;
+    // A texture or shader landed during a poll only frame, read by the main
+    // thread with atomics
+    bool changed;
+    UniformId model_id, view_id, projection_id, light_color_id, object_color_id;
+    UniformId texture_id, time_id;
+} Scene;
+
+static bool render_frame(const FramePacket *packet, void *user) {
+    Scene *scene = (Scene *)user;
+    // Both may create GL objects, so they run where the context is
+    int reloads = scene->shaders->stats.reloads;
+    bool changed = aio_poll(scene->io) > 0;
+    shader_library_poll(scene->shaders);
+    changed = changed || scene->shaders->stats.reloads != reloads;
+    if (packet->flags & FRAME_POLL_ONLY) {
+        if (changed)
+            __atomic_store_n(&scene->changed, true, __ATOMIC_RELEASE);
+        return false;
+    }
+
+    glViewport(0, 0, packet->width, packet->height);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    for (int i = 0; i < packet->draw_count; i++) {
+        const FrameDraw *draw = &packet->draws[i];
+        const mat4x4 *instances = packet->instances + draw->first_instance;
+        ShaderProgram *shader = draw->kind == DRAW_LAMP ? scene->light_program
+                                : draw->kind == DRAW_CUBES_ANIMATED ? scene->animated_program
+                                                                    : scene->program;
+        UniformTable *uniforms = &shader->uniforms;
+        glUseProgram(shader->program);
+        int unit = uniform_texture_unit(uniforms, scene->texture_id);
+        if (unit >= 0) {
+            glActiveTexture(GL_TEXTURE0 + unit);
+            glBindTexture(GL_TEXTURE_2D, *scene->texture);
+        }
+        // Only values that changed since the last upload reach GL
+        uniform_set_mat4(uniforms, scene->view_id, (const float *)packet->view);
+        uniform_set_mat4(uniforms, scene->projection_id, (const float *)packet->projection);
+        uniform_set_vec3(uniforms, scene->light_color_id, scene->light_color);
+        uniform_set_vec3(uniforms, scene->object_color_id, scene->object_color);
+
+        glBindVertexArray(draw->kind == DRAW_LAMP ? scene->light_vao : scene->vao);
+        if (draw->kind == DRAW_CUBES_ANIMATED) {
+            uniform_set_float(uniforms, scene->time_id, packet->time);
+            uniform_table_upload(uniforms);
+            glDrawArraysInstanced(GL_TRIANGLES, 0, 36, draw->instance_count);
+            continue;
+        }
+        for (int j = 0; j < draw->instance_count; j++) {
+            uniform_set_mat4(uniforms, scene->model_id, (const float *)instances[j]);
+            uniform_table_upload(uniforms);
+            glDrawArrays(GL_TRIANGLES, 0, 36);
+        }
+    }
+    return true;
 }
 
-int main(void) {
+static double cpu_seconds() {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_utime.tv_sec + usage.ru_utime.tv_usec * 1e-6 +
+           usage.ru_stime.tv_sec + usage.ru_stime.tv_usec * 1e-6;
+}
+
+int main(int argc, char **argv) {
     glfwSetErrorCallback(error_callback);
 
     if (!glfwInit())
@@ -176,34 +269,23 @@ int main(void) {
 
     GLFWwindow *window = window_init();
 
-    glfwSetKeyCallback(window, key_callback);
-    glfwSetMouseButtonCallback(window, mouse_callback);
-    glfwSetCursorPosCallback(window, cursor_callback);
-    glfwSetScrollCallback(window, scroll_callback);
+    glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
+    glfwSetWindowRefreshCallback(window, refresh_callback);
 
     // NOTE: OpenGL error checks have been omitted for brevity
 
-    int width, height, nrChannels;
-    unsigned char *data =
-        stbi_load("container.jpg", &width, &height, &nrChannels, 0);
-
-    GLuint texture;
-    glGenTextures(1, &texture);
-    glBindTexture(GL_TEXTURE_2D, texture);
+    // Assets come from the pak when present, loose files otherwise
+    if (vfs_exists("assets.pak"))
+        vfs_mount("assets.pak");
 
-    // float borderColor[] = { 1.0f, 1.0f, 0.0f, 1.0f };
-    // glTexParameterfv(GL_TEXTURE_2D, GL_TEXTURE_BORDER_COLOR, borderColor);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-    // Filtering parameters
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB,
-                 GL_UNSIGNED_BYTE, data);
-    glGenerateMipmap(GL_TEXTURE_2D);
-
-    stbi_image_free(data);
+    // The texture streams in and replaces the unbound default when it lands
+    AsyncIo io;
+    aio_init(&io, 64, 16, 0, true);
+    GLuint texture = 0;
+    // Cooked with: cook texture container.jpg container.ktx2 --srgb
+    const char *texture_path =
+        vfs_exists("container.ktx2") ? "container.ktx2" : "container.jpg";
+    aio_read_file(&io, texture_path, AIO_PRIORITY_HIGH, on_texture_read, &texture);
 
     // float vertices[] = {
     // // positions        // colors          // texture coords
@@ -301,32 +383,115 @@ int main(void) {
                           (void *)(6 * sizeof(float)));
     glEnableVertexAttribArray(2);
 
-    const GLuint vertex_shader = glCreateShader(GL_VERTEX_SHADER);
-    glShaderSource(vertex_shader, 1, &vertex_shader_text, NULL);
-    glCompileShader(vertex_shader);
-
-    const GLuint fragment_shader = glCreateShader(GL_FRAGMENT_SHADER);
-    glShaderSource(fragment_shader, 1, &fragment_shader_text, NULL);
-    glCompileShader(fragment_shader);
-
-    const GLuint light_fragment_shader = glCreateShader(GL_FRAGMENT_SHADER);
-    glShaderSource(light_fragment_shader, 1, &fragment_light_shader_text, NULL);
-    glCompileShader(light_fragment_shader);
-
-    const GLuint program = glCreateProgram();
-    glAttachShader(program, vertex_shader);
-    glAttachShader(program, fragment_shader);
-    glLinkProgram(program);
-
-    glDeleteShader(fragment_shader);
-
-    const GLuint light_program = glCreateProgram();
-    glAttachShader(light_program, vertex_shader);
-    glAttachShader(light_program, light_fragment_shader);
-    glLinkProgram(light_program);
-
-    glDeleteShader(vertex_shader);
-    glDeleteShader(light_fragment_shader);
+    // The hand placed cubes come first, extra ones asked for on the command
+    // line are scattered behind them. Their parameters never change, so they
+    // are uploaded once.
+    // --render-thread hands the context to a thread of its own,
+    // --present=vsync|adaptive|uncapped|<fps> picks how frames are paced and
+    // --low-latency reads input as late as the pacing allows and
+    // --on-demand only draws when something changed. --record=<file> saves
+    // the input and --replay=<file> plays it back instead of live input;
+    // both step the simulation at a fixed rate so a replay repeats the
+    // recorded frames exactly.
+    int cube_count = 10;
+    bool threaded = false, low_latency = false, on_demand = false;
+    const char *record_path = NULL, *replay_path = NULL;
+    PresentMode present_mode = PRESENT_VSYNC;
+    double target_fps = 0.0;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--render-thread") == 0)
+            threaded = true;
+        else if (strcmp(argv[i], "--low-latency") == 0)
+            low_latency = true;
+        else if (strcmp(argv[i], "--on-demand") == 0)
+            on_demand = true;
+        else if (strncmp(argv[i], "--record=", 9) == 0)
+            record_path = argv[i] + 9;
+        else if (strncmp(argv[i], "--replay=", 9) == 0)
+            replay_path = argv[i] + 9;
+        else if (strncmp(argv[i], "--present=", 10) == 0) {
+            if (!present_mode_parse(argv[i] + 10, &present_mode, &target_fps))
+                fprintf(stderr, "Error: unknown present mode %s\n", argv[i] + 10);
+        } else
+            cube_count = atoi(argv[i]);
+    }
+    // The callbacks only queue events, the frame loop applies them
+    Input input;
+    input_init(&input);
+    bind_actions(&input);
+    InputRecording recording;
+    bool replaying = false, fixed_step = false;
+    if (replay_path) {
+        if (!input_replay_open(&recording, replay_path))
+            exit(EXIT_FAILURE);
+        replaying = fixed_step = true;
+    } else {
+        input_attach(&input, window);
+        if (record_path && input_record_open(&recording, record_path, FIXED_TIMESTEP)) {
+            input.recording = &recording;
+            fixed_step = true;
+        }
+    }
+    if (fixed_step && on_demand) {
+        fprintf(stderr, "Error: --on-demand is ignored while recording or replaying\n");
+        on_demand = false;
+    }
+    // A recorded run has to draw the same frames when replayed, so the
+    // texture is in place before frame 0 rather than landing mid-run
+    if (fixed_step)
+        aio_flush(&io);
+
+    if (cube_count < 10)
+        cube_count = 10;
+    AnimatedInstance *cubes =
+        (AnimatedInstance *)malloc(cube_count * sizeof(AnimatedInstance));
+    unsigned int seed = 1;
+    for (int i = 0; i < cube_count; i++) {
+        if (i < 10) {
+            vec3 axis = {1.0f, 0.3f, 0.5f};
+            animation_instance_init(&cubes[i], cubePositions[i], axis, 1.0f,
+                                    i * 20.0f * 3.1415f / 180.0f);
+            continue;
+        }
+        vec3 position = {random_range(&seed, -30.0f, 30.0f),
+                         random_range(&seed, -15.0f, 15.0f),
+                         random_range(&seed, -60.0f, -5.0f)};
+        vec3 axis = {random_range(&seed, -1.0f, 1.0f), random_range(&seed, -1.0f, 1.0f),
+                     random_range(&seed, -1.0f, 1.0f)};
+        animation_instance_init(&cubes[i], position, axis,
+                                random_range(&seed, 0.5f, 2.5f),
+                                random_range(&seed, 0.0f, 6.283f));
+    }
+    GLuint instanceVBO;
+    glGenBuffers(1, &instanceVBO);
+    glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+    glBufferData(GL_ARRAY_BUFFER, cube_count * sizeof(AnimatedInstance), cubes,
+                 GL_STATIC_DRAW);
+    animation_instance_attributes(VAO, 3);
+
+    // Shader files are watched and rebuilt in the background when edited
+    ShaderLibrary shaders;
+    shader_library_init(&shaders, "shaders", window);
+    shader_library_set_cache(&shaders, "shader_cache");
+    // Nor may an edited shader change them halfway
+    if (fixed_step)
+        shader_library_stop_watching(&shaders);
+    // Every variant the scene draws with, built before the first frame
+    uint32_t unlit = shader_feature(&shaders, "UNLIT");
+    uint32_t gpu_animated = shader_feature(&shaders, "GPU_ANIMATION");
+    const ShaderVariantDesc variants[] = {
+        {"cube.vert", "cube.frag", 0},
+        {"cube.vert", "cube.frag", unlit},
+        {"cube.vert", "cube.frag", gpu_animated},
+    };
+    shader_prewarm(&shaders, variants, sizeof(variants) / sizeof(variants[0]));
+    ShaderProgram *program = shader_variant(&shaders, "cube.vert", "cube.frag", 0);
+    ShaderProgram *light_program =
+        shader_variant(&shaders, "cube.vert", "cube.frag", unlit);
+    ShaderProgram *animated_program =
+        shader_variant(&shaders, "cube.vert", "cube.frag", gpu_animated);
+    if (!program || !light_program || !animated_program)
+        exit(EXIT_FAILURE);
 
     mat4x4 model, view, projection;
     mat4x4_identity(model);
@@ -336,13 +501,10 @@ int main(void) {
     mat4x4_rotate_X(model, model, -20.0f);
     mat4x4_translate(view, 0.0f, 0.0f, -3.0f);
     mat4x4_perspective(projection, zoom, 640.0f / 480.0f, 0.1f, 100.0f);
-    unsigned int modelLoc = glGetUniformLocation(program, "model");
-    unsigned int viewLoc = glGetUniformLocation(program, "view");
-    unsigned int projectionLoc = glGetUniformLocation(program, "projection");
-    unsigned int lightLoc = glGetUniformLocation(program, "lightColor");
-    unsigned int colorLoc = glGetUniformLocation(program, "objectColor");
-
-    unsigned int lightModelLoc = glGetUniformLocation(light_program, "model");
+    mat4x4 *matrices = (mat4x4 *)malloc(cube_count * sizeof(mat4x4));
+    double animate_ms = 0.0, last_report = glfwGetTime(), last_cpu = cpu_seconds();
+    int report_frames = 0;
+    float animation_time = 0.0f;
 
     glEnable(GL_DEPTH_TEST);
     glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
@@ -365,88 +527,172 @@ int main(void) {
                    lightColor[2] * toyColor[2]};
     // vec3_mul_inner(result) = lightColor * toyColor; // = (1.0f, 0.5f, 0.31f);
 
+    Scene scene;
+    scene.io = &io;
+    scene.shaders = &shaders;
+    scene.program = program;
+    scene.light_program = light_program;
+    scene.animated_program = animated_program;
+    scene.vao = VAO;
+    scene.light_vao = lightVAO;
+    scene.texture = &texture;
+    scene.changed = false;
+    vec3_dup(scene.light_color, lightColor);
+    vec3_dup(scene.object_color, toyColor);
+    scene.model_id = uniform_id("model");
+    scene.view_id = uniform_id("view");
+    scene.projection_id = uniform_id("projection");
+    scene.light_color_id = uniform_id("lightColor");
+    scene.object_color_id = uniform_id("objectColor");
+    scene.texture_id = uniform_id("texture1");
+    scene.time_id = uniform_id("time");
+
     glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
+    // The main thread simulates a frame while the previous one is drawn
+    FramePacer pacer;
+    frame_pacer_init(&pacer, window, present_mode, target_fps, low_latency);
+    printf("presenting %s%s\n", present_mode_name(pacer.mode),
+           pacer.low_latency ? ", low latency" : "");
+    RenderThread renderer;
+    render_thread_init(&renderer, window, threaded, &pacer, render_frame, &scene);
+    double replay_start = glfwGetTime();
     while (!glfwWindowShouldClose(window)) {
+        // On demand the loop sleeps in the event queue while nothing moves,
+        // waking now and then to pick up streamed textures and reloads
+        if (on_demand && !frame_dirty && animation_paused)
+            glfwWaitEventsTimeout(ON_DEMAND_TIMEOUT);
+
+        frame_pacer_begin(&pacer);
+        // Events are read after waiting for a packet so they are as fresh as
+        // possible when the frame is built
+        FramePacket *packet = render_thread_begin(&renderer);
+        glfwPollEvents();
+        int events = replaying ? input_replay(&input, &recording)
+                               : input_update(&input, glfwGetTime());
+        if (events < 0) {
+            packet->flags = FRAME_POLL_ONLY;
+            render_thread_submit(&renderer);
+            break;
+        }
+        if (events > 0)
+            frame_dirty = true;
+        handle_input(&input, window);
+        if (__atomic_exchange_n(&scene.changed, false, __ATOMIC_ACQUIRE))
+            frame_dirty = true;
+
+        bool draw = !on_demand || frame_dirty || !animation_paused;
+        frame_dirty = false;
+
         int width, height;
         glfwGetFramebufferSize(window, &width, &height);
-        const float ratio = width / (float)height;
-
-        glViewport(0, 0, width, height);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
         float current_frame = glfwGetTime();
-        delta_time = current_frame - last_frame;
+        delta_time = fixed_step ? (float)recording.timestep : current_frame - last_frame;
         last_frame = current_frame;
-
-        float mult = 3.1415f / 180.0f;
-        float radian_yaw = yaw * mult;
-        float radian_pitch = -pitch * mult;
-        camera.direction[0] = cos(radian_yaw) * cos(radian_pitch);
-        camera.direction[1] = sin(radian_pitch);
-        camera.direction[2] = sin(radian_yaw) * cos(radian_pitch);
-        vec3 front;
-        vec3_norm(front, camera.direction);
-
-        processInput(window, delta_time, camera.position, front, up);
-
-        glUseProgram(program);
-
-        // const float radius = 10.0f;
-        // float camX = sin(glfwGetTime()) * radius;
-        // float camZ = cos(glfwGetTime()) * radius;
-
-        vec3_add(tmp, camera.position, front);
-        mat4x4_look_at(view, camera.position, tmp, up);
-
-        for (unsigned int i = 0; i < 10; i++) {
-            mat4x4 m;
+        if (!animation_paused)
+            animation_time += delta_time;
+
+        if (!draw) {
+            packet->flags = FRAME_POLL_ONLY;
+            render_thread_submit(&renderer);
+        } else {
+            float mult = 3.1415f / 180.0f;
+            float radian_yaw = yaw * mult;
+            float radian_pitch = -pitch * mult;
+            camera.direction[0] = cos(radian_yaw) * cos(radian_pitch);
+            camera.direction[1] = sin(radian_pitch);
+            camera.direction[2] = sin(radian_yaw) * cos(radian_pitch);
+            vec3 front;
+            vec3_norm(front, camera.direction);
+
+            // A held key keeps the camera moving without sending events
+            if (processInput(&input, delta_time, camera.position, front, up))
+                frame_dirty = true;
+
+            // const float radius = 10.0f;
+            // float camX = sin(glfwGetTime()) * radius;
+            // float camZ = cos(glfwGetTime()) * radius;
+
+            vec3_add(tmp, camera.position, front);
+            mat4x4_look_at(view, camera.position, tmp, up);
+
+            packet->width = width;
+            packet->height = height;
+            packet->flags = 0;
+            mat4x4_dup(packet->view, view);
+            mat4x4_dup(packet->projection, projection);
+            vec3_dup(packet->camera_position, camera.position);
+
+            double animate_start = glfwGetTime();
+            packet->time = animation_time;
+            if (gpu_animation) {
+                frame_packet_draw(packet, DRAW_CUBES_ANIMATED, NULL, cube_count);
+            } else {
+                for (int i = 0; i < cube_count; i++)
+                    animation_instance_matrix(matrices[i], &cubes[i], packet->time);
+                frame_packet_draw(packet, DRAW_CUBES, matrices, cube_count);
+            }
+            animate_ms += (glfwGetTime() - animate_start) * 1e3;
+
+            // light
+            mat4x4 m, scaled;
             mat4x4_identity(m);
-            float x = cubePositions[i][0];
-            float y = cubePositions[i][1];
-            float z = cubePositions[i][2];
-            mat4x4_translate(m, x, y, z);
-
-            float angle = i;
-            mat4x4_rotate_Z(m, m, (float)glfwGetTime() * angle);
-            mat4x4_rotate_X(m, m, (float)glfwGetTime());
-
-            glUniformMatrix4fv(modelLoc, 1, GL_FALSE, (const GLfloat *)m);
-            // glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
-            glBindVertexArray(VAO);
-            glDrawArrays(GL_TRIANGLES, 0, 36);
+            mat4x4_translate_in_place(m, light_pos[0], light_pos[1], light_pos[2]);
+            mat4x4_scale(scaled, m, 0.2f);
+            frame_packet_draw(packet, DRAW_LAMP, &scaled, 1);
+            render_thread_submit(&renderer);
+            report_frames++;
+        }
+
+        if (current_frame - last_report > 2.0) {
+            RenderStats stats = render_thread_stats(&renderer);
+            FramePacerStats pacing = frame_pacer_stats(&pacer);
+            double cpu = cpu_seconds();
+            printf("%s: %d frames drawn, %.0f%% of a core\n",
+                   on_demand ? "on demand" : "continuous", report_frames,
+                   (cpu - last_cpu) / (current_frame - last_report) * 100.0);
+            if (report_frames > 0)
+                printf("%d cubes animated on the %s: %.3f ms cpu per frame\n", cube_count,
+                       gpu_animation ? "GPU" : "CPU", animate_ms / report_frames);
+            if (stats.frames > 0 && report_frames > 0)
+                printf("render %s: %.2f ms per frame, main thread waited %.2f ms per frame\n",
+                       threaded ? "thread" : "inline", stats.render_ms / stats.frames,
+                       stats.wait_ms / report_frames);
+            if (pacing.frames > 0)
+                printf("frames: %.2f ms +- %.2f, worst %.2f, %ld missed; "
+                       "input to present %.2f ms, %.2f ms of it working\n",
+                       pacing.frame_ms, pacing.frame_deviation_ms, pacing.frame_max_ms,
+                       pacing.missed, pacing.latency_ms, pacing.work_ms);
+            animate_ms = 0.0;
+            report_frames = 0;
+            last_report = current_frame;
+            last_cpu = cpu;
         }
-        glUniformMatrix4fv(viewLoc, 1, GL_FALSE, (const GLfloat *)view);
-        glUniformMatrix4fv(projectionLoc, 1, GL_FALSE,
-                           (const GLfloat *)projection);
-
-        // glUniformMatrix4fv(lightLoc, 1, GL_FALSE, (const GLfloat *)lightColor);
-        // glUniformMatrix4fv(colorLoc, 1, GL_FALSE, (const GLfloat *)toyColor);
-
-        glUniform3f(lightLoc, lightColor[0], lightColor[1], lightColor[2]);
-        glUniform3f(colorLoc, toyColor[0], toyColor[1], toyColor[2]);
-
-        glUseProgram(light_program);
-        // light
-        mat4x4 m, scaled;
-        mat4x4_identity(m);
-        mat4x4_translate_in_place(m, light_pos[0], light_pos[1], light_pos[2]);
-        mat4x4_scale(scaled, m, 0.2f);
-        glUniformMatrix4fv(lightModelLoc, 1, GL_FALSE, (const GLfloat *)scaled);
-        glBindVertexArray(lightVAO);
-        glDrawArrays(GL_TRIANGLES, 0, 36);
-        glUniformMatrix4fv(viewLoc, 1, GL_FALSE, (const GLfloat *)view);
-        glUniformMatrix4fv(projectionLoc, 1, GL_FALSE,
-                           (const GLfloat *)projection);
-        glfwSwapBuffers(window);
-        glfwPollEvents();
     }
+    render_thread_destroy(&renderer);
+    if (replaying)
+        printf("replayed %u frames in %.2f s, %.3f ms per frame\n", recording.frame,
+               glfwGetTime() - replay_start, (glfwGetTime() - replay_start) * 1e3 /
+                                                 (recording.frame > 0 ? recording.frame : 1));
+    else if (input.recording)
+        printf("recorded %u events over %u frames to %s\n", recording.event_count,
+               recording.frame, recording.path);
+    if (replaying || input.recording)
+        input_recording_close(&recording);
+    frame_pacer_destroy(&pacer);
 
     glDeleteVertexArrays(1, &VAO);
     glDeleteBuffers(1, &VBO);
     glDeleteBuffers(1, &EBO);
-    glDeleteProgram(program);
+    glDeleteBuffers(1, &instanceVBO);
+    free(cubes);
+    free(matrices);
+    shader_library_destroy(&shaders);
+    aio_destroy(&io);
+    glDeleteTextures(1, &texture);
 
     glfwDestroyWindow(window);
 
+    vfs_unmount_all();
     glfwTerminate();
     exit(EXIT_SUCCESS);
 }
\ No newline at end of file
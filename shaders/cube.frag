@@ -0,0 +1,16 @@
+#version 330 core
+out vec4 FragColor;
+in vec2 TexCoord;
+
+uniform sampler2D texture1;
+uniform vec3 objectColor;
+uniform vec3 lightColor;
+
+void main()
+{
+#ifdef UNLIT
+    FragColor = vec4(1.0);
+#else
+    FragColor = texture(texture1, TexCoord) * vec4(lightColor * objectColor, 1.0);
+#endif
+}
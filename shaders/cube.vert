@@ -0,0 +1,36 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;      // Vertex position
+layout (location = 1) in vec3 aColor;    // Color
+layout (location = 2) in vec2 aTexCoord; // Texture coordinate
+
+out vec2 TexCoord;
+uniform mat4 model;
+uniform mat4 view;
+uniform mat4 projection;
+
+#ifdef GPU_ANIMATION
+layout (location = 3) in vec4 aInstance; // Position, phase
+layout (location = 4) in vec4 aSpin;     // Unit rotation axis, angular speed
+uniform float time;
+
+// Rotation about a unit axis, matching linmath's mat4x4_rotate
+mat3 axis_rotation(vec3 u, float angle)
+{
+    float s = sin(angle);
+    float c = cos(angle);
+    mat3 outer = mat3(u.x * u, u.y * u, u.z * u);
+    mat3 skew = mat3(0.0, u.z, -u.y, -u.z, 0.0, u.x, u.y, -u.x, 0.0);
+    return outer + c * (mat3(1.0) - outer) + s * skew;
+}
+#endif
+
+void main()
+{
+#ifdef GPU_ANIMATION
+    vec3 world = axis_rotation(aSpin.xyz, aSpin.w * time + aInstance.w) * aPos + aInstance.xyz;
+    gl_Position = projection * view * vec4(world, 1.0);
+#else
+    gl_Position = projection * view * model * vec4(aPos, 1.0);
+#endif
+    TexCoord = aTexCoord;
+}
@@ -0,0 +1,10 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;
+
+uniform mat4 light_view_proj;
+uniform mat4 model;
+
+void main()
+{
+    gl_Position = light_view_proj * model * vec4(aPos, 1.0);
+}
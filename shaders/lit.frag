@@ -0,0 +1,62 @@
+#version 330 core
+in vec3 world_pos;
+in float view_depth;
+out vec4 FragColor;
+
+uniform vec3 objectColor;
+uniform vec3 lightColor;
+uniform vec3 light_pos;
+
+// The point light's tile in the shadow atlas
+uniform sampler2DShadow shadow_atlas;
+uniform mat4 light_view_proj;
+uniform vec4 shadow_rect;
+
+// The sun's cascades, picked by distance from the camera
+uniform sampler2DArrayShadow sun_shadow;
+uniform mat4 cascade_view_proj[4];
+uniform float cascade_far[4];
+uniform int cascade_count;
+uniform vec3 sun_dir;
+uniform vec3 sun_color;
+
+float sun_shadow_factor()
+{
+    int cascade = cascade_count - 1;
+    for (int i = 0; i < cascade_count; i++) {
+        if (view_depth < cascade_far[i]) {
+            cascade = i;
+            break;
+        }
+    }
+    vec4 clip = cascade_view_proj[cascade] * vec4(world_pos, 1.0);
+    vec3 coord = clip.xyz / clip.w * 0.5 + 0.5;
+    if (any(lessThan(coord, vec3(0.0))) || any(greaterThan(coord, vec3(1.0))))
+        return 1.0;
+    // Layer then reference depth
+    return texture(sun_shadow, vec4(coord.xy, float(cascade), coord.z - 0.002));
+}
+
+float point_shadow()
+{
+    vec4 clip = light_view_proj * vec4(world_pos, 1.0);
+    if (clip.w <= 0.0)
+        return 1.0;
+    vec3 ndc = clip.xyz / clip.w;
+    if (any(greaterThan(abs(ndc), vec3(1.0))))
+        return 1.0;
+    vec3 coord = ndc * 0.5 + 0.5;
+    vec2 uv = shadow_rect.xy + coord.xy * shadow_rect.zw;
+    return texture(shadow_atlas, vec3(uv, coord.z - 0.0005));
+}
+
+void main()
+{
+    // The cube vertices carry no normals, so shading is flat
+    vec3 normal = normalize(cross(dFdx(world_pos), dFdy(world_pos)));
+    vec3 to_light = normalize(light_pos - world_pos);
+    float diffuse = max(dot(normal, to_light), 0.0) * point_shadow();
+    float sun = max(dot(normal, -normalize(sun_dir)), 0.0) * sun_shadow_factor();
+    vec3 light = (0.15 + diffuse) * lightColor + sun * sun_color;
+    FragColor = vec4(light * objectColor, 1.0);
+}
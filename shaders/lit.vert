@@ -0,0 +1,18 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;
+
+uniform mat4 model;
+uniform mat4 view;
+uniform mat4 projection;
+
+out vec3 world_pos;
+out float view_depth;
+
+void main()
+{
+    vec4 world = model * vec4(aPos, 1.0);
+    vec4 eye = view * world;
+    world_pos = world.xyz;
+    view_depth = -eye.z;
+    gl_Position = projection * eye;
+}
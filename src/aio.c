@@ -0,0 +1,653 @@
+#include "aio.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "lz4.h"
+#include "vfs.h"
+
+#define AIO_WAKE_TAG UINT64_MAX
+#define AIO_MAX_READ (1u << 30)
+#define AIO_THREAD_CHUNK (4 << 20)
+#define AIO_ASYNC_READ (64u << 10)
+#define AIO_DEFAULT_THREADS 4
+
+static int aio_slot(const AsyncIo* aio, AioHandle handle) {
+    int slot = (int)(handle & 0xffff) - 1;
+    if (slot < 0 || slot >= aio->capacity ||
+        aio->requests[slot].handle != handle ||
+        aio->requests[slot].status == AIO_FREE)
+        return -1;
+    return slot;
+}
+
+static void aio_queue_push(AsyncIo* aio, AioQueue* queue, AioHandle handle) {
+    queue->handles[(queue->head + queue->count) % aio->capacity] = handle;
+    queue->count++;
+}
+
+static void aio_queue_remove(AsyncIo* aio, AioQueue* queue, AioHandle handle) {
+    bool found = false;
+    for (int i = 0; i < queue->count; i++) {
+        int index = (queue->head + i) % aio->capacity;
+        if (found)
+            queue->handles[(queue->head + i - 1) % aio->capacity] = queue->handles[index];
+        else if (queue->handles[index] == handle)
+            found = true;
+    }
+    if (found)
+        queue->count--;
+}
+
+// Highest priority first, FIFO within a priority
+static int aio_pop(AsyncIo* aio) {
+    for (int p = 0; p < AIO_PRIORITY_COUNT; p++) {
+        AioQueue *queue = &aio->queues[p];
+        if (queue->count == 0)
+            continue;
+        AioHandle handle = queue->handles[queue->head];
+        queue->head = (queue->head + 1) % aio->capacity;
+        queue->count--;
+        return aio_slot(aio, handle);
+    }
+    return -1;
+}
+
+static void aio_complete_locked(AsyncIo* aio, int slot, AioStatus status) {
+    AioRequest *request = &aio->requests[slot];
+    request->status = status;
+    request->next = -1;
+    if (aio->completed_tail >= 0)
+        aio->requests[aio->completed_tail].next = slot;
+    else
+        aio->completed_head = slot;
+    aio->completed_tail = slot;
+
+    if (status == AIO_DONE) {
+        aio->stats.completed++;
+        aio->stats.bytes += request->size;
+    } else if (status == AIO_FAILED) {
+        aio->stats.failed++;
+    } else {
+        aio->stats.cancelled++;
+    }
+    pthread_cond_broadcast(&aio->completed);
+}
+
+// Runs on I/O threads, the path never changes while a request is live
+static bool aio_prepare(AioRequest* request) {
+    VfsLocation location;
+    if (vfs_locate(request->path, &location)) {
+        request->fd = location.fd;
+        request->own_fd = false;
+        request->offset = location.offset;
+        request->stored_size = location.stored_size;
+        request->size = location.size;
+        request->lz4 = location.lz4;
+    } else {
+        request->fd = open(request->path, O_RDONLY | O_CLOEXEC);
+        if (request->fd < 0)
+            return false;
+        request->own_fd = true;
+        struct stat st;
+        if (fstat(request->fd, &st) != 0)
+            return false;
+        request->offset = 0;
+        request->stored_size = st.st_size;
+        request->size = st.st_size;
+        request->lz4 = false;
+    }
+    request->done = 0;
+    request->buffer =
+        (unsigned char *)malloc(request->stored_size > 0 ? request->stored_size : 1);
+    return true;
+}
+
+static void aio_finish(AsyncIo* aio, int slot, bool ok) {
+    AioRequest *request = &aio->requests[slot];
+    if (request->own_fd)
+        close(request->fd);
+    request->fd = -1;
+    request->own_fd = false;
+
+    bool cancel = __atomic_load_n(&request->cancel, __ATOMIC_RELAXED);
+    if (ok && !cancel && request->lz4) {
+        unsigned char *data = (unsigned char *)malloc(request->size > 0 ? request->size : 1);
+        ok = lz4_decompress(request->buffer, request->stored_size, data,
+                            request->size) == (long)request->size;
+        free(request->buffer);
+        request->buffer = data;
+    }
+    if (!ok && !cancel)
+        fprintf(stderr, "Error: cannot read %s\n", request->path);
+
+    AioStatus status = cancel ? AIO_CANCELLED : ok ? AIO_DONE : AIO_FAILED;
+    if (status != AIO_DONE) {
+        free(request->buffer);
+        request->buffer = NULL;
+    }
+    pthread_mutex_lock(&aio->lock);
+    aio_complete_locked(aio, slot, status);
+    pthread_mutex_unlock(&aio->lock);
+}
+
+// Reads whatever is left of a prepared request
+static bool aio_pread(AioRequest* request) {
+    bool ok = true;
+    while (ok && request->done < request->stored_size &&
+           !__atomic_load_n(&request->cancel, __ATOMIC_RELAXED)) {
+        size_t chunk = request->stored_size - request->done;
+        if (chunk > AIO_THREAD_CHUNK)
+            chunk = AIO_THREAD_CHUNK;
+        ssize_t n = pread(request->fd, request->buffer + request->done, chunk,
+                          request->offset + request->done);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            ok = false;
+        else
+            request->done += n;
+    }
+    return ok;
+}
+
+static void *aio_thread_worker(void* arg) {
+    AsyncIo *aio = (AsyncIo *)arg;
+    for (;;) {
+        pthread_mutex_lock(&aio->lock);
+        int slot;
+        while ((slot = aio_pop(aio)) < 0 && !aio->stopping)
+            pthread_cond_wait(&aio->has_work, &aio->lock);
+        if (slot < 0) {
+            pthread_mutex_unlock(&aio->lock);
+            break;
+        }
+        aio->requests[slot].status = AIO_IN_FLIGHT;
+        pthread_mutex_unlock(&aio->lock);
+
+        AioRequest *request = &aio->requests[slot];
+        bool ok = aio_prepare(request) && aio_pread(request);
+        aio_finish(aio, slot, ok);
+    }
+    return NULL;
+}
+
+static int aio_uring_setup(unsigned entries, struct io_uring_params* params) {
+    return (int)syscall(__NR_io_uring_setup, entries, params);
+}
+
+static int aio_uring_enter(int fd, unsigned submit, unsigned min_complete,
+                           unsigned flags) {
+    return (int)syscall(__NR_io_uring_enter, fd, submit, min_complete, flags, NULL, 0);
+}
+
+static void aio_ring_destroy(AioRing* ring) {
+    for (int i = 0; i < ring->retired_count; i++)
+        free(ring->retired[i]);
+    free(ring->retired);
+    if (ring->sqes)
+        munmap(ring->sqes, ring->sqes_map_size);
+    if (ring->cq_ptr && ring->cq_ptr != ring->sq_ptr)
+        munmap(ring->cq_ptr, ring->cq_map_size);
+    if (ring->sq_ptr)
+        munmap(ring->sq_ptr, ring->sq_map_size);
+    if (ring->wake_fd >= 0)
+        close(ring->wake_fd);
+    if (ring->fd >= 0)
+        close(ring->fd);
+    memset(ring, 0, sizeof(*ring));
+    ring->fd = -1;
+    ring->wake_fd = -1;
+}
+
+static void *aio_ring_map(AioRing* ring, size_t size, off_t offset) {
+    void *ptr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                     ring->fd, offset);
+    return ptr == MAP_FAILED ? NULL : ptr;
+}
+
+static bool aio_ring_init(AioRing* ring, unsigned entries) {
+    memset(ring, 0, sizeof(*ring));
+    ring->wake_fd = -1;
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    ring->fd = aio_uring_setup(entries, &params);
+    if (ring->fd < 0)
+        return false;
+
+    // IORING_OP_READ arrived in the same release as this feature bit
+    if (!(params.features & IORING_FEAT_RW_CUR_POS)) {
+        aio_ring_destroy(ring);
+        return false;
+    }
+
+    ring->sq_map_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    ring->cq_map_size =
+        params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    bool single = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (single) {
+        if (ring->cq_map_size > ring->sq_map_size)
+            ring->sq_map_size = ring->cq_map_size;
+        ring->cq_map_size = ring->sq_map_size;
+    }
+    ring->sq_ptr = aio_ring_map(ring, ring->sq_map_size, IORING_OFF_SQ_RING);
+    ring->cq_ptr = single ? ring->sq_ptr
+                          : aio_ring_map(ring, ring->cq_map_size, IORING_OFF_CQ_RING);
+    ring->sqes_map_size = params.sq_entries * sizeof(struct io_uring_sqe);
+    ring->sqes = aio_ring_map(ring, ring->sqes_map_size, IORING_OFF_SQES);
+    ring->wake_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (!ring->sq_ptr || !ring->cq_ptr || !ring->sqes || ring->wake_fd < 0) {
+        aio_ring_destroy(ring);
+        return false;
+    }
+
+    char *sq = (char *)ring->sq_ptr, *cq = (char *)ring->cq_ptr;
+    ring->sq_head = (unsigned *)(sq + params.sq_off.head);
+    ring->sq_tail = (unsigned *)(sq + params.sq_off.tail);
+    ring->sq_mask = (unsigned *)(sq + params.sq_off.ring_mask);
+    ring->sq_array = (unsigned *)(sq + params.sq_off.array);
+    ring->sq_entries = params.sq_entries;
+    ring->cq_head = (unsigned *)(cq + params.cq_off.head);
+    ring->cq_tail = (unsigned *)(cq + params.cq_off.tail);
+    ring->cq_mask = (unsigned *)(cq + params.cq_off.ring_mask);
+    ring->cqes = cq + params.cq_off.cqes;
+    return true;
+}
+
+// Only the ring thread touches the submission queue, the kernel reads it
+// during io_uring_enter
+static void aio_ring_push(AioRing* ring, int opcode, int fd, void* addr,
+                          unsigned length, uint64_t offset, uint64_t tag) {
+    unsigned tail = *ring->sq_tail;
+    unsigned index = tail & *ring->sq_mask;
+    struct io_uring_sqe *sqe = &((struct io_uring_sqe *)ring->sqes)[index];
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = opcode;
+    sqe->fd = fd;
+    sqe->addr = (uint64_t)(uintptr_t)addr;
+    sqe->len = length;
+    sqe->off = offset;
+    sqe->user_data = tag;
+    // Small reads are copied inline when cached, large ones go straight to
+    // the kernel workers instead of holding up the rest of the batch
+    if (opcode == IORING_OP_READ && length >= AIO_ASYNC_READ)
+        sqe->flags = IOSQE_ASYNC;
+    if (opcode == IORING_OP_POLL_ADD)
+        sqe->poll32_events = POLLIN;
+    ring->sq_array[index] = index;
+    __atomic_store_n(ring->sq_tail, tail + 1, __ATOMIC_RELEASE);
+}
+
+static void aio_ring_read(AioRing* ring, AioRequest* request, int slot) {
+    size_t length = request->stored_size - request->done;
+    if (length > AIO_MAX_READ)
+        length = AIO_MAX_READ;
+    aio_ring_push(ring, IORING_OP_READ, request->fd, request->buffer + request->done,
+                  (unsigned)length, request->offset + request->done,
+                  (uint64_t)slot + 1);
+    ring->in_flight++;
+}
+
+// Waits for the reads the kernel already took off the submission queue so
+// none of them lands in a buffer after its request completed
+static bool aio_ring_drain(AsyncIo* aio) {
+    AioRing *ring = &aio->ring;
+    int kernel_reads = ring->in_flight;
+    unsigned head = __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE);
+    for (unsigned i = head; i != *ring->sq_tail; i++) {
+        unsigned index = ring->sq_array[i & *ring->sq_mask];
+        if (((struct io_uring_sqe *)ring->sqes)[index].opcode == IORING_OP_READ)
+            kernel_reads--;
+    }
+
+    while (kernel_reads > 0) {
+        if (aio_uring_enter(ring->fd, 0, 1, IORING_ENTER_GETEVENTS) < 0 &&
+            errno != EINTR)
+            return false;
+        unsigned cq = *ring->cq_head;
+        while (cq != __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE)) {
+            struct io_uring_cqe *cqe =
+                &((struct io_uring_cqe *)ring->cqes)[cq & *ring->cq_mask];
+            if (cqe->user_data != AIO_WAKE_TAG) {
+                if (cqe->res > 0)
+                    aio->requests[cqe->user_data - 1].done += cqe->res;
+                kernel_reads--;
+            }
+            cq++;
+            __atomic_store_n(ring->cq_head, cq, __ATOMIC_RELEASE);
+        }
+    }
+    return true;
+}
+
+// Once the ring is unusable the reads it holds are finished with pread and
+// this thread carries on as the fallback pool. When the ring cannot even be
+// drained the reads start over in fresh buffers, the old ones are freed with
+// the ring.
+static void aio_ring_fallback(AsyncIo* aio, int* slots) {
+    bool drained = aio_ring_drain(aio);
+    pthread_mutex_lock(&aio->lock);
+    __atomic_store_n(&aio->backend, AIO_BACKEND_THREADS, __ATOMIC_RELAXED);
+    int count = 0;
+    for (int i = 0; i < aio->capacity; i++)
+        if (aio->requests[i].status == AIO_IN_FLIGHT)
+            slots[count++] = i;
+    pthread_mutex_unlock(&aio->lock);
+
+    AioRing *ring = &aio->ring;
+    if (!drained) {
+        ring->retired = (void **)realloc(ring->retired,
+                                         (ring->retired_count + count) * sizeof(void *));
+        for (int i = 0; i < count; i++) {
+            AioRequest *request = &aio->requests[slots[i]];
+            ring->retired[ring->retired_count++] = request->buffer;
+            request->buffer = (unsigned char *)malloc(
+                request->stored_size > 0 ? request->stored_size : 1);
+            request->done = 0;
+        }
+    }
+    for (int i = 0; i < count; i++)
+        aio_finish(aio, slots[i], aio_pread(&aio->requests[slots[i]]));
+    ring->in_flight = 0;
+}
+
+static void *aio_ring_worker(void* arg) {
+    AsyncIo *aio = (AsyncIo *)arg;
+    AioRing *ring = &aio->ring;
+    int *batch = (int *)malloc(ring->sq_entries * sizeof(int));
+    unsigned to_submit = 0;
+
+    // New requests write the eventfd, so the ring wait doubles as the
+    // wait for work
+    aio_ring_push(ring, IORING_OP_POLL_ADD, ring->wake_fd, NULL, 0, 0, AIO_WAKE_TAG);
+    to_submit++;
+
+    for (;;) {
+        pthread_mutex_lock(&aio->lock);
+        int count = 0, slot;
+        while (ring->in_flight + count < (int)ring->sq_entries - 1 &&
+               (slot = aio_pop(aio)) >= 0) {
+            aio->requests[slot].status = AIO_IN_FLIGHT;
+            batch[count++] = slot;
+        }
+        bool stopping = aio->stopping;
+        pthread_mutex_unlock(&aio->lock);
+        if (stopping && count == 0 && ring->in_flight == 0)
+            break;
+
+        int reads = 0;
+        for (int i = 0; i < count; i++) {
+            AioRequest *request = &aio->requests[batch[i]];
+            if (!aio_prepare(request)) {
+                aio_finish(aio, batch[i], false);
+            } else if (request->stored_size == 0) {
+                aio_finish(aio, batch[i], true);
+            } else {
+                aio_ring_read(ring, request, batch[i]);
+                reads++;
+            }
+        }
+        to_submit += reads;
+        if (reads > 0) {
+            pthread_mutex_lock(&aio->lock);
+            aio->stats.batches++;
+            aio->stats.batched += reads;
+            pthread_mutex_unlock(&aio->lock);
+        }
+
+        int submitted = aio_uring_enter(ring->fd, to_submit, 1, IORING_ENTER_GETEVENTS);
+        if (submitted < 0) {
+            if (errno == EINTR || errno == EAGAIN || errno == EBUSY)
+                continue;
+            fprintf(stderr, "Error: io_uring_enter failed (%s), falling back to pread\n",
+                    strerror(errno));
+            aio_ring_fallback(aio, batch);
+            free(batch);
+            return aio_thread_worker(aio);
+        }
+        to_submit -= submitted;
+
+        unsigned head = *ring->cq_head;
+        while (head != __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE)) {
+            struct io_uring_cqe *cqe =
+                &((struct io_uring_cqe *)ring->cqes)[head & *ring->cq_mask];
+            uint64_t tag = cqe->user_data;
+            int res = cqe->res;
+            head++;
+            __atomic_store_n(ring->cq_head, head, __ATOMIC_RELEASE);
+
+            if (tag == AIO_WAKE_TAG) {
+                uint64_t value;
+                if (read(ring->wake_fd, &value, sizeof(value)) < 0 && errno != EAGAIN)
+                    fprintf(stderr, "Error: cannot reset io wake event\n");
+                aio_ring_push(ring, IORING_OP_POLL_ADD, ring->wake_fd, NULL, 0, 0,
+                              AIO_WAKE_TAG);
+                to_submit++;
+                continue;
+            }
+
+            int slot = (int)(tag - 1);
+            AioRequest *request = &aio->requests[slot];
+            ring->in_flight--;
+            if (res == -EINTR || res == -EAGAIN) {
+                aio_ring_read(ring, request, slot);
+                to_submit++;
+            } else if (res <= 0) {
+                aio_finish(aio, slot, false);
+            } else {
+                request->done += res;
+                if (request->done < request->stored_size &&
+                    !__atomic_load_n(&request->cancel, __ATOMIC_RELAXED)) {
+                    // Short read, carry on from where it stopped
+                    aio_ring_read(ring, request, slot);
+                    to_submit++;
+                } else {
+                    aio_finish(aio, slot, true);
+                }
+            }
+        }
+    }
+    free(batch);
+    return NULL;
+}
+
+static void aio_wake(AsyncIo* aio) {
+    // The ring thread may switch to the fallback under the lock
+    if (__atomic_load_n(&aio->backend, __ATOMIC_RELAXED) == AIO_BACKEND_URING) {
+        uint64_t one = 1;
+        if (write(aio->ring.wake_fd, &one, sizeof(one)) < 0 && errno != EAGAIN)
+            fprintf(stderr, "Error: cannot wake io thread\n");
+    } else {
+        pthread_cond_signal(&aio->has_work);
+    }
+}
+
+void aio_init(AsyncIo* aio, int capacity, int depth, int thread_count,
+              bool allow_uring) {
+    memset(aio, 0, sizeof(*aio));
+    if (capacity < 1)
+        capacity = 1;
+    if (capacity > AIO_MAX_REQUESTS)
+        capacity = AIO_MAX_REQUESTS;
+    if (depth < 1)
+        depth = 1;
+
+    aio->capacity = capacity;
+    aio->requests = (AioRequest *)calloc(capacity, sizeof(AioRequest));
+    for (int i = 0; i < capacity; i++) {
+        aio->requests[i].handle = (1u << 16) | (AioHandle)(i + 1);
+        aio->requests[i].fd = -1;
+        aio->requests[i].next = i + 1 < capacity ? i + 1 : -1;
+    }
+    aio->free_head = 0;
+    aio->completed_head = -1;
+    aio->completed_tail = -1;
+    for (int p = 0; p < AIO_PRIORITY_COUNT; p++)
+        aio->queues[p].handles = (AioHandle *)malloc(capacity * sizeof(AioHandle));
+    pthread_mutex_init(&aio->lock, NULL);
+    pthread_cond_init(&aio->has_work, NULL);
+    pthread_cond_init(&aio->completed, NULL);
+
+    aio->ring.fd = -1;
+    aio->ring.wake_fd = -1;
+    if (allow_uring && aio_ring_init(&aio->ring, depth + 1)) {
+        aio->backend = AIO_BACKEND_URING;
+        aio->thread_count = 1;
+        aio->threads = (pthread_t *)malloc(sizeof(pthread_t));
+        pthread_create(&aio->threads[0], NULL, aio_ring_worker, aio);
+        return;
+    }
+
+    aio->backend = AIO_BACKEND_THREADS;
+    aio->thread_count = thread_count > 0 ? thread_count : AIO_DEFAULT_THREADS;
+    aio->threads = (pthread_t *)malloc(aio->thread_count * sizeof(pthread_t));
+    for (int i = 0; i < aio->thread_count; i++)
+        pthread_create(&aio->threads[i], NULL, aio_thread_worker, aio);
+}
+
+void aio_destroy(AsyncIo* aio) {
+    pthread_mutex_lock(&aio->lock);
+    int slot;
+    while ((slot = aio_pop(aio)) >= 0)
+        aio_complete_locked(aio, slot, AIO_CANCELLED);
+    for (int i = 0; i < aio->capacity; i++)
+        if (aio->requests[i].status == AIO_IN_FLIGHT)
+            __atomic_store_n(&aio->requests[i].cancel, true, __ATOMIC_RELAXED);
+    aio->stopping = true;
+    pthread_cond_broadcast(&aio->has_work);
+    pthread_mutex_unlock(&aio->lock);
+    aio_wake(aio);
+
+    for (int i = 0; i < aio->thread_count; i++)
+        pthread_join(aio->threads[i], NULL);
+    aio_poll(aio);
+
+    aio_ring_destroy(&aio->ring);
+    for (int p = 0; p < AIO_PRIORITY_COUNT; p++)
+        free(aio->queues[p].handles);
+    free(aio->threads);
+    free(aio->requests);
+    pthread_mutex_destroy(&aio->lock);
+    pthread_cond_destroy(&aio->has_work);
+    pthread_cond_destroy(&aio->completed);
+    memset(aio, 0, sizeof(*aio));
+}
+
+AioHandle aio_read_file(AsyncIo* aio, const char* path, AioPriority priority,
+                        AioCallback callback, void* user) {
+    char *copy = strdup(path);
+    pthread_mutex_lock(&aio->lock);
+    if (aio->free_head < 0 || aio->stopping) {
+        pthread_mutex_unlock(&aio->lock);
+        free(copy);
+        return AIO_INVALID_HANDLE;
+    }
+    int slot = aio->free_head;
+    AioRequest *request = &aio->requests[slot];
+    aio->free_head = request->next;
+
+    request->status = AIO_QUEUED;
+    request->priority = priority;
+    request->cancel = false;
+    request->path = copy;
+    request->callback = callback;
+    request->user = user;
+    request->buffer = NULL;
+    request->size = 0;
+    request->next = -1;
+    aio_queue_push(aio, &aio->queues[priority], request->handle);
+    aio->live++;
+    aio->stats.submitted++;
+    AioHandle handle = request->handle;
+    pthread_mutex_unlock(&aio->lock);
+
+    aio_wake(aio);
+    return handle;
+}
+
+bool aio_cancel(AsyncIo* aio, AioHandle handle) {
+    bool cancelled = false;
+    pthread_mutex_lock(&aio->lock);
+    int slot = aio_slot(aio, handle);
+    if (slot >= 0) {
+        AioRequest *request = &aio->requests[slot];
+        if (request->status == AIO_QUEUED) {
+            aio_queue_remove(aio, &aio->queues[request->priority], handle);
+            aio_complete_locked(aio, slot, AIO_CANCELLED);
+            cancelled = true;
+        } else if (request->status == AIO_IN_FLIGHT) {
+            __atomic_store_n(&request->cancel, true, __ATOMIC_RELAXED);
+            cancelled = true;
+        }
+    }
+    pthread_mutex_unlock(&aio->lock);
+    return cancelled;
+}
+
+int aio_poll(AsyncIo* aio) {
+    pthread_mutex_lock(&aio->lock);
+    int slot = aio->completed_head;
+    aio->completed_head = -1;
+    aio->completed_tail = -1;
+    pthread_mutex_unlock(&aio->lock);
+
+    int ran = 0;
+    while (slot >= 0) {
+        AioRequest *request = &aio->requests[slot];
+        int next = request->next;
+
+        AioResult result;
+        result.handle = request->handle;
+        result.status = request->status;
+        result.path = request->path;
+        result.data = request->buffer;
+        result.size = request->status == AIO_DONE ? request->size : 0;
+        result.user = request->user;
+        if (request->callback)
+            request->callback(&result);
+        else
+            free(request->buffer);
+        free(request->path);
+
+        pthread_mutex_lock(&aio->lock);
+        AioHandle generation = (request->handle >> 16) + 1;
+        if (generation > 0xffff)
+            generation = 1;
+        request->handle = (generation << 16) | (AioHandle)(slot + 1);
+        request->status = AIO_FREE;
+        request->path = NULL;
+        request->buffer = NULL;
+        request->next = aio->free_head;
+        aio->free_head = slot;
+        aio->live--;
+        pthread_mutex_unlock(&aio->lock);
+
+        ran++;
+        slot = next;
+    }
+    return ran;
+}
+
+void aio_flush(AsyncIo* aio) {
+    for (;;) {
+        aio_poll(aio);
+        pthread_mutex_lock(&aio->lock);
+        if (aio->live == 0) {
+            pthread_mutex_unlock(&aio->lock);
+            return;
+        }
+        if (aio->completed_head < 0)
+            pthread_cond_wait(&aio->completed, &aio->lock);
+        pthread_mutex_unlock(&aio->lock);
+    }
+}
@@ -0,0 +1,146 @@
+#ifndef AIO_H
+#define AIO_H
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef enum AioPriority {
+  AIO_PRIORITY_HIGH,
+  AIO_PRIORITY_NORMAL,
+  AIO_PRIORITY_LOW,
+  AIO_PRIORITY_COUNT
+} AioPriority;
+
+typedef enum AioStatus {
+  AIO_FREE,
+  AIO_QUEUED,
+  AIO_IN_FLIGHT,
+  AIO_DONE,
+  AIO_FAILED,
+  AIO_CANCELLED
+} AioStatus;
+
+typedef enum AioBackend { AIO_BACKEND_URING, AIO_BACKEND_THREADS } AioBackend;
+
+// Slot index + 1 in the low 16 bits, reuse generation above
+typedef uint32_t AioHandle;
+#define AIO_INVALID_HANDLE 0
+#define AIO_MAX_REQUESTS 65535
+
+// `data` is owned by the callback and must be released with free()
+typedef struct AioResult {
+  AioHandle handle;
+  AioStatus status;
+  const char* path;
+  unsigned char* data;
+  size_t size;
+  void* user;
+} AioResult;
+
+typedef void (*AioCallback)(AioResult* result);
+
+typedef struct AioRequest {
+  AioHandle handle;
+  AioStatus status;
+  AioPriority priority;
+  bool cancel;
+  char* path;
+  AioCallback callback;
+  void* user;
+  int fd;
+  bool own_fd;
+  bool lz4;
+  uint64_t offset;
+  size_t stored_size;
+  size_t size;
+  size_t done;
+  unsigned char* buffer;
+  int next;
+} AioRequest;
+
+typedef struct AioQueue {
+  AioHandle* handles;
+  int head;
+  int count;
+} AioQueue;
+
+typedef struct AioStats {
+  int submitted;
+  int completed;
+  int failed;
+  int cancelled;
+  int batches;
+  int batched;
+  uint64_t bytes;
+} AioStats;
+
+typedef struct AioRing {
+  int fd;
+  int wake_fd;
+  void* sq_ptr;
+  size_t sq_map_size;
+  void* cq_ptr;
+  size_t cq_map_size;
+  void* sqes;
+  size_t sqes_map_size;
+  unsigned* sq_head;
+  unsigned* sq_tail;
+  unsigned* sq_mask;
+  unsigned* sq_array;
+  unsigned sq_entries;
+  unsigned* cq_head;
+  unsigned* cq_tail;
+  unsigned* cq_mask;
+  void* cqes;
+  int in_flight;
+  // Buffers the kernel may still write after a failed fallback drain
+  void** retired;
+  int retired_count;
+} AioRing;
+
+// Reads whole assets on background threads. With io_uring a single thread
+// owns the ring and submits queued reads in batches; otherwise a small pool
+// uses pread. Callbacks run on the thread calling aio_poll.
+typedef struct AsyncIo {
+  AioBackend backend;
+  AioRing ring;
+  pthread_t* threads;
+  int thread_count;
+  AioRequest* requests;
+  int capacity;
+  int free_head;
+  int completed_head;
+  int completed_tail;
+  int live;
+  AioQueue queues[AIO_PRIORITY_COUNT];
+  bool stopping;
+  AioStats stats;
+  pthread_mutex_t lock;
+  pthread_cond_t has_work;
+  pthread_cond_t completed;
+} AsyncIo;
+
+// `depth` bounds the reads in flight. `thread_count` sizes the fallback
+// pool, 0 picks a default; `allow_uring` false forces the fallback.
+void aio_init(AsyncIo* aio, int capacity, int depth, int thread_count,
+              bool allow_uring);
+// Cancels everything still queued and delivers the remaining callbacks
+void aio_destroy(AsyncIo* aio);
+
+// Reads a whole file through the VFS, decompressing pak entries. Returns
+// AIO_INVALID_HANDLE when every request slot is in use.
+AioHandle aio_read_file(AsyncIo* aio, const char* path, AioPriority priority,
+                        AioCallback callback, void* user);
+
+// Queued requests complete as cancelled on the next poll; reads already in
+// flight are dropped when they land. False when the request has finished.
+bool aio_cancel(AsyncIo* aio, AioHandle handle);
+
+// Runs callbacks for finished requests, returns how many ran
+int aio_poll(AsyncIo* aio);
+// Blocks until every request has finished and its callback has run
+void aio_flush(AsyncIo* aio);
+
+#endif
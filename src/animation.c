@@ -0,0 +1,38 @@
+#include "animation.h"
+
+#include <stddef.h>
+
+void animation_instance_init(AnimatedInstance* instance, const float* position,
+                             const float* axis, float speed, float phase) {
+    vec3 normalised = {axis[0], axis[1], axis[2]};
+    if (vec3_len(normalised) > 1e-4f)
+        vec3_norm(normalised, normalised);
+    else
+        normalised[1] = 1.0f;
+    for (int i = 0; i < 3; i++) {
+        instance->position[i] = position[i];
+        instance->axis[i] = normalised[i];
+    }
+    instance->speed = speed;
+    instance->phase = phase;
+}
+
+void animation_instance_matrix(mat4x4 model, const AnimatedInstance* instance,
+                               float time) {
+    mat4x4_translate(model, instance->position[0], instance->position[1],
+                     instance->position[2]);
+    mat4x4_rotate(model, model, instance->axis[0], instance->axis[1], instance->axis[2],
+                  instance->speed * time + instance->phase);
+}
+
+void animation_instance_attributes(GLuint vao, GLuint location) {
+    glBindVertexArray(vao);
+    glVertexAttribPointer(location, 4, GL_FLOAT, GL_FALSE, sizeof(AnimatedInstance),
+                          (void *)offsetof(AnimatedInstance, position));
+    glVertexAttribPointer(location + 1, 4, GL_FLOAT, GL_FALSE, sizeof(AnimatedInstance),
+                          (void *)offsetof(AnimatedInstance, axis));
+    for (GLuint i = 0; i < 2; i++) {
+        glEnableVertexAttribArray(location + i);
+        glVertexAttribDivisor(location + i, 1);
+    }
+}
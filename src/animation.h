@@ -0,0 +1,30 @@
+#ifndef ANIMATION_H
+#define ANIMATION_H
+
+#include <glad/gl.h>
+
+#include "linmath.h"
+
+// Parameters of an object spinning in place, laid out as two vec4 vertex
+// attributes. Uploaded once; the vertex shader turns them into the model
+// matrix from a time uniform, so animating costs no CPU per frame.
+typedef struct AnimatedInstance {
+  float position[3];
+  float phase;
+  float axis[3];
+  float speed;
+} AnimatedInstance;
+
+// `axis` need not be normalised, `speed` and `phase` are in radians
+void animation_instance_init(AnimatedInstance* instance, const float* position,
+                             const float* axis, float speed, float phase);
+
+// Same transform the shader computes, for drawing without instancing
+void animation_instance_matrix(mat4x4 model, const AnimatedInstance* instance,
+                               float time);
+
+// Points `location` and `location + 1` of `vao` at the instances in the
+// bound GL_ARRAY_BUFFER, advancing once per instance
+void animation_instance_attributes(GLuint vao, GLuint location);
+
+#endif
@@ -0,0 +1,110 @@
+#include "atlas.h"
+
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+
+void atlas_init(Atlas* atlas, int width, int height) {
+    memset(atlas, 0, sizeof(*atlas));
+    atlas->width = width;
+    atlas->height = height;
+    atlas->node_capacity = 16;
+    atlas->nodes = (AtlasNode *)malloc(atlas->node_capacity * sizeof(AtlasNode));
+    atlas_reset(atlas);
+}
+
+void atlas_destroy(Atlas* atlas) {
+    free(atlas->nodes);
+    memset(atlas, 0, sizeof(*atlas));
+}
+
+void atlas_reset(Atlas* atlas) {
+    AtlasNode floor = {0, 0, atlas->width};
+    atlas->nodes[0] = floor;
+    atlas->node_count = 1;
+    atlas->used_area = 0;
+}
+
+// Height the rectangle would rest at if its left edge sat on node `index`,
+// -1 if it runs off the right or top
+static int atlas_fit(const Atlas* atlas, int index, int width, int height) {
+    int x = atlas->nodes[index].x;
+    if (x + width > atlas->width)
+        return -1;
+    int y = 0, remaining = width;
+    for (int i = index; remaining > 0; i++) {
+        if (atlas->nodes[i].y > y)
+            y = atlas->nodes[i].y;
+        remaining -= atlas->nodes[i].width;
+    }
+    return y + height <= atlas->height ? y : -1;
+}
+
+bool atlas_pack(Atlas* atlas, int width, int height, int* x, int* y) {
+    if (width <= 0 || height <= 0)
+        return false;
+
+    // Lowest resulting top edge, ties broken by the narrowest segment
+    int best = -1, best_top = INT_MAX, best_width = INT_MAX, best_y = 0;
+    for (int i = 0; i < atlas->node_count; i++) {
+        int fit = atlas_fit(atlas, i, width, height);
+        if (fit < 0)
+            continue;
+        if (fit + height < best_top ||
+            (fit + height == best_top && atlas->nodes[i].width < best_width)) {
+            best = i;
+            best_top = fit + height;
+            best_width = atlas->nodes[i].width;
+            best_y = fit;
+        }
+    }
+    if (best < 0)
+        return false;
+
+    if (atlas->node_count == atlas->node_capacity) {
+        atlas->node_capacity *= 2;
+        atlas->nodes = (AtlasNode *)realloc(atlas->nodes,
+                                            atlas->node_capacity * sizeof(AtlasNode));
+    }
+    AtlasNode node = {atlas->nodes[best].x, best_y + height, width};
+    memmove(&atlas->nodes[best + 1], &atlas->nodes[best],
+            (atlas->node_count - best) * sizeof(AtlasNode));
+    atlas->nodes[best] = node;
+    atlas->node_count++;
+
+    // Segments now under the new one shrink or disappear
+    int right = node.x + node.width;
+    int i = best + 1;
+    while (i < atlas->node_count && atlas->nodes[i].x < right) {
+        AtlasNode *next = &atlas->nodes[i];
+        int overlap = right - next->x;
+        if (overlap < next->width) {
+            next->x += overlap;
+            next->width -= overlap;
+            break;
+        }
+        memmove(next, next + 1, (atlas->node_count - i - 1) * sizeof(AtlasNode));
+        atlas->node_count--;
+    }
+
+    // Neighbours at the same height merge into one segment
+    for (i = 0; i + 1 < atlas->node_count;) {
+        if (atlas->nodes[i].y == atlas->nodes[i + 1].y) {
+            atlas->nodes[i].width += atlas->nodes[i + 1].width;
+            memmove(&atlas->nodes[i + 1], &atlas->nodes[i + 2],
+                    (atlas->node_count - i - 2) * sizeof(AtlasNode));
+            atlas->node_count--;
+        } else {
+            i++;
+        }
+    }
+
+    atlas->used_area += (long)width * height;
+    *x = node.x;
+    *y = best_y;
+    return true;
+}
+
+float atlas_occupancy(const Atlas* atlas) {
+    return (float)atlas->used_area / ((float)atlas->width * atlas->height);
+}
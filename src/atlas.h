@@ -0,0 +1,32 @@
+#ifndef ATLAS_H
+#define ATLAS_H
+
+#include <stdbool.h>
+
+typedef struct AtlasNode {
+  int x;
+  int y;
+  int width;
+} AtlasNode;
+
+// Skyline rectangle packer. The skyline is the top edge of everything packed
+// so far, kept as left-to-right segments; a rectangle goes where it leaves
+// the lowest top edge.
+typedef struct Atlas {
+  int width;
+  int height;
+  AtlasNode* nodes;
+  int node_count;
+  int node_capacity;
+  long used_area;
+} Atlas;
+
+void atlas_init(Atlas* atlas, int width, int height);
+void atlas_destroy(Atlas* atlas);
+void atlas_reset(Atlas* atlas);
+
+// Returns false when the rectangle does not fit anywhere
+bool atlas_pack(Atlas* atlas, int width, int height, int* x, int* y);
+float atlas_occupancy(const Atlas* atlas);
+
+#endif
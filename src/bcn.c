@@ -0,0 +1,569 @@
+#include "bcn.h"
+
+#include <float.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+// Pixels as floats, one array per channel so four pixels fit an SSE register
+typedef struct BcnPixels {
+  float c[4][16];
+} BcnPixels;
+
+static const int bc7_weights[16] = {0,  4,  9,  13, 17, 21, 26, 30,
+                                    34, 38, 43, 47, 51, 55, 60, 64};
+
+int bcn_block_bytes(BcnFormat format) {
+    return format == BCN_BC1 || format == BCN_BC4 ? 8 : 16;
+}
+
+size_t bcn_image_size(BcnFormat format, int width, int height) {
+    return (size_t)((width + 3) / 4) * ((height + 3) / 4) * bcn_block_bytes(format);
+}
+
+static int bcn_round(float v, int max) {
+    int i = (int)(v + 0.5f);
+    return i < 0 ? 0 : i > max ? max : i;
+}
+
+// Picks the nearest palette entry for every pixel over the first
+// `channels` of `chan`, returns the summed squared error
+static float bcn_fit(const float* const* chan, int channels,
+                     const float (*palette)[4], int count, uint8_t* indices) {
+    float total = 0.0f;
+#ifdef __SSE2__
+    for (int i = 0; i < 16; i += 4) {
+        __m128 best = _mm_set1_ps(FLT_MAX);
+        __m128i best_index = _mm_setzero_si128();
+        for (int p = 0; p < count; p++) {
+            __m128 err = _mm_setzero_ps();
+            for (int c = 0; c < channels; c++) {
+                __m128 d = _mm_sub_ps(_mm_loadu_ps(&chan[c][i]),
+                                      _mm_set1_ps(palette[p][c]));
+                err = _mm_add_ps(err, _mm_mul_ps(d, d));
+            }
+            __m128i less = _mm_castps_si128(_mm_cmplt_ps(err, best));
+            best = _mm_min_ps(err, best);
+            best_index = _mm_or_si128(_mm_andnot_si128(less, best_index),
+                                      _mm_and_si128(less, _mm_set1_epi32(p)));
+        }
+        int index[4];
+        float err[4];
+        _mm_storeu_si128((__m128i *)index, best_index);
+        _mm_storeu_ps(err, best);
+        for (int j = 0; j < 4; j++) {
+            indices[i + j] = (uint8_t)index[j];
+            total += err[j];
+        }
+    }
+#else
+    for (int i = 0; i < 16; i++) {
+        float best = FLT_MAX;
+        for (int p = 0; p < count; p++) {
+            float err = 0.0f;
+            for (int c = 0; c < channels; c++) {
+                float d = chan[c][i] - palette[p][c];
+                err += d * d;
+            }
+            if (err < best) {
+                best = err;
+                indices[i] = (uint8_t)p;
+            }
+        }
+        total += best;
+    }
+#endif
+    return total;
+}
+
+// Endpoints at the extremes of the principal axis
+static void bcn_principal_endpoints(const float* const* chan, int channels,
+                                    float* e0, float* e1) {
+    float mean[4] = {0};
+    for (int c = 0; c < channels; c++) {
+        for (int i = 0; i < 16; i++)
+            mean[c] += chan[c][i];
+        mean[c] /= 16.0f;
+    }
+
+    float cov[4][4] = {{0}};
+    for (int i = 0; i < 16; i++)
+        for (int a = 0; a < channels; a++)
+            for (int b = 0; b < channels; b++)
+                cov[a][b] += (chan[a][i] - mean[a]) * (chan[b][i] - mean[b]);
+
+    // Power iteration
+    float axis[4] = {1.0f, 1.0f, 1.0f, 1.0f};
+    for (int iteration = 0; iteration < 8; iteration++) {
+        float next[4] = {0}, length = 0.0f;
+        for (int a = 0; a < channels; a++) {
+            for (int b = 0; b < channels; b++)
+                next[a] += cov[a][b] * axis[b];
+            length += next[a] * next[a];
+        }
+        if (length < 1e-12f)
+            break;
+        length = 1.0f / sqrtf(length);
+        for (int a = 0; a < channels; a++)
+            axis[a] = next[a] * length;
+    }
+
+    float tmin = FLT_MAX, tmax = -FLT_MAX;
+    for (int i = 0; i < 16; i++) {
+        float t = 0.0f;
+        for (int c = 0; c < channels; c++)
+            t += (chan[c][i] - mean[c]) * axis[c];
+        if (t < tmin)
+            tmin = t;
+        if (t > tmax)
+            tmax = t;
+    }
+    for (int c = 0; c < channels; c++) {
+        e0[c] = fminf(fmaxf(mean[c] + axis[c] * tmin, 0.0f), 255.0f);
+        e1[c] = fminf(fmaxf(mean[c] + axis[c] * tmax, 0.0f), 255.0f);
+    }
+}
+
+// Least squares endpoints for fixed interpolation weights in [0, 1]
+static bool bcn_refine(const float* const* chan, int channels, const uint8_t* indices,
+                       const float* weights, float* e0, float* e1) {
+    float a = 0.0f, b = 0.0f, c = 0.0f, x0[4] = {0}, x1[4] = {0};
+    for (int i = 0; i < 16; i++) {
+        float w = weights[indices[i]], v = 1.0f - w;
+        a += v * v;
+        b += v * w;
+        c += w * w;
+        for (int k = 0; k < channels; k++) {
+            x0[k] += v * chan[k][i];
+            x1[k] += w * chan[k][i];
+        }
+    }
+    float det = a * c - b * b;
+    if (fabsf(det) < 1e-6f)
+        return false;
+    for (int k = 0; k < channels; k++) {
+        e0[k] = fminf(fmaxf((c * x0[k] - b * x1[k]) / det, 0.0f), 255.0f);
+        e1[k] = fminf(fmaxf((a * x1[k] - b * x0[k]) / det, 0.0f), 255.0f);
+    }
+    return true;
+}
+
+static uint16_t bcn_pack565(const float* c) {
+    return (uint16_t)(bcn_round(c[0] * 31.0f / 255.0f, 31) << 11 |
+                      bcn_round(c[1] * 63.0f / 255.0f, 63) << 5 |
+                      bcn_round(c[2] * 31.0f / 255.0f, 31));
+}
+
+static void bcn_unpack565(uint16_t v, int* c) {
+    int r = v >> 11 & 31, g = v >> 5 & 63, b = v & 31;
+    c[0] = r << 3 | r >> 2;
+    c[1] = g << 2 | g >> 4;
+    c[2] = b << 3 | b >> 2;
+}
+
+static void bcn_encode_bc1(const BcnPixels* px, uint8_t* out) {
+    static const float weights[4] = {0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f};
+    const float *chan[3] = {px->c[0], px->c[1], px->c[2]};
+    float e0[4], e1[4];
+    bcn_principal_endpoints(chan, 3, e0, e1);
+
+    float best = FLT_MAX;
+    uint16_t best0 = 0, best1 = 0;
+    uint8_t best_indices[16] = {0};
+    for (int iteration = 0; iteration < 2; iteration++) {
+        uint16_t c0 = bcn_pack565(e1), c1 = bcn_pack565(e0);
+        if (c0 < c1) {
+            uint16_t t = c0;
+            c0 = c1;
+            c1 = t;
+        }
+
+        int p0[3], p1[3];
+        bcn_unpack565(c0, p0);
+        bcn_unpack565(c1, p1);
+        float palette[4][4];
+        for (int k = 0; k < 3; k++) {
+            palette[0][k] = (float)p0[k];
+            palette[1][k] = (float)p1[k];
+            palette[2][k] = (2.0f * p0[k] + p1[k]) / 3.0f;
+            palette[3][k] = (p0[k] + 2.0f * p1[k]) / 3.0f;
+        }
+
+        // Equal endpoints select the three colour mode, index 0 stays exact
+        uint8_t indices[16];
+        float err = bcn_fit(chan, 3, palette, c0 == c1 ? 1 : 4, indices);
+        if (err < best) {
+            best = err;
+            best0 = c0;
+            best1 = c1;
+            memcpy(best_indices, indices, sizeof(indices));
+        }
+        if (c0 == c1 || !bcn_refine(chan, 3, indices, weights, e1, e0))
+            break;
+    }
+
+    uint32_t bits = 0;
+    for (int i = 0; i < 16; i++)
+        bits |= (uint32_t)best_indices[i] << (2 * i);
+    memcpy(out, &best0, 2);
+    memcpy(out + 2, &best1, 2);
+    memcpy(out + 4, &bits, 4);
+}
+
+static void bcn_encode_bc4(const float* values, uint8_t* out) {
+    static const float weights[8] = {0.0f,        1.0f,        1.0f / 7.0f, 2.0f / 7.0f,
+                                     3.0f / 7.0f, 4.0f / 7.0f, 5.0f / 7.0f, 6.0f / 7.0f};
+    const float *chan[1] = {values};
+    float lo = values[0], hi = values[0];
+    for (int i = 1; i < 16; i++) {
+        lo = fminf(lo, values[i]);
+        hi = fmaxf(hi, values[i]);
+    }
+
+    float best = FLT_MAX;
+    int best0 = 0, best1 = 0;
+    uint8_t best_indices[16] = {0};
+    float e0 = hi, e1 = lo;
+    for (int iteration = 0; iteration < 2; iteration++) {
+        int a0 = bcn_round(e0, 255), a1 = bcn_round(e1, 255);
+        if (a0 < a1) {
+            int t = a0;
+            a0 = a1;
+            a1 = t;
+        }
+
+        float palette[8][4];
+        palette[0][0] = (float)a0;
+        palette[1][0] = (float)a1;
+        for (int i = 2; i < 8; i++)
+            palette[i][0] = ((8 - i) * a0 + (i - 1) * a1) / 7.0f;
+
+        uint8_t indices[16];
+        float err = bcn_fit(chan, 1, palette, a0 == a1 ? 1 : 8, indices);
+        if (err < best) {
+            best = err;
+            best0 = a0;
+            best1 = a1;
+            memcpy(best_indices, indices, sizeof(indices));
+        }
+        if (a0 == a1 || !bcn_refine(chan, 1, indices, weights, &e0, &e1))
+            break;
+    }
+
+    uint64_t bits = 0;
+    for (int i = 0; i < 16; i++)
+        bits |= (uint64_t)best_indices[i] << (3 * i);
+    out[0] = (uint8_t)best0;
+    out[1] = (uint8_t)best1;
+    for (int i = 0; i < 6; i++)
+        out[2 + i] = (uint8_t)(bits >> (8 * i));
+}
+
+// 7 bit endpoint plus shared p-bit, whichever p-bit lands closer
+static int bc7_quantize(const float* e, int* q) {
+    float best = FLT_MAX;
+    int best_p = 0;
+    for (int p = 0; p < 2; p++) {
+        float err = 0.0f;
+        int t[4];
+        for (int c = 0; c < 4; c++) {
+            t[c] = bcn_round((e[c] - p) * 0.5f, 127);
+            float d = (float)(t[c] << 1 | p) - e[c];
+            err += d * d;
+        }
+        if (err < best) {
+            best = err;
+            best_p = p;
+            memcpy(q, t, sizeof(t));
+        }
+    }
+    return best_p;
+}
+
+static void bc7_put_bits(uint8_t* out, int* pos, uint32_t value, int bits) {
+    for (int i = 0; i < bits; i++, (*pos)++)
+        if (value >> i & 1)
+            out[*pos >> 3] |= (uint8_t)(1 << (*pos & 7));
+}
+
+// Mode 6: one subset, RGBA 7.7.7.7 endpoints with p-bits, 4 bit indices
+static void bcn_encode_bc7(const BcnPixels* px, uint8_t* out) {
+    float weights[16];
+    for (int i = 0; i < 16; i++)
+        weights[i] = bc7_weights[i] / 64.0f;
+    const float *chan[4] = {px->c[0], px->c[1], px->c[2], px->c[3]};
+    float e0[4], e1[4];
+    bcn_principal_endpoints(chan, 4, e0, e1);
+
+    float best = FLT_MAX;
+    int best_q[2][4] = {{0}}, best_p[2] = {0};
+    uint8_t best_indices[16] = {0};
+    for (int iteration = 0; iteration < 3; iteration++) {
+        int q[2][4], p[2];
+        p[0] = bc7_quantize(e0, q[0]);
+        p[1] = bc7_quantize(e1, q[1]);
+
+        float palette[16][4];
+        for (int c = 0; c < 4; c++) {
+            int a = q[0][c] << 1 | p[0], b = q[1][c] << 1 | p[1];
+            for (int i = 0; i < 16; i++)
+                palette[i][c] =
+                    (float)(((64 - bc7_weights[i]) * a + bc7_weights[i] * b + 32) >> 6);
+        }
+
+        uint8_t indices[16];
+        float err = bcn_fit(chan, 4, palette, 16, indices);
+        if (err < best) {
+            best = err;
+            memcpy(best_q, q, sizeof(q));
+            memcpy(best_p, p, sizeof(p));
+            memcpy(best_indices, indices, sizeof(indices));
+        }
+        if (!bcn_refine(chan, 4, indices, weights, e0, e1))
+            break;
+    }
+
+    // The first index is stored without its top bit
+    if (best_indices[0] & 8) {
+        for (int c = 0; c < 4; c++) {
+            int t = best_q[0][c];
+            best_q[0][c] = best_q[1][c];
+            best_q[1][c] = t;
+        }
+        int t = best_p[0];
+        best_p[0] = best_p[1];
+        best_p[1] = t;
+        for (int i = 0; i < 16; i++)
+            best_indices[i] = 15 - best_indices[i];
+    }
+
+    memset(out, 0, 16);
+    int pos = 0;
+    bc7_put_bits(out, &pos, 1 << 6, 7);
+    for (int c = 0; c < 4; c++) {
+        bc7_put_bits(out, &pos, best_q[0][c], 7);
+        bc7_put_bits(out, &pos, best_q[1][c], 7);
+    }
+    bc7_put_bits(out, &pos, best_p[0], 1);
+    bc7_put_bits(out, &pos, best_p[1], 1);
+    for (int i = 0; i < 16; i++)
+        bc7_put_bits(out, &pos, best_indices[i], i == 0 ? 3 : 4);
+}
+
+void bcn_encode_block(BcnFormat format, const uint8_t* rgba, uint8_t* out) {
+    BcnPixels px;
+    for (int i = 0; i < 16; i++)
+        for (int c = 0; c < 4; c++)
+            px.c[c][i] = rgba[i * 4 + c];
+
+    switch (format) {
+    case BCN_BC1:
+        bcn_encode_bc1(&px, out);
+        break;
+    case BCN_BC3:
+        bcn_encode_bc4(px.c[3], out);
+        bcn_encode_bc1(&px, out + 8);
+        break;
+    case BCN_BC4:
+        bcn_encode_bc4(px.c[0], out);
+        break;
+    case BCN_BC5:
+        bcn_encode_bc4(px.c[0], out);
+        bcn_encode_bc4(px.c[1], out + 8);
+        break;
+    case BCN_BC7:
+        bcn_encode_bc7(&px, out);
+        break;
+    default:
+        break;
+    }
+}
+
+typedef struct BcnRows {
+  BcnFormat format;
+  const uint8_t* rgba;
+  int width;
+  int height;
+  int first_row;
+  int row_count;
+  uint8_t* out;
+} BcnRows;
+
+static void bcn_encode_rows(void* arg) {
+    BcnRows *rows = (BcnRows *)arg;
+    int blocks_x = (rows->width + 3) / 4, block_bytes = bcn_block_bytes(rows->format);
+    uint8_t block[64];
+    for (int by = rows->first_row; by < rows->first_row + rows->row_count; by++) {
+        for (int bx = 0; bx < blocks_x; bx++) {
+            for (int y = 0; y < 4; y++) {
+                int sy = by * 4 + y < rows->height ? by * 4 + y : rows->height - 1;
+                for (int x = 0; x < 4; x++) {
+                    int sx = bx * 4 + x < rows->width ? bx * 4 + x : rows->width - 1;
+                    memcpy(&block[(y * 4 + x) * 4],
+                           &rows->rgba[((size_t)sy * rows->width + sx) * 4], 4);
+                }
+            }
+            bcn_encode_block(rows->format, block,
+                             rows->out + ((size_t)by * blocks_x + bx) * block_bytes);
+        }
+    }
+}
+
+void bcn_encode_image(BcnFormat format, const uint8_t* rgba, int width,
+                      int height, uint8_t* out, JobSystem* jobs) {
+    int blocks_y = (height + 3) / 4;
+    int job_count = jobs ? jobs->thread_count * 4 : 1;
+    if (job_count > blocks_y)
+        job_count = blocks_y;
+    if (job_count < 1)
+        return;
+
+    BcnRows *rows = (BcnRows *)malloc(job_count * sizeof(BcnRows));
+    JobCounter counter = {0};
+    int first = 0;
+    for (int i = 0; i < job_count; i++) {
+        int count = blocks_y / job_count + (i < blocks_y % job_count);
+        BcnRows r = {format, rgba, width, height, first, count, out};
+        rows[i] = r;
+        first += count;
+        if (jobs)
+            job_submit_counted(jobs, bcn_encode_rows, &rows[i], &counter);
+        else
+            bcn_encode_rows(&rows[i]);
+    }
+    if (jobs)
+        job_wait_counter(jobs, &counter);
+    free(rows);
+}
+
+static void bcn_decode_bc1(const uint8_t* block, uint8_t* rgba, bool force_four) {
+    uint16_t c0, c1;
+    uint32_t bits;
+    memcpy(&c0, block, 2);
+    memcpy(&c1, block + 2, 2);
+    memcpy(&bits, block + 4, 4);
+
+    int palette[4][4], p0[3], p1[3];
+    bcn_unpack565(c0, p0);
+    bcn_unpack565(c1, p1);
+    for (int k = 0; k < 3; k++) {
+        palette[0][k] = p0[k];
+        palette[1][k] = p1[k];
+        if (c0 > c1 || force_four) {
+            palette[2][k] = (2 * p0[k] + p1[k]) / 3;
+            palette[3][k] = (p0[k] + 2 * p1[k]) / 3;
+        } else {
+            palette[2][k] = (p0[k] + p1[k]) / 2;
+            palette[3][k] = 0;
+        }
+    }
+    for (int i = 0; i < 4; i++)
+        palette[i][3] = 255;
+    if (c0 <= c1 && !force_four)
+        palette[3][3] = 0;
+
+    for (int i = 0; i < 16; i++)
+        for (int k = 0; k < 4; k++)
+            rgba[i * 4 + k] = (uint8_t)palette[bits >> (2 * i) & 3][k];
+}
+
+static void bcn_decode_bc4(const uint8_t* block, uint8_t* rgba, int channel) {
+    int a0 = block[0], a1 = block[1], palette[8];
+    palette[0] = a0;
+    palette[1] = a1;
+    if (a0 > a1) {
+        for (int i = 2; i < 8; i++)
+            palette[i] = ((8 - i) * a0 + (i - 1) * a1) / 7;
+    } else {
+        for (int i = 2; i < 6; i++)
+            palette[i] = ((6 - i) * a0 + (i - 1) * a1) / 5;
+        palette[6] = 0;
+        palette[7] = 255;
+    }
+
+    uint64_t bits = 0;
+    for (int i = 0; i < 6; i++)
+        bits |= (uint64_t)block[2 + i] << (8 * i);
+    for (int i = 0; i < 16; i++)
+        rgba[i * 4 + channel] = (uint8_t)palette[bits >> (3 * i) & 7];
+}
+
+static uint32_t bc7_get_bits(const uint8_t* block, int* pos, int bits) {
+    uint32_t value = 0;
+    for (int i = 0; i < bits; i++, (*pos)++)
+        value |= (uint32_t)(block[*pos >> 3] >> (*pos & 7) & 1) << i;
+    return value;
+}
+
+static bool bcn_decode_bc7(const uint8_t* block, uint8_t* rgba) {
+    if ((block[0] & 0x7f) != 0x40)
+        return false;
+
+    int pos = 7, e[2][4];
+    for (int c = 0; c < 4; c++) {
+        e[0][c] = (int)bc7_get_bits(block, &pos, 7) << 1;
+        e[1][c] = (int)bc7_get_bits(block, &pos, 7) << 1;
+    }
+    int p0 = (int)bc7_get_bits(block, &pos, 1), p1 = (int)bc7_get_bits(block, &pos, 1);
+    for (int c = 0; c < 4; c++) {
+        e[0][c] |= p0;
+        e[1][c] |= p1;
+    }
+    for (int i = 0; i < 16; i++) {
+        int w = bc7_weights[bc7_get_bits(block, &pos, i == 0 ? 3 : 4)];
+        for (int c = 0; c < 4; c++)
+            rgba[i * 4 + c] = (uint8_t)(((64 - w) * e[0][c] + w * e[1][c] + 32) >> 6);
+    }
+    return true;
+}
+
+bool bcn_decode_block(BcnFormat format, const uint8_t* block, uint8_t* rgba) {
+    switch (format) {
+    case BCN_BC1:
+        bcn_decode_bc1(block, rgba, false);
+        return true;
+    case BCN_BC3:
+        bcn_decode_bc1(block + 8, rgba, true);
+        bcn_decode_bc4(block, rgba, 3);
+        return true;
+    case BCN_BC4:
+    case BCN_BC5:
+        for (int i = 0; i < 16; i++) {
+            rgba[i * 4 + 1] = 0;
+            rgba[i * 4 + 2] = 0;
+            rgba[i * 4 + 3] = 255;
+        }
+        bcn_decode_bc4(block, rgba, 0);
+        if (format == BCN_BC5)
+            bcn_decode_bc4(block + 8, rgba, 1);
+        return true;
+    case BCN_BC7:
+        return bcn_decode_bc7(block, rgba);
+    default:
+        return false;
+    }
+}
+
+bool bcn_decode_image(BcnFormat format, const uint8_t* data, int width,
+                      int height, uint8_t* rgba) {
+    int blocks_x = (width + 3) / 4, blocks_y = (height + 3) / 4;
+    int block_bytes = bcn_block_bytes(format);
+    uint8_t block[64];
+    for (int by = 0; by < blocks_y; by++) {
+        for (int bx = 0; bx < blocks_x; bx++) {
+            if (!bcn_decode_block(format, data + ((size_t)by * blocks_x + bx) * block_bytes,
+                                  block))
+                return false;
+            for (int y = 0; y < 4 && by * 4 + y < height; y++) {
+                int w = width - bx * 4 < 4 ? width - bx * 4 : 4;
+                memcpy(&rgba[((size_t)(by * 4 + y) * width + bx * 4) * 4],
+                       &block[y * 16], w * 4);
+            }
+        }
+    }
+    return true;
+}
@@ -0,0 +1,37 @@
+#ifndef BCN_H
+#define BCN_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "job.h"
+
+// BC4 stores the red channel and BC5 red and green. BC1 is always opaque.
+typedef enum BcnFormat {
+  BCN_BC1,
+  BCN_BC3,
+  BCN_BC4,
+  BCN_BC5,
+  BCN_BC7,
+  BCN_FORMAT_COUNT
+} BcnFormat;
+
+int bcn_block_bytes(BcnFormat format);
+size_t bcn_image_size(BcnFormat format, int width, int height);
+
+// `rgba` is a 4x4 block of RGBA8 pixels, row by row
+void bcn_encode_block(BcnFormat format, const uint8_t* rgba, uint8_t* out);
+
+// Edge blocks repeat the last row and column. With `jobs` the block rows are
+// spread over the worker threads.
+void bcn_encode_image(BcnFormat format, const uint8_t* rgba, int width,
+                      int height, uint8_t* out, JobSystem* jobs);
+
+// Decodes to RGBA8. BC7 blocks using a mode other than 6, which is the only
+// one the encoder emits, are rejected.
+bool bcn_decode_block(BcnFormat format, const uint8_t* block, uint8_t* rgba);
+bool bcn_decode_image(BcnFormat format, const uint8_t* data, int width,
+                      int height, uint8_t* rgba);
+
+#endif
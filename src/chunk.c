@@ -0,0 +1,482 @@
+#include "chunk.h"
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+static int chunk_index(int x, int y, int z) {
+    return x + y * CHUNK_SIZE + z * CHUNK_SIZE * CHUNK_SIZE;
+}
+
+Block chunk_get_block(const Chunk* chunk, int x, int y, int z) {
+    return chunk->blocks[chunk_index(x, y, z)];
+}
+
+void chunk_set_block(Chunk* chunk, int x, int y, int z, Block block) {
+    chunk->blocks[chunk_index(x, y, z)] = block;
+}
+
+// Looks one block past the chunk border into the neighbouring chunk. Missing
+// neighbours count as air so the outer faces of the world are kept.
+static Block chunk_sample(const Chunk* chunk, int p[3]) {
+    for (int axis = 0; axis < 3; axis++) {
+        if (p[axis] < 0 || p[axis] >= CHUNK_SIZE) {
+            const Chunk *neighbor = chunk->neighbors[axis * 2 + (p[axis] >= 0)];
+            if (!neighbor)
+                return BLOCK_AIR;
+            int q[3] = {p[0], p[1], p[2]};
+            q[axis] = (q[axis] + CHUNK_SIZE) % CHUNK_SIZE;
+            return chunk_get_block(neighbor, q[0], q[1], q[2]);
+        }
+    }
+    return chunk_get_block(chunk, p[0], p[1], p[2]);
+}
+
+static void chunk_mesh_reserve(ChunkMesh* mesh, int vertices, int indices) {
+    if (mesh->vertex_count + vertices > mesh->vertex_capacity) {
+        mesh->vertex_capacity = (mesh->vertex_capacity + vertices) * 2;
+        mesh->vertices = (float *)realloc(
+            mesh->vertices,
+            mesh->vertex_capacity * CHUNK_VERTEX_FLOATS * sizeof(float));
+    }
+    if (mesh->index_count + indices > mesh->index_capacity) {
+        mesh->index_capacity = (mesh->index_capacity + indices) * 2;
+        mesh->indices = (uint32_t *)realloc(
+            mesh->indices, mesh->index_capacity * sizeof(uint32_t));
+    }
+}
+
+static void chunk_emit_quad(ChunkMesh* mesh, const Chunk* chunk, int d,
+                            bool positive, int base[3], int du[3], int dv[3],
+                            int w, int h) {
+    chunk_mesh_reserve(mesh, 4, 6);
+
+    float origin[3] = {(float)chunk->x * CHUNK_SIZE, (float)chunk->y * CHUNK_SIZE,
+                       (float)chunk->z * CHUNK_SIZE};
+    float normal[3] = {0.0f, 0.0f, 0.0f};
+    normal[d] = positive ? 1.0f : -1.0f;
+    const float uvs[4][2] = {{0.0f, 0.0f}, {(float)w, 0.0f},
+                             {(float)w, (float)h}, {0.0f, (float)h}};
+
+    uint32_t first = mesh->vertex_count;
+    for (int corner = 0; corner < 4; corner++) {
+        float *v = &mesh->vertices[mesh->vertex_count * CHUNK_VERTEX_FLOATS];
+        for (int axis = 0; axis < 3; axis++) {
+            float p = (float)base[axis];
+            if (corner == 1 || corner == 2)
+                p += du[axis];
+            if (corner == 2 || corner == 3)
+                p += dv[axis];
+            v[axis] = origin[axis] + p;
+            v[3 + axis] = normal[axis];
+        }
+        v[6] = uvs[corner][0];
+        v[7] = uvs[corner][1];
+        mesh->vertex_count++;
+    }
+
+    // u x v points along +d, so flip the winding for faces looking down -d
+    static const uint32_t front[6] = {0, 1, 2, 2, 3, 0};
+    static const uint32_t back[6] = {0, 2, 1, 2, 0, 3};
+    const uint32_t *order = positive ? front : back;
+    for (int i = 0; i < 6; i++)
+        mesh->indices[mesh->index_count++] = first + order[i];
+}
+
+void chunk_mesh_greedy(const Chunk* chunk, ChunkMesh* mesh, ChunkMeshStats* stats) {
+    Block mask[CHUNK_SIZE * CHUNK_SIZE];
+    mesh->vertex_count = 0;
+    mesh->index_count = 0;
+    memset(stats, 0, sizeof(*stats));
+
+    for (int i = 0; i < CHUNK_VOLUME; i++)
+        stats->solid_blocks += chunk->blocks[i] != BLOCK_AIR;
+    if (stats->solid_blocks == 0)
+        return;
+
+    for (int d = 0; d < 3; d++) {
+        int u = (d + 1) % 3;
+        int v = (d + 2) % 3;
+
+        for (int side = 0; side < 2; side++) {
+            bool positive = side == 1;
+            int p[3], q[3];
+
+            for (p[d] = 0; p[d] < CHUNK_SIZE; p[d]++) {
+                // Mask of faces on this slice that are visible from `side`
+                int n = 0;
+                for (p[v] = 0; p[v] < CHUNK_SIZE; p[v]++) {
+                    for (p[u] = 0; p[u] < CHUNK_SIZE; p[u]++, n++) {
+                        Block block = chunk_get_block(chunk, p[0], p[1], p[2]);
+                        mask[n] = BLOCK_AIR;
+                        if (block == BLOCK_AIR)
+                            continue;
+                        q[0] = p[0];
+                        q[1] = p[1];
+                        q[2] = p[2];
+                        q[d] += positive ? 1 : -1;
+                        if (chunk_sample(chunk, q) == BLOCK_AIR) {
+                            mask[n] = block;
+                            stats->visible_faces++;
+                        }
+                    }
+                }
+
+                // Merge runs of equal faces into rectangles, widest first
+                n = 0;
+                for (int j = 0; j < CHUNK_SIZE; j++) {
+                    for (int i = 0; i < CHUNK_SIZE;) {
+                        Block block = mask[n];
+                        if (block == BLOCK_AIR) {
+                            i++;
+                            n++;
+                            continue;
+                        }
+
+                        int w = 1;
+                        while (i + w < CHUNK_SIZE && mask[n + w] == block)
+                            w++;
+
+                        int h = 1;
+                        for (; j + h < CHUNK_SIZE; h++) {
+                            bool row = true;
+                            for (int k = 0; k < w; k++) {
+                                if (mask[n + k + h * CHUNK_SIZE] != block) {
+                                    row = false;
+                                    break;
+                                }
+                            }
+                            if (!row)
+                                break;
+                        }
+
+                        int base[3] = {0, 0, 0};
+                        int du[3] = {0, 0, 0};
+                        int dv[3] = {0, 0, 0};
+                        base[d] = p[d] + (positive ? 1 : 0);
+                        base[u] = i;
+                        base[v] = j;
+                        du[u] = w;
+                        dv[v] = h;
+                        chunk_emit_quad(mesh, chunk, d, positive, base, du, dv,
+                                        w, h);
+                        stats->quads++;
+
+                        for (int y = 0; y < h; y++)
+                            for (int x = 0; x < w; x++)
+                                mask[n + x + y * CHUNK_SIZE] = BLOCK_AIR;
+                        i += w;
+                        n += w;
+                    }
+                }
+            }
+        }
+    }
+}
+
+void chunk_mesh_free(ChunkMesh* mesh) {
+    free(mesh->vertices);
+    free(mesh->indices);
+    memset(mesh, 0, sizeof(*mesh));
+}
+
+void chunk_world_init(ChunkWorld* world, JobSystem* jobs, int vertex_capacity,
+                      int index_capacity) {
+    memset(world, 0, sizeof(*world));
+    world->jobs = jobs;
+    pthread_mutex_init(&world->lock, NULL);
+
+    glGenVertexArrays(1, &world->vao);
+    glBindVertexArray(world->vao);
+    gpu_pool_init(&world->vertices, GL_ARRAY_BUFFER,
+                  CHUNK_VERTEX_FLOATS * sizeof(float), vertex_capacity);
+    gpu_pool_init(&world->indices, GL_ELEMENT_ARRAY_BUFFER, sizeof(uint32_t),
+                  index_capacity);
+
+    GLsizei stride = CHUNK_VERTEX_FLOATS * sizeof(float);
+    glBindBuffer(GL_ARRAY_BUFFER, world->vertices.buffer);
+    // Position attribute
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, (void *)0);
+    glEnableVertexAttribArray(0);
+    // Normal attribute
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, stride,
+                          (void *)(3 * sizeof(float)));
+    glEnableVertexAttribArray(1);
+    // Texture coordinate attribute
+    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, stride,
+                          (void *)(6 * sizeof(float)));
+    glEnableVertexAttribArray(2);
+    glBindVertexArray(0);
+}
+
+void chunk_world_destroy(ChunkWorld* world) {
+    job_wait(world->jobs);
+    for (int i = 0; i < world->chunk_count; i++) {
+        chunk_mesh_free(&world->chunks[i]->mesh);
+        free(world->chunks[i]);
+    }
+    free(world->chunks);
+    free(world->table);
+    free(world->ready);
+    free(world->draw_counts);
+    free(world->draw_offsets);
+    free(world->draw_base_vertices);
+    gpu_pool_destroy(&world->vertices);
+    gpu_pool_destroy(&world->indices);
+    glDeleteVertexArrays(1, &world->vao);
+    pthread_mutex_destroy(&world->lock);
+}
+
+static uint32_t chunk_hash(int x, int y, int z) {
+    uint32_t h = (uint32_t)x * 73856093u ^ (uint32_t)y * 19349663u ^
+                 (uint32_t)z * 83492791u;
+    return h * 2654435761u;
+}
+
+// Open addressing with linear probing, the table is kept at most half full
+static void chunk_table_insert(ChunkWorld* world, Chunk* chunk) {
+    uint32_t mask = world->table_capacity - 1;
+    uint32_t slot = chunk_hash(chunk->x, chunk->y, chunk->z) & mask;
+    while (world->table[slot])
+        slot = (slot + 1) & mask;
+    world->table[slot] = chunk;
+}
+
+static void chunk_table_grow(ChunkWorld* world) {
+    Chunk **old = world->table;
+    int old_capacity = world->table_capacity;
+
+    world->table_capacity = old_capacity ? old_capacity * 2 : 256;
+    world->table = (Chunk **)calloc(world->table_capacity, sizeof(Chunk *));
+    for (int i = 0; i < old_capacity; i++)
+        if (old[i])
+            chunk_table_insert(world, old[i]);
+    free(old);
+}
+
+static void chunk_table_remove(ChunkWorld* world, Chunk* chunk) {
+    uint32_t mask = world->table_capacity - 1;
+    uint32_t slot = chunk_hash(chunk->x, chunk->y, chunk->z) & mask;
+    while (world->table[slot] != chunk)
+        slot = (slot + 1) & mask;
+    world->table[slot] = NULL;
+
+    // Backward shift so later entries of the probe run stay reachable
+    uint32_t hole = slot;
+    for (slot = (slot + 1) & mask; world->table[slot]; slot = (slot + 1) & mask) {
+        Chunk *moved = world->table[slot];
+        uint32_t home = chunk_hash(moved->x, moved->y, moved->z) & mask;
+        if (((slot - home) & mask) >= ((slot - hole) & mask)) {
+            world->table[hole] = moved;
+            world->table[slot] = NULL;
+            hole = slot;
+        }
+    }
+}
+
+Chunk* chunk_world_find(ChunkWorld* world, int x, int y, int z) {
+    if (world->table_capacity == 0)
+        return NULL;
+
+    uint32_t mask = world->table_capacity - 1;
+    uint32_t slot = chunk_hash(x, y, z) & mask;
+    for (Chunk *chunk = world->table[slot]; chunk;
+         slot = (slot + 1) & mask, chunk = world->table[slot]) {
+        if (chunk->x == x && chunk->y == y && chunk->z == z)
+            return chunk;
+    }
+    return NULL;
+}
+
+static const int chunk_neighbor_offsets[6][3] = {
+    {-1, 0, 0}, {1, 0, 0}, {0, -1, 0}, {0, 1, 0}, {0, 0, -1}, {0, 0, 1}};
+
+Chunk* chunk_world_add(ChunkWorld* world, int x, int y, int z) {
+    Chunk *chunk = (Chunk *)calloc(1, sizeof(Chunk));
+    chunk->x = x;
+    chunk->y = y;
+    chunk->z = z;
+    chunk->world = world;
+    chunk->vertex_offset = -1;
+    chunk->index_offset = -1;
+
+    for (int i = 0; i < 6; i++) {
+        Chunk *neighbor = chunk_world_find(world, x + chunk_neighbor_offsets[i][0],
+                                           y + chunk_neighbor_offsets[i][1],
+                                           z + chunk_neighbor_offsets[i][2]);
+        chunk->neighbors[i] = neighbor;
+        if (neighbor)
+            neighbor->neighbors[i ^ 1] = chunk;
+    }
+
+    if (world->chunk_count == world->chunk_capacity) {
+        world->chunk_capacity = world->chunk_capacity ? world->chunk_capacity * 2 : 64;
+        world->chunks = (Chunk **)realloc(world->chunks,
+                                          world->chunk_capacity * sizeof(Chunk *));
+    }
+    chunk->slot = world->chunk_count;
+    world->chunks[world->chunk_count++] = chunk;
+
+    if (world->chunk_count * 2 > world->table_capacity)
+        chunk_table_grow(world);
+    chunk_table_insert(world, chunk);
+    return chunk;
+}
+
+static double chunk_now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void chunk_mesh_job(void* arg) {
+    Chunk *chunk = (Chunk *)arg;
+    ChunkWorld *world = chunk->world;
+
+    double start = chunk_now();
+    chunk_mesh_greedy(chunk, &chunk->mesh, &chunk->mesh_stats);
+    chunk->mesh_seconds = chunk_now() - start;
+
+    pthread_mutex_lock(&world->lock);
+    chunk->state = CHUNK_MESHED;
+    if (world->ready_count == world->ready_capacity) {
+        world->ready_capacity = world->ready_capacity ? world->ready_capacity * 2 : 64;
+        world->ready = (Chunk **)realloc(world->ready,
+                                         world->ready_capacity * sizeof(Chunk *));
+    }
+    world->ready[world->ready_count++] = chunk;
+    pthread_mutex_unlock(&world->lock);
+}
+
+void chunk_world_remesh(ChunkWorld* world, Chunk* chunk) {
+    // A mesh in flight or waiting for upload still owns `chunk->mesh`, so the
+    // request is remembered and resubmitted once that one is uploaded.
+    pthread_mutex_lock(&world->lock);
+    bool busy = chunk->state == CHUNK_MESHING || chunk->state == CHUNK_MESHED;
+    chunk->dirty = busy;
+    if (!busy)
+        chunk->state = CHUNK_MESHING;
+    pthread_mutex_unlock(&world->lock);
+
+    if (!busy)
+        job_submit(world->jobs, chunk_mesh_job, chunk);
+}
+
+static void chunk_release_gpu(ChunkWorld* world, Chunk* chunk) {
+    if (chunk->vertex_offset >= 0)
+        gpu_pool_free(&world->vertices, chunk->vertex_offset, chunk->vertex_count);
+    if (chunk->index_offset >= 0)
+        gpu_pool_free(&world->indices, chunk->index_offset, chunk->index_count);
+    chunk->vertex_offset = -1;
+    chunk->index_offset = -1;
+    chunk->vertex_count = 0;
+    chunk->index_count = 0;
+}
+
+bool chunk_world_remove(ChunkWorld* world, Chunk* chunk) {
+    pthread_mutex_lock(&world->lock);
+    bool busy = chunk->state == CHUNK_GENERATING ||
+                chunk->state == CHUNK_MESHING || chunk->state == CHUNK_MESHED;
+    // Meshing a neighbour reads this chunk's border blocks
+    for (int i = 0; i < 6; i++)
+        if (chunk->neighbors[i] && chunk->neighbors[i]->state == CHUNK_MESHING)
+            busy = true;
+    pthread_mutex_unlock(&world->lock);
+    if (busy)
+        return false;
+
+    chunk_release_gpu(world, chunk);
+    for (int i = 0; i < 6; i++)
+        if (chunk->neighbors[i])
+            chunk->neighbors[i]->neighbors[i ^ 1] = NULL;
+
+    chunk_table_remove(world, chunk);
+    Chunk *last = world->chunks[--world->chunk_count];
+    world->chunks[chunk->slot] = last;
+    last->slot = chunk->slot;
+
+    chunk_mesh_free(&chunk->mesh);
+    free(chunk);
+    return true;
+}
+
+int chunk_world_upload(ChunkWorld* world, int max_chunks) {
+    int uploaded = 0;
+
+    pthread_mutex_lock(&world->lock);
+    while (world->ready_count > 0 && (max_chunks <= 0 || uploaded < max_chunks)) {
+        Chunk *chunk = world->ready[--world->ready_count];
+        pthread_mutex_unlock(&world->lock);
+
+        chunk_release_gpu(world, chunk);
+        ChunkMesh *mesh = &chunk->mesh;
+        if (mesh->index_count > 0) {
+            int vertex_offset = gpu_pool_alloc(&world->vertices, mesh->vertex_count);
+            int index_offset = gpu_pool_alloc(&world->indices, mesh->index_count);
+            if (vertex_offset >= 0 && index_offset >= 0) {
+                gpu_pool_write(&world->vertices, vertex_offset,
+                               mesh->vertex_count, mesh->vertices);
+                gpu_pool_write(&world->indices, index_offset,
+                               mesh->index_count, mesh->indices);
+                chunk->vertex_offset = vertex_offset;
+                chunk->index_offset = index_offset;
+                chunk->vertex_count = mesh->vertex_count;
+                chunk->index_count = mesh->index_count;
+            } else {
+                if (vertex_offset >= 0)
+                    gpu_pool_free(&world->vertices, vertex_offset, mesh->vertex_count);
+                if (index_offset >= 0)
+                    gpu_pool_free(&world->indices, index_offset, mesh->index_count);
+            }
+        }
+
+        world->stats.chunks_meshed++;
+        world->stats.solid_blocks += chunk->mesh_stats.solid_blocks;
+        world->stats.visible_faces += chunk->mesh_stats.visible_faces;
+        world->stats.quads += chunk->mesh_stats.quads;
+        world->stats.mesh_seconds += chunk->mesh_seconds;
+
+        // CPU copy is no longer needed once it lives in the pool
+        chunk_mesh_free(mesh);
+        chunk->state = CHUNK_READY;
+        uploaded++;
+        if (chunk->dirty)
+            chunk_world_remesh(world, chunk);
+
+        pthread_mutex_lock(&world->lock);
+    }
+    pthread_mutex_unlock(&world->lock);
+    return uploaded;
+}
+
+void chunk_world_draw(ChunkWorld* world) {
+    if (world->draw_capacity < world->chunk_count) {
+        world->draw_capacity = world->chunk_capacity;
+        world->draw_counts = (GLsizei *)realloc(
+            world->draw_counts, world->draw_capacity * sizeof(GLsizei));
+        world->draw_offsets = (void **)realloc(
+            world->draw_offsets, world->draw_capacity * sizeof(void *));
+        world->draw_base_vertices = (GLint *)realloc(
+            world->draw_base_vertices, world->draw_capacity * sizeof(GLint));
+    }
+
+    int draws = 0;
+    for (int i = 0; i < world->chunk_count; i++) {
+        Chunk *chunk = world->chunks[i];
+        if (chunk->index_offset < 0)
+            continue;
+        world->draw_counts[draws] = chunk->index_count;
+        world->draw_offsets[draws] =
+            (void *)((size_t)chunk->index_offset * sizeof(uint32_t));
+        world->draw_base_vertices[draws] = chunk->vertex_offset;
+        draws++;
+    }
+    if (draws == 0)
+        return;
+
+    glBindVertexArray(world->vao);
+    glMultiDrawElementsBaseVertex(GL_TRIANGLES, world->draw_counts,
+                                  GL_UNSIGNED_INT, world->draw_offsets, draws,
+                                  world->draw_base_vertices);
+}
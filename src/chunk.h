@@ -0,0 +1,122 @@
+#ifndef CHUNK_H
+#define CHUNK_H
+
+#include <glad/gl.h>
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "gpu_pool.h"
+#include "job.h"
+
+#define CHUNK_SIZE 32
+#define CHUNK_VOLUME (CHUNK_SIZE * CHUNK_SIZE * CHUNK_SIZE)
+
+// Same layout as CUBE_VERTICES_POS_NORM_TEXT: position, normal, texture coords
+#define CHUNK_VERTEX_FLOATS 8
+
+typedef uint8_t Block;
+#define BLOCK_AIR 0
+
+enum ChunkNeighbor {
+  CHUNK_NEG_X,
+  CHUNK_POS_X,
+  CHUNK_NEG_Y,
+  CHUNK_POS_Y,
+  CHUNK_NEG_Z,
+  CHUNK_POS_Z,
+};
+
+enum ChunkState {
+  CHUNK_EMPTY,
+  CHUNK_GENERATING,
+  CHUNK_MESHING,
+  CHUNK_MESHED,
+  CHUNK_READY,
+};
+
+typedef struct ChunkMesh {
+  float* vertices;
+  uint32_t* indices;
+  int vertex_count;
+  int index_count;
+  int vertex_capacity;
+  int index_capacity;
+} ChunkMesh;
+
+typedef struct ChunkMeshStats {
+  int solid_blocks;
+  int visible_faces;
+  int quads;
+} ChunkMeshStats;
+
+typedef struct Chunk {
+  int x, y, z;
+  Block blocks[CHUNK_VOLUME];
+  struct Chunk* neighbors[6];
+  struct ChunkWorld* world;
+  void* owner;
+  int slot;
+  uint64_t last_used;
+  int state;
+  bool dirty;
+  ChunkMesh mesh;
+  ChunkMeshStats mesh_stats;
+  double mesh_seconds;
+  int vertex_offset;
+  int index_offset;
+  int vertex_count;
+  int index_count;
+} Chunk;
+
+typedef struct ChunkWorldStats {
+  int chunks_meshed;
+  long solid_blocks;
+  long visible_faces;
+  long quads;
+  double mesh_seconds;
+} ChunkWorldStats;
+
+// All chunk meshes live in two shared pools so the whole world is drawn with
+// one glMultiDrawElementsBaseVertex. Meshing runs on `jobs`, finished meshes
+// are queued on `ready` and uploaded from the GL thread.
+typedef struct ChunkWorld {
+  JobSystem* jobs;
+  GpuPool vertices;
+  GpuPool indices;
+  GLuint vao;
+  Chunk** chunks;
+  int chunk_count;
+  int chunk_capacity;
+  Chunk** table;
+  int table_capacity;
+  Chunk** ready;
+  int ready_count;
+  int ready_capacity;
+  pthread_mutex_t lock;
+  ChunkWorldStats stats;
+  GLsizei* draw_counts;
+  void** draw_offsets;
+  GLint* draw_base_vertices;
+  int draw_capacity;
+} ChunkWorld;
+
+Block chunk_get_block(const Chunk* chunk, int x, int y, int z);
+void chunk_set_block(Chunk* chunk, int x, int y, int z, Block block);
+
+void chunk_mesh_greedy(const Chunk* chunk, ChunkMesh* mesh, ChunkMeshStats* stats);
+void chunk_mesh_free(ChunkMesh* mesh);
+
+void chunk_world_init(ChunkWorld* world, JobSystem* jobs, int vertex_capacity,
+                      int index_capacity);
+void chunk_world_destroy(ChunkWorld* world);
+
+Chunk* chunk_world_add(ChunkWorld* world, int x, int y, int z);
+Chunk* chunk_world_find(ChunkWorld* world, int x, int y, int z);
+bool chunk_world_remove(ChunkWorld* world, Chunk* chunk);
+void chunk_world_remesh(ChunkWorld* world, Chunk* chunk);
+int chunk_world_upload(ChunkWorld* world, int max_chunks);
+void chunk_world_draw(ChunkWorld* world);
+
+#endif
@@ -0,0 +1,238 @@
+#include "command.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define COMMAND_UNBOUND 0xFFFFFFFFu
+
+typedef struct CommandRecordJob {
+  CommandBuffer* buffer;
+  int begin;
+  int end;
+  CommandRecordFn record;
+  void* user;
+} CommandRecordJob;
+
+void command_buffer_init(CommandBuffer* buffer, int capacity) {
+    memset(buffer, 0, sizeof(*buffer));
+    buffer->capacity = capacity > 16 ? capacity : 16;
+    buffer->data = (CommandWord *)malloc(buffer->capacity * sizeof(CommandWord));
+    command_buffer_reset(buffer);
+}
+
+void command_buffer_destroy(CommandBuffer* buffer) {
+    free(buffer->data);
+    memset(buffer, 0, sizeof(*buffer));
+}
+
+void command_buffer_reset(CommandBuffer* buffer) {
+    buffer->size = 0;
+    buffer->command_count = 0;
+    buffer->draw_count = 0;
+    buffer->program = COMMAND_UNBOUND;
+    buffer->vertex_array = COMMAND_UNBOUND;
+    for (int i = 0; i < COMMAND_MAX_TEXTURE_UNITS; i++)
+        buffer->textures[i] = COMMAND_UNBOUND;
+}
+
+static CommandWord *command_push(CommandBuffer* buffer, CommandType type, int words) {
+    if (buffer->size + words + 1 > buffer->capacity) {
+        while (buffer->size + words + 1 > buffer->capacity)
+            buffer->capacity *= 2;
+        buffer->data = (CommandWord *)realloc(buffer->data,
+                                              buffer->capacity * sizeof(CommandWord));
+    }
+    CommandWord *command = buffer->data + buffer->size;
+    command[0].u = (uint32_t)type | (uint32_t)(words + 1) << 8;
+    buffer->size += words + 1;
+    buffer->command_count++;
+    return command + 1;
+}
+
+void command_use_program(CommandBuffer* buffer, GLuint program) {
+    if (buffer->program == program)
+        return;
+    buffer->program = program;
+    command_push(buffer, COMMAND_USE_PROGRAM, 1)[0].u = program;
+}
+
+void command_bind_vertex_array(CommandBuffer* buffer, GLuint vertex_array) {
+    if (buffer->vertex_array == vertex_array)
+        return;
+    buffer->vertex_array = vertex_array;
+    command_push(buffer, COMMAND_BIND_VERTEX_ARRAY, 1)[0].u = vertex_array;
+}
+
+void command_bind_texture(CommandBuffer* buffer, GLuint unit, GLenum target,
+                          GLuint texture) {
+    if (unit >= COMMAND_MAX_TEXTURE_UNITS || buffer->textures[unit] == texture)
+        return;
+    buffer->textures[unit] = texture;
+    CommandWord *args = command_push(buffer, COMMAND_BIND_TEXTURE, 3);
+    args[0].u = unit;
+    args[1].u = target;
+    args[2].u = texture;
+}
+
+// Like GL, writes to location -1 are ignored
+static void command_uniform(CommandBuffer* buffer, CommandType type, GLint location,
+                            const void* value, int words) {
+    if (location < 0)
+        return;
+    CommandWord *args = command_push(buffer, type, words + 1);
+    args[0].i = location;
+    memcpy(args + 1, value, words * sizeof(CommandWord));
+}
+
+void command_uniform_int(CommandBuffer* buffer, GLint location, int value) {
+    command_uniform(buffer, COMMAND_UNIFORM_INT, location, &value, 1);
+}
+
+void command_uniform_float(CommandBuffer* buffer, GLint location, float value) {
+    command_uniform(buffer, COMMAND_UNIFORM_FLOAT, location, &value, 1);
+}
+
+void command_uniform_vec3(CommandBuffer* buffer, GLint location, const float* value) {
+    command_uniform(buffer, COMMAND_UNIFORM_VEC3, location, value, 3);
+}
+
+void command_uniform_vec4(CommandBuffer* buffer, GLint location, const float* value) {
+    command_uniform(buffer, COMMAND_UNIFORM_VEC4, location, value, 4);
+}
+
+void command_uniform_mat4(CommandBuffer* buffer, GLint location, const float* value) {
+    command_uniform(buffer, COMMAND_UNIFORM_MAT4, location, value, 16);
+}
+
+void command_draw_arrays(CommandBuffer* buffer, GLenum mode, GLint first, GLsizei count) {
+    CommandWord *args = command_push(buffer, COMMAND_DRAW_ARRAYS, 3);
+    args[0].u = mode;
+    args[1].i = first;
+    args[2].i = count;
+    buffer->draw_count++;
+}
+
+void command_draw_arrays_instanced(CommandBuffer* buffer, GLenum mode, GLint first,
+                                   GLsizei count, GLsizei instances) {
+    CommandWord *args = command_push(buffer, COMMAND_DRAW_ARRAYS_INSTANCED, 4);
+    args[0].u = mode;
+    args[1].i = first;
+    args[2].i = count;
+    args[3].i = instances;
+    buffer->draw_count++;
+}
+
+void command_draw_elements(CommandBuffer* buffer, GLenum mode, GLsizei count,
+                           GLenum type, uint32_t offset) {
+    CommandWord *args = command_push(buffer, COMMAND_DRAW_ELEMENTS, 4);
+    args[0].u = mode;
+    args[1].i = count;
+    args[2].u = type;
+    args[3].u = offset;
+    buffer->draw_count++;
+}
+
+void command_draw_elements_instanced(CommandBuffer* buffer, GLenum mode, GLsizei count,
+                                     GLenum type, uint32_t offset, GLsizei instances) {
+    CommandWord *args = command_push(buffer, COMMAND_DRAW_ELEMENTS_INSTANCED, 5);
+    args[0].u = mode;
+    args[1].i = count;
+    args[2].u = type;
+    args[3].u = offset;
+    args[4].i = instances;
+    buffer->draw_count++;
+}
+
+void command_buffers_execute(const CommandBuffer* buffers, int count) {
+    GLuint program = COMMAND_UNBOUND, vertex_array = COMMAND_UNBOUND;
+    GLuint active_unit = COMMAND_UNBOUND;
+    GLuint textures[COMMAND_MAX_TEXTURE_UNITS];
+    for (int i = 0; i < COMMAND_MAX_TEXTURE_UNITS; i++)
+        textures[i] = COMMAND_UNBOUND;
+
+    for (int b = 0; b < count; b++) {
+        const CommandWord *p = buffers[b].data;
+        const CommandWord *end = p + buffers[b].size;
+        while (p < end) {
+            const CommandWord *args = p + 1;
+            switch ((CommandType)(p->u & 0xFF)) {
+            case COMMAND_USE_PROGRAM:
+                if (program != args[0].u)
+                    glUseProgram(program = args[0].u);
+                break;
+            case COMMAND_BIND_VERTEX_ARRAY:
+                if (vertex_array != args[0].u)
+                    glBindVertexArray(vertex_array = args[0].u);
+                break;
+            case COMMAND_BIND_TEXTURE:
+                if (textures[args[0].u] == args[2].u)
+                    break;
+                if (active_unit != args[0].u)
+                    glActiveTexture(GL_TEXTURE0 + (active_unit = args[0].u));
+                glBindTexture(args[1].u, textures[args[0].u] = args[2].u);
+                break;
+            case COMMAND_UNIFORM_INT:
+                glUniform1i(args[0].i, args[1].i);
+                break;
+            case COMMAND_UNIFORM_FLOAT:
+                glUniform1f(args[0].i, args[1].f);
+                break;
+            case COMMAND_UNIFORM_VEC3:
+                glUniform3fv(args[0].i, 1, &args[1].f);
+                break;
+            case COMMAND_UNIFORM_VEC4:
+                glUniform4fv(args[0].i, 1, &args[1].f);
+                break;
+            case COMMAND_UNIFORM_MAT4:
+                glUniformMatrix4fv(args[0].i, 1, GL_FALSE, &args[1].f);
+                break;
+            case COMMAND_DRAW_ARRAYS:
+                glDrawArrays(args[0].u, args[1].i, args[2].i);
+                break;
+            case COMMAND_DRAW_ARRAYS_INSTANCED:
+                glDrawArraysInstanced(args[0].u, args[1].i, args[2].i, args[3].i);
+                break;
+            case COMMAND_DRAW_ELEMENTS:
+                glDrawElements(args[0].u, args[1].i, args[2].u,
+                               (const void *)(uintptr_t)args[3].u);
+                break;
+            case COMMAND_DRAW_ELEMENTS_INSTANCED:
+                glDrawElementsInstanced(args[0].u, args[1].i, args[2].u,
+                                        (const void *)(uintptr_t)args[3].u, args[4].i);
+                break;
+            }
+            p += p->u >> 8;
+        }
+    }
+}
+
+static void command_record_job(void* arg) {
+    CommandRecordJob *job = (CommandRecordJob *)arg;
+    command_buffer_reset(job->buffer);
+    job->record(job->buffer, job->begin, job->end, job->user);
+}
+
+void command_record_parallel(JobSystem* jobs, CommandBuffer* buffers, int buffer_count,
+                             int item_count, CommandRecordFn record, void* user) {
+    CommandRecordJob *work =
+        (CommandRecordJob *)malloc(buffer_count * sizeof(CommandRecordJob));
+    for (int i = 0; i < buffer_count; i++) {
+        work[i].buffer = &buffers[i];
+        work[i].begin = (int)((int64_t)item_count * i / buffer_count);
+        work[i].end = (int)((int64_t)item_count * (i + 1) / buffer_count);
+        work[i].record = record;
+        work[i].user = user;
+    }
+
+    JobCounter counter = {0};
+    for (int i = 0; i < buffer_count - 1; i++) {
+        if (jobs)
+            job_submit_counted(jobs, command_record_job, &work[i], &counter);
+        else
+            command_record_job(&work[i]);
+    }
+    command_record_job(&work[buffer_count - 1]);
+    if (jobs)
+        job_wait_counter(jobs, &counter);
+    free(work);
+}
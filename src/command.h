@@ -0,0 +1,85 @@
+#ifndef COMMAND_H
+#define COMMAND_H
+
+#include <glad/gl.h>
+#include <stdint.h>
+
+#include "job.h"
+
+#define COMMAND_MAX_TEXTURE_UNITS 16
+
+typedef enum CommandType {
+  COMMAND_USE_PROGRAM,
+  COMMAND_BIND_VERTEX_ARRAY,
+  COMMAND_BIND_TEXTURE,
+  COMMAND_UNIFORM_INT,
+  COMMAND_UNIFORM_FLOAT,
+  COMMAND_UNIFORM_VEC3,
+  COMMAND_UNIFORM_VEC4,
+  COMMAND_UNIFORM_MAT4,
+  COMMAND_DRAW_ARRAYS,
+  COMMAND_DRAW_ARRAYS_INSTANCED,
+  COMMAND_DRAW_ELEMENTS,
+  COMMAND_DRAW_ELEMENTS_INSTANCED
+} CommandType;
+
+typedef union CommandWord {
+  uint32_t u;
+  int32_t i;
+  float f;
+} CommandWord;
+
+// A stream of GL work recorded without touching GL, so any thread can fill
+// one. Each command is a word holding its type and length followed by its
+// arguments. Binds that repeat what the buffer already bound are dropped
+// while recording.
+typedef struct CommandBuffer {
+  CommandWord* data;
+  int size;
+  int capacity;
+  int command_count;
+  int draw_count;
+  GLuint program;
+  GLuint vertex_array;
+  GLuint textures[COMMAND_MAX_TEXTURE_UNITS];
+} CommandBuffer;
+
+void command_buffer_init(CommandBuffer* buffer, int capacity);
+void command_buffer_destroy(CommandBuffer* buffer);
+void command_buffer_reset(CommandBuffer* buffer);
+
+void command_use_program(CommandBuffer* buffer, GLuint program);
+void command_bind_vertex_array(CommandBuffer* buffer, GLuint vertex_array);
+void command_bind_texture(CommandBuffer* buffer, GLuint unit, GLenum target,
+                          GLuint texture);
+
+// Locations come from the program's UniformTable, which is safe to read
+// from any thread. Values written here bypass the table's mirror.
+void command_uniform_int(CommandBuffer* buffer, GLint location, int value);
+void command_uniform_float(CommandBuffer* buffer, GLint location, float value);
+void command_uniform_vec3(CommandBuffer* buffer, GLint location, const float* value);
+void command_uniform_vec4(CommandBuffer* buffer, GLint location, const float* value);
+void command_uniform_mat4(CommandBuffer* buffer, GLint location, const float* value);
+
+void command_draw_arrays(CommandBuffer* buffer, GLenum mode, GLint first, GLsizei count);
+void command_draw_arrays_instanced(CommandBuffer* buffer, GLenum mode, GLint first,
+                                   GLsizei count, GLsizei instances);
+void command_draw_elements(CommandBuffer* buffer, GLenum mode, GLsizei count,
+                           GLenum type, uint32_t offset);
+void command_draw_elements_instanced(CommandBuffer* buffer, GLenum mode, GLsizei count,
+                                     GLenum type, uint32_t offset, GLsizei instances);
+
+// Replays the buffers in order on the GL thread. Binds that repeat the state
+// the previous buffer left behind are skipped too.
+void command_buffers_execute(const CommandBuffer* buffers, int count);
+
+typedef void (*CommandRecordFn)(CommandBuffer* buffer, int begin, int end, void* user);
+
+// Splits [0, item_count) into one contiguous range per buffer, in order, and
+// records each into its buffer after resetting it. The calling thread takes
+// the last range while the job system does the rest; without `jobs`
+// everything is recorded inline.
+void command_record_parallel(JobSystem* jobs, CommandBuffer* buffers, int buffer_count,
+                             int item_count, CommandRecordFn record, void* user);
+
+#endif
@@ -0,0 +1,303 @@
+#include "csm.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char *csm_vertex_shader_text =
+    "#version 330 core\n"
+    "layout (location = 0) in vec3 aPos;\n"
+    "layout (location = 3) in mat4 aModel;\n"
+    "\n"
+    "uniform mat4 view_proj;\n"
+    "\n"
+    "void main()\n"
+    "{\n"
+    "    gl_Position = view_proj * aModel * vec4(aPos, 1.0);\n"
+    "}\n";
+
+static const char *csm_fragment_shader_text =
+    "#version 330 core\n"
+    "\n"
+    "void main()\n"
+    "{\n"
+    "}\n";
+
+static GLuint csm_compile(GLenum type, const char* source) {
+    GLuint shader = glCreateShader(type);
+    glShaderSource(shader, 1, &source, NULL);
+    glCompileShader(shader);
+    GLint ok = GL_FALSE;
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &ok);
+    if (!ok) {
+        char log[1024];
+        glGetShaderInfoLog(shader, sizeof(log), NULL, log);
+        fprintf(stderr, "Error: cascade shadow shader: %s\n", log);
+        glDeleteShader(shader);
+        return 0;
+    }
+    return shader;
+}
+
+// 0 if the program does not build, which leaves the cascades unrendered
+static GLuint csm_create_program() {
+    const GLuint vertex_shader = csm_compile(GL_VERTEX_SHADER, csm_vertex_shader_text);
+    const GLuint fragment_shader =
+        csm_compile(GL_FRAGMENT_SHADER, csm_fragment_shader_text);
+    if (!vertex_shader || !fragment_shader) {
+        glDeleteShader(fragment_shader);
+        glDeleteShader(vertex_shader);
+        return 0;
+    }
+
+    const GLuint program = glCreateProgram();
+    glAttachShader(program, vertex_shader);
+    glAttachShader(program, fragment_shader);
+    glLinkProgram(program);
+    glDeleteShader(fragment_shader);
+    glDeleteShader(vertex_shader);
+
+    GLint ok = GL_FALSE;
+    glGetProgramiv(program, GL_LINK_STATUS, &ok);
+    if (!ok) {
+        char log[1024];
+        glGetProgramInfoLog(program, sizeof(log), NULL, log);
+        fprintf(stderr, "Error: cascade shadow program: %s\n", log);
+        glDeleteProgram(program);
+        return 0;
+    }
+    return program;
+}
+
+void csm_init(CascadedShadows* csm, int cascade_count, int resolution, float lambda) {
+    memset(csm, 0, sizeof(*csm));
+    if (cascade_count > CSM_MAX_CASCADES)
+        cascade_count = CSM_MAX_CASCADES;
+    csm->cascade_count = cascade_count;
+    csm->resolution = resolution;
+    csm->lambda = lambda;
+    csm->caster_margin = 50.0f;
+
+    glGenTextures(1, &csm->depth_array);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, csm->depth_array);
+    glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_DEPTH_COMPONENT24, resolution,
+                 resolution, cascade_count, 0, GL_DEPTH_COMPONENT, GL_FLOAT,
+                 NULL);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_MODE,
+                    GL_COMPARE_REF_TO_TEXTURE);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+
+    glGenFramebuffers(1, &csm->fbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, csm->fbo);
+    glDrawBuffer(GL_NONE);
+    glReadBuffer(GL_NONE);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glGenBuffers(1, &csm->instance_vbo);
+    glGenQueries(2 * CSM_MAX_CASCADES, &csm->queries[0][0]);
+
+    csm->program = csm_create_program();
+    csm->view_proj_loc = glGetUniformLocation(csm->program, "view_proj");
+}
+
+void csm_destroy(CascadedShadows* csm) {
+    glDeleteQueries(2 * CSM_MAX_CASCADES, &csm->queries[0][0]);
+    glDeleteBuffers(1, &csm->instance_vbo);
+    glDeleteFramebuffers(1, &csm->fbo);
+    glDeleteTextures(1, &csm->depth_array);
+    glDeleteProgram(csm->program);
+    free(csm->instances);
+}
+
+// Blend of the logarithmic and uniform split schemes, `lambda` = 1 is fully
+// logarithmic.
+static float csm_split(float near, float far, float lambda, float t) {
+    float log_split = near * powf(far / near, t);
+    float uniform_split = near + (far - near) * t;
+    return lambda * log_split + (1.0f - lambda) * uniform_split;
+}
+
+static void csm_fit_cascade(CascadedShadows* csm, Cascade* cascade,
+                            mat4x4 inv_view, float fov, float aspect,
+                            const vec3 light_dir) {
+    float tan_y = tanf(fov * 0.5f);
+    float tan_x = tan_y * aspect;
+
+    // Bounding sphere of the frustum slice in world space. Using a sphere
+    // keeps the shadow projection the same size regardless of camera
+    // orientation.
+    vec3 corners[8];
+    vec3 center = {0.0f, 0.0f, 0.0f};
+    for (int i = 0; i < 8; i++) {
+        float z = (i & 4) ? cascade->split_far : cascade->split_near;
+        vec4 p = {((i & 1) ? 1.0f : -1.0f) * tan_x * z,
+                  ((i & 2) ? 1.0f : -1.0f) * tan_y * z, -z, 1.0f};
+        vec4 w;
+        mat4x4_mul_vec4(w, inv_view, p);
+        vec3 corner = {w[0], w[1], w[2]};
+        vec3_dup(corners[i], corner);
+        vec3_add(center, center, corner);
+    }
+    vec3_scale(center, center, 1.0f / 8.0f);
+
+    float radius = 0.0f;
+    for (int i = 0; i < 8; i++) {
+        vec3 d;
+        vec3_sub(d, corners[i], center);
+        float len = vec3_len(d);
+        if (len > radius)
+            radius = len;
+    }
+    radius = ceilf(radius * 16.0f) / 16.0f;
+
+    vec3 dir, eye, offset;
+    vec3_norm(dir, light_dir);
+    vec3_scale(offset, dir, radius + csm->caster_margin);
+    vec3_sub(eye, center, offset);
+    vec3 up = {0.0f, 1.0f, 0.0f};
+    if (fabsf(dir[1]) > 0.99f) {
+        up[1] = 0.0f;
+        up[2] = 1.0f;
+    }
+
+    mat4x4 light_view, light_proj;
+    mat4x4_look_at(light_view, eye, center, up);
+    mat4x4_ortho(light_proj, -radius, radius, -radius, radius, 0.0f,
+                 2.0f * radius + csm->caster_margin);
+
+    // Snap the projected world origin to a texel so the shadow map only
+    // moves in whole texel increments.
+    mat4x4 view_proj;
+    mat4x4_mul(view_proj, light_proj, light_view);
+    vec4 origin = {0.0f, 0.0f, 0.0f, 1.0f}, projected;
+    mat4x4_mul_vec4(projected, view_proj, origin);
+    float half_res = csm->resolution * 0.5f;
+    float ox = projected[0] * half_res;
+    float oy = projected[1] * half_res;
+    light_proj[3][0] += (roundf(ox) - ox) / half_res;
+    light_proj[3][1] += (roundf(oy) - oy) / half_res;
+
+    mat4x4_mul(cascade->view_proj, light_proj, light_view);
+    frustum_from_matrix(&cascade->frustum, cascade->view_proj);
+}
+
+void csm_update(CascadedShadows* csm, mat4x4 view, float fov, float aspect,
+                float near, float far, const vec3 light_dir) {
+    mat4x4 inv_view;
+    mat4x4_invert(inv_view, view);
+
+    for (int i = 0; i < csm->cascade_count; i++) {
+        Cascade *cascade = &csm->cascades[i];
+        cascade->split_near =
+            csm_split(near, far, csm->lambda, (float)i / csm->cascade_count);
+        cascade->split_far =
+            csm_split(near, far, csm->lambda, (float)(i + 1) / csm->cascade_count);
+        csm_fit_cascade(csm, cascade, inv_view, fov, aspect, light_dir);
+    }
+}
+
+void csm_cull(CascadedShadows* csm, const ShadowCaster* casters, int count) {
+    int needed = count * csm->cascade_count;
+    if (needed > csm->instance_capacity) {
+        csm->instance_capacity = needed;
+        csm->instances =
+            (mat4x4 *)realloc(csm->instances, needed * sizeof(mat4x4));
+        glBindBuffer(GL_ARRAY_BUFFER, csm->instance_vbo);
+        glBufferData(GL_ARRAY_BUFFER, needed * sizeof(mat4x4), NULL,
+                     GL_STREAM_DRAW);
+    }
+
+    int written = 0;
+    for (int c = 0; c < csm->cascade_count; c++) {
+        Cascade *cascade = &csm->cascades[c];
+        cascade->instance_offset = written;
+        for (int i = 0; i < count; i++) {
+            if (!frustum_test_sphere(&cascade->frustum, casters[i].center,
+                                     casters[i].radius))
+                continue;
+            mat4x4_dup(csm->instances[written++], casters[i].model);
+        }
+        cascade->instance_count = written - cascade->instance_offset;
+    }
+
+    glBindBuffer(GL_ARRAY_BUFFER, csm->instance_vbo);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, written * sizeof(mat4x4),
+                    csm->instances);
+}
+
+// GL 3.3 has no base instance, so each cascade re-points the matrix
+// attributes at its own range of the instance buffer instead.
+static void csm_point_instances(CascadedShadows* csm, int first) {
+    glBindBuffer(GL_ARRAY_BUFFER, csm->instance_vbo);
+    for (int i = 0; i < 4; i++) {
+        glVertexAttribPointer(
+            3 + i, 4, GL_FLOAT, GL_FALSE, sizeof(mat4x4),
+            (void *)(first * sizeof(mat4x4) + i * sizeof(vec4)));
+    }
+}
+
+void csm_bind_instances(CascadedShadows* csm, GLuint vao) {
+    glBindVertexArray(vao);
+    csm_point_instances(csm, 0);
+    for (int i = 0; i < 4; i++) {
+        glEnableVertexAttribArray(3 + i);
+        glVertexAttribDivisor(3 + i, 1);
+    }
+}
+
+void csm_render(CascadedShadows* csm, GLuint vao, int vertex_count) {
+    if (!csm->program)
+        return;
+    GLint viewport[4];
+    glGetIntegerv(GL_VIEWPORT, viewport);
+
+    // Queries from the previous frame are read back so the CPU never waits on
+    // the GPU for timings.
+    unsigned int current = csm->frame & 1;
+    unsigned int previous = current ^ 1;
+    if (csm->frame > 0) {
+        for (int c = 0; c < csm->cascade_count; c++) {
+            GLint available = 0;
+            glGetQueryObjectiv(csm->queries[previous][c],
+                               GL_QUERY_RESULT_AVAILABLE, &available);
+            if (!available)
+                continue;
+            GLuint64 ns = 0;
+            glGetQueryObjectui64v(csm->queries[previous][c], GL_QUERY_RESULT,
+                                  &ns);
+            csm->cascades[c].gpu_ms = ns / 1e6;
+        }
+    }
+
+    glUseProgram(csm->program);
+    glBindFramebuffer(GL_FRAMEBUFFER, csm->fbo);
+    glViewport(0, 0, csm->resolution, csm->resolution);
+    glEnable(GL_DEPTH_TEST);
+    glBindVertexArray(vao);
+
+    for (int c = 0; c < csm->cascade_count; c++) {
+        Cascade *cascade = &csm->cascades[c];
+        glBeginQuery(GL_TIME_ELAPSED, csm->queries[current][c]);
+
+        glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT,
+                                  csm->depth_array, 0, c);
+        glClear(GL_DEPTH_BUFFER_BIT);
+        if (cascade->instance_count > 0) {
+            glUniformMatrix4fv(csm->view_proj_loc, 1, GL_FALSE,
+                               (const GLfloat *)cascade->view_proj);
+            csm_point_instances(csm, cascade->instance_offset);
+            glDrawArraysInstanced(GL_TRIANGLES, 0, vertex_count,
+                                  cascade->instance_count);
+        }
+
+        glEndQuery(GL_TIME_ELAPSED);
+    }
+
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+    csm->frame++;
+}
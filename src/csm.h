@@ -0,0 +1,58 @@
+#ifndef CSM_H
+#define CSM_H
+
+#include <glad/gl.h>
+
+#include "frustum.h"
+#include "linmath.h"
+
+#define CSM_MAX_CASCADES 4
+
+typedef struct ShadowCaster {
+  mat4x4 model;
+  vec3 center;
+  float radius;
+} ShadowCaster;
+
+typedef struct Cascade {
+  float split_near, split_far;
+  mat4x4 view_proj;
+  Frustum frustum;
+  int instance_offset;
+  int instance_count;
+  double gpu_ms;
+} Cascade;
+
+// Directional light shadows split along the view frustum. Each cascade is a
+// layer of `depth_array`, fitted to a bounding sphere of its frustum slice so
+// the projection does not change size when the camera rotates, and snapped to
+// whole texels so it does not shimmer when the camera moves.
+typedef struct CascadedShadows {
+  int cascade_count;
+  int resolution;
+  float lambda;
+  float caster_margin;
+  GLuint depth_array;
+  GLuint fbo;
+  GLuint program;
+  GLint view_proj_loc;
+  GLuint instance_vbo;
+  int instance_capacity;
+  mat4x4* instances;
+  GLuint queries[2][CSM_MAX_CASCADES];
+  unsigned int frame;
+  Cascade cascades[CSM_MAX_CASCADES];
+} CascadedShadows;
+
+void csm_init(CascadedShadows* csm, int cascade_count, int resolution, float lambda);
+void csm_destroy(CascadedShadows* csm);
+
+void csm_update(CascadedShadows* csm, mat4x4 view, float fov, float aspect,
+                float near, float far, const vec3 light_dir);
+void csm_cull(CascadedShadows* csm, const ShadowCaster* casters, int count);
+
+// Enables the per-instance model matrix at attribute locations 3..6 of `vao`.
+void csm_bind_instances(CascadedShadows* csm, GLuint vao);
+void csm_render(CascadedShadows* csm, GLuint vao, int vertex_count);
+
+#endif
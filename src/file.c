@@ -0,0 +1,49 @@
+#include "file.h"
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+bool file_map(MappedFile* file, const char* path) {
+    file->data = NULL;
+    file->size = 0;
+    file->fd = open(path, O_RDONLY);
+    if (file->fd < 0) {
+        fprintf(stderr, "Error: cannot open %s\n", path);
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(file->fd, &st) != 0 || st.st_size == 0) {
+        fprintf(stderr, "Error: cannot stat %s\n", path);
+        close(file->fd);
+        file->fd = -1;
+        return false;
+    }
+
+    void *data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, file->fd, 0);
+    if (data == MAP_FAILED) {
+        fprintf(stderr, "Error: cannot map %s\n", path);
+        close(file->fd);
+        file->fd = -1;
+        return false;
+    }
+
+    // Loaders read front to back
+    madvise(data, st.st_size, MADV_SEQUENTIAL);
+    file->data = (const unsigned char *)data;
+    file->size = st.st_size;
+    return true;
+}
+
+void file_unmap(MappedFile* file) {
+    if (file->data)
+        munmap((void *)file->data, file->size);
+    if (file->fd >= 0)
+        close(file->fd);
+    file->data = NULL;
+    file->size = 0;
+    file->fd = -1;
+}
@@ -0,0 +1,17 @@
+#ifndef FILE_H
+#define FILE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// Read-only memory mapping of a whole file
+typedef struct MappedFile {
+  const unsigned char* data;
+  size_t size;
+  int fd;
+} MappedFile;
+
+bool file_map(MappedFile* file, const char* path);
+void file_unmap(MappedFile* file);
+
+#endif
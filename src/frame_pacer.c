@@ -0,0 +1,197 @@
+#include "frame_pacer.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <time.h>
+
+// Sleeps can overshoot by about a scheduler tick, so the last stretch of a
+// wait is spun instead
+#define FRAME_PACER_SPIN_MS 1.5
+// Slack left between the end of a low latency frame and its present
+#define FRAME_PACER_MARGIN_MS 1.0
+
+static double now_ms() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e3 + ts.tv_nsec * 1e-6;
+}
+
+static void sleep_until(double deadline_ms) {
+    double remaining = deadline_ms - now_ms();
+    if (remaining > FRAME_PACER_SPIN_MS) {
+        double sleep_ms = remaining - FRAME_PACER_SPIN_MS;
+        struct timespec ts;
+        ts.tv_sec = (time_t)(sleep_ms / 1e3);
+        ts.tv_nsec = (long)((sleep_ms - ts.tv_sec * 1e3) * 1e6);
+        nanosleep(&ts, NULL);
+    }
+    while (now_ms() < deadline_ms)
+        ;
+}
+
+static double refresh_period_ms(GLFWwindow* window) {
+    GLFWmonitor *monitor = glfwGetWindowMonitor(window);
+    if (!monitor)
+        monitor = glfwGetPrimaryMonitor();
+    const GLFWvidmode *video = monitor ? glfwGetVideoMode(monitor) : NULL;
+    int hz = video && video->refreshRate > 0 ? video->refreshRate : 60;
+    return 1e3 / hz;
+}
+
+void frame_pacer_init(FramePacer* pacer, GLFWwindow* window, PresentMode mode,
+                      double target_fps, bool low_latency) {
+    memset(pacer, 0, sizeof(*pacer));
+    pthread_mutex_init(&pacer->lock, NULL);
+    pacer->low_latency = low_latency;
+
+    if (mode == PRESENT_ADAPTIVE && !glfwExtensionSupported("WGL_EXT_swap_control_tear") &&
+        !glfwExtensionSupported("GLX_EXT_swap_control_tear")) {
+        fprintf(stderr, "Error: adaptive vsync is not supported, using vsync\n");
+        mode = PRESENT_VSYNC;
+    }
+    if (mode == PRESENT_LIMITED && target_fps <= 0.0) {
+        fprintf(stderr, "Error: invalid frame rate limit %g, running uncapped\n", target_fps);
+        mode = PRESENT_UNCAPPED;
+    }
+    pacer->mode = mode;
+
+    switch (mode) {
+    case PRESENT_VSYNC:
+        glfwSwapInterval(1);
+        pacer->period_ms = refresh_period_ms(window);
+        break;
+    case PRESENT_ADAPTIVE:
+        glfwSwapInterval(-1);
+        pacer->period_ms = refresh_period_ms(window);
+        break;
+    case PRESENT_UNCAPPED:
+        glfwSwapInterval(0);
+        break;
+    case PRESENT_LIMITED:
+        glfwSwapInterval(0);
+        pacer->period_ms = 1e3 / target_fps;
+        break;
+    }
+}
+
+void frame_pacer_destroy(FramePacer* pacer) {
+    pthread_mutex_destroy(&pacer->lock);
+}
+
+bool present_mode_parse(const char* text, PresentMode* mode, double* target_fps) {
+    *target_fps = 0.0;
+    if (strcmp(text, "vsync") == 0)
+        *mode = PRESENT_VSYNC;
+    else if (strcmp(text, "adaptive") == 0)
+        *mode = PRESENT_ADAPTIVE;
+    else if (strcmp(text, "uncapped") == 0)
+        *mode = PRESENT_UNCAPPED;
+    else {
+        char *end;
+        *target_fps = strtod(text, &end);
+        if (end == text || *end != '\0' || *target_fps <= 0.0)
+            return false;
+        *mode = PRESENT_LIMITED;
+    }
+    return true;
+}
+
+const char* present_mode_name(PresentMode mode) {
+    switch (mode) {
+    case PRESENT_VSYNC: return "vsync";
+    case PRESENT_ADAPTIVE: return "adaptive";
+    case PRESENT_UNCAPPED: return "uncapped";
+    case PRESENT_LIMITED: return "limited";
+    }
+    return "unknown";
+}
+
+void frame_pacer_begin(FramePacer* pacer) {
+    if (pacer->mode == PRESENT_UNCAPPED)
+        return;
+
+    pthread_mutex_lock(&pacer->lock);
+    double last_present = pacer->last_present_ms;
+    double work = pacer->work_ms;
+    pthread_mutex_unlock(&pacer->lock);
+
+    double now = now_ms();
+    double present;
+    if (pacer->mode == PRESENT_LIMITED) {
+        // The schedule is kept unless a frame ran a whole period late
+        if (pacer->next_present_ms == 0.0 || now - pacer->next_present_ms > pacer->period_ms)
+            pacer->next_present_ms = now + pacer->period_ms;
+        else
+            pacer->next_present_ms += pacer->period_ms;
+        present = pacer->next_present_ms;
+    } else {
+        // The swap already waits for vblank, only low latency waits here
+        if (!pacer->low_latency || last_present == 0.0)
+            return;
+        present = last_present + pacer->period_ms;
+    }
+
+    double start = present - pacer->period_ms;
+    if (pacer->low_latency)
+        start = present - work - FRAME_PACER_MARGIN_MS;
+    sleep_until(start);
+}
+
+void frame_pacer_presented(FramePacer* pacer, double input_ms, double submit_ms,
+                           double present_ms) {
+    pthread_mutex_lock(&pacer->lock);
+    double work = submit_ms - input_ms;
+    // Quick to grow so a slow frame does not miss the next vblank too, slow
+    // to shrink so one fast frame does not
+    double rate = work > pacer->work_ms ? 0.5 : 0.05;
+    pacer->work_ms += (work - pacer->work_ms) * rate;
+
+    if (pacer->last_present_ms > 0.0) {
+        double frame = present_ms - pacer->last_present_ms;
+        pacer->frames++;
+        pacer->frame_sum += frame;
+        pacer->frame_sum_squares += frame * frame;
+        if (frame > pacer->frame_max)
+            pacer->frame_max = frame;
+        pacer->latency_sum += present_ms - input_ms;
+        pacer->work_sum += work;
+        if (pacer->period_ms > 0.0 && frame > pacer->period_ms * 1.5)
+            pacer->missed++;
+    }
+    pacer->last_present_ms = present_ms;
+    pthread_mutex_unlock(&pacer->lock);
+}
+
+void frame_pacer_idle(FramePacer* pacer) {
+    pthread_mutex_lock(&pacer->lock);
+    pacer->last_present_ms = 0.0;
+    pthread_mutex_unlock(&pacer->lock);
+}
+
+FramePacerStats frame_pacer_stats(FramePacer* pacer) {
+    FramePacerStats stats;
+    memset(&stats, 0, sizeof(stats));
+    pthread_mutex_lock(&pacer->lock);
+    long n = pacer->frames;
+    if (n > 0) {
+        stats.frames = n;
+        stats.frame_ms = pacer->frame_sum / n;
+        double variance = pacer->frame_sum_squares / n - stats.frame_ms * stats.frame_ms;
+        stats.frame_deviation_ms = variance > 0.0 ? sqrt(variance) : 0.0;
+        stats.frame_max_ms = pacer->frame_max;
+        stats.latency_ms = pacer->latency_sum / n;
+        stats.work_ms = pacer->work_sum / n;
+        stats.missed = pacer->missed;
+    }
+    pacer->frames = 0;
+    pacer->frame_sum = 0.0;
+    pacer->frame_sum_squares = 0.0;
+    pacer->frame_max = 0.0;
+    pacer->latency_sum = 0.0;
+    pacer->work_sum = 0.0;
+    pacer->missed = 0;
+    pthread_mutex_unlock(&pacer->lock);
+    return stats;
+}
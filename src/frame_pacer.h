@@ -0,0 +1,78 @@
+#ifndef FRAME_PACER_H
+#define FRAME_PACER_H
+
+#include <glad/gl.h>
+#define GLFW_INCLUDE_NONE
+#include <GLFW/glfw3.h>
+
+#include <pthread.h>
+#include <stdbool.h>
+
+typedef enum PresentMode {
+  // Swap waits for vblank
+  PRESENT_VSYNC,
+  // Like vsync, but a late frame tears instead of waiting another refresh
+  PRESENT_ADAPTIVE,
+  // No waiting anywhere
+  PRESENT_UNCAPPED,
+  // No vsync, frames start at a fixed rate kept by sleeping then spinning
+  PRESENT_LIMITED
+} PresentMode;
+
+// Averages since the last frame_pacer_stats call. Latency runs from just
+// before the frame's events are polled to the swap returning, which is
+// where the frame is assumed to reach the screen.
+typedef struct FramePacerStats {
+  long frames;
+  double frame_ms;
+  double frame_deviation_ms;
+  double frame_max_ms;
+  double latency_ms;
+  double work_ms;
+  long missed;
+} FramePacerStats;
+
+// Decides when a frame starts. In low latency mode reading input and
+// simulating are held back until just enough time is left to finish the
+// frame before the next present, from a running estimate of how long a
+// frame takes from input to swap.
+typedef struct FramePacer {
+  PresentMode mode;
+  bool low_latency;
+  double period_ms;
+  double next_present_ms;
+  double last_present_ms;
+  double work_ms;
+  pthread_mutex_t lock;
+  long frames;
+  double frame_sum;
+  double frame_sum_squares;
+  double frame_max;
+  double latency_sum;
+  double work_sum;
+  long missed;
+} FramePacer;
+
+// Sets the swap interval on the current context; `target_fps` is only used
+// by PRESENT_LIMITED. Vsync modes take their period from the monitor.
+void frame_pacer_init(FramePacer* pacer, GLFWwindow* window, PresentMode mode,
+                      double target_fps, bool low_latency);
+void frame_pacer_destroy(FramePacer* pacer);
+
+// "vsync", "adaptive", "uncapped" or a frame rate to limit to
+bool present_mode_parse(const char* text, PresentMode* mode, double* target_fps);
+const char* present_mode_name(PresentMode mode);
+
+// Waits until the next frame should read its input
+void frame_pacer_begin(FramePacer* pacer);
+// Called by whichever thread swaps, with the time input was read, the time
+// just before the swap and the time the swap returned
+void frame_pacer_presented(FramePacer* pacer, double input_ms, double submit_ms,
+                           double present_ms);
+// Called by the same thread for a frame that was not swapped, so the next
+// present does not count the gap as one long, missed frame
+void frame_pacer_idle(FramePacer* pacer);
+
+FramePacerStats frame_pacer_stats(FramePacer* pacer);
+
+#endif
@@ -0,0 +1,34 @@
+#include "frustum.h"
+
+#include <math.h>
+
+void frustum_from_matrix(Frustum* frustum, mat4x4 m) {
+    // Gribb/Hartmann plane extraction, linmath matrices are column-major
+    for (int i = 0; i < 3; i++) {
+        for (int j = 0; j < 4; j++) {
+            frustum->planes[i * 2 + 0][j] = m[j][3] + m[j][i];
+            frustum->planes[i * 2 + 1][j] = m[j][3] - m[j][i];
+        }
+    }
+
+    for (int i = 0; i < 6; i++) {
+        float *p = frustum->planes[i];
+        float len = sqrtf(p[0] * p[0] + p[1] * p[1] + p[2] * p[2]);
+        if (len > 0.0f) {
+            p[0] /= len;
+            p[1] /= len;
+            p[2] /= len;
+            p[3] /= len;
+        }
+    }
+}
+
+bool frustum_test_sphere(const Frustum* frustum, const vec3 center, float radius) {
+    for (int i = 0; i < 6; i++) {
+        const float *p = frustum->planes[i];
+        float d = p[0] * center[0] + p[1] * center[1] + p[2] * center[2] + p[3];
+        if (d < -radius)
+            return false;
+    }
+    return true;
+}
@@ -0,0 +1,17 @@
+#ifndef FRUSTUM_H
+#define FRUSTUM_H
+
+#include <stdbool.h>
+
+#include "linmath.h"
+
+// Planes are stored as (a, b, c, d) with the normal pointing inwards, so a
+// point p is inside when dot(n, p) + d >= 0 for all six planes.
+typedef struct Frustum {
+  vec4 planes[6];
+} Frustum;
+
+void frustum_from_matrix(Frustum* frustum, mat4x4 view_proj);
+bool frustum_test_sphere(const Frustum* frustum, const vec3 center, float radius);
+
+#endif
@@ -0,0 +1,94 @@
+#include "gpu_pool.h"
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+void gpu_pool_init(GpuPool* pool, GLenum target, int element_size, int capacity) {
+    memset(pool, 0, sizeof(*pool));
+    pool->target = target;
+    pool->element_size = element_size;
+    pool->capacity = capacity;
+
+    glGenBuffers(1, &pool->buffer);
+    glBindBuffer(target, pool->buffer);
+    glBufferData(target, (GLsizeiptr)capacity * element_size, NULL,
+                 GL_DYNAMIC_DRAW);
+
+    pool->free_capacity = 64;
+    pool->free_ranges =
+        (GpuRange *)malloc(pool->free_capacity * sizeof(GpuRange));
+    pool->free_ranges[0].offset = 0;
+    pool->free_ranges[0].count = capacity;
+    pool->free_count = 1;
+}
+
+void gpu_pool_destroy(GpuPool* pool) {
+    glDeleteBuffers(1, &pool->buffer);
+    free(pool->free_ranges);
+}
+
+int gpu_pool_alloc(GpuPool* pool, int count) {
+    for (int i = 0; i < pool->free_count; i++) {
+        GpuRange *range = &pool->free_ranges[i];
+        if (range->count < count)
+            continue;
+
+        int offset = range->offset;
+        range->offset += count;
+        range->count -= count;
+        if (range->count == 0) {
+            memmove(range, range + 1,
+                    (pool->free_count - i - 1) * sizeof(GpuRange));
+            pool->free_count--;
+        }
+        pool->used += count;
+        return offset;
+    }
+    return -1;
+}
+
+void gpu_pool_free(GpuPool* pool, int offset, int count) {
+    // Free list is kept sorted by offset so neighbours can be merged
+    int i = 0;
+    while (i < pool->free_count && pool->free_ranges[i].offset < offset)
+        i++;
+
+    bool merge_prev = i > 0 && pool->free_ranges[i - 1].offset +
+                                       pool->free_ranges[i - 1].count ==
+                                   offset;
+    bool merge_next =
+        i < pool->free_count && offset + count == pool->free_ranges[i].offset;
+
+    if (merge_prev && merge_next) {
+        pool->free_ranges[i - 1].count += count + pool->free_ranges[i].count;
+        memmove(&pool->free_ranges[i], &pool->free_ranges[i + 1],
+                (pool->free_count - i - 1) * sizeof(GpuRange));
+        pool->free_count--;
+    } else if (merge_prev) {
+        pool->free_ranges[i - 1].count += count;
+    } else if (merge_next) {
+        pool->free_ranges[i].offset = offset;
+        pool->free_ranges[i].count += count;
+    } else {
+        if (pool->free_count == pool->free_capacity) {
+            pool->free_capacity *= 2;
+            pool->free_ranges = (GpuRange *)realloc(
+                pool->free_ranges, pool->free_capacity * sizeof(GpuRange));
+        }
+        memmove(&pool->free_ranges[i + 1], &pool->free_ranges[i],
+                (pool->free_count - i) * sizeof(GpuRange));
+        pool->free_ranges[i].offset = offset;
+        pool->free_ranges[i].count = count;
+        pool->free_count++;
+    }
+    pool->used -= count;
+}
+
+void gpu_pool_write(GpuPool* pool, int offset, int count, const void* data) {
+    // Binding an index pool to its own target would replace the element
+    // buffer of whichever VAO happens to be bound
+    glBindBuffer(GL_COPY_WRITE_BUFFER, pool->buffer);
+    glBufferSubData(GL_COPY_WRITE_BUFFER, (GLintptr)offset * pool->element_size,
+                    (GLsizeiptr)count * pool->element_size, data);
+}
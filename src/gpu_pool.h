@@ -0,0 +1,33 @@
+#ifndef GPU_POOL_H
+#define GPU_POOL_H
+
+#include <glad/gl.h>
+
+typedef struct GpuRange {
+  int offset;
+  int count;
+} GpuRange;
+
+// One large GL buffer sub-allocated in fixed-size elements with a first-fit
+// free list, so many small meshes can share a buffer and a single draw call.
+typedef struct GpuPool {
+  GLuint buffer;
+  GLenum target;
+  int element_size;
+  int capacity;
+  int used;
+  GpuRange* free_ranges;
+  int free_count;
+  int free_capacity;
+} GpuPool;
+
+// Binds the buffer to `target`, so an index pool should be created with its
+// VAO bound. Writes go through GL_COPY_WRITE_BUFFER and bind nothing else.
+void gpu_pool_init(GpuPool* pool, GLenum target, int element_size, int capacity);
+void gpu_pool_destroy(GpuPool* pool);
+
+int gpu_pool_alloc(GpuPool* pool, int count);
+void gpu_pool_free(GpuPool* pool, int offset, int count);
+void gpu_pool_write(GpuPool* pool, int offset, int count, const void* data);
+
+#endif
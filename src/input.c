@@ -0,0 +1,274 @@
+#include "input.h"
+
+#include <stdio.h>
+#include <string.h>
+
+bool input_queue_push(InputQueue* queue, const InputEvent* event) {
+    uint32_t head = queue->head;
+    uint32_t tail = __atomic_load_n(&queue->tail, __ATOMIC_ACQUIRE);
+    if (head - tail == INPUT_QUEUE_SIZE) {
+        __atomic_fetch_add(&queue->dropped, 1, __ATOMIC_RELAXED);
+        return false;
+    }
+    queue->events[head & (INPUT_QUEUE_SIZE - 1)] = *event;
+    __atomic_store_n(&queue->head, head + 1, __ATOMIC_RELEASE);
+    return true;
+}
+
+bool input_queue_pop(InputQueue* queue, double until, InputEvent* event) {
+    uint32_t tail = queue->tail;
+    uint32_t head = __atomic_load_n(&queue->head, __ATOMIC_ACQUIRE);
+    if (tail == head)
+        return false;
+    const InputEvent *next = &queue->events[tail & (INPUT_QUEUE_SIZE - 1)];
+    if (next->time > until)
+        return false;
+    *event = *next;
+    __atomic_store_n(&queue->tail, tail + 1, __ATOMIC_RELEASE);
+    return true;
+}
+
+static void input_push(GLFWwindow* window, InputEventType type, int code, int action,
+                       int mods, double x, double y) {
+    Input *input = (Input *)glfwGetWindowUserPointer(window);
+    InputEvent event;
+    event.time = glfwGetTime();
+    event.type = (uint8_t)type;
+    event.action = (uint8_t)action;
+    event.mods = (uint16_t)mods;
+    event.code = code;
+    event.x = (float)x;
+    event.y = (float)y;
+    input_queue_push(&input->queue, &event);
+}
+
+static void input_key_callback(GLFWwindow* window, int key, int scancode, int action,
+                               int mods) {
+    input_push(window, INPUT_KEY, key, action, mods, 0.0, 0.0);
+}
+
+static void input_mouse_button_callback(GLFWwindow* window, int button, int action,
+                                        int mods) {
+    input_push(window, INPUT_MOUSE_BUTTON, button, action, mods, 0.0, 0.0);
+}
+
+static void input_cursor_callback(GLFWwindow* window, double x, double y) {
+    input_push(window, INPUT_CURSOR, 0, 0, 0, x, y);
+}
+
+static void input_scroll_callback(GLFWwindow* window, double x, double y) {
+    input_push(window, INPUT_SCROLL, 0, 0, 0, x, y);
+}
+
+void input_init(Input* input) {
+    memset(input, 0, sizeof(*input));
+}
+
+void input_attach(Input* input, GLFWwindow* window) {
+    glfwSetWindowUserPointer(window, input);
+    glfwSetKeyCallback(window, input_key_callback);
+    glfwSetMouseButtonCallback(window, input_mouse_button_callback);
+    glfwSetCursorPosCallback(window, input_cursor_callback);
+    glfwSetScrollCallback(window, input_scroll_callback);
+}
+
+static bool input_bind(Input* input, InputEventType type, int code, int action) {
+    if (input->binding_count == INPUT_MAX_BINDINGS || action < 0 ||
+        action >= INPUT_MAX_ACTIONS)
+        return false;
+    InputBinding *binding = &input->bindings[input->binding_count++];
+    binding->type = (uint8_t)type;
+    binding->code = code;
+    binding->action = action;
+    return true;
+}
+
+bool input_bind_key(Input* input, int key, int action) {
+    return input_bind(input, INPUT_KEY, key, action);
+}
+
+bool input_bind_mouse_button(Input* input, int button, int action) {
+    return input_bind(input, INPUT_MOUSE_BUTTON, button, action);
+}
+
+void input_apply(Input* input, const InputEvent* event) {
+    input->time = event->time;
+    input->events++;
+    switch (event->type) {
+    case INPUT_CURSOR:
+        // The first position only sets where motion is measured from
+        if (input->has_cursor) {
+            input->look_x += event->x - input->cursor_x;
+            input->look_y += event->y - input->cursor_y;
+        }
+        input->has_cursor = true;
+        input->cursor_x = event->x;
+        input->cursor_y = event->y;
+        return;
+    case INPUT_SCROLL:
+        input->scroll_x += event->x;
+        input->scroll_y += event->y;
+        return;
+    }
+    if (event->action == GLFW_REPEAT)
+        return;
+
+    bool press = event->action == GLFW_PRESS;
+    for (int i = 0; i < input->binding_count; i++) {
+        const InputBinding *binding = &input->bindings[i];
+        if (binding->type != event->type || binding->code != event->code)
+            continue;
+        input->held[i] = press;
+        uint32_t bit = 1u << binding->action;
+        if (press && !(input->down & bit))
+            input->pressed |= bit;
+
+        // Down while any input bound to the action is held
+        bool down = false;
+        for (int j = 0; j < input->binding_count; j++)
+            down = down || (input->held[j] && input->bindings[j].action == binding->action);
+        if (!down && (input->down & bit))
+            input->released |= bit;
+        input->down = down ? input->down | bit : input->down & ~bit;
+    }
+}
+
+static void input_clear_edges(Input* input) {
+    input->pressed = 0;
+    input->released = 0;
+    input->look_x = input->look_y = 0.0f;
+    input->scroll_x = input->scroll_y = 0.0f;
+}
+
+static void input_record_event(InputRecording* recording, const InputEvent* event) {
+    InputRecordEvent record;
+    record.frame = recording->frame;
+    record.time = (float)(event->time - recording->started);
+    record.type = event->type;
+    record.action = event->action;
+    record.mods = event->mods;
+    record.code = event->code;
+    record.x = event->x;
+    record.y = event->y;
+    if (fwrite(&record, sizeof(record), 1, recording->file) == 1)
+        recording->event_count++;
+}
+
+int input_update(Input* input, double until) {
+    input_clear_edges(input);
+
+    InputRecording *recording = input->recording;
+    int count = 0;
+    InputEvent event;
+    while (input_queue_pop(&input->queue, until, &event)) {
+        if (recording && recording->file && !recording->replaying)
+            input_record_event(recording, &event);
+        input_apply(input, &event);
+        count++;
+    }
+    if (recording && recording->file && !recording->replaying)
+        recording->frame++;
+    return count;
+}
+
+bool input_record_open(InputRecording* recording, const char* path, double timestep) {
+    memset(recording, 0, sizeof(*recording));
+    snprintf(recording->path, sizeof(recording->path), "%s", path);
+    recording->timestep = timestep;
+    recording->started = glfwGetTime();
+    recording->file = fopen(path, "wb");
+    // The header is written again with the counts when closing
+    InputRecordHeader header;
+    memset(&header, 0, sizeof(header));
+    if (!recording->file || fwrite(&header, sizeof(header), 1, recording->file) != 1) {
+        fprintf(stderr, "Error: cannot record input to %s\n", path);
+        if (recording->file)
+            fclose(recording->file);
+        recording->file = NULL;
+        return false;
+    }
+    return true;
+}
+
+static void input_replay_read(InputRecording* recording) {
+    recording->has_next =
+        fread(&recording->next, sizeof(recording->next), 1, recording->file) == 1;
+}
+
+bool input_replay_open(InputRecording* recording, const char* path) {
+    memset(recording, 0, sizeof(*recording));
+    snprintf(recording->path, sizeof(recording->path), "%s", path);
+    recording->replaying = true;
+    recording->file = fopen(path, "rb");
+    InputRecordHeader header;
+    if (!recording->file || fread(&header, sizeof(header), 1, recording->file) != 1 ||
+        header.magic != INPUT_RECORD_MAGIC || header.version != INPUT_RECORD_VERSION ||
+        header.timestep <= 0.0) {
+        fprintf(stderr, "Error: %s is not an input recording\n", path);
+        if (recording->file)
+            fclose(recording->file);
+        recording->file = NULL;
+        return false;
+    }
+    recording->timestep = header.timestep;
+    recording->frame_count = header.frame_count;
+    recording->event_count = header.event_count;
+    input_replay_read(recording);
+    return true;
+}
+
+void input_recording_close(InputRecording* recording) {
+    if (!recording->file)
+        return;
+    if (!recording->replaying) {
+        InputRecordHeader header;
+        header.magic = INPUT_RECORD_MAGIC;
+        header.version = INPUT_RECORD_VERSION;
+        header.frame_count = recording->frame;
+        header.event_count = recording->event_count;
+        header.timestep = recording->timestep;
+        bool ok = fseek(recording->file, 0, SEEK_SET) == 0 &&
+                  fwrite(&header, sizeof(header), 1, recording->file) == 1;
+        ok = fclose(recording->file) == 0 && ok;
+        if (!ok)
+            fprintf(stderr, "Error: failed writing %s\n", recording->path);
+    } else {
+        fclose(recording->file);
+    }
+    recording->file = NULL;
+}
+
+int input_replay(Input* input, InputRecording* recording) {
+    if (!recording->file || recording->frame >= recording->frame_count)
+        return -1;
+    input_clear_edges(input);
+
+    int count = 0;
+    while (recording->has_next && recording->next.frame <= recording->frame) {
+        InputEvent event;
+        event.time = recording->frame * recording->timestep;
+        event.type = recording->next.type;
+        event.action = recording->next.action;
+        event.mods = recording->next.mods;
+        event.code = recording->next.code;
+        event.x = recording->next.x;
+        event.y = recording->next.y;
+        input_apply(input, &event);
+        count++;
+        input_replay_read(recording);
+    }
+    recording->frame++;
+    return count;
+}
+
+bool input_down(const Input* input, int action) {
+    return (input->down >> action) & 1;
+}
+
+bool input_pressed(const Input* input, int action) {
+    return (input->pressed >> action) & 1;
+}
+
+bool input_released(const Input* input, int action) {
+    return (input->released >> action) & 1;
+}
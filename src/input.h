@@ -1,5 +1,153 @@
 #ifndef INPUT_H
 #define INPUT_H
 
+#include <glad/gl.h>
+#define GLFW_INCLUDE_NONE
+#include <GLFW/glfw3.h>
 
-#endif
\ No newline at end of file
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+// Power of two
+#define INPUT_QUEUE_SIZE 1024
+#define INPUT_MAX_ACTIONS 32
+#define INPUT_MAX_BINDINGS 64
+
+#define INPUT_RECORD_MAGIC 0x43455249u // "IREC"
+#define INPUT_RECORD_VERSION 1
+
+typedef enum InputEventType {
+  INPUT_KEY,
+  INPUT_MOUSE_BUTTON,
+  INPUT_CURSOR,
+  INPUT_SCROLL
+} InputEventType;
+
+// `code` is the GLFW key or button and `action` GLFW_PRESS, GLFW_RELEASE or
+// GLFW_REPEAT; cursor and scroll events carry their values in x and y.
+// Times are glfwGetTime seconds.
+typedef struct InputEvent {
+  double time;
+  uint8_t type;
+  uint8_t action;
+  uint16_t mods;
+  int32_t code;
+  float x;
+  float y;
+} InputEvent;
+
+// Single producer, single consumer ring. The window thread pushes from the
+// GLFW callbacks and whichever thread runs the simulation pops; neither
+// waits on the other. A full queue drops the new event and counts it.
+typedef struct InputQueue {
+  InputEvent events[INPUT_QUEUE_SIZE];
+  // Apart so the two threads do not share a cache line
+  uint32_t head;
+  char head_pad[60];
+  uint32_t tail;
+  char tail_pad[60];
+  uint32_t dropped;
+} InputQueue;
+
+bool input_queue_push(InputQueue* queue, const InputEvent* event);
+// False when there is nothing older than `until` to pop
+bool input_queue_pop(InputQueue* queue, double until, InputEvent* event);
+
+// Recording file layout: a header, then one entry per event in the order
+// they were applied, tagged with the frame that applied them
+typedef struct InputRecordHeader {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t frame_count;
+  uint32_t event_count;
+  double timestep;
+} InputRecordHeader;
+
+typedef struct InputRecordEvent {
+  uint32_t frame;
+  // Seconds since recording started, kept for reference; replay goes by
+  // frame
+  float time;
+  uint8_t type;
+  uint8_t action;
+  uint16_t mods;
+  int32_t code;
+  float x;
+  float y;
+} InputRecordEvent;
+
+// Either writes the events a run applies or plays a written run back one
+// frame per update. Both run the simulation at `timestep`, which is what
+// makes a replay produce the same frames as the recording.
+typedef struct InputRecording {
+  FILE* file;
+  char path[256];
+  bool replaying;
+  double timestep;
+  double started;
+  uint32_t frame;
+  uint32_t frame_count;
+  uint32_t event_count;
+  InputRecordEvent next;
+  bool has_next;
+} InputRecording;
+
+typedef struct InputBinding {
+  uint8_t type;
+  int code;
+  int action;
+} InputBinding;
+
+// Keys and buttons bound to numbered actions, which the application
+// defines. Everything past the queue belongs to the consuming thread.
+typedef struct Input {
+  InputQueue queue;
+  InputBinding bindings[INPUT_MAX_BINDINGS];
+  bool held[INPUT_MAX_BINDINGS];
+  int binding_count;
+
+  uint32_t down;
+  uint32_t pressed;
+  uint32_t released;
+  bool has_cursor;
+  float cursor_x;
+  float cursor_y;
+  // Accumulated since the last input_update
+  float look_x;
+  float look_y;
+  float scroll_x;
+  float scroll_y;
+  double time;
+  long events;
+  // Written to by input_update when set
+  InputRecording* recording;
+} Input;
+
+void input_init(Input* input);
+// Installs callbacks that feed `input`, through the window user pointer
+void input_attach(Input* input, GLFWwindow* window);
+
+// Actions must be below INPUT_MAX_ACTIONS; several inputs may share one
+bool input_bind_key(Input* input, int key, int action);
+bool input_bind_mouse_button(Input* input, int button, int action);
+
+// Applies queued events up to `until` and returns how many there were.
+// Edges and motion from the previous update are cleared first.
+int input_update(Input* input, double until);
+void input_apply(Input* input, const InputEvent* event);
+
+bool input_record_open(InputRecording* recording, const char* path, double timestep);
+bool input_replay_open(InputRecording* recording, const char* path);
+// Finishes the file when recording
+void input_recording_close(InputRecording* recording);
+
+// Applies the events recorded for the next frame in place of input_update.
+// Returns -1 once every recorded frame has been played.
+int input_replay(Input* input, InputRecording* recording);
+
+bool input_down(const Input* input, int action);
+bool input_pressed(const Input* input, int action);
+bool input_released(const Input* input, int action);
+
+#endif
@@ -0,0 +1,144 @@
+#include "job.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+int job_default_thread_count() {
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    if (cores <= 1)
+        return 1;
+    // Leave one core for the main thread
+    return (int)cores - 1;
+}
+
+// Takes the `index`th queued job out of the queue and runs it. Called with
+// the lock held.
+static void job_run(JobSystem* jobs, int index) {
+    Job job = jobs->queue[(jobs->head + index) % jobs->capacity];
+    for (int i = index; i > 0; i--)
+        jobs->queue[(jobs->head + i) % jobs->capacity] =
+            jobs->queue[(jobs->head + i - 1) % jobs->capacity];
+    jobs->head = (jobs->head + 1) % jobs->capacity;
+    jobs->count--;
+    jobs->active++;
+    pthread_mutex_unlock(&jobs->lock);
+
+    job.fn(job.arg);
+
+    pthread_mutex_lock(&jobs->lock);
+    jobs->active--;
+    if (job.counter && --job.counter->pending == 0)
+        pthread_cond_broadcast(&jobs->finished);
+    if (jobs->count == 0 && jobs->active == 0)
+        pthread_cond_broadcast(&jobs->idle);
+}
+
+static void *job_worker(void* arg) {
+    JobSystem *jobs = (JobSystem *)arg;
+
+    pthread_mutex_lock(&jobs->lock);
+    while (true) {
+        while (jobs->count == 0 && !jobs->stopping)
+            pthread_cond_wait(&jobs->has_work, &jobs->lock);
+        if (jobs->count == 0 && jobs->stopping)
+            break;
+        job_run(jobs, 0);
+    }
+    pthread_mutex_unlock(&jobs->lock);
+    return NULL;
+}
+
+void job_system_init(JobSystem* jobs, int thread_count) {
+    memset(jobs, 0, sizeof(*jobs));
+    if (thread_count <= 0)
+        thread_count = job_default_thread_count();
+
+    jobs->capacity = 256;
+    jobs->queue = (Job *)malloc(jobs->capacity * sizeof(Job));
+    pthread_mutex_init(&jobs->lock, NULL);
+    pthread_cond_init(&jobs->has_work, NULL);
+    pthread_cond_init(&jobs->idle, NULL);
+    pthread_cond_init(&jobs->finished, NULL);
+
+    jobs->thread_count = thread_count;
+    jobs->threads = (pthread_t *)malloc(thread_count * sizeof(pthread_t));
+    for (int i = 0; i < thread_count; i++)
+        pthread_create(&jobs->threads[i], NULL, job_worker, jobs);
+}
+
+void job_system_destroy(JobSystem* jobs) {
+    pthread_mutex_lock(&jobs->lock);
+    jobs->stopping = true;
+    pthread_cond_broadcast(&jobs->has_work);
+    pthread_mutex_unlock(&jobs->lock);
+
+    for (int i = 0; i < jobs->thread_count; i++)
+        pthread_join(jobs->threads[i], NULL);
+
+    pthread_cond_destroy(&jobs->finished);
+    pthread_cond_destroy(&jobs->idle);
+    pthread_cond_destroy(&jobs->has_work);
+    pthread_mutex_destroy(&jobs->lock);
+    free(jobs->threads);
+    free(jobs->queue);
+}
+
+void job_submit(JobSystem* jobs, JobFn fn, void* arg) {
+    job_submit_counted(jobs, fn, arg, NULL);
+}
+
+void job_submit_counted(JobSystem* jobs, JobFn fn, void* arg, JobCounter* counter) {
+    pthread_mutex_lock(&jobs->lock);
+    if (jobs->count == jobs->capacity) {
+        int capacity = jobs->capacity * 2;
+        Job *queue = (Job *)malloc(capacity * sizeof(Job));
+        for (int i = 0; i < jobs->count; i++)
+            queue[i] = jobs->queue[(jobs->head + i) % jobs->capacity];
+        free(jobs->queue);
+        jobs->queue = queue;
+        jobs->capacity = capacity;
+        jobs->head = 0;
+    }
+
+    Job *job = &jobs->queue[(jobs->head + jobs->count) % jobs->capacity];
+    job->fn = fn;
+    job->arg = arg;
+    job->counter = counter;
+    if (counter)
+        counter->pending++;
+    jobs->count++;
+    pthread_cond_signal(&jobs->has_work);
+    pthread_mutex_unlock(&jobs->lock);
+}
+
+void job_wait(JobSystem* jobs) {
+    pthread_mutex_lock(&jobs->lock);
+    while (jobs->count > 0 || jobs->active > 0)
+        pthread_cond_wait(&jobs->idle, &jobs->lock);
+    pthread_mutex_unlock(&jobs->lock);
+}
+
+void job_wait_counter(JobSystem* jobs, JobCounter* counter) {
+    pthread_mutex_lock(&jobs->lock);
+    while (counter->pending > 0) {
+        // Only the caller's own jobs, anything else could be long enough to
+        // stall a frame
+        int index = 0;
+        while (index < jobs->count &&
+               jobs->queue[(jobs->head + index) % jobs->capacity].counter != counter)
+            index++;
+        if (index < jobs->count)
+            job_run(jobs, index);
+        else
+            pthread_cond_wait(&jobs->finished, &jobs->lock);
+    }
+    pthread_mutex_unlock(&jobs->lock);
+}
+
+int job_pending(JobSystem* jobs) {
+    pthread_mutex_lock(&jobs->lock);
+    int pending = jobs->count + jobs->active;
+    pthread_mutex_unlock(&jobs->lock);
+    return pending;
+}
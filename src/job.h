@@ -0,0 +1,53 @@
+#ifndef JOB_H
+#define JOB_H
+
+#include <pthread.h>
+#include <stdbool.h>
+
+typedef void (*JobFn)(void* arg);
+
+// Jobs of one batch submitted with job_submit_counted, guarded by the job
+// system's lock. Start it at zero.
+typedef struct JobCounter {
+  int pending;
+} JobCounter;
+
+typedef struct Job {
+  JobFn fn;
+  void* arg;
+  JobCounter* counter;
+} Job;
+
+// Fixed pool of worker threads pulling from a single FIFO queue. Jobs must
+// not touch GL, results are handed back to the main thread by the caller.
+typedef struct JobSystem {
+  pthread_t* threads;
+  int thread_count;
+  Job* queue;
+  int capacity;
+  int head;
+  int count;
+  int active;
+  bool stopping;
+  pthread_mutex_t lock;
+  pthread_cond_t has_work;
+  pthread_cond_t idle;
+  pthread_cond_t finished;
+} JobSystem;
+
+int job_default_thread_count();
+
+void job_system_init(JobSystem* jobs, int thread_count);
+void job_system_destroy(JobSystem* jobs);
+
+void job_submit(JobSystem* jobs, JobFn fn, void* arg);
+void job_submit_counted(JobSystem* jobs, JobFn fn, void* arg, JobCounter* counter);
+// Waits for every job in the system, so it must not be called from a job
+void job_wait(JobSystem* jobs);
+// Waits for the jobs of `counter` only. Those still queued are run by the
+// caller, never anyone else's, so it is safe from inside a job and does not
+// pick up unrelated work on the GL thread.
+void job_wait_counter(JobSystem* jobs, JobCounter* counter);
+int job_pending(JobSystem* jobs);
+
+#endif
@@ -0,0 +1,207 @@
+#include "json.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct JsonParser {
+  const char* p;
+  const char* end;
+  JsonDoc* doc;
+  int capacity;
+} JsonParser;
+
+static void json_skip(JsonParser* parser) {
+    while (parser->p < parser->end &&
+           (*parser->p == ' ' || *parser->p == '\n' || *parser->p == '\r' ||
+            *parser->p == '\t'))
+        parser->p++;
+}
+
+static int json_new_node(JsonParser* parser, JsonType type) {
+    JsonDoc *doc = parser->doc;
+    if (doc->node_count == parser->capacity) {
+        parser->capacity = parser->capacity ? parser->capacity * 2 : 256;
+        doc->nodes = (JsonNode *)realloc(doc->nodes,
+                                         parser->capacity * sizeof(JsonNode));
+    }
+    JsonNode *node = &doc->nodes[doc->node_count];
+    memset(node, 0, sizeof(*node));
+    node->type = type;
+    node->child = -1;
+    node->next = -1;
+    return doc->node_count++;
+}
+
+static bool json_string(JsonParser* parser, const char** start, int* length) {
+    if (parser->p >= parser->end || *parser->p != '"')
+        return false;
+    parser->p++;
+    *start = parser->p;
+    while (parser->p < parser->end && *parser->p != '"') {
+        if (*parser->p == '\\')
+            parser->p++;
+        parser->p++;
+    }
+    if (parser->p >= parser->end)
+        return false;
+    *length = (int)(parser->p - *start);
+    parser->p++;
+    return true;
+}
+
+static int json_value(JsonParser* parser);
+
+static int json_container(JsonParser* parser, bool object) {
+    int node = json_new_node(parser, object ? JSON_OBJECT : JSON_ARRAY);
+    char close = object ? '}' : ']';
+    int last = -1;
+    parser->p++;
+
+    json_skip(parser);
+    if (parser->p < parser->end && *parser->p == close) {
+        parser->p++;
+        return node;
+    }
+
+    while (parser->p < parser->end) {
+        const char *key = NULL;
+        int key_length = 0;
+        if (object) {
+            json_skip(parser);
+            if (!json_string(parser, &key, &key_length))
+                return -1;
+            json_skip(parser);
+            if (parser->p >= parser->end || *parser->p != ':')
+                return -1;
+            parser->p++;
+        }
+
+        int child = json_value(parser);
+        if (child < 0)
+            return -1;
+        parser->doc->nodes[child].key = key;
+        parser->doc->nodes[child].key_length = key_length;
+        if (last < 0)
+            parser->doc->nodes[node].child = child;
+        else
+            parser->doc->nodes[last].next = child;
+        parser->doc->nodes[node].count++;
+        last = child;
+
+        json_skip(parser);
+        if (parser->p < parser->end && *parser->p == ',') {
+            parser->p++;
+            continue;
+        }
+        if (parser->p < parser->end && *parser->p == close) {
+            parser->p++;
+            return node;
+        }
+        return -1;
+    }
+    return -1;
+}
+
+static int json_value(JsonParser* parser) {
+    json_skip(parser);
+    if (parser->p >= parser->end)
+        return -1;
+
+    char c = *parser->p;
+    if (c == '{' || c == '[')
+        return json_container(parser, c == '{');
+
+    if (c == '"') {
+        int node = json_new_node(parser, JSON_STRING);
+        const char *start;
+        int length;
+        if (!json_string(parser, &start, &length))
+            return -1;
+        parser->doc->nodes[node].string = start;
+        parser->doc->nodes[node].string_length = length;
+        return node;
+    }
+
+    size_t left = parser->end - parser->p;
+    if (left >= 4 && strncmp(parser->p, "true", 4) == 0) {
+        int node = json_new_node(parser, JSON_BOOL);
+        parser->doc->nodes[node].number = 1.0;
+        parser->p += 4;
+        return node;
+    }
+    if (left >= 5 && strncmp(parser->p, "false", 5) == 0) {
+        parser->p += 5;
+        return json_new_node(parser, JSON_BOOL);
+    }
+    if (left >= 4 && strncmp(parser->p, "null", 4) == 0) {
+        parser->p += 4;
+        return json_new_node(parser, JSON_NULL);
+    }
+
+    // Numbers are short, copy into a terminated buffer for strtod
+    char buffer[64];
+    int n = 0;
+    while (parser->p < parser->end && n < 63 &&
+           strchr("+-0123456789.eE", *parser->p))
+        buffer[n++] = *parser->p++;
+    if (n == 0)
+        return -1;
+    buffer[n] = '\0';
+    int node = json_new_node(parser, JSON_NUMBER);
+    parser->doc->nodes[node].number = strtod(buffer, NULL);
+    return node;
+}
+
+bool json_parse(JsonDoc* doc, const char* text, size_t length) {
+    doc->nodes = NULL;
+    doc->node_count = 0;
+
+    JsonParser parser = {text, text + length, doc, 0};
+    if (json_value(&parser) != 0) {
+        json_free(doc);
+        return false;
+    }
+    return true;
+}
+
+void json_free(JsonDoc* doc) {
+    free(doc->nodes);
+    doc->nodes = NULL;
+    doc->node_count = 0;
+}
+
+int json_get(const JsonDoc* doc, int node, const char* key) {
+    if (node < 0 || doc->nodes[node].type != JSON_OBJECT)
+        return -1;
+    int length = (int)strlen(key);
+    for (int child = doc->nodes[node].child; child >= 0;
+         child = doc->nodes[child].next) {
+        const JsonNode *n = &doc->nodes[child];
+        if (n->key_length == length && strncmp(n->key, key, length) == 0)
+            return child;
+    }
+    return -1;
+}
+
+int json_at(const JsonDoc* doc, int node, int index) {
+    if (node < 0 || index < 0 || doc->nodes[node].type != JSON_ARRAY)
+        return -1;
+    int child = doc->nodes[node].child;
+    while (child >= 0 && index-- > 0)
+        child = doc->nodes[child].next;
+    return child;
+}
+
+double json_number(const JsonDoc* doc, int node, double fallback) {
+    if (node < 0 || doc->nodes[node].type != JSON_NUMBER)
+        return fallback;
+    return doc->nodes[node].number;
+}
+
+bool json_string_is(const JsonDoc* doc, int node, const char* value) {
+    if (node < 0 || doc->nodes[node].type != JSON_STRING)
+        return false;
+    int length = (int)strlen(value);
+    return doc->nodes[node].string_length == length &&
+           strncmp(doc->nodes[node].string, value, length) == 0;
+}
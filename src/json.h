@@ -0,0 +1,43 @@
+#ifndef JSON_H
+#define JSON_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+typedef enum JsonType {
+  JSON_NULL,
+  JSON_BOOL,
+  JSON_NUMBER,
+  JSON_STRING,
+  JSON_ARRAY,
+  JSON_OBJECT,
+} JsonType;
+
+// Strings point into the source text and are not unescaped, which is enough
+// for the ASCII keys and names used by asset formats.
+typedef struct JsonNode {
+  JsonType type;
+  const char* key;
+  int key_length;
+  const char* string;
+  int string_length;
+  double number;
+  int child;
+  int next;
+  int count;
+} JsonNode;
+
+typedef struct JsonDoc {
+  JsonNode* nodes;
+  int node_count;
+} JsonDoc;
+
+bool json_parse(JsonDoc* doc, const char* text, size_t length);
+void json_free(JsonDoc* doc);
+
+int json_get(const JsonDoc* doc, int node, const char* key);
+int json_at(const JsonDoc* doc, int node, int index);
+double json_number(const JsonDoc* doc, int node, double fallback);
+bool json_string_is(const JsonDoc* doc, int node, const char* value);
+
+#endif
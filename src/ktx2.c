@@ -0,0 +1,205 @@
+#include "ktx2.h"
+
+#include <stdio.h>
+#include <string.h>
+
+static const uint8_t ktx2_identifier[12] = {0xAB, 'K', 'T', 'X', ' ', '2',
+                                            '0',  0xBB, '\r', '\n', 0x1A, '\n'};
+
+// Identifier, then the fixed header and index
+typedef struct Ktx2Header {
+  uint32_t vk_format;
+  uint32_t type_size;
+  uint32_t pixel_width;
+  uint32_t pixel_height;
+  uint32_t pixel_depth;
+  uint32_t layer_count;
+  uint32_t face_count;
+  uint32_t level_count;
+  uint32_t supercompression;
+  uint32_t dfd_offset;
+  uint32_t dfd_length;
+  uint32_t kvd_offset;
+  uint32_t kvd_length;
+  // 64 bit supercompression offset and length, split to keep the layout
+  uint32_t sgd[4];
+} Ktx2Header;
+
+typedef struct Ktx2LevelIndex {
+  uint64_t offset;
+  uint64_t length;
+  uint64_t uncompressed_length;
+} Ktx2LevelIndex;
+
+// Khronos data format colour models and channel ids
+#define KTX2_DF_MODEL_BC1A 128
+#define KTX2_DF_MODEL_BC3 130
+#define KTX2_DF_MODEL_BC4 131
+#define KTX2_DF_MODEL_BC5 132
+#define KTX2_DF_MODEL_BC7 134
+#define KTX2_DF_CHANNEL_COLOR 0
+#define KTX2_DF_CHANNEL_GREEN 1
+#define KTX2_DF_CHANNEL_BC3_ALPHA 15
+
+bool ktx2_is_ktx2(const uint8_t* data, size_t size) {
+    return size >= sizeof(ktx2_identifier) &&
+           memcmp(data, ktx2_identifier, sizeof(ktx2_identifier)) == 0;
+}
+
+uint32_t ktx2_vk_format(BcnFormat format, bool srgb) {
+    switch (format) {
+    case BCN_BC1:
+        return srgb ? KTX2_VK_BC1_RGB_SRGB : KTX2_VK_BC1_RGB_UNORM;
+    case BCN_BC3:
+        return srgb ? KTX2_VK_BC3_SRGB : KTX2_VK_BC3_UNORM;
+    case BCN_BC4:
+        return KTX2_VK_BC4_UNORM;
+    case BCN_BC5:
+        return KTX2_VK_BC5_UNORM;
+    case BCN_BC7:
+        return srgb ? KTX2_VK_BC7_SRGB : KTX2_VK_BC7_UNORM;
+    default:
+        return 0;
+    }
+}
+
+bool ktx2_bcn_format(uint32_t vk_format, BcnFormat* format, bool* srgb) {
+    for (int f = 0; f < BCN_FORMAT_COUNT; f++) {
+        for (int s = 0; s < 2; s++) {
+            if (ktx2_vk_format((BcnFormat)f, s) == vk_format) {
+                *format = (BcnFormat)f;
+                *srgb = s && f != BCN_BC4 && f != BCN_BC5;
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+bool ktx2_parse(Ktx2Texture* texture, const uint8_t* data, size_t size) {
+    memset(texture, 0, sizeof(*texture));
+    if (!ktx2_is_ktx2(data, size) ||
+        size < sizeof(ktx2_identifier) + sizeof(Ktx2Header))
+        return false;
+
+    Ktx2Header h;
+    memcpy(&h, data + sizeof(ktx2_identifier), sizeof(h));
+    int level_count = h.level_count > 0 ? (int)h.level_count : 1;
+    size_t index_offset = sizeof(ktx2_identifier) + sizeof(h);
+    if (h.supercompression != 0 || h.face_count != 1 || h.layer_count > 1 ||
+        h.pixel_depth > 1 || h.pixel_width == 0 || h.pixel_height == 0 ||
+        level_count > KTX2_MAX_LEVELS ||
+        index_offset + level_count * sizeof(Ktx2LevelIndex) > size)
+        return false;
+
+    texture->vk_format = h.vk_format;
+    texture->width = (int)h.pixel_width;
+    texture->height = (int)h.pixel_height;
+    texture->level_count = level_count;
+    for (int i = 0; i < level_count; i++) {
+        Ktx2LevelIndex level;
+        memcpy(&level, data + index_offset + i * sizeof(level), sizeof(level));
+        if (level.offset > size || level.length > size - level.offset)
+            return false;
+        texture->levels[i] = data + level.offset;
+        texture->level_sizes[i] = level.length;
+    }
+    return true;
+}
+
+static uint32_t ktx2_dfd(uint32_t vk_format, uint32_t* words) {
+    BcnFormat format;
+    bool srgb;
+    if (!ktx2_bcn_format(vk_format, &format, &srgb))
+        return 0;
+
+    static const uint32_t models[BCN_FORMAT_COUNT] = {
+        KTX2_DF_MODEL_BC1A, KTX2_DF_MODEL_BC3, KTX2_DF_MODEL_BC4, KTX2_DF_MODEL_BC5,
+        KTX2_DF_MODEL_BC7};
+    uint32_t channels[2] = {KTX2_DF_CHANNEL_COLOR, KTX2_DF_CHANNEL_COLOR};
+    int sample_count = 1;
+    if (format == BCN_BC3) {
+        channels[0] = KTX2_DF_CHANNEL_BC3_ALPHA;
+        sample_count = 2;
+    } else if (format == BCN_BC5) {
+        channels[1] = KTX2_DF_CHANNEL_GREEN;
+        sample_count = 2;
+    }
+
+    uint32_t block_size = 24 + 16 * sample_count;
+    int n = 0;
+    words[n++] = 4 + block_size;
+    words[n++] = 0;
+    words[n++] = 2 | block_size << 16;
+    words[n++] = models[format] | 1 << 8 | (srgb ? 2u : 1u) << 16;
+    words[n++] = 3 | 3 << 8;
+    words[n++] = (uint32_t)bcn_block_bytes(format);
+    words[n++] = 0;
+    uint32_t bit_length = bcn_block_bytes(format) * 8 / sample_count;
+    for (int i = 0; i < sample_count; i++) {
+        words[n++] = i * bit_length | (bit_length - 1) << 16 | channels[i] << 24;
+        words[n++] = 0;
+        words[n++] = 0;
+        words[n++] = 0xFFFFFFFFu;
+    }
+    return (uint32_t)(n * sizeof(uint32_t));
+}
+
+bool ktx2_write(const char* path, uint32_t vk_format, int width, int height,
+                int level_count, const uint8_t* const* levels,
+                const size_t* level_sizes) {
+    uint32_t dfd[16];
+    uint32_t dfd_length = ktx2_dfd(vk_format, dfd);
+    if (dfd_length == 0 || level_count < 1 || level_count > KTX2_MAX_LEVELS) {
+        fprintf(stderr, "Error: unsupported KTX2 texture for %s\n", path);
+        return false;
+    }
+
+    Ktx2Header h;
+    memset(&h, 0, sizeof(h));
+    h.vk_format = vk_format;
+    h.type_size = 1;
+    h.pixel_width = width;
+    h.pixel_height = height;
+    h.face_count = 1;
+    h.level_count = level_count;
+    h.dfd_offset = (uint32_t)(sizeof(ktx2_identifier) + sizeof(h) +
+                              level_count * sizeof(Ktx2LevelIndex));
+    h.dfd_length = dfd_length;
+
+    // Mips are stored smallest first, each aligned to the block size
+    BcnFormat format;
+    bool srgb;
+    ktx2_bcn_format(vk_format, &format, &srgb);
+    uint64_t alignment = bcn_block_bytes(format);
+    Ktx2LevelIndex index[KTX2_MAX_LEVELS];
+    uint64_t offset = h.dfd_offset + dfd_length;
+    for (int i = level_count - 1; i >= 0; i--) {
+        offset = (offset + alignment - 1) / alignment * alignment;
+        index[i].offset = offset;
+        index[i].length = level_sizes[i];
+        index[i].uncompressed_length = level_sizes[i];
+        offset += level_sizes[i];
+    }
+
+    FILE *f = fopen(path, "wb");
+    if (!f) {
+        fprintf(stderr, "Error: cannot create %s\n", path);
+        return false;
+    }
+    bool ok = fwrite(ktx2_identifier, sizeof(ktx2_identifier), 1, f) == 1 &&
+              fwrite(&h, sizeof(h), 1, f) == 1 &&
+              fwrite(index, sizeof(Ktx2LevelIndex), level_count, f) ==
+                  (size_t)level_count &&
+              fwrite(dfd, dfd_length, 1, f) == 1;
+    for (int i = level_count - 1; ok && i >= 0; i--) {
+        static const uint8_t zeros[16] = {0};
+        long padding = (long)index[i].offset - ftell(f);
+        ok = (padding == 0 || fwrite(zeros, padding, 1, f) == 1) &&
+             fwrite(levels[i], level_sizes[i], 1, f) == 1;
+    }
+    ok = fclose(f) == 0 && ok;
+    if (!ok)
+        fprintf(stderr, "Error: failed writing %s\n", path);
+    return ok;
+}
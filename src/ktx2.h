@@ -0,0 +1,45 @@
+#ifndef KTX2_H
+#define KTX2_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "bcn.h"
+
+#define KTX2_MAX_LEVELS 16
+
+// VkFormat values for the block compressed formats we cook
+#define KTX2_VK_BC1_RGB_UNORM 131
+#define KTX2_VK_BC1_RGB_SRGB 132
+#define KTX2_VK_BC3_UNORM 137
+#define KTX2_VK_BC3_SRGB 138
+#define KTX2_VK_BC4_UNORM 139
+#define KTX2_VK_BC5_UNORM 141
+#define KTX2_VK_BC7_UNORM 145
+#define KTX2_VK_BC7_SRGB 146
+
+// View into a KTX2 file in memory, level 0 is the full size image
+typedef struct Ktx2Texture {
+  uint32_t vk_format;
+  int width;
+  int height;
+  int level_count;
+  const uint8_t* levels[KTX2_MAX_LEVELS];
+  size_t level_sizes[KTX2_MAX_LEVELS];
+} Ktx2Texture;
+
+bool ktx2_is_ktx2(const uint8_t* data, size_t size);
+
+// Only 2D, single layer, non-supercompressed textures are accepted
+bool ktx2_parse(Ktx2Texture* texture, const uint8_t* data, size_t size);
+
+// Writes levels in the order given, level 0 first
+bool ktx2_write(const char* path, uint32_t vk_format, int width, int height,
+                int level_count, const uint8_t* const* levels,
+                const size_t* level_sizes);
+
+uint32_t ktx2_vk_format(BcnFormat format, bool srgb);
+bool ktx2_bcn_format(uint32_t vk_format, BcnFormat* format, bool* srgb);
+
+#endif
@@ -0,0 +1,536 @@
+#include "loader.h"
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "json.h"
+#include "vfs.h"
+
+#define LOADER_STRIDE 8
+
+static double loader_now_ms() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e3 + ts.tv_nsec * 1e-6;
+}
+
+static const char *skip_spaces(const char* p, const char* end) {
+    while (p < end && (*p == ' ' || *p == '\t'))
+        p++;
+    return p;
+}
+
+static const char *next_line(const char* p, const char* end) {
+    while (p < end && *p != '\n')
+        p++;
+    return p < end ? p + 1 : end;
+}
+
+// strtof needs a terminated string which a mapping does not provide
+static const char *parse_float(const char* p, const char* end, float* out) {
+    p = skip_spaces(p, end);
+    bool negative = false;
+    if (p < end && (*p == '-' || *p == '+'))
+        negative = *p++ == '-';
+
+    double value = 0.0;
+    while (p < end && *p >= '0' && *p <= '9')
+        value = value * 10.0 + (*p++ - '0');
+    if (p < end && *p == '.') {
+        p++;
+        double scale = 0.1;
+        while (p < end && *p >= '0' && *p <= '9') {
+            value += (*p++ - '0') * scale;
+            scale *= 0.1;
+        }
+    }
+    if (p < end && (*p == 'e' || *p == 'E')) {
+        p++;
+        bool negative_exponent = false;
+        if (p < end && (*p == '-' || *p == '+'))
+            negative_exponent = *p++ == '-';
+        int exponent = 0;
+        while (p < end && *p >= '0' && *p <= '9')
+            exponent = exponent * 10 + (*p++ - '0');
+        value *= pow(10.0, negative_exponent ? -exponent : exponent);
+    }
+
+    *out = (float)(negative ? -value : value);
+    return p;
+}
+
+static const char *parse_int(const char* p, const char* end, int* out) {
+    bool negative = false;
+    if (p < end && *p == '-') {
+        negative = true;
+        p++;
+    }
+    int value = 0;
+    while (p < end && *p >= '0' && *p <= '9')
+        value = value * 10 + (*p++ - '0');
+    *out = negative ? -value : value;
+    return p;
+}
+
+typedef struct ObjCorner {
+  int v, vt, vn;
+} ObjCorner;
+
+static uint32_t obj_hash(ObjCorner c) {
+    return ((uint32_t)c.v * 73856093u ^ (uint32_t)c.vt * 19349663u ^
+            (uint32_t)c.vn * 83492791u) * 2654435761u;
+}
+
+bool obj_load(const char* path, Mesh* mesh, LoadStats* stats) {
+    memset(stats, 0, sizeof(*stats));
+    memset(mesh, 0, sizeof(*mesh));
+
+    double start = loader_now_ms();
+    VfsFile file;
+    if (!vfs_open(&file, path))
+        return false;
+    stats->file_bytes = file.size;
+    stats->map_ms = loader_now_ms() - start;
+    start = loader_now_ms();
+
+    const char *begin = (const char *)file.data;
+    const char *end = begin + file.size;
+
+    // Count everything first so each array is allocated exactly once
+    size_t positions = 0, normals = 0, uvs = 0, triangles = 0;
+    for (const char *p = begin; p < end; p = next_line(p, end)) {
+        p = skip_spaces(p, end);
+        if (end - p < 2)
+            continue;
+        if (p[0] == 'v' && p[1] == ' ')
+            positions++;
+        else if (p[0] == 'v' && p[1] == 'n')
+            normals++;
+        else if (p[0] == 'v' && p[1] == 't')
+            uvs++;
+        else if (p[0] == 'f' && p[1] == ' ') {
+            int corners = 0;
+            const char *q = p + 1;
+            while (q < end && *q != '\n') {
+                q = skip_spaces(q, end);
+                if (q >= end || *q == '\n' || *q == '\r')
+                    break;
+                corners++;
+                while (q < end && *q != ' ' && *q != '\t' && *q != '\n')
+                    q++;
+            }
+            if (corners >= 3)
+                triangles += corners - 2;
+        }
+    }
+
+    float *position = (float *)malloc((positions + 1) * 3 * sizeof(float));
+    float *normal = (float *)malloc((normals + 1) * 3 * sizeof(float));
+    float *uv = (float *)malloc((uvs + 1) * 2 * sizeof(float));
+    size_t corner_count = triangles * 3;
+    ObjCorner *corners = (ObjCorner *)malloc(corner_count * sizeof(ObjCorner));
+    mesh->stride = LOADER_STRIDE;
+    mesh->indices = (uint32_t *)malloc(corner_count * sizeof(uint32_t));
+
+    size_t table_size = 1;
+    while (table_size < corner_count * 2)
+        table_size *= 2;
+    int *table = (int *)malloc(table_size * sizeof(int));
+    memset(table, -1, table_size * sizeof(int));
+
+    size_t np = 0, nn = 0, nt = 0;
+    for (const char *p = begin; p < end; p = next_line(p, end)) {
+        p = skip_spaces(p, end);
+        if (end - p < 2)
+            continue;
+
+        if (p[0] == 'v' && p[1] == ' ') {
+            const char *q = p + 1;
+            for (int k = 0; k < 3; k++)
+                q = parse_float(q, end, &position[np * 3 + k]);
+            np++;
+        } else if (p[0] == 'v' && p[1] == 'n') {
+            const char *q = p + 2;
+            for (int k = 0; k < 3; k++)
+                q = parse_float(q, end, &normal[nn * 3 + k]);
+            nn++;
+        } else if (p[0] == 'v' && p[1] == 't') {
+            const char *q = p + 2;
+            for (int k = 0; k < 2; k++)
+                q = parse_float(q, end, &uv[nt * 2 + k]);
+            nt++;
+        } else if (p[0] == 'f' && p[1] == ' ') {
+            // Faces are triangulated as fans around their first corner
+            ObjCorner first = {0, 0, 0}, previous = {0, 0, 0};
+            int n = 0;
+            const char *q = p + 1;
+            while (true) {
+                q = skip_spaces(q, end);
+                if (q >= end || *q == '\n' || *q == '\r')
+                    break;
+
+                // Anything that is not an index, such as a trailing comment,
+                // ends the face
+                ObjCorner c = {0, 0, 0};
+                const char *token = q;
+                q = parse_int(q, end, &c.v);
+                if (q == token || (q == token + 1 && *token == '-'))
+                    break;
+                if (q < end && *q == '/') {
+                    q++;
+                    if (q < end && *q != '/')
+                        q = parse_int(q, end, &c.vt);
+                    if (q < end && *q == '/')
+                        q = parse_int(q + 1, end, &c.vn);
+                }
+                // Negative indices count back from the current end
+                c.v = c.v < 0 ? (int)np + c.v : c.v - 1;
+                c.vt = c.vt < 0 ? (int)nt + c.vt : c.vt - 1;
+                c.vn = c.vn < 0 ? (int)nn + c.vn : c.vn - 1;
+
+                if (n == 0)
+                    first = c;
+                else if (n >= 2) {
+                    if ((size_t)mesh->index_count + 3 > corner_count)
+                        break;
+                    ObjCorner tri[3] = {first, previous, c};
+                    for (int k = 0; k < 3; k++)
+                        corners[mesh->index_count++] = tri[k];
+                }
+                previous = c;
+                n++;
+            }
+        }
+    }
+
+    // Merge corners referencing the same position/uv/normal triple. Unique
+    // corners are compacted to the front of `corners`, which never overtakes
+    // the read position, and the table maps to their output vertex.
+    int index_count = mesh->index_count;
+    mesh->index_count = 0;
+    for (int i = 0; i < index_count; i++) {
+        ObjCorner c = corners[i];
+        size_t slot = obj_hash(c) & (table_size - 1);
+        while (table[slot] >= 0) {
+            ObjCorner o = corners[table[slot]];
+            if (o.v == c.v && o.vt == c.vt && o.vn == c.vn)
+                break;
+            slot = (slot + 1) & (table_size - 1);
+        }
+
+        if (table[slot] < 0) {
+            corners[mesh->vertex_count] = c;
+            table[slot] = mesh->vertex_count++;
+        }
+        mesh->indices[mesh->index_count++] = table[slot];
+    }
+
+    // Vertices are only allocated once the unique count is known
+    mesh->vertices =
+        (float *)malloc((size_t)mesh->vertex_count * LOADER_STRIDE * sizeof(float));
+    for (int i = 0; i < mesh->vertex_count; i++) {
+        ObjCorner c = corners[i];
+        float *v = &mesh->vertices[(size_t)i * LOADER_STRIDE];
+        for (int k = 0; k < 3; k++) {
+            v[k] = c.v >= 0 && c.v < (int)np ? position[c.v * 3 + k] : 0.0f;
+            v[3 + k] = c.vn >= 0 && c.vn < (int)nn ? normal[c.vn * 3 + k] : 0.0f;
+        }
+        for (int k = 0; k < 2; k++)
+            v[6 + k] = c.vt >= 0 && c.vt < (int)nt ? uv[c.vt * 2 + k] : 0.0f;
+    }
+
+    free(table);
+    free(corners);
+    free(uv);
+    free(normal);
+    free(position);
+    vfs_close(&file);
+    stats->parse_ms = loader_now_ms() - start;
+    return true;
+}
+
+#define GLB_MAGIC 0x46546C67
+#define GLB_CHUNK_JSON 0x4E4F534A
+#define GLB_CHUNK_BIN 0x004E4942
+
+typedef struct GlbAccessor {
+  bool present;
+  size_t offset;
+  int count;
+  int components;
+  GLenum component_type;
+  int stride;
+} GlbAccessor;
+
+typedef struct GlbPrimitive {
+  const unsigned char* bin;
+  size_t bin_size;
+  GlbAccessor position;
+  GlbAccessor normal;
+  GlbAccessor uv;
+  GlbAccessor indices;
+} GlbPrimitive;
+
+static int glb_component_size(GLenum type) {
+    switch (type) {
+    case GL_UNSIGNED_BYTE:
+    case GL_BYTE:
+        return 1;
+    case GL_UNSIGNED_SHORT:
+    case GL_SHORT:
+        return 2;
+    default:
+        return 4;
+    }
+}
+
+static int glb_type_components(const JsonDoc* doc, int node) {
+    if (json_string_is(doc, node, "SCALAR"))
+        return 1;
+    if (json_string_is(doc, node, "VEC2"))
+        return 2;
+    if (json_string_is(doc, node, "VEC3"))
+        return 3;
+    if (json_string_is(doc, node, "VEC4"))
+        return 4;
+    return 0;
+}
+
+static bool glb_accessor(const JsonDoc* doc, GlbPrimitive* prim, int index,
+                         GlbAccessor* accessor) {
+    int root = 0;
+    int node = json_at(doc, json_get(doc, root, "accessors"), index);
+    if (node < 0)
+        return false;
+    int view = json_at(doc, json_get(doc, root, "bufferViews"),
+                       (int)json_number(doc, json_get(doc, node, "bufferView"), -1));
+    if (view < 0)
+        return false;
+
+    accessor->count = (int)json_number(doc, json_get(doc, node, "count"), 0);
+    accessor->components = glb_type_components(doc, json_get(doc, node, "type"));
+    accessor->component_type =
+        (GLenum)json_number(doc, json_get(doc, node, "componentType"), 0);
+    accessor->offset =
+        (size_t)json_number(doc, json_get(doc, view, "byteOffset"), 0) +
+        (size_t)json_number(doc, json_get(doc, node, "byteOffset"), 0);
+    int packed = accessor->components * glb_component_size(accessor->component_type);
+    accessor->stride =
+        (int)json_number(doc, json_get(doc, view, "byteStride"), packed);
+
+    size_t last = accessor->offset +
+                  (size_t)(accessor->count > 0 ? accessor->count - 1 : 0) *
+                      accessor->stride +
+                  packed;
+    if (accessor->components == 0 || last > prim->bin_size)
+        return false;
+    accessor->present = true;
+    return true;
+}
+
+static uint32_t glb_read_index(const GlbPrimitive* prim, int i) {
+    const unsigned char *p =
+        prim->bin + prim->indices.offset + (size_t)i * prim->indices.stride;
+    if (prim->indices.component_type == GL_UNSIGNED_BYTE)
+        return *p;
+    if (prim->indices.component_type == GL_UNSIGNED_SHORT) {
+        uint16_t v;
+        memcpy(&v, p, 2);
+        return v;
+    }
+    uint32_t v;
+    memcpy(&v, p, 4);
+    return v;
+}
+
+static bool glb_open(const VfsFile* file, const char* path, GlbPrimitive* prim) {
+    memset(prim, 0, sizeof(*prim));
+    const unsigned char *data = file->data;
+    uint32_t header[3];
+    if (file->size < 20)
+        goto invalid;
+    memcpy(header, data, sizeof(header));
+    if (header[0] != GLB_MAGIC || header[1] != 2 || header[2] > file->size)
+        goto invalid;
+
+    {
+        uint32_t json_length, json_type;
+        memcpy(&json_length, data + 12, 4);
+        memcpy(&json_type, data + 16, 4);
+        if (json_type != GLB_CHUNK_JSON || 20 + (size_t)json_length + 8 > file->size)
+            goto invalid;
+
+        size_t bin_header = 20 + json_length;
+        uint32_t bin_length, bin_type;
+        memcpy(&bin_length, data + bin_header, 4);
+        memcpy(&bin_type, data + bin_header + 4, 4);
+        if (bin_type != GLB_CHUNK_BIN || bin_header + 8 + bin_length > file->size)
+            goto invalid;
+        prim->bin = data + bin_header + 8;
+        prim->bin_size = bin_length;
+
+        JsonDoc doc;
+        if (!json_parse(&doc, (const char *)data + 20, json_length))
+            goto invalid;
+
+        int mesh = json_at(&doc, json_get(&doc, 0, "meshes"), 0);
+        int primitive = json_at(&doc, json_get(&doc, mesh, "primitives"), 0);
+        int attributes = json_get(&doc, primitive, "attributes");
+        int position = (int)json_number(&doc, json_get(&doc, attributes, "POSITION"), -1);
+        int normal = (int)json_number(&doc, json_get(&doc, attributes, "NORMAL"), -1);
+        int uv = (int)json_number(&doc, json_get(&doc, attributes, "TEXCOORD_0"), -1);
+        int indices = (int)json_number(&doc, json_get(&doc, primitive, "indices"), -1);
+
+        bool ok = glb_accessor(&doc, prim, position, &prim->position) &&
+                  prim->position.component_type == GL_FLOAT;
+        if (normal >= 0)
+            ok = ok && glb_accessor(&doc, prim, normal, &prim->normal) &&
+                 prim->normal.component_type == GL_FLOAT;
+        if (uv >= 0)
+            ok = ok && glb_accessor(&doc, prim, uv, &prim->uv) &&
+                 prim->uv.component_type == GL_FLOAT;
+        if (indices >= 0)
+            ok = ok && glb_accessor(&doc, prim, indices, &prim->indices) &&
+                 prim->indices.components == 1 &&
+                 (prim->indices.component_type == GL_UNSIGNED_BYTE ||
+                  prim->indices.component_type == GL_UNSIGNED_SHORT ||
+                  prim->indices.component_type == GL_UNSIGNED_INT);
+        json_free(&doc);
+        // Every attribute is read per vertex, so they must all have as many
+        // elements as POSITION and the layout the copy expects
+        ok = ok && prim->position.components == 3 && prim->position.count > 0;
+        if (ok && prim->normal.present)
+            ok = prim->normal.count == prim->position.count && prim->normal.components == 3;
+        if (ok && prim->uv.present)
+            ok = prim->uv.count == prim->position.count && prim->uv.components == 2;
+        if (!ok)
+            goto invalid;
+    }
+    for (int i = 0; prim->indices.present && i < prim->indices.count; i++) {
+        if (glb_read_index(prim, i) >= (uint32_t)prim->position.count) {
+            fprintf(stderr, "Error: %s has an index past its %d vertices\n", path,
+                    prim->position.count);
+            return false;
+        }
+    }
+    return true;
+
+invalid:
+    fprintf(stderr, "Error: %s is not a supported glTF binary\n", path);
+    return false;
+}
+
+static void glb_copy_attribute(const GlbPrimitive* prim, const GlbAccessor* accessor,
+                               float* out, int offset, int components) {
+    for (int i = 0; i < accessor->count; i++) {
+        float *v = &out[(size_t)i * LOADER_STRIDE + offset];
+        if (!accessor->present) {
+            memset(v, 0, components * sizeof(float));
+            continue;
+        }
+        memcpy(v, prim->bin + accessor->offset + (size_t)i * accessor->stride,
+               components * sizeof(float));
+    }
+}
+
+bool glb_load(const char* path, Mesh* mesh, LoadStats* stats) {
+    memset(stats, 0, sizeof(*stats));
+    memset(mesh, 0, sizeof(*mesh));
+
+    double start = loader_now_ms();
+    VfsFile file;
+    if (!vfs_open(&file, path))
+        return false;
+    stats->file_bytes = file.size;
+    stats->map_ms = loader_now_ms() - start;
+    start = loader_now_ms();
+
+    GlbPrimitive prim;
+    if (!glb_open(&file, path, &prim)) {
+        vfs_close(&file);
+        return false;
+    }
+
+    int count = prim.position.count;
+    mesh->stride = LOADER_STRIDE;
+    mesh->vertex_count = count;
+    mesh->vertices = (float *)malloc((size_t)count * LOADER_STRIDE * sizeof(float));
+    GlbAccessor missing = prim.position;
+    missing.present = false;
+    glb_copy_attribute(&prim, &prim.position, mesh->vertices, 0, 3);
+    glb_copy_attribute(&prim, prim.normal.present ? &prim.normal : &missing,
+                       mesh->vertices, 3, 3);
+    glb_copy_attribute(&prim, prim.uv.present ? &prim.uv : &missing,
+                       mesh->vertices, 6, 2);
+
+    mesh->index_count = prim.indices.present ? prim.indices.count : count;
+    mesh->indices = (uint32_t *)malloc(mesh->index_count * sizeof(uint32_t));
+    for (int i = 0; i < mesh->index_count; i++)
+        mesh->indices[i] = prim.indices.present ? glb_read_index(&prim, i) : i;
+
+    vfs_close(&file);
+    stats->parse_ms = loader_now_ms() - start;
+    return true;
+}
+
+static void glb_bind_attribute(GLuint location, const GlbAccessor* accessor,
+                               int components) {
+    if (!accessor->present) {
+        glDisableVertexAttribArray(location);
+        glVertexAttrib4f(location, 0.0f, 0.0f, 0.0f, 1.0f);
+        return;
+    }
+    glVertexAttribPointer(location, components, GL_FLOAT, GL_FALSE,
+                          accessor->stride, (void *)accessor->offset);
+    glEnableVertexAttribArray(location);
+}
+
+bool glb_upload(const char* path, GpuMesh* gpu, LoadStats* stats) {
+    memset(stats, 0, sizeof(*stats));
+    memset(gpu, 0, sizeof(*gpu));
+
+    double start = loader_now_ms();
+    VfsFile file;
+    if (!vfs_open(&file, path))
+        return false;
+    stats->file_bytes = file.size;
+    stats->map_ms = loader_now_ms() - start;
+    start = loader_now_ms();
+
+    GlbPrimitive prim;
+    if (!glb_open(&file, path, &prim)) {
+        vfs_close(&file);
+        return false;
+    }
+    stats->parse_ms = loader_now_ms() - start;
+    start = loader_now_ms();
+
+    // The driver copies straight out of the page cache, the file is never
+    // read into a heap buffer.
+    glGenVertexArrays(1, &gpu->vao);
+    glGenBuffers(1, gpu->buffers);
+    gpu->buffer_count = 1;
+    glBindVertexArray(gpu->vao);
+    glBindBuffer(GL_ARRAY_BUFFER, gpu->buffers[0]);
+    glBufferData(GL_ARRAY_BUFFER, prim.bin_size, prim.bin, GL_STATIC_DRAW);
+    glb_bind_attribute(0, &prim.position, 3);
+    glb_bind_attribute(1, &prim.normal, 3);
+    glb_bind_attribute(2, &prim.uv, 2);
+
+    gpu->vertex_count = prim.position.count;
+    if (prim.indices.present) {
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, gpu->buffers[0]);
+        gpu->index_type = prim.indices.component_type;
+        gpu->index_count = prim.indices.count;
+        gpu->index_offset = prim.indices.offset;
+    }
+    glBindVertexArray(0);
+
+    vfs_close(&file);
+    stats->upload_ms = loader_now_ms() - start;
+    return true;
+}
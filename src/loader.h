@@ -0,0 +1,28 @@
+#ifndef LOADER_H
+#define LOADER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "mesh.h"
+
+typedef struct LoadStats {
+  double map_ms;
+  double parse_ms;
+  double upload_ms;
+  size_t file_bytes;
+} LoadStats;
+
+// CPU loaders produce a Mesh with position, normal, texture coords (stride 8).
+// Files are memory mapped and parsed in place; OBJ is pre-scanned once so
+// every array is allocated at its final size.
+bool obj_load(const char* path, Mesh* mesh, LoadStats* stats);
+bool glb_load(const char* path, Mesh* mesh, LoadStats* stats);
+
+// Uploads the binary chunk of a .glb straight from the mapping into a single
+// GL buffer and points the attributes and indices at their accessors, so the
+// geometry is never copied on the CPU. Only the first primitive of the first
+// mesh is loaded.
+bool glb_upload(const char* path, GpuMesh* gpu, LoadStats* stats);
+
+#endif
@@ -0,0 +1,336 @@
+#include "lod.h"
+
+#include <float.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct Quadric {
+  double a2, ab, ac, ad, b2, bc, bd, c2, cd, d2;
+} Quadric;
+
+typedef struct LodEdge {
+  uint32_t from, to;
+  double cost;
+} LodEdge;
+
+static void quadric_add_plane(Quadric* q, double a, double b, double c,
+                              double d, double w) {
+    q->a2 += w * a * a;
+    q->ab += w * a * b;
+    q->ac += w * a * c;
+    q->ad += w * a * d;
+    q->b2 += w * b * b;
+    q->bc += w * b * c;
+    q->bd += w * b * d;
+    q->c2 += w * c * c;
+    q->cd += w * c * d;
+    q->d2 += w * d * d;
+}
+
+static void quadric_add(Quadric* r, const Quadric* a, const Quadric* b) {
+    const double *pa = (const double *)a, *pb = (const double *)b;
+    double *pr = (double *)r;
+    for (int i = 0; i < 10; i++)
+        pr[i] = pa[i] + pb[i];
+}
+
+static double quadric_eval(const Quadric* q, const float* p) {
+    double x = p[0], y = p[1], z = p[2];
+    double e = q->a2 * x * x + 2 * q->ab * x * y + 2 * q->ac * x * z +
+               2 * q->ad * x + q->b2 * y * y + 2 * q->bc * y * z +
+               2 * q->bd * y + q->c2 * z * z + 2 * q->cd * z + q->d2;
+    return e > 0.0 ? e : 0.0;
+}
+
+static const float *lod_pos(const Mesh* mesh, uint32_t v) {
+    return &mesh->vertices[v * mesh->stride];
+}
+
+static void lod_normal(const float* a, const float* b, const float* c, vec3 n) {
+    vec3 e1 = {b[0] - a[0], b[1] - a[1], b[2] - a[2]};
+    vec3 e2 = {c[0] - a[0], c[1] - a[1], c[2] - a[2]};
+    vec3_mul_cross(n, e1, e2);
+}
+
+static int compare_u64(const void* a, const void* b) {
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+static int compare_edge(const void* a, const void* b) {
+    double x = ((const LodEdge *)a)->cost, y = ((const LodEdge *)b)->cost;
+    return x < y ? -1 : x > y;
+}
+
+static void lod_build_quadrics(const Mesh* mesh, const uint32_t* indices,
+                               int index_count, Quadric* quadrics) {
+    memset(quadrics, 0, mesh->vertex_count * sizeof(Quadric));
+
+    for (int i = 0; i < index_count; i += 3) {
+        const float *p[3] = {lod_pos(mesh, indices[i]),
+                             lod_pos(mesh, indices[i + 1]),
+                             lod_pos(mesh, indices[i + 2])};
+        vec3 n;
+        lod_normal(p[0], p[1], p[2], n);
+        float len = vec3_len(n);
+        if (len <= 0.0f)
+            continue;
+        vec3_scale(n, n, 1.0f / len);
+        double d = -(n[0] * p[0][0] + n[1] * p[0][1] + n[2] * p[0][2]);
+        for (int k = 0; k < 3; k++)
+            quadric_add_plane(&quadrics[indices[i + k]], n[0], n[1], n[2], d, 1.0);
+    }
+
+    // Edges used by a single triangle are borders or attribute seams. They
+    // get a heavily weighted plane perpendicular to the face so collapses
+    // along them are preferred over collapses away from them.
+    int edge_count = index_count;
+    uint64_t *edges = (uint64_t *)malloc(edge_count * sizeof(uint64_t));
+    for (int i = 0; i < index_count; i += 3) {
+        for (int k = 0; k < 3; k++) {
+            uint32_t a = indices[i + k], b = indices[i + (k + 1) % 3];
+            uint32_t lo = a < b ? a : b, hi = a < b ? b : a;
+            edges[i + k] = (uint64_t)lo << 32 | hi;
+        }
+    }
+    uint64_t *sorted = (uint64_t *)malloc(edge_count * sizeof(uint64_t));
+    memcpy(sorted, edges, edge_count * sizeof(uint64_t));
+    qsort(sorted, edge_count, sizeof(uint64_t), compare_u64);
+
+    for (int i = 0; i < index_count; i += 3) {
+        const float *p[3] = {lod_pos(mesh, indices[i]),
+                             lod_pos(mesh, indices[i + 1]),
+                             lod_pos(mesh, indices[i + 2])};
+        vec3 n;
+        lod_normal(p[0], p[1], p[2], n);
+        for (int k = 0; k < 3; k++) {
+            uint64_t key = edges[i + k];
+            uint64_t *found = (uint64_t *)bsearch(&key, sorted, edge_count,
+                                                  sizeof(uint64_t), compare_u64);
+            if ((found > sorted && found[-1] == key) ||
+                (found + 1 < sorted + edge_count && found[1] == key))
+                continue;
+
+            const float *a = p[k], *b = p[(k + 1) % 3];
+            vec3 e = {b[0] - a[0], b[1] - a[1], b[2] - a[2]}, m;
+            vec3_mul_cross(m, e, n);
+            float len = vec3_len(m);
+            if (len <= 0.0f)
+                continue;
+            vec3_scale(m, m, 1.0f / len);
+            double d = -(m[0] * a[0] + m[1] * a[1] + m[2] * a[2]);
+            quadric_add_plane(&quadrics[indices[i + k]], m[0], m[1], m[2], d, 10.0);
+            quadric_add_plane(&quadrics[indices[i + (k + 1) % 3]], m[0], m[1],
+                              m[2], d, 10.0);
+        }
+    }
+    free(sorted);
+    free(edges);
+}
+
+// Collapsing `from` onto `to` must not turn any remaining triangle around
+static bool lod_collapse_flips(const Mesh* mesh, const uint32_t* indices,
+                               const int* adjacency, const int* adjacency_start,
+                               const uint32_t* remap, uint32_t from, uint32_t to) {
+    const float *target = lod_pos(mesh, to);
+    for (int i = adjacency_start[from]; i < adjacency_start[from + 1]; i++) {
+        const uint32_t *tri = &indices[adjacency[i] * 3];
+        uint32_t v[3] = {remap[tri[0]], remap[tri[1]], remap[tri[2]]};
+        if (v[0] == to || v[1] == to || v[2] == to)
+            continue;
+
+        const float *p[3], *q[3];
+        for (int k = 0; k < 3; k++) {
+            p[k] = lod_pos(mesh, v[k]);
+            q[k] = v[k] == from ? target : p[k];
+        }
+        vec3 before, after;
+        lod_normal(p[0], p[1], p[2], before);
+        lod_normal(q[0], q[1], q[2], after);
+        if (vec3_mul_inner(before, after) <= 0.0f)
+            return true;
+    }
+    return false;
+}
+
+int lod_simplify(const Mesh* mesh, const uint32_t* indices, int index_count,
+                 int target_index_count, uint32_t* out, float* error) {
+    int vertex_count = mesh->vertex_count;
+    Quadric *quadrics = (Quadric *)malloc(vertex_count * sizeof(Quadric));
+    uint32_t *remap = (uint32_t *)malloc(vertex_count * sizeof(uint32_t));
+    bool *locked = (bool *)malloc(vertex_count * sizeof(bool));
+    int *adjacency_start = (int *)malloc((vertex_count + 1) * sizeof(int));
+    int *adjacency = (int *)malloc(index_count * sizeof(int));
+    LodEdge *edges = (LodEdge *)malloc(index_count * sizeof(LodEdge));
+
+    lod_build_quadrics(mesh, indices, index_count, quadrics);
+    memcpy(out, indices, index_count * sizeof(uint32_t));
+    int count = index_count;
+    double max_cost = 0.0;
+
+    while (count > target_index_count) {
+        int triangles = count / 3;
+
+        // Vertex to triangle adjacency for the flip test
+        memset(adjacency_start, 0, (vertex_count + 1) * sizeof(int));
+        for (int i = 0; i < count; i++)
+            adjacency_start[out[i] + 1]++;
+        for (int v = 0; v < vertex_count; v++)
+            adjacency_start[v + 1] += adjacency_start[v];
+        for (int i = 0; i < count; i++)
+            adjacency[adjacency_start[out[i]]++] = i / 3;
+        for (int v = vertex_count; v > 0; v--)
+            adjacency_start[v] = adjacency_start[v - 1];
+        adjacency_start[0] = 0;
+
+        // Cheapest direction of every edge
+        int edge_count = 0;
+        for (int i = 0; i < count; i += 3) {
+            for (int k = 0; k < 3; k++) {
+                uint32_t a = out[i + k], b = out[i + (k + 1) % 3];
+                if (a > b)
+                    continue;
+                Quadric q;
+                quadric_add(&q, &quadrics[a], &quadrics[b]);
+                double to_b = quadric_eval(&q, lod_pos(mesh, b));
+                double to_a = quadric_eval(&q, lod_pos(mesh, a));
+                LodEdge *edge = &edges[edge_count++];
+                edge->from = to_b <= to_a ? a : b;
+                edge->to = to_b <= to_a ? b : a;
+                edge->cost = to_b <= to_a ? to_b : to_a;
+            }
+        }
+        qsort(edges, edge_count, sizeof(LodEdge), compare_edge);
+
+        for (int v = 0; v < vertex_count; v++) {
+            remap[v] = v;
+            locked[v] = false;
+        }
+
+        // Each collapse removes about two triangles, vertices touched by a
+        // collapse are locked until the next pass rebuilds adjacency.
+        int wanted = (triangles - target_index_count / 3 + 1) / 2;
+        int collapses = 0;
+        for (int i = 0; i < edge_count && collapses < wanted; i++) {
+            LodEdge *edge = &edges[i];
+            if (locked[edge->from] || locked[edge->to])
+                continue;
+            if (lod_collapse_flips(mesh, out, adjacency, adjacency_start, remap,
+                                   edge->from, edge->to))
+                continue;
+
+            remap[edge->from] = edge->to;
+            quadric_add(&quadrics[edge->to], &quadrics[edge->to],
+                        &quadrics[edge->from]);
+            locked[edge->from] = true;
+            locked[edge->to] = true;
+            if (edge->cost > max_cost)
+                max_cost = edge->cost;
+            collapses++;
+        }
+        if (collapses == 0)
+            break;
+
+        int kept = 0;
+        for (int i = 0; i < count; i += 3) {
+            uint32_t a = remap[out[i]], b = remap[out[i + 1]], c = remap[out[i + 2]];
+            if (a == b || b == c || a == c)
+                continue;
+            out[kept++] = a;
+            out[kept++] = b;
+            out[kept++] = c;
+        }
+        count = kept;
+    }
+
+    free(edges);
+    free(adjacency);
+    free(adjacency_start);
+    free(locked);
+    free(remap);
+    free(quadrics);
+
+    *error = (float)sqrt(max_cost);
+    return count;
+}
+
+void lod_chain_build(LodChain* chain, const Mesh* mesh, int max_levels,
+                     float reduction) {
+    memset(chain, 0, sizeof(*chain));
+    if (max_levels > LOD_MAX_LEVELS)
+        max_levels = LOD_MAX_LEVELS;
+    mesh_bounds(mesh, chain->center, &chain->radius);
+
+    // Every level is at most the size of the source, so this is an upper
+    // bound for the concatenated index list.
+    chain->indices =
+        (uint32_t *)malloc((size_t)mesh->index_count * max_levels * sizeof(uint32_t));
+    memcpy(chain->indices, mesh->indices, mesh->index_count * sizeof(uint32_t));
+    chain->levels[0].first_index = 0;
+    chain->levels[0].index_count = mesh->index_count;
+    chain->levels[0].error = 0.0f;
+    chain->index_count = mesh->index_count;
+    chain->level_count = 1;
+
+    while (chain->level_count < max_levels) {
+        const LodLevel *previous = &chain->levels[chain->level_count - 1];
+        int target = (int)(previous->index_count / 3 * reduction) * 3;
+        if (target < 3)
+            break;
+
+        LodLevel *level = &chain->levels[chain->level_count];
+        level->first_index = chain->index_count;
+        level->index_count = lod_simplify(
+            mesh, &chain->indices[previous->first_index], previous->index_count,
+            target, &chain->indices[level->first_index], &level->error);
+
+        // Stop once the simplifier cannot make meaningful progress
+        if (level->index_count > previous->index_count * 0.95f)
+            break;
+        if (level->error < previous->error)
+            level->error = previous->error;
+        chain->index_count += level->index_count;
+        chain->level_count++;
+    }
+}
+
+void lod_chain_free(LodChain* chain) {
+    free(chain->indices);
+    memset(chain, 0, sizeof(*chain));
+}
+
+float lod_screen_radius(const vec3 center, float radius, mat4x4 view,
+                        float proj_scale, float viewport_height) {
+    vec4 world = {center[0], center[1], center[2], 1.0f}, eye;
+    mat4x4_mul_vec4(eye, view, world);
+    float distance = sqrtf(eye[0] * eye[0] + eye[1] * eye[1] + eye[2] * eye[2]);
+    if (distance <= radius)
+        return FLT_MAX;
+    return radius / distance * proj_scale * viewport_height * 0.5f;
+}
+
+int lod_select(const LodChain* chain, int current, float screen_radius,
+               float max_error_px, float hysteresis) {
+    float pixels_per_unit = chain->radius > 0.0f ? screen_radius / chain->radius : 0.0f;
+    float strict = max_error_px * (1.0f - hysteresis);
+
+    int best = 0, best_strict = 0;
+    for (int i = chain->level_count - 1; i >= 0; i--) {
+        if (chain->levels[i].error * pixels_per_unit <= max_error_px) {
+            best = i;
+            break;
+        }
+    }
+    for (int i = chain->level_count - 1; i >= 0; i--) {
+        if (chain->levels[i].error * pixels_per_unit <= strict) {
+            best_strict = i;
+            break;
+        }
+    }
+
+    if (best < current)
+        return best;
+    return best_strict > current ? best_strict : current;
+}
@@ -0,0 +1,52 @@
+#ifndef LOD_H
+#define LOD_H
+
+#include <stdint.h>
+
+#include "linmath.h"
+#include "mesh.h"
+
+#define LOD_MAX_LEVELS 8
+
+typedef struct LodLevel {
+  int first_index;
+  int index_count;
+  float error;
+} LodLevel;
+
+// All levels share the source vertex buffer, only the index lists differ,
+// so a chain is uploaded as one vertex buffer and one index buffer.
+typedef struct LodChain {
+  uint32_t* indices;
+  int index_count;
+  LodLevel levels[LOD_MAX_LEVELS];
+  int level_count;
+  vec3 center;
+  float radius;
+} LodChain;
+
+// Quadric error metric edge collapse onto existing vertices. Writes at most
+// `index_count` indices to `out` and returns how many were kept. `error`
+// receives the largest collapse error in mesh units.
+int lod_simplify(const Mesh* mesh, const uint32_t* indices, int index_count,
+                 int target_index_count, uint32_t* out, float* error);
+
+// Level 0 is the source mesh, each further level aims for `reduction` of the
+// previous triangle count.
+void lod_chain_build(LodChain* chain, const Mesh* mesh, int max_levels,
+                     float reduction);
+void lod_chain_free(LodChain* chain);
+
+// Projected radius in pixels of a bounding sphere. `proj_scale` is
+// projection[1][1] of the camera projection.
+float lod_screen_radius(const vec3 center, float radius, mat4x4 view,
+                        float proj_scale, float viewport_height);
+
+// Picks the coarsest level whose error stays below `max_error_px` on screen.
+// Moving to a coarser level requires the error to be below
+// `max_error_px * (1 - hysteresis)`, which keeps objects near a threshold
+// from flickering between levels.
+int lod_select(const LodChain* chain, int current, float screen_radius,
+               float max_error_px, float hysteresis);
+
+#endif
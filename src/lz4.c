@@ -0,0 +1,169 @@
+#include "lz4.h"
+
+#include <stdint.h>
+#include <string.h>
+
+#define LZ4_HASH_BITS 14
+#define LZ4_MIN_MATCH 4
+#define LZ4_MF_LIMIT 12
+#define LZ4_LAST_LITERALS 5
+#define LZ4_MAX_DISTANCE 65535
+
+static uint32_t lz4_read32(const unsigned char* p) {
+    uint32_t v;
+    memcpy(&v, p, 4);
+    return v;
+}
+
+static uint32_t lz4_hash(uint32_t sequence) {
+    return (sequence * 2654435761u) >> (32 - LZ4_HASH_BITS);
+}
+
+static unsigned char *lz4_write_length(unsigned char* op, size_t length) {
+    while (length >= 255) {
+        *op++ = 255;
+        length -= 255;
+    }
+    *op++ = (unsigned char)length;
+    return op;
+}
+
+// Copies in 8 byte steps and may write up to 7 bytes past `length`
+static void lz4_wild_copy(unsigned char* dst, const unsigned char* src,
+                          size_t length) {
+    unsigned char *end = dst + length;
+    do {
+        memcpy(dst, src, 8);
+        dst += 8;
+        src += 8;
+    } while (dst < end);
+}
+
+size_t lz4_compress_bound(size_t size) {
+    return size + size / 255 + 16;
+}
+
+static unsigned char *lz4_emit(unsigned char* op, const unsigned char* literals,
+                               size_t literal_length, size_t offset,
+                               size_t match_length) {
+    unsigned char *token = op++;
+    *token = (unsigned char)((literal_length >= 15 ? 15 : literal_length) << 4);
+    if (literal_length >= 15)
+        op = lz4_write_length(op, literal_length - 15);
+    memcpy(op, literals, literal_length);
+    op += literal_length;
+
+    if (match_length == 0)
+        return op;
+    *op++ = (unsigned char)(offset & 0xff);
+    *op++ = (unsigned char)(offset >> 8);
+    size_t extra = match_length - LZ4_MIN_MATCH;
+    *token |= (unsigned char)(extra >= 15 ? 15 : extra);
+    if (extra >= 15)
+        op = lz4_write_length(op, extra - 15);
+    return op;
+}
+
+size_t lz4_compress(const unsigned char* src, size_t size, unsigned char* dst,
+                    size_t capacity) {
+    if (capacity < lz4_compress_bound(size))
+        return 0;
+
+    uint32_t table[1 << LZ4_HASH_BITS];
+    memset(table, 0, sizeof(table));
+    unsigned char *op = dst;
+    size_t anchor = 0, ip = 0;
+
+    // Greedy single-probe matcher, positions are stored +1 so 0 means empty
+    while (size > LZ4_MF_LIMIT && ip < size - LZ4_MF_LIMIT) {
+        uint32_t sequence = lz4_read32(src + ip);
+        uint32_t h = lz4_hash(sequence);
+        size_t candidate = table[h];
+        table[h] = (uint32_t)(ip + 1);
+
+        if (candidate == 0 || ip - (candidate - 1) > LZ4_MAX_DISTANCE ||
+            lz4_read32(src + candidate - 1) != sequence) {
+            ip++;
+            continue;
+        }
+
+        size_t ref = candidate - 1;
+        size_t length = LZ4_MIN_MATCH;
+        while (ip + length < size - LZ4_LAST_LITERALS &&
+               src[ref + length] == src[ip + length])
+            length++;
+
+        op = lz4_emit(op, src + anchor, ip - anchor, ip - ref, length);
+        ip += length;
+        anchor = ip;
+    }
+
+    op = lz4_emit(op, src + anchor, size - anchor, 0, 0);
+    return op - dst;
+}
+
+long lz4_decompress(const unsigned char* src, size_t size, unsigned char* dst,
+                    size_t capacity) {
+    const unsigned char *ip = src, *end = src + size;
+    unsigned char *op = dst, *out_end = dst + capacity;
+
+    while (ip < end) {
+        unsigned token = *ip++;
+
+        size_t literal_length = token >> 4;
+        if (literal_length == 15) {
+            unsigned char b;
+            do {
+                if (ip >= end)
+                    return -1;
+                b = *ip++;
+                literal_length += b;
+            } while (b == 255);
+        }
+        if (literal_length > (size_t)(end - ip) ||
+            literal_length > (size_t)(out_end - op))
+            return -1;
+        if (end - ip >= (long)literal_length + 8 &&
+            out_end - op >= (long)literal_length + 8)
+            lz4_wild_copy(op, ip, literal_length);
+        else
+            memcpy(op, ip, literal_length);
+        ip += literal_length;
+        op += literal_length;
+
+        // The last sequence only has literals
+        if (ip == end)
+            break;
+
+        if (end - ip < 2)
+            return -1;
+        size_t offset = ip[0] | (ip[1] << 8);
+        ip += 2;
+        if (offset == 0 || offset > (size_t)(op - dst))
+            return -1;
+
+        size_t match_length = token & 15;
+        if (match_length == 15) {
+            unsigned char b;
+            do {
+                if (ip >= end)
+                    return -1;
+                b = *ip++;
+                match_length += b;
+            } while (b == 255);
+        }
+        match_length += LZ4_MIN_MATCH;
+        if (match_length > (size_t)(out_end - op))
+            return -1;
+
+        // Overlapping copies repeat the pattern, so short offsets go byte-wise
+        const unsigned char *match = op - offset;
+        if (offset >= 8 && out_end - op >= (long)match_length + 8)
+            lz4_wild_copy(op, match, match_length);
+        else
+            for (size_t i = 0; i < match_length; i++)
+                op[i] = match[i];
+        op += match_length;
+    }
+    return op - dst;
+}
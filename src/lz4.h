@@ -0,0 +1,17 @@
+#ifndef LZ4_H
+#define LZ4_H
+
+#include <stddef.h>
+
+// LZ4 block format, compatible with the reference LZ4_compress_default and
+// LZ4_decompress_safe (no frame header, no checksums).
+size_t lz4_compress_bound(size_t size);
+size_t lz4_compress(const unsigned char* src, size_t size, unsigned char* dst,
+                    size_t capacity);
+
+// Returns the decompressed size, or -1 when the input is malformed or does
+// not fit in `capacity`.
+long lz4_decompress(const unsigned char* src, size_t size, unsigned char* dst,
+                    size_t capacity);
+
+#endif
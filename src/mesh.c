@@ -0,0 +1,130 @@
+#include "mesh.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+static uint32_t mesh_hash_vertex(const float* v, int stride) {
+    uint32_t h = 2166136261u;
+    const unsigned char *bytes = (const unsigned char *)v;
+    for (size_t i = 0; i < stride * sizeof(float); i++) {
+        h ^= bytes[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+void mesh_from_triangles(Mesh* mesh, const float* vertices, int vertex_count,
+                         int stride) {
+    memset(mesh, 0, sizeof(*mesh));
+    mesh->stride = stride;
+    mesh->vertices = (float *)malloc(vertex_count * stride * sizeof(float));
+    mesh->indices = (uint32_t *)malloc(vertex_count * sizeof(uint32_t));
+
+    int table_size = 1;
+    while (table_size < vertex_count * 2)
+        table_size *= 2;
+    int *table = (int *)malloc(table_size * sizeof(int));
+    memset(table, -1, table_size * sizeof(int));
+
+    for (int i = 0; i < vertex_count; i++) {
+        const float *v = &vertices[i * stride];
+        uint32_t slot = mesh_hash_vertex(v, stride) & (table_size - 1);
+        while (table[slot] >= 0 &&
+               memcmp(&mesh->vertices[table[slot] * stride], v,
+                      stride * sizeof(float)) != 0)
+            slot = (slot + 1) & (table_size - 1);
+
+        if (table[slot] < 0) {
+            table[slot] = mesh->vertex_count;
+            memcpy(&mesh->vertices[mesh->vertex_count * stride], v,
+                   stride * sizeof(float));
+            mesh->vertex_count++;
+        }
+        mesh->indices[mesh->index_count++] = table[slot];
+    }
+    free(table);
+}
+
+void mesh_free(Mesh* mesh) {
+    free(mesh->vertices);
+    free(mesh->indices);
+    memset(mesh, 0, sizeof(*mesh));
+}
+
+void mesh_bounds(const Mesh* mesh, vec3 center, float* radius) {
+    vec3 lo = {INFINITY, INFINITY, INFINITY};
+    vec3 hi = {-INFINITY, -INFINITY, -INFINITY};
+    for (int i = 0; i < mesh->vertex_count; i++) {
+        const float *p = &mesh->vertices[i * mesh->stride];
+        for (int k = 0; k < 3; k++) {
+            lo[k] = fminf(lo[k], p[k]);
+            hi[k] = fmaxf(hi[k], p[k]);
+        }
+    }
+
+    vec3_add(center, lo, hi);
+    vec3_scale(center, center, 0.5f);
+    float r2 = 0.0f;
+    for (int i = 0; i < mesh->vertex_count; i++) {
+        const float *p = &mesh->vertices[i * mesh->stride];
+        float dx = p[0] - center[0], dy = p[1] - center[1], dz = p[2] - center[2];
+        r2 = fmaxf(r2, dx * dx + dy * dy + dz * dz);
+    }
+    *radius = sqrtf(r2);
+}
+
+void gpu_mesh_upload(GpuMesh* gpu, const Mesh* mesh) {
+    memset(gpu, 0, sizeof(*gpu));
+    gpu->buffer_count = 2;
+    gpu->index_type = GL_UNSIGNED_INT;
+    gpu->index_count = mesh->index_count;
+    gpu->vertex_count = mesh->vertex_count;
+
+    glGenVertexArrays(1, &gpu->vao);
+    glGenBuffers(2, gpu->buffers);
+    glBindVertexArray(gpu->vao);
+
+    glBindBuffer(GL_ARRAY_BUFFER, gpu->buffers[0]);
+    glBufferData(GL_ARRAY_BUFFER,
+                 (GLsizeiptr)mesh->vertex_count * mesh->stride * sizeof(float),
+                 mesh->vertices, GL_STATIC_DRAW);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, gpu->buffers[1]);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER,
+                 (GLsizeiptr)mesh->index_count * sizeof(uint32_t),
+                 mesh->indices, GL_STATIC_DRAW);
+
+    GLsizei stride = mesh->stride * sizeof(float);
+    // Position attribute
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, (void *)0);
+    glEnableVertexAttribArray(0);
+    // Normal attribute
+    if (mesh->stride >= 6) {
+        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, stride,
+                              (void *)(3 * sizeof(float)));
+        glEnableVertexAttribArray(1);
+    }
+    // Texture coordinate attribute
+    if (mesh->stride >= 8) {
+        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, stride,
+                              (void *)(6 * sizeof(float)));
+        glEnableVertexAttribArray(2);
+    }
+    glBindVertexArray(0);
+}
+
+void gpu_mesh_draw(const GpuMesh* gpu) {
+    glBindVertexArray(gpu->vao);
+    if (gpu->index_count == 0) {
+        glDrawArrays(GL_TRIANGLES, 0, gpu->vertex_count);
+        return;
+    }
+    glDrawElements(GL_TRIANGLES, gpu->index_count, gpu->index_type,
+                   (void *)gpu->index_offset);
+}
+
+void gpu_mesh_destroy(GpuMesh* gpu) {
+    glDeleteBuffers(gpu->buffer_count, gpu->buffers);
+    glDeleteVertexArrays(1, &gpu->vao);
+    memset(gpu, 0, sizeof(*gpu));
+}
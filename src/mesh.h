@@ -0,0 +1,46 @@
+#ifndef MESH_H
+#define MESH_H
+
+#include <glad/gl.h>
+
+#include <stdint.h>
+
+#include "linmath.h"
+
+// Indexed triangle mesh. Each vertex is `stride` floats with the position in
+// the first three.
+typedef struct Mesh {
+  float* vertices;
+  uint32_t* indices;
+  int vertex_count;
+  int index_count;
+  int stride;
+} Mesh;
+
+// Builds an indexed mesh from a flat triangle list such as
+// CUBE_VERTICES_POS_NORM_TEXT, merging identical vertices.
+void mesh_from_triangles(Mesh* mesh, const float* vertices, int vertex_count,
+                         int stride);
+void mesh_free(Mesh* mesh);
+
+void mesh_bounds(const Mesh* mesh, vec3 center, float* radius);
+
+// Geometry resident in GL buffers. Attributes are bound to locations 0
+// (position), 1 (normal) and 2 (texture coords).
+typedef struct GpuMesh {
+  GLuint vao;
+  GLuint buffers[2];
+  int buffer_count;
+  GLenum index_type;
+  int index_count;
+  size_t index_offset;
+  int vertex_count;
+} GpuMesh;
+
+// Uploads a mesh with position, normal, texture coords layout. Strides of 3
+// or 6 leave the missing attributes disabled.
+void gpu_mesh_upload(GpuMesh* gpu, const Mesh* mesh);
+void gpu_mesh_draw(const GpuMesh* gpu);
+void gpu_mesh_destroy(GpuMesh* gpu);
+
+#endif
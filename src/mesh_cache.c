@@ -0,0 +1,176 @@
+#include "mesh_cache.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static uint64_t cache_align(uint64_t offset) {
+    return (offset + MESH_CACHE_ALIGN - 1) & ~(uint64_t)(MESH_CACHE_ALIGN - 1);
+}
+
+static bool cache_put(FILE* f, uint64_t* cursor, uint64_t* offset,
+                      const void* data, size_t size) {
+    static const unsigned char zeros[MESH_CACHE_ALIGN] = {0};
+    uint64_t aligned = cache_align(*cursor);
+    if (aligned > *cursor && fwrite(zeros, aligned - *cursor, 1, f) != 1)
+        return false;
+    *offset = size ? aligned : 0;
+    *cursor = aligned + size;
+    return size == 0 || fwrite(data, size, 1, f) == 1;
+}
+
+bool mesh_cache_write(const char* path, const Mesh* mesh, const LodChain* lod,
+                      const MeshletSet* meshlets) {
+    FILE *f = fopen(path, "wb");
+    if (!f) {
+        fprintf(stderr, "Error: cannot write %s\n", path);
+        return false;
+    }
+
+    MeshCacheHeader header;
+    memset(&header, 0, sizeof(header));
+    header.magic = MESH_CACHE_MAGIC;
+    header.version = MESH_CACHE_VERSION;
+    header.vertex_stride = mesh->stride;
+    header.vertex_count = mesh->vertex_count;
+    mesh_bounds(mesh, header.center, &header.radius);
+
+    LodLevel single = {0, mesh->index_count, 0.0f};
+    const uint32_t *indices = lod ? lod->indices : mesh->indices;
+    const LodLevel *levels = lod ? lod->levels : &single;
+    header.index_count = lod ? lod->index_count : mesh->index_count;
+    header.lod_count = lod ? lod->level_count : 1;
+
+    if (meshlets) {
+        header.meshlet_count = meshlets->meshlet_count;
+        header.meshlet_vertex_count = meshlets->vertex_count;
+        header.meshlet_triangle_count = meshlets->triangle_count;
+        header.meshlet_index_count = meshlets->index_count;
+    }
+
+    // Header goes first with placeholder offsets and is rewritten at the end
+    uint64_t cursor = 0, unused;
+    bool ok = cache_put(f, &cursor, &unused, &header, sizeof(header));
+    ok = ok && cache_put(f, &cursor, &header.vertex_offset, mesh->vertices,
+                         (size_t)mesh->vertex_count * mesh->stride * sizeof(float));
+    ok = ok && cache_put(f, &cursor, &header.index_offset, indices,
+                         (size_t)header.index_count * sizeof(uint32_t));
+    ok = ok && cache_put(f, &cursor, &header.lod_offset, levels,
+                         header.lod_count * sizeof(LodLevel));
+    if (meshlets) {
+        ok = ok && cache_put(f, &cursor, &header.meshlet_offset, meshlets->meshlets,
+                             meshlets->meshlet_count * sizeof(Meshlet));
+        ok = ok && cache_put(f, &cursor, &header.meshlet_vertex_offset,
+                             meshlets->vertices,
+                             meshlets->vertex_count * sizeof(uint32_t));
+        ok = ok && cache_put(f, &cursor, &header.meshlet_triangle_offset,
+                             meshlets->triangles, meshlets->triangle_count * 3);
+        ok = ok && cache_put(f, &cursor, &header.meshlet_index_offset,
+                             meshlets->indices,
+                             meshlets->index_count * sizeof(uint32_t));
+    }
+
+    ok = ok && fseek(f, 0, SEEK_SET) == 0 &&
+         fwrite(&header, sizeof(header), 1, f) == 1;
+    ok = fclose(f) == 0 && ok;
+    if (!ok)
+        fprintf(stderr, "Error: failed writing %s\n", path);
+    return ok;
+}
+
+static bool cache_range_ok(const VfsFile* file, uint64_t offset, size_t size) {
+    return size == 0 || (offset % MESH_CACHE_ALIGN == 0 && offset <= file->size &&
+                         size <= file->size - offset);
+}
+
+static bool cache_slice_ok(uint64_t first, uint64_t count, uint64_t total) {
+    return first <= total && count <= total - first;
+}
+
+bool mesh_cache_open(MeshCache* cache, const char* path) {
+    memset(cache, 0, sizeof(*cache));
+    if (!vfs_open(&cache->file, path))
+        return false;
+
+    const VfsFile *file = &cache->file;
+    const MeshCacheHeader *h = (const MeshCacheHeader *)file->data;
+    bool ok = file->size >= sizeof(*h) && h->magic == MESH_CACHE_MAGIC &&
+              h->version == MESH_CACHE_VERSION && h->lod_count > 0 &&
+              h->lod_count <= LOD_MAX_LEVELS;
+    ok = ok && cache_range_ok(file, h->vertex_offset,
+                              (size_t)h->vertex_count * h->vertex_stride * sizeof(float));
+    ok = ok && cache_range_ok(file, h->index_offset,
+                              (size_t)h->index_count * sizeof(uint32_t));
+    ok = ok && cache_range_ok(file, h->lod_offset, h->lod_count * sizeof(LodLevel));
+    ok = ok && cache_range_ok(file, h->meshlet_offset,
+                              (size_t)h->meshlet_count * sizeof(Meshlet));
+    ok = ok && cache_range_ok(file, h->meshlet_vertex_offset,
+                              (size_t)h->meshlet_vertex_count * sizeof(uint32_t));
+    ok = ok && cache_range_ok(file, h->meshlet_triangle_offset,
+                              (size_t)h->meshlet_triangle_count * 3);
+    ok = ok && cache_range_ok(file, h->meshlet_index_offset,
+                              (size_t)h->meshlet_index_count * sizeof(uint32_t));
+
+    // Every level and meshlet has to stay inside the blobs it points into
+    const LodLevel *lods = (const LodLevel *)(file->data + h->lod_offset);
+    for (uint32_t i = 0; ok && i < h->lod_count; i++)
+        ok = lods[i].first_index >= 0 && lods[i].index_count >= 0 &&
+             cache_slice_ok(lods[i].first_index, lods[i].index_count, h->index_count);
+    const Meshlet *meshlets = (const Meshlet *)(file->data + h->meshlet_offset);
+    for (uint32_t i = 0; ok && i < h->meshlet_count; i++)
+        ok = cache_slice_ok(meshlets[i].vertex_offset, meshlets[i].vertex_count,
+                            h->meshlet_vertex_count) &&
+             cache_slice_ok(meshlets[i].triangle_offset, meshlets[i].triangle_count,
+                            h->meshlet_triangle_count) &&
+             cache_slice_ok(meshlets[i].first_index, meshlets[i].triangle_count * 3u,
+                            h->meshlet_index_count);
+    if (!ok) {
+        fprintf(stderr, "Error: %s is not a valid mesh cache\n", path);
+        vfs_close(&cache->file);
+        return false;
+    }
+
+    const unsigned char *base = file->data;
+    cache->header = h;
+
+    // Level 0 doubles as the plain mesh index list
+    const LodLevel *levels = (const LodLevel *)(base + h->lod_offset);
+    cache->mesh.stride = h->vertex_stride;
+    cache->mesh.vertex_count = h->vertex_count;
+    cache->mesh.vertices = (float *)(base + h->vertex_offset);
+    cache->mesh.indices = (uint32_t *)(base + h->index_offset);
+    cache->mesh.index_count = levels[0].index_count;
+
+    cache->lod.indices = cache->mesh.indices;
+    cache->lod.index_count = h->index_count;
+    cache->lod.level_count = h->lod_count;
+    memcpy(cache->lod.levels, levels, h->lod_count * sizeof(LodLevel));
+    memcpy(cache->lod.center, h->center, sizeof(h->center));
+    cache->lod.radius = h->radius;
+
+    if (h->meshlet_count > 0) {
+        cache->meshlets.meshlets = (Meshlet *)(base + h->meshlet_offset);
+        cache->meshlets.meshlet_count = h->meshlet_count;
+        cache->meshlets.vertices = (uint32_t *)(base + h->meshlet_vertex_offset);
+        cache->meshlets.vertex_count = h->meshlet_vertex_count;
+        cache->meshlets.triangles = (uint8_t *)(base + h->meshlet_triangle_offset);
+        cache->meshlets.triangle_count = h->meshlet_triangle_count;
+        cache->meshlets.indices = (uint32_t *)(base + h->meshlet_index_offset);
+        cache->meshlets.index_count = h->meshlet_index_count;
+    }
+    return true;
+}
+
+void mesh_cache_close(MeshCache* cache) {
+    vfs_close(&cache->file);
+    memset(cache, 0, sizeof(*cache));
+}
+
+void mesh_cache_upload(const MeshCache* cache, GpuMesh* gpu) {
+    // gpu_mesh_upload only reads the mesh, the mapping is handed to the driver
+    // without an intermediate copy.
+    Mesh all_levels = cache->mesh;
+    all_levels.index_count = cache->lod.index_count;
+    gpu_mesh_upload(gpu, &all_levels);
+    gpu->index_count = cache->mesh.index_count;
+}
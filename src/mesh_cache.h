@@ -0,0 +1,62 @@
+#ifndef MESH_CACHE_H
+#define MESH_CACHE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "lod.h"
+#include "mesh.h"
+#include "meshlet.h"
+#include "vfs.h"
+
+#define MESH_CACHE_MAGIC 0x434D474E // "NGMC"
+#define MESH_CACHE_VERSION 1
+#define MESH_CACHE_ALIGN 64
+
+// Every blob starts at a MESH_CACHE_ALIGN boundary of the file so it can be
+// used in place from a read-only mapping. Offsets are from the file start
+// and zero when the blob is absent.
+typedef struct MeshCacheHeader {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t vertex_stride;
+  uint32_t vertex_count;
+  uint32_t index_count;
+  uint32_t lod_count;
+  uint32_t meshlet_count;
+  uint32_t meshlet_vertex_count;
+  uint32_t meshlet_triangle_count;
+  uint32_t meshlet_index_count;
+  float center[3];
+  float radius;
+  uint64_t vertex_offset;
+  uint64_t index_offset;
+  uint64_t lod_offset;
+  uint64_t meshlet_offset;
+  uint64_t meshlet_vertex_offset;
+  uint64_t meshlet_triangle_offset;
+  uint64_t meshlet_index_offset;
+} MeshCacheHeader;
+
+// View into a cache file opened through the VFS. `mesh` and `lod` point into
+// the file data and must not be freed; `lod.indices` holds every level, level 0 first.
+typedef struct MeshCache {
+  VfsFile file;
+  const MeshCacheHeader* header;
+  Mesh mesh;
+  LodChain lod;
+  MeshletSet meshlets;
+} MeshCache;
+
+// `lod` and `meshlets` are optional. Without a LOD chain the mesh indices are
+// written as a single level.
+bool mesh_cache_write(const char* path, const Mesh* mesh, const LodChain* lod,
+                      const MeshletSet* meshlets);
+
+bool mesh_cache_open(MeshCache* cache, const char* path);
+void mesh_cache_close(MeshCache* cache);
+
+// Uploads vertices and all LOD indices directly from the mapping
+void mesh_cache_upload(const MeshCache* cache, GpuMesh* gpu);
+
+#endif
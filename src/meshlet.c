@@ -0,0 +1,258 @@
+#include "meshlet.h"
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct MeshletBuilder {
+  const Mesh* mesh;
+  int* adjacency_start;
+  int* adjacency;
+  bool* used;
+  int* local;
+  uint32_t vertices[MESHLET_MAX_VERTICES];
+  int vertex_count;
+  uint32_t triangles[MESHLET_MAX_TRIANGLES];
+  int triangle_count;
+} MeshletBuilder;
+
+static int meshlet_new_vertices(const MeshletBuilder* b, int tri) {
+    const uint32_t *v = &b->mesh->indices[tri * 3];
+    return (b->local[v[0]] < 0) + (b->local[v[1]] < 0) + (b->local[v[2]] < 0);
+}
+
+static void meshlet_add_triangle(MeshletBuilder* b, int tri) {
+    const uint32_t *v = &b->mesh->indices[tri * 3];
+    for (int k = 0; k < 3; k++) {
+        if (b->local[v[k]] < 0) {
+            b->local[v[k]] = b->vertex_count;
+            b->vertices[b->vertex_count++] = v[k];
+        }
+    }
+    b->triangles[b->triangle_count++] = tri;
+    b->used[tri] = true;
+}
+
+// Best unused triangle touching `vertex`, preferring ones that add the fewest
+// new vertices so meshlets stay compact.
+static void meshlet_scan_vertex(const MeshletBuilder* b, uint32_t vertex,
+                                int* best, int* best_new) {
+    for (int i = b->adjacency_start[vertex]; i < b->adjacency_start[vertex + 1]; i++) {
+        int tri = b->adjacency[i];
+        if (b->used[tri])
+            continue;
+        int added = meshlet_new_vertices(b, tri);
+        if (b->vertex_count + added > MESHLET_MAX_VERTICES)
+            continue;
+        if (added < *best_new) {
+            *best = tri;
+            *best_new = added;
+        }
+    }
+}
+
+static void meshlet_compute_bounds(const MeshletBuilder* b, Meshlet* meshlet) {
+    const Mesh *mesh = b->mesh;
+    vec3 lo = {INFINITY, INFINITY, INFINITY};
+    vec3 hi = {-INFINITY, -INFINITY, -INFINITY};
+    for (int i = 0; i < b->vertex_count; i++) {
+        const float *p = &mesh->vertices[b->vertices[i] * mesh->stride];
+        for (int k = 0; k < 3; k++) {
+            lo[k] = fminf(lo[k], p[k]);
+            hi[k] = fmaxf(hi[k], p[k]);
+        }
+    }
+    vec3_add(meshlet->center, lo, hi);
+    vec3_scale(meshlet->center, meshlet->center, 0.5f);
+    float r2 = 0.0f;
+    for (int i = 0; i < b->vertex_count; i++) {
+        const float *p = &mesh->vertices[b->vertices[i] * mesh->stride];
+        vec3 d = {p[0] - meshlet->center[0], p[1] - meshlet->center[1],
+                  p[2] - meshlet->center[2]};
+        r2 = fmaxf(r2, vec3_mul_inner(d, d));
+    }
+    meshlet->radius = sqrtf(r2);
+
+    // Normal cone: axis is the average facing, the cutoff is the sine of the
+    // widest deviation from it. A cone of 90 degrees or more can never be
+    // entirely back-facing and gets a cutoff of 1.
+    vec3 normals[MESHLET_MAX_TRIANGLES];
+    vec3 axis = {0.0f, 0.0f, 0.0f};
+    for (int i = 0; i < b->triangle_count; i++) {
+        const uint32_t *v = &mesh->indices[b->triangles[i] * 3];
+        const float *p0 = &mesh->vertices[v[0] * mesh->stride];
+        const float *p1 = &mesh->vertices[v[1] * mesh->stride];
+        const float *p2 = &mesh->vertices[v[2] * mesh->stride];
+        vec3 e1 = {p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2]};
+        vec3 e2 = {p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2]};
+        vec3_mul_cross(normals[i], e1, e2);
+        float len = vec3_len(normals[i]);
+        if (len > 0.0f)
+            vec3_scale(normals[i], normals[i], 1.0f / len);
+        vec3_add(axis, axis, normals[i]);
+    }
+
+    float len = vec3_len(axis);
+    if (len <= 0.0f) {
+        vec3 zero = {0.0f, 0.0f, 0.0f};
+        vec3_dup(meshlet->cone_axis, zero);
+        meshlet->cone_cutoff = 1.0f;
+        return;
+    }
+    vec3_scale(meshlet->cone_axis, axis, 1.0f / len);
+
+    float min_dot = 1.0f;
+    for (int i = 0; i < b->triangle_count; i++) {
+        if (vec3_len(normals[i]) > 0.0f)
+            min_dot = fminf(min_dot, vec3_mul_inner(normals[i], meshlet->cone_axis));
+    }
+    meshlet->cone_cutoff = min_dot <= 0.0f ? 1.0f : sqrtf(1.0f - min_dot * min_dot);
+}
+
+void meshlet_build(MeshletSet* set, const Mesh* mesh) {
+    memset(set, 0, sizeof(*set));
+    int tri_count = mesh->index_count / 3;
+    int max_meshlets = tri_count;
+
+    set->meshlets = (Meshlet *)malloc(max_meshlets * sizeof(Meshlet));
+    set->vertices = (uint32_t *)malloc(mesh->index_count * sizeof(uint32_t));
+    set->triangles = (uint8_t *)malloc(mesh->index_count);
+    set->indices = (uint32_t *)malloc(mesh->index_count * sizeof(uint32_t));
+
+    MeshletBuilder b;
+    memset(&b, 0, sizeof(b));
+    b.mesh = mesh;
+    b.adjacency_start = (int *)calloc(mesh->vertex_count + 1, sizeof(int));
+    b.adjacency = (int *)malloc(mesh->index_count * sizeof(int));
+    b.used = (bool *)calloc(tri_count, sizeof(bool));
+    b.local = (int *)malloc(mesh->vertex_count * sizeof(int));
+    memset(b.local, -1, mesh->vertex_count * sizeof(int));
+
+    for (int i = 0; i < mesh->index_count; i++)
+        b.adjacency_start[mesh->indices[i] + 1]++;
+    for (int v = 0; v < mesh->vertex_count; v++)
+        b.adjacency_start[v + 1] += b.adjacency_start[v];
+    int *fill = (int *)malloc(mesh->vertex_count * sizeof(int));
+    memcpy(fill, b.adjacency_start, mesh->vertex_count * sizeof(int));
+    for (int i = 0; i < mesh->index_count; i++)
+        b.adjacency[fill[mesh->indices[i]]++] = i / 3;
+    free(fill);
+
+    int seed = 0;
+    while (true) {
+        while (seed < tri_count && b.used[seed])
+            seed++;
+        if (seed == tri_count)
+            break;
+
+        b.vertex_count = 0;
+        b.triangle_count = 0;
+        meshlet_add_triangle(&b, seed);
+
+        while (b.triangle_count < MESHLET_MAX_TRIANGLES) {
+            // Scanning every meshlet vertex rather than just the last triangle
+            // grows blob-shaped meshlets, which share more vertices than strips
+            int best = -1, best_new = 4;
+            for (int i = 0; i < b.vertex_count && best_new > 0; i++)
+                meshlet_scan_vertex(&b, b.vertices[i], &best, &best_new);
+            if (best < 0)
+                break;
+            meshlet_add_triangle(&b, best);
+        }
+
+        Meshlet *meshlet = &set->meshlets[set->meshlet_count++];
+        meshlet->vertex_offset = set->vertex_count;
+        meshlet->triangle_offset = set->triangle_count;
+        meshlet->first_index = set->index_count;
+        meshlet->vertex_count = b.vertex_count;
+        meshlet->triangle_count = b.triangle_count;
+        meshlet_compute_bounds(&b, meshlet);
+
+        memcpy(&set->vertices[set->vertex_count], b.vertices,
+               b.vertex_count * sizeof(uint32_t));
+        set->vertex_count += b.vertex_count;
+        for (int i = 0; i < b.triangle_count; i++) {
+            const uint32_t *v = &mesh->indices[b.triangles[i] * 3];
+            for (int k = 0; k < 3; k++) {
+                set->triangles[set->triangle_count * 3 + k] = b.local[v[k]];
+                set->indices[set->index_count++] = v[k];
+            }
+            set->triangle_count++;
+        }
+
+        for (int i = 0; i < b.vertex_count; i++)
+            b.local[b.vertices[i]] = -1;
+    }
+
+    free(b.local);
+    free(b.used);
+    free(b.adjacency);
+    free(b.adjacency_start);
+}
+
+void meshlet_set_free(MeshletSet* set) {
+    free(set->meshlets);
+    free(set->vertices);
+    free(set->triangles);
+    free(set->indices);
+    memset(set, 0, sizeof(*set));
+}
+
+static void meshlet_push_range(MeshletRanges* ranges, uint32_t first, int count) {
+    if (ranges->range_count > 0) {
+        int last = ranges->range_count - 1;
+        size_t end = (size_t)ranges->offsets[last] / sizeof(uint32_t) +
+                     ranges->counts[last];
+        if (end == first) {
+            ranges->counts[last] += count;
+            return;
+        }
+    }
+
+    if (ranges->range_count == ranges->capacity) {
+        ranges->capacity = ranges->capacity ? ranges->capacity * 2 : 64;
+        ranges->counts = (GLsizei *)realloc(ranges->counts,
+                                            ranges->capacity * sizeof(GLsizei));
+        ranges->offsets =
+            (void **)realloc(ranges->offsets, ranges->capacity * sizeof(void *));
+    }
+    ranges->counts[ranges->range_count] = count;
+    ranges->offsets[ranges->range_count] =
+        (void *)((size_t)first * sizeof(uint32_t));
+    ranges->range_count++;
+}
+
+void meshlet_cull(const MeshletSet* set, const Frustum* frustum,
+                  const vec3 camera, MeshletRanges* ranges, MeshletStats* stats) {
+    ranges->range_count = 0;
+    memset(stats, 0, sizeof(*stats));
+
+    for (int i = 0; i < set->meshlet_count; i++) {
+        const Meshlet *meshlet = &set->meshlets[i];
+        if (!frustum_test_sphere(frustum, meshlet->center, meshlet->radius)) {
+            stats->frustum_culled++;
+            continue;
+        }
+
+        // Every triangle faces away when the view direction lies inside the
+        // normal cone, widened by the bounding sphere.
+        vec3 d;
+        vec3_sub(d, meshlet->center, camera);
+        if (vec3_mul_inner(d, meshlet->cone_axis) >=
+            meshlet->cone_cutoff * vec3_len(d) + meshlet->radius) {
+            stats->cone_culled++;
+            continue;
+        }
+
+        stats->visible++;
+        stats->triangles += meshlet->triangle_count;
+        meshlet_push_range(ranges, meshlet->first_index, meshlet->triangle_count * 3);
+    }
+}
+
+void meshlet_ranges_free(MeshletRanges* ranges) {
+    free(ranges->counts);
+    free(ranges->offsets);
+    memset(ranges, 0, sizeof(*ranges));
+}
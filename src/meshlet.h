@@ -0,0 +1,65 @@
+#ifndef MESHLET_H
+#define MESHLET_H
+
+#include <glad/gl.h>
+
+#include <stdint.h>
+
+#include "frustum.h"
+#include "linmath.h"
+#include "mesh.h"
+
+#define MESHLET_MAX_VERTICES 64
+#define MESHLET_MAX_TRIANGLES 124
+
+typedef struct Meshlet {
+  uint32_t vertex_offset;
+  uint32_t triangle_offset;
+  uint32_t first_index;
+  uint8_t vertex_count;
+  uint8_t triangle_count;
+  vec3 center;
+  float radius;
+  vec3 cone_axis;
+  float cone_cutoff;
+} Meshlet;
+
+// `vertices` maps meshlet-local vertices to mesh vertices and `triangles`
+// holds three local indices per triangle. `indices` is the same geometry
+// flattened into one mesh index buffer with every meshlet contiguous, which
+// is what gets uploaded and drawn.
+typedef struct MeshletSet {
+  Meshlet* meshlets;
+  int meshlet_count;
+  uint32_t* vertices;
+  int vertex_count;
+  uint8_t* triangles;
+  int triangle_count;
+  uint32_t* indices;
+  int index_count;
+} MeshletSet;
+
+typedef struct MeshletStats {
+  int visible;
+  int frustum_culled;
+  int cone_culled;
+  int triangles;
+} MeshletStats;
+
+// Contiguous runs of visible meshlets, ready for glMultiDrawElements
+typedef struct MeshletRanges {
+  GLsizei* counts;
+  void** offsets;
+  int range_count;
+  int capacity;
+} MeshletRanges;
+
+void meshlet_build(MeshletSet* set, const Mesh* mesh);
+void meshlet_set_free(MeshletSet* set);
+
+// Frustum and camera position are in the mesh's object space
+void meshlet_cull(const MeshletSet* set, const Frustum* frustum,
+                  const vec3 camera, MeshletRanges* ranges, MeshletStats* stats);
+void meshlet_ranges_free(MeshletRanges* ranges);
+
+#endif
@@ -0,0 +1,277 @@
+#include "mip.h"
+
+#include <limits.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#define MIP_MAX_TAPS 12
+#define MIP_SRGB_STEPS 16384
+#define MIP_KAISER_BETA 4.0f
+
+static float srgb_to_linear[256];
+static uint8_t linear_to_srgb[MIP_SRGB_STEPS + 1];
+static pthread_once_t mip_tables_once = PTHREAD_ONCE_INIT;
+
+static void mip_build_tables() {
+    for (int i = 0; i < 256; i++) {
+        float v = i / 255.0f;
+        srgb_to_linear[i] =
+            v <= 0.04045f ? v / 12.92f : powf((v + 0.055f) / 1.055f, 2.4f);
+    }
+    for (int i = 0; i <= MIP_SRGB_STEPS; i++) {
+        float v = i / (float)MIP_SRGB_STEPS;
+        float s = v <= 0.0031308f ? v * 12.92f : 1.055f * powf(v, 1.0f / 2.4f) - 0.055f;
+        linear_to_srgb[i] = (uint8_t)(s * 255.0f + 0.5f);
+    }
+}
+
+static float mip_sinc(float x) {
+    if (fabsf(x) < 1e-6f)
+        return 1.0f;
+    x *= 3.14159265f;
+    return sinf(x) / x;
+}
+
+// Modified Bessel function of the first kind, order zero
+static float mip_bessel_i0(float x) {
+    float sum = 1.0f, term = 1.0f;
+    for (int k = 1; k < 20; k++) {
+        term *= (x / (2.0f * k)) * (x / (2.0f * k));
+        sum += term;
+    }
+    return sum;
+}
+
+static float mip_kernel(MipFilter filter, float x) {
+    const float radius = 3.0f;
+    if (fabsf(x) >= radius)
+        return 0.0f;
+    if (filter == MIP_FILTER_LANCZOS)
+        return mip_sinc(x) * mip_sinc(x / radius);
+    float t = x / radius;
+    return mip_sinc(x) * mip_bessel_i0(MIP_KAISER_BETA * sqrtf(1.0f - t * t)) /
+           mip_bessel_i0(MIP_KAISER_BETA);
+}
+
+// Destination texel i covers source texels 2i and 2i + 1, tap t reads
+// source texel 2i + offsets[t]. The phase is the same for every texel.
+typedef struct MipTaps {
+  int count;
+  int offsets[MIP_MAX_TAPS];
+  float weights[MIP_MAX_TAPS];
+} MipTaps;
+
+static void mip_taps(MipFilter filter, MipTaps* taps) {
+    if (filter == MIP_FILTER_BOX) {
+        taps->count = 2;
+        taps->offsets[0] = 0;
+        taps->offsets[1] = 1;
+        taps->weights[0] = taps->weights[1] = 0.5f;
+        return;
+    }
+
+    float sum = 0.0f;
+    taps->count = MIP_MAX_TAPS;
+    for (int t = 0; t < MIP_MAX_TAPS; t++) {
+        int d = t - MIP_MAX_TAPS / 2 + 1;
+        taps->offsets[t] = d;
+        // Source texel centre relative to the destination centre, in
+        // destination texels
+        taps->weights[t] = mip_kernel(filter, (d - 0.5f) * 0.5f);
+        sum += taps->weights[t];
+    }
+    for (int t = 0; t < MIP_MAX_TAPS; t++)
+        taps->weights[t] /= sum;
+}
+
+typedef struct MipBand {
+  const uint8_t* src;
+  int width;
+  int height;
+  uint8_t* dst;
+  int dst_width;
+  int dst_height;
+  const MipTaps* taps;
+  bool srgb;
+  int first_row;
+  int row_count;
+} MipBand;
+
+static int mip_clamp(int v, int max) {
+    return v < 0 ? 0 : v > max ? max : v;
+}
+
+static void mip_filter_row(const MipBand* band, int y, float* linear, float* out) {
+    const uint8_t *row = band->src + (size_t)y * band->width * 4;
+    for (int x = 0; x < band->width * 4; x += 4) {
+        for (int c = 0; c < 3; c++)
+            linear[x + c] = band->srgb ? srgb_to_linear[row[x + c]] : row[x + c] / 255.0f;
+        linear[x + 3] = row[x + 3] / 255.0f;
+    }
+
+    const MipTaps *taps = band->taps;
+    // Texels whose taps all land inside the row skip the edge clamp
+    int first = taps->offsets[0], last = taps->offsets[taps->count - 1];
+    int inner_begin = (1 - first) / 2;
+    int inner_end = band->width - 1 >= last ? (band->width - 1 - last) / 2 + 1 : 0;
+    for (int x = 0; x < band->dst_width; x++) {
+#ifdef __SSE2__
+        __m128 sum = _mm_setzero_ps();
+        if (x >= inner_begin && x < inner_end) {
+            const float *base = &linear[(2 * x + first) * 4];
+            for (int t = 0; t < taps->count; t++)
+                sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(taps->weights[t]),
+                                                 _mm_loadu_ps(base + t * 4)));
+        } else {
+            for (int t = 0; t < taps->count; t++) {
+                int sx = mip_clamp(2 * x + taps->offsets[t], band->width - 1);
+                sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(taps->weights[t]),
+                                                 _mm_loadu_ps(&linear[sx * 4])));
+            }
+        }
+        _mm_storeu_ps(&out[x * 4], sum);
+#else
+        float sum[4] = {0};
+        for (int t = 0; t < taps->count; t++) {
+            int sx = mip_clamp(2 * x + taps->offsets[t], band->width - 1);
+            for (int c = 0; c < 4; c++)
+                sum[c] += taps->weights[t] * linear[sx * 4 + c];
+        }
+        memcpy(&out[x * 4], sum, sizeof(sum));
+#endif
+    }
+}
+
+static uint8_t mip_encode(float v, bool srgb) {
+    v = v < 0.0f ? 0.0f : v > 1.0f ? 1.0f : v;
+    if (srgb)
+        return linear_to_srgb[(int)(v * MIP_SRGB_STEPS + 0.5f)];
+    return (uint8_t)(v * 255.0f + 0.5f);
+}
+
+// Horizontally filtered source rows are kept in a ring indexed by the
+// unclamped source row, so each one is filtered once per band
+static void mip_filter_band(void* arg) {
+    MipBand *band = (MipBand *)arg;
+    const MipTaps *taps = band->taps;
+    int row_floats = band->dst_width * 4;
+    float *ring = (float *)malloc((size_t)taps->count * row_floats * sizeof(float));
+    float *linear = (float *)malloc((size_t)band->width * 4 * sizeof(float));
+    float *sum = (float *)malloc((size_t)row_floats * sizeof(float));
+    int keys[MIP_MAX_TAPS];
+    for (int t = 0; t < taps->count; t++)
+        keys[t] = INT_MIN;
+
+    for (int y = band->first_row; y < band->first_row + band->row_count; y++) {
+        memset(sum, 0, (size_t)row_floats * sizeof(float));
+        for (int t = 0; t < taps->count; t++) {
+            int key = 2 * y + taps->offsets[t];
+            int slot = ((key % taps->count) + taps->count) % taps->count;
+            float *row = ring + (size_t)slot * row_floats;
+            if (keys[slot] != key) {
+                mip_filter_row(band, mip_clamp(key, band->height - 1), linear, row);
+                keys[slot] = key;
+            }
+
+            float w = taps->weights[t];
+#ifdef __SSE2__
+            __m128 weight = _mm_set1_ps(w);
+            for (int i = 0; i < row_floats; i += 4)
+                _mm_storeu_ps(&sum[i], _mm_add_ps(_mm_loadu_ps(&sum[i]),
+                                                  _mm_mul_ps(weight, _mm_loadu_ps(&row[i]))));
+#else
+            for (int i = 0; i < row_floats; i++)
+                sum[i] += w * row[i];
+#endif
+        }
+
+        uint8_t *out = band->dst + (size_t)y * band->dst_width * 4;
+        for (int i = 0; i < row_floats; i += 4) {
+            out[i] = mip_encode(sum[i], band->srgb);
+            out[i + 1] = mip_encode(sum[i + 1], band->srgb);
+            out[i + 2] = mip_encode(sum[i + 2], band->srgb);
+            out[i + 3] = mip_encode(sum[i + 3], false);
+        }
+    }
+    free(sum);
+    free(linear);
+    free(ring);
+}
+
+int mip_level_count(int width, int height) {
+    int count = 1;
+    while ((width > 1 || height > 1) && count < MIP_MAX_LEVELS) {
+        width = width > 1 ? width / 2 : 1;
+        height = height > 1 ? height / 2 : 1;
+        count++;
+    }
+    return count;
+}
+
+const char* mip_filter_name(MipFilter filter) {
+    static const char *names[MIP_FILTER_COUNT] = {"box", "kaiser", "lanczos"};
+    return filter >= 0 && filter < MIP_FILTER_COUNT ? names[filter] : "unknown";
+}
+
+void mip_downsample(const uint8_t* src, int width, int height, uint8_t* dst,
+                    MipFilter filter, bool srgb, JobSystem* jobs) {
+    pthread_once(&mip_tables_once, mip_build_tables);
+    MipTaps taps;
+    mip_taps(filter, &taps);
+
+    int dst_width = width > 1 ? width / 2 : 1, dst_height = height > 1 ? height / 2 : 1;
+    int band_count = jobs ? jobs->thread_count * 4 : 1;
+    if (band_count > dst_height)
+        band_count = dst_height;
+
+    MipBand *bands = (MipBand *)malloc(band_count * sizeof(MipBand));
+    JobCounter counter = {0};
+    int first = 0;
+    for (int i = 0; i < band_count; i++) {
+        int count = dst_height / band_count + (i < dst_height % band_count);
+        MipBand band = {src,   width, height, dst,   dst_width,
+                        dst_height, &taps, srgb, first, count};
+        bands[i] = band;
+        first += count;
+        if (jobs)
+            job_submit_counted(jobs, mip_filter_band, &bands[i], &counter);
+        else
+            mip_filter_band(&bands[i]);
+    }
+    if (jobs)
+        job_wait_counter(jobs, &counter);
+    free(bands);
+}
+
+void mip_chain_build(MipChain* chain, const uint8_t* rgba, int width, int height,
+                     int max_levels, MipFilter filter, bool srgb, JobSystem* jobs) {
+    memset(chain, 0, sizeof(*chain));
+    int count = mip_level_count(width, height);
+    if (max_levels > 0 && max_levels < count)
+        count = max_levels;
+
+    chain->level_count = count;
+    chain->widths[0] = width;
+    chain->heights[0] = height;
+    chain->levels[0] = (uint8_t *)rgba;
+    for (int i = 1; i < count; i++) {
+        int w = chain->widths[i - 1], h = chain->heights[i - 1];
+        chain->widths[i] = w > 1 ? w / 2 : 1;
+        chain->heights[i] = h > 1 ? h / 2 : 1;
+        chain->levels[i] =
+            (uint8_t *)malloc((size_t)chain->widths[i] * chain->heights[i] * 4);
+        mip_downsample(chain->levels[i - 1], w, h, chain->levels[i], filter, srgb, jobs);
+    }
+}
+
+void mip_chain_free(MipChain* chain) {
+    for (int i = 1; i < chain->level_count; i++)
+        free(chain->levels[i]);
+    memset(chain, 0, sizeof(*chain));
+}
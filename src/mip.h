@@ -0,0 +1,41 @@
+#ifndef MIP_H
+#define MIP_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "job.h"
+
+#define MIP_MAX_LEVELS 16
+
+// Kaiser and Lanczos are windowed sincs over three destination texels, box
+// averages 2x2 texels
+typedef enum MipFilter {
+  MIP_FILTER_BOX,
+  MIP_FILTER_KAISER,
+  MIP_FILTER_LANCZOS,
+  MIP_FILTER_COUNT
+} MipFilter;
+
+// Level 0 is the caller's image and is not owned by the chain
+typedef struct MipChain {
+  int level_count;
+  int widths[MIP_MAX_LEVELS];
+  int heights[MIP_MAX_LEVELS];
+  uint8_t* levels[MIP_MAX_LEVELS];
+} MipChain;
+
+int mip_level_count(int width, int height);
+const char* mip_filter_name(MipFilter filter);
+
+// Halves an RGBA8 image into `dst`, sized max(1, width / 2) by
+// max(1, height / 2). With `srgb` colour is filtered in linear light.
+void mip_downsample(const uint8_t* src, int width, int height, uint8_t* dst,
+                    MipFilter filter, bool srgb, JobSystem* jobs);
+
+// `max_levels` of 0 builds the full chain down to 1x1
+void mip_chain_build(MipChain* chain, const uint8_t* rgba, int width, int height,
+                     int max_levels, MipFilter filter, bool srgb, JobSystem* jobs);
+void mip_chain_free(MipChain* chain);
+
+#endif
@@ -0,0 +1,211 @@
+#include "pak.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#include "lz4.h"
+
+uint64_t pak_hash(const char* name) {
+    // FNV-1a
+    uint64_t hash = 14695981039346656037ull;
+    for (const unsigned char *c = (const unsigned char *)name; *c; c++) {
+        hash ^= *c;
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+static bool pak_pad(FILE* f, uint64_t* offset, uint64_t alignment) {
+    static const unsigned char zeros[PAK_PAGE] = {0};
+    uint64_t padding = (alignment - *offset % alignment) % alignment;
+    *offset += padding;
+    return padding == 0 || fwrite(zeros, 1, padding, f) == padding;
+}
+
+bool pak_write(const char* path, const char** names, const char** sources,
+               int count, bool compress) {
+    FILE *f = fopen(path, "wb");
+    if (!f) {
+        fprintf(stderr, "Error: cannot create %s\n", path);
+        return false;
+    }
+
+    PakHeader header;
+    memset(&header, 0, sizeof(header));
+    PakEntry *entries = (PakEntry *)calloc(count > 0 ? count : 1, sizeof(PakEntry));
+    uint64_t offset = sizeof(header);
+    bool ok = fwrite(&header, sizeof(header), 1, f) == 1;
+    uint64_t name_size = 0;
+
+    for (int i = 0; ok && i < count; i++) {
+        MappedFile source;
+        if (!file_map(&source, sources[i])) {
+            ok = false;
+            break;
+        }
+
+        PakEntry *entry = &entries[i];
+        entry->hash = pak_hash(names[i]);
+        entry->name = (uint32_t)name_size;
+        entry->size = source.size;
+        name_size += strlen(names[i]) + 1;
+
+        unsigned char *packed = NULL;
+        size_t packed_size = 0;
+        if (compress) {
+            packed = (unsigned char *)malloc(lz4_compress_bound(source.size));
+            packed_size = lz4_compress(source.data, source.size, packed,
+                                       lz4_compress_bound(source.size));
+        }
+
+        if (packed && packed_size <= source.size - source.size / 8) {
+            entry->flags = PAK_ENTRY_LZ4;
+            ok = pak_pad(f, &offset, PAK_ALIGN);
+            entry->offset = offset;
+            entry->stored_size = packed_size;
+            ok = ok && fwrite(packed, 1, packed_size, f) == packed_size;
+        } else {
+            ok = pak_pad(f, &offset, PAK_PAGE);
+            entry->offset = offset;
+            entry->stored_size = source.size;
+            ok = ok && fwrite(source.data, 1, source.size, f) == source.size;
+        }
+        offset += entry->stored_size;
+        free(packed);
+        file_unmap(&source);
+    }
+
+    // Hash table at most half full
+    uint32_t slot_count = 1;
+    while (slot_count < (uint32_t)count * 2)
+        slot_count <<= 1;
+    uint32_t *slots = (uint32_t *)calloc(slot_count, sizeof(uint32_t));
+    for (int i = 0; ok && i < count; i++) {
+        uint32_t slot = (uint32_t)entries[i].hash & (slot_count - 1);
+        while (slots[slot] != 0) {
+            const PakEntry *other = &entries[slots[slot] - 1];
+            if (other->hash == entries[i].hash &&
+                strcmp(names[slots[slot] - 1], names[i]) == 0) {
+                fprintf(stderr, "Error: duplicate pak entry %s\n", names[i]);
+                ok = false;
+                break;
+            }
+            slot = (slot + 1) & (slot_count - 1);
+        }
+        slots[slot] = i + 1;
+    }
+
+    ok = ok && pak_pad(f, &offset, PAK_ALIGN);
+    header.magic = PAK_MAGIC;
+    header.version = PAK_VERSION;
+    header.entry_count = count;
+    header.slot_count = slot_count;
+    header.entry_offset = offset;
+    header.slot_offset = header.entry_offset + (uint64_t)count * sizeof(PakEntry);
+    header.name_offset = header.slot_offset + (uint64_t)slot_count * sizeof(uint32_t);
+    header.name_size = name_size;
+    ok = ok && fwrite(entries, sizeof(PakEntry), count, f) == (size_t)count;
+    ok = ok && fwrite(slots, sizeof(uint32_t), slot_count, f) == slot_count;
+    for (int i = 0; ok && i < count; i++)
+        ok = fwrite(names[i], 1, strlen(names[i]) + 1, f) == strlen(names[i]) + 1;
+    ok = ok && fseek(f, 0, SEEK_SET) == 0 &&
+         fwrite(&header, sizeof(header), 1, f) == 1;
+
+    free(slots);
+    free(entries);
+    ok = fclose(f) == 0 && ok;
+    if (!ok)
+        fprintf(stderr, "Error: failed writing %s\n", path);
+    return ok;
+}
+
+static bool pak_range_ok(const MappedFile* file, uint64_t offset, uint64_t size) {
+    return offset <= file->size && size <= file->size - offset;
+}
+
+bool pak_open(Pak* pak, const char* path) {
+    memset(pak, 0, sizeof(*pak));
+    if (!file_map(&pak->file, path))
+        return false;
+
+    const MappedFile *file = &pak->file;
+    const PakHeader *h = (const PakHeader *)file->data;
+    bool ok = file->size >= sizeof(*h) && h->magic == PAK_MAGIC &&
+              h->version == PAK_VERSION && h->slot_count > 0 &&
+              (h->slot_count & (h->slot_count - 1)) == 0 &&
+              h->slot_count >= h->entry_count &&
+              h->entry_offset % PAK_ALIGN == 0 &&
+              pak_range_ok(file, h->entry_offset,
+                           (uint64_t)h->entry_count * sizeof(PakEntry)) &&
+              pak_range_ok(file, h->slot_offset,
+                           (uint64_t)h->slot_count * sizeof(uint32_t)) &&
+              pak_range_ok(file, h->name_offset, h->name_size) &&
+              (h->name_size == 0 || file->data[h->name_offset + h->name_size - 1] == 0);
+
+    const PakEntry *entries = (const PakEntry *)(file->data + h->entry_offset);
+    for (uint32_t i = 0; ok && i < h->entry_count; i++)
+        ok = pak_range_ok(file, entries[i].offset, entries[i].stored_size) &&
+             entries[i].name < h->name_size &&
+             (entries[i].flags & PAK_ENTRY_LZ4 ||
+              entries[i].stored_size == entries[i].size);
+    if (!ok) {
+        fprintf(stderr, "Error: %s is not a valid pak\n", path);
+        file_unmap(&pak->file);
+        return false;
+    }
+
+    // Lookups jump around the table of contents
+    madvise((void *)file->data, file->size, MADV_RANDOM);
+    pak->header = h;
+    pak->entries = entries;
+    pak->slots = (const uint32_t *)(file->data + h->slot_offset);
+    pak->names = (const char *)(file->data + h->name_offset);
+    return true;
+}
+
+void pak_close(Pak* pak) {
+    file_unmap(&pak->file);
+    memset(pak, 0, sizeof(*pak));
+}
+
+const PakEntry* pak_find(const Pak* pak, const char* name) {
+    uint64_t hash = pak_hash(name);
+    uint32_t mask = pak->header->slot_count - 1;
+    for (uint32_t probe = 0; probe <= mask; probe++) {
+        uint32_t index = pak->slots[(hash + probe) & mask];
+        if (index == 0 || index > pak->header->entry_count)
+            return NULL;
+        const PakEntry *entry = &pak->entries[index - 1];
+        if (entry->hash == hash && strcmp(pak->names + entry->name, name) == 0)
+            return entry;
+    }
+    return NULL;
+}
+
+const char* pak_entry_name(const Pak* pak, const PakEntry* entry) {
+    return pak->names + entry->name;
+}
+
+const unsigned char* pak_entry_data(const Pak* pak, const PakEntry* entry) {
+    return pak->file.data + entry->offset;
+}
+
+void pak_prefetch(const Pak* pak, const PakEntry* entry) {
+    if (entry->stored_size == 0)
+        return;
+    uint64_t begin = entry->offset & ~(uint64_t)(PAK_PAGE - 1);
+    madvise((void *)(pak->file.data + begin),
+            entry->offset + entry->stored_size - begin, MADV_WILLNEED);
+}
+
+bool pak_decompress(const Pak* pak, const PakEntry* entry, unsigned char* dst) {
+    long size = lz4_decompress(pak_entry_data(pak, entry), entry->stored_size,
+                               dst, entry->size);
+    if (size != (long)entry->size) {
+        fprintf(stderr, "Error: corrupt pak entry %s\n", pak_entry_name(pak, entry));
+        return false;
+    }
+    return true;
+}
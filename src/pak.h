@@ -0,0 +1,70 @@
+#ifndef PAK_H
+#define PAK_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "file.h"
+
+#define PAK_MAGIC 0x4B41504E // "NPAK"
+#define PAK_VERSION 1
+#define PAK_PAGE 4096
+#define PAK_ALIGN 16
+
+#define PAK_ENTRY_LZ4 1
+
+// Layout: header, entry data, entry table, hash slots, name strings.
+// Uncompressed entries start on a PAK_PAGE boundary so they can be used in
+// place from the mapping; compressed entries are packed at PAK_ALIGN.
+typedef struct PakHeader {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t entry_count;
+  uint32_t slot_count;
+  uint64_t entry_offset;
+  uint64_t slot_offset;
+  uint64_t name_offset;
+  uint64_t name_size;
+} PakHeader;
+
+typedef struct PakEntry {
+  uint64_t hash;
+  uint64_t offset;
+  uint64_t size;
+  uint64_t stored_size;
+  uint32_t name;
+  uint32_t flags;
+} PakEntry;
+
+// Open addressing table of entry index + 1, slot_count is a power of two
+typedef struct Pak {
+  MappedFile file;
+  const PakHeader* header;
+  const PakEntry* entries;
+  const uint32_t* slots;
+  const char* names;
+} Pak;
+
+uint64_t pak_hash(const char* name);
+
+bool pak_open(Pak* pak, const char* path);
+void pak_close(Pak* pak);
+
+const PakEntry* pak_find(const Pak* pak, const char* name);
+const char* pak_entry_name(const Pak* pak, const PakEntry* entry);
+
+// Pointer to the stored bytes of an entry inside the mapping
+const unsigned char* pak_entry_data(const Pak* pak, const PakEntry* entry);
+
+// Asks the kernel to read the entry's pages ahead of use
+void pak_prefetch(const Pak* pak, const PakEntry* entry);
+
+// Decompresses an LZ4 entry into `dst`, which must hold `entry->size` bytes
+bool pak_decompress(const Pak* pak, const PakEntry* entry, unsigned char* dst);
+
+// Packs `sources` into an archive under `names`. With `compress` set each
+// entry is LZ4 compressed when that saves at least an eighth of its size.
+bool pak_write(const char* path, const char** names, const char** sources,
+               int count, bool compress);
+
+#endif
@@ -0,0 +1,160 @@
+#include "render_thread.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+static double now_ms() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e3 + ts.tv_nsec * 1e-6;
+}
+
+static void render_thread_draw(RenderThread* renderer, const FramePacket* packet) {
+    double start = now_ms();
+    if (!renderer->render(packet, renderer->user)) {
+        if (renderer->pacer)
+            frame_pacer_idle(renderer->pacer);
+        return;
+    }
+    double submitted = now_ms();
+    glfwSwapBuffers(renderer->window);
+    double end = now_ms();
+    if (renderer->pacer)
+        frame_pacer_presented(renderer->pacer, packet->started_ms, submitted, end);
+
+    if (renderer->threaded)
+        pthread_mutex_lock(&renderer->lock);
+    renderer->stats.frames++;
+    renderer->stats.render_ms += end - start;
+    if (renderer->threaded)
+        pthread_mutex_unlock(&renderer->lock);
+}
+
+static void *render_thread_main(void* arg) {
+    RenderThread *renderer = (RenderThread *)arg;
+    glfwMakeContextCurrent(renderer->window);
+
+    pthread_mutex_lock(&renderer->lock);
+    for (;;) {
+        // Packets already submitted are still drawn when stopping
+        while (!renderer->stopping && renderer->states[renderer->read] != PACKET_READY)
+            pthread_cond_wait(&renderer->changed, &renderer->lock);
+        if (renderer->states[renderer->read] != PACKET_READY)
+            break;
+        int index = renderer->read;
+        renderer->states[index] = PACKET_RENDERING;
+        pthread_mutex_unlock(&renderer->lock);
+
+        render_thread_draw(renderer, &renderer->packets[index]);
+
+        pthread_mutex_lock(&renderer->lock);
+        renderer->states[index] = PACKET_FREE;
+        renderer->read = (index + 1) % RENDER_PACKETS;
+        pthread_cond_broadcast(&renderer->changed);
+    }
+    pthread_mutex_unlock(&renderer->lock);
+
+    glfwMakeContextCurrent(NULL);
+    return NULL;
+}
+
+void render_thread_init(RenderThread* renderer, GLFWwindow* window, bool threaded,
+                        FramePacer* pacer, RenderFn render, void* user) {
+    memset(renderer, 0, sizeof(*renderer));
+    renderer->window = window;
+    renderer->threaded = threaded;
+    renderer->pacer = pacer;
+    renderer->render = render;
+    renderer->user = user;
+    if (!threaded)
+        return;
+
+    pthread_mutex_init(&renderer->lock, NULL);
+    pthread_cond_init(&renderer->changed, NULL);
+    glfwMakeContextCurrent(NULL);
+    pthread_create(&renderer->thread, NULL, render_thread_main, renderer);
+}
+
+void render_thread_destroy(RenderThread* renderer) {
+    if (renderer->threaded) {
+        pthread_mutex_lock(&renderer->lock);
+        renderer->stopping = true;
+        pthread_cond_broadcast(&renderer->changed);
+        pthread_mutex_unlock(&renderer->lock);
+        pthread_join(renderer->thread, NULL);
+        pthread_cond_destroy(&renderer->changed);
+        pthread_mutex_destroy(&renderer->lock);
+        glfwMakeContextCurrent(renderer->window);
+    }
+    for (int i = 0; i < RENDER_PACKETS; i++) {
+        free(renderer->packets[i].draws);
+        free(renderer->packets[i].instances);
+    }
+    memset(renderer, 0, sizeof(*renderer));
+}
+
+FramePacket* render_thread_begin(RenderThread* renderer) {
+    FramePacket *packet = &renderer->packets[renderer->write];
+    if (renderer->threaded) {
+        double start = now_ms();
+        pthread_mutex_lock(&renderer->lock);
+        while (renderer->states[renderer->write] != PACKET_FREE)
+            pthread_cond_wait(&renderer->changed, &renderer->lock);
+        renderer->states[renderer->write] = PACKET_FILLING;
+        renderer->stats.wait_ms += now_ms() - start;
+        pthread_mutex_unlock(&renderer->lock);
+    }
+
+    packet->frame = ++renderer->frame;
+    packet->started_ms = now_ms();
+    packet->draw_count = 0;
+    packet->instance_count = 0;
+    return packet;
+}
+
+void render_thread_submit(RenderThread* renderer) {
+    if (!renderer->threaded) {
+        render_thread_draw(renderer, &renderer->packets[renderer->write]);
+        return;
+    }
+    pthread_mutex_lock(&renderer->lock);
+    renderer->states[renderer->write] = PACKET_READY;
+    renderer->write = (renderer->write + 1) % RENDER_PACKETS;
+    pthread_cond_broadcast(&renderer->changed);
+    pthread_mutex_unlock(&renderer->lock);
+}
+
+void frame_packet_draw(FramePacket* packet, int kind, const mat4x4* instances, int count) {
+    if (packet->draw_count == packet->draw_capacity) {
+        packet->draw_capacity = packet->draw_capacity ? packet->draw_capacity * 2 : 16;
+        packet->draws = (FrameDraw *)realloc(packet->draws,
+                                             packet->draw_capacity * sizeof(FrameDraw));
+    }
+    FrameDraw *draw = &packet->draws[packet->draw_count++];
+    draw->kind = kind;
+    draw->first_instance = packet->instance_count;
+    draw->instance_count = count;
+    if (!instances)
+        return;
+
+    if (packet->instance_count + count > packet->instance_capacity) {
+        while (packet->instance_count + count > packet->instance_capacity)
+            packet->instance_capacity =
+                packet->instance_capacity ? packet->instance_capacity * 2 : 256;
+        packet->instances = (mat4x4 *)realloc(packet->instances,
+                                              packet->instance_capacity * sizeof(mat4x4));
+    }
+    memcpy(packet->instances + packet->instance_count, instances, count * sizeof(mat4x4));
+    packet->instance_count += count;
+}
+
+RenderStats render_thread_stats(RenderThread* renderer) {
+    if (renderer->threaded)
+        pthread_mutex_lock(&renderer->lock);
+    RenderStats stats = renderer->stats;
+    memset(&renderer->stats, 0, sizeof(renderer->stats));
+    if (renderer->threaded)
+        pthread_mutex_unlock(&renderer->lock);
+    return stats;
+}
@@ -0,0 +1,105 @@
+#ifndef RENDER_THREAD_H
+#define RENDER_THREAD_H
+
+#include <glad/gl.h>
+#define GLFW_INCLUDE_NONE
+#include <GLFW/glfw3.h>
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "frame_pacer.h"
+#include "linmath.h"
+
+#define RENDER_PACKETS 2
+
+// A run of instances drawn the same way; what `kind` means is up to the
+// render function
+typedef struct FrameDraw {
+  int kind;
+  int first_instance;
+  int instance_count;
+} FrameDraw;
+
+// Everything needed to draw one frame. The main thread fills it and does
+// not touch it again once submitted; the render thread only reads it.
+typedef struct FramePacket {
+  uint64_t frame;
+  // Set by render_thread_begin, just before the frame's events are polled
+  double started_ms;
+  int width;
+  int height;
+  float time;
+  uint32_t flags;
+  mat4x4 view;
+  mat4x4 projection;
+  vec3 camera_position;
+  FrameDraw* draws;
+  int draw_count;
+  int draw_capacity;
+  mat4x4* instances;
+  int instance_count;
+  int instance_capacity;
+} FramePacket;
+
+// Returns false when it drew nothing, which skips the swap
+typedef bool (*RenderFn)(const FramePacket* packet, void* user);
+
+typedef enum PacketState {
+  PACKET_FREE,
+  PACKET_FILLING,
+  PACKET_READY,
+  PACKET_RENDERING
+} PacketState;
+
+// Sums over `frames`; wait is the time the main thread spent blocked on a
+// free packet. Input to present latency is measured by the FramePacer.
+typedef struct RenderStats {
+  long frames;
+  double render_ms;
+  double wait_ms;
+} RenderStats;
+
+// Owns the window's GL context on a thread of its own, drawing packets the
+// main thread produces up to a frame ahead. With `threaded` false packets
+// are drawn and swapped inside render_thread_submit instead, which is the
+// same code path without the overlap.
+typedef struct RenderThread {
+  GLFWwindow* window;
+  bool threaded;
+  FramePacer* pacer;
+  RenderFn render;
+  void* user;
+  FramePacket packets[RENDER_PACKETS];
+  PacketState states[RENDER_PACKETS];
+  int write;
+  int read;
+  uint64_t frame;
+  bool stopping;
+  pthread_t thread;
+  pthread_mutex_t lock;
+  pthread_cond_t changed;
+  RenderStats stats;
+} RenderThread;
+
+// GL resources must exist before this; in threaded mode the context is
+// released here and made current on the render thread. Swaps are reported
+// to `pacer` when there is one.
+void render_thread_init(RenderThread* renderer, GLFWwindow* window, bool threaded,
+                        FramePacer* pacer, RenderFn render, void* user);
+// Draws what was submitted, then makes the context current here again
+void render_thread_destroy(RenderThread* renderer);
+
+// Blocks until a packet is free and returns it emptied
+FramePacket* render_thread_begin(RenderThread* renderer);
+void render_thread_submit(RenderThread* renderer);
+
+// Copies `count` matrices into the packet, `instances` may be NULL when the
+// draw takes its per-instance data from elsewhere
+void frame_packet_draw(FramePacket* packet, int kind, const mat4x4* instances, int count);
+
+// Returns the stats gathered since the last call and starts over
+RenderStats render_thread_stats(RenderThread* renderer);
+
+#endif
@@ -0,0 +1,734 @@
+#include "shader.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "file.h"
+#include "vfs.h"
+
+// From KHR_parallel_shader_compile, glad only knows core enums
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+
+#define SHADER_HASH_BASIS 14695981039346656037ull
+#define SHADER_BINARY_MAGIC 0x4E494253u // "SBIN"
+
+typedef void (GLAD_API_PTR *PFNGLMAXSHADERCOMPILERTHREADSKHRPROC)(GLuint count);
+
+typedef struct ShaderBinaryHeader {
+  uint32_t magic;
+  uint32_t format;
+  uint64_t source_hash;
+  uint32_t size;
+  uint32_t reserved;
+} ShaderBinaryHeader;
+
+static double now_ms() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e3 + ts.tv_nsec * 1e-6;
+}
+
+// FNV-1a, the terminator is hashed too so "ab" + "c" differs from "a" + "bc"
+static uint64_t shader_hash(uint64_t hash, const char* text) {
+    const unsigned char *c = (const unsigned char *)(text ? text : "");
+    do {
+        hash ^= *c;
+        hash *= 1099511628211ull;
+    } while (*c++);
+    return hash;
+}
+
+static bool shader_has_extension(const char* name) {
+    GLint count = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+    for (GLint i = 0; i < count; i++) {
+        const char *extension = (const char *)glGetStringi(GL_EXTENSIONS, i);
+        if (extension && strcmp(extension, name) == 0)
+            return true;
+    }
+    return false;
+}
+
+// Indices of the set features sorted by define name
+static int shader_sorted_features(const ShaderLibrary* library, uint32_t features,
+                                  int order[SHADER_MAX_FEATURES]) {
+    int count = 0;
+    for (int i = 0; i < library->feature_count; i++) {
+        if (!(features & (1u << i)))
+            continue;
+        int j = count++;
+        for (; j > 0 && strcmp(library->features[order[j - 1]], library->features[i]) > 0; j--)
+            order[j] = order[j - 1];
+        order[j] = i;
+    }
+    return count;
+}
+
+static char *shader_defines(const ShaderLibrary* library, uint32_t features) {
+    int order[SHADER_MAX_FEATURES];
+    int count = shader_sorted_features(library, features, order);
+    size_t size = 1;
+    for (int i = 0; i < count; i++)
+        size += strlen(library->features[order[i]]) + sizeof("#define  1\n");
+    char *defines = (char *)malloc(size);
+    defines[0] = '\0';
+    for (int i = 0, length = 0; i < count; i++)
+        length += sprintf(defines + length, "#define %s 1\n", library->features[order[i]]);
+    return defines;
+}
+
+static void shader_label(const ShaderLibrary* library, uint32_t features, char* label,
+                         size_t size) {
+    int order[SHADER_MAX_FEATURES];
+    int count = shader_sorted_features(library, features, order);
+    snprintf(label, size, "%s", count ? "" : "no features");
+    for (int i = 0; i < count; i++) {
+        size_t length = strlen(label);
+        snprintf(label + length, size - length, "%s%s", i ? "+" : "",
+                 library->features[order[i]]);
+    }
+}
+
+uint32_t shader_feature(ShaderLibrary* library, const char* define) {
+    for (int i = 0; i < library->feature_count; i++)
+        if (strcmp(library->features[i], define) == 0)
+            return 1u << i;
+    if (library->feature_count == SHADER_MAX_FEATURES) {
+        fprintf(stderr, "Error: too many shader features, %s ignored\n", define);
+        return 0;
+    }
+    snprintf(library->features[library->feature_count], SHADER_MAX_NAME, "%s", define);
+    return 1u << library->feature_count++;
+}
+
+uint64_t shader_variant_hash(const ShaderLibrary* library, const char* vertex,
+                             const char* fragment, uint32_t features) {
+    int order[SHADER_MAX_FEATURES];
+    int count = shader_sorted_features(library, features, order);
+    uint64_t hash = shader_hash(shader_hash(SHADER_HASH_BASIS, vertex), fragment);
+    for (int i = 0; i < count; i++)
+        hash = shader_hash(hash, library->features[order[i]]);
+    return hash;
+}
+
+static ShaderProgram *shader_find(ShaderLibrary* library, uint64_t hash) {
+    for (int i = 0; i < library->program_count; i++)
+        if (library->programs[i].hash == hash)
+            return &library->programs[i];
+    return NULL;
+}
+
+// Loose files win over packed ones so edits show up during development
+static char *shader_read(const ShaderLibrary* library, const char* name) {
+    char path[SHADER_MAX_PATH * 2];
+    snprintf(path, sizeof(path), "%s/%s", library->directory, name);
+
+    MappedFile file;
+    VfsFile packed;
+    const unsigned char *data;
+    size_t size;
+    bool loose = file_map(&file, path);
+    if (loose) {
+        data = file.data;
+        size = file.size;
+    } else if (vfs_open(&packed, path)) {
+        data = packed.data;
+        size = packed.size;
+    } else {
+        fprintf(stderr, "Error: cannot read shader %s\n", path);
+        return NULL;
+    }
+
+    char *text = (char *)malloc(size + 1);
+    memcpy(text, data, size);
+    text[size] = '\0';
+    if (loose)
+        file_unmap(&file);
+    else
+        vfs_close(&packed);
+    return text;
+}
+
+static void shader_free_sources(char* sources[3]) {
+    for (int i = 0; i < 3; i++) {
+        free(sources[i]);
+        sources[i] = NULL;
+    }
+}
+
+// Also records what the sources hash to, which is what a cached binary of
+// the build has to match
+static bool shader_read_sources(const ShaderLibrary* library, ShaderProgram* target,
+                                char* sources[3]) {
+    sources[0] = shader_read(library, target->vertex);
+    sources[1] = shader_read(library, target->fragment);
+    sources[2] = shader_defines(library, target->features);
+    if (!sources[0] || !sources[1]) {
+        shader_free_sources(sources);
+        return false;
+    }
+
+    uint64_t hash = SHADER_HASH_BASIS;
+    for (int i = 0; i < 3; i++)
+        hash = shader_hash(hash, sources[i]);
+    // A driver update invalidates every binary
+    hash = shader_hash(hash, (const char *)glGetString(GL_VENDOR));
+    hash = shader_hash(hash, (const char *)glGetString(GL_RENDERER));
+    hash = shader_hash(hash, (const char *)glGetString(GL_VERSION));
+    target->source_hash = hash;
+    return true;
+}
+
+static bool shader_caching(const ShaderLibrary* library) {
+    return library->binaries && library->cache_directory[0];
+}
+
+// Issues the compile and link without asking for the result, which is what
+// lets a parallel compiling driver return straight away. The defines go
+// after #version, and #line keeps error messages on the file's numbering.
+static GLuint shader_build(char* const sources[3], bool retrievable) {
+    static const GLenum stages[2] = {GL_VERTEX_SHADER, GL_FRAGMENT_SHADER};
+    GLuint program = glCreateProgram();
+    for (int i = 0; i < 2; i++) {
+        const char *text = sources[i], *body = text, *line = "#line 1\n";
+        if (strncmp(text, "#version", 8) == 0) {
+            const char *end = strchr(text, '\n');
+            body = end ? end + 1 : text + strlen(text);
+            line = "#line 2\n";
+        }
+        const GLchar *parts[5] = {text, "\n", sources[2], line, body};
+        GLint lengths[5] = {(GLint)(body - text), -1, -1, -1, -1};
+
+        GLuint shader = glCreateShader(stages[i]);
+        glShaderSource(shader, 5, parts, lengths);
+        glCompileShader(shader);
+        glAttachShader(program, shader);
+        // Stays alive while attached, so its log can still be read
+        glDeleteShader(shader);
+    }
+    if (retrievable)
+        glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    glLinkProgram(program);
+    return program;
+}
+
+static bool shader_check(const ShaderLibrary* library, GLuint program,
+                         const ShaderProgram* target) {
+    GLint linked = 0;
+    glGetProgramiv(program, GL_LINK_STATUS, &linked);
+    if (linked)
+        return true;
+
+    char log[1024];
+    GLuint shaders[2];
+    GLsizei count = 0;
+    glGetAttachedShaders(program, 2, &count, shaders);
+    for (int i = 0; i < count; i++) {
+        GLint compiled = 0;
+        glGetShaderiv(shaders[i], GL_COMPILE_STATUS, &compiled);
+        if (!compiled) {
+            glGetShaderInfoLog(shaders[i], sizeof(log), NULL, log);
+            fprintf(stderr, "Error: %s: %s", i == 0 ? target->vertex : target->fragment,
+                    log);
+        }
+    }
+    char label[256];
+    shader_label(library, target->features, label, sizeof(label));
+    glGetProgramInfoLog(program, sizeof(log), NULL, log);
+    fprintf(stderr, "Error: cannot link %s + %s [%s]: %s\n", target->vertex,
+            target->fragment, label, log);
+    return false;
+}
+
+static void shader_cache_path(const ShaderLibrary* library, uint64_t hash, char* path,
+                              size_t size) {
+    snprintf(path, size, "%s/%016llx.bin", library->cache_directory,
+             (unsigned long long)hash);
+}
+
+// 0 when there is no binary for these exact sources or the driver rejects it
+static GLuint shader_cache_load(ShaderLibrary* library, const ShaderProgram* target) {
+    if (!shader_caching(library))
+        return 0;
+    char path[SHADER_MAX_PATH + 32];
+    shader_cache_path(library, target->hash, path, sizeof(path));
+    MappedFile file;
+    if (!file_map(&file, path)) {
+        library->stats.cache_misses++;
+        return 0;
+    }
+
+    GLuint program = 0;
+    const ShaderBinaryHeader *header = (const ShaderBinaryHeader *)file.data;
+    if (file.size >= sizeof(ShaderBinaryHeader) && header->magic == SHADER_BINARY_MAGIC &&
+        header->source_hash == target->source_hash &&
+        header->size <= file.size - sizeof(ShaderBinaryHeader)) {
+        program = glCreateProgram();
+        glProgramBinary(program, header->format, file.data + sizeof(ShaderBinaryHeader),
+                        (GLsizei)header->size);
+        GLint linked = 0;
+        glGetProgramiv(program, GL_LINK_STATUS, &linked);
+        if (!linked) {
+            glDeleteProgram(program);
+            program = 0;
+        }
+    }
+    file_unmap(&file);
+    if (program)
+        library->stats.cache_hits++;
+    else
+        library->stats.cache_misses++;
+    return program;
+}
+
+// Written to a temporary name and renamed, so a crash never leaves a torn
+// binary behind
+static void shader_cache_store(const ShaderLibrary* library, const ShaderProgram* target,
+                               GLuint program) {
+    if (!shader_caching(library))
+        return;
+    GLint length = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0)
+        return;
+
+    unsigned char *data = (unsigned char *)malloc(sizeof(ShaderBinaryHeader) + length);
+    ShaderBinaryHeader *header = (ShaderBinaryHeader *)data;
+    GLenum format = 0;
+    glGetProgramBinary(program, length, NULL, &format, data + sizeof(ShaderBinaryHeader));
+    header->magic = SHADER_BINARY_MAGIC;
+    header->format = format;
+    header->source_hash = target->source_hash;
+    header->size = (uint32_t)length;
+    header->reserved = 0;
+
+    char path[SHADER_MAX_PATH + 32], temporary[SHADER_MAX_PATH + 48];
+    shader_cache_path(library, target->hash, path, sizeof(path));
+    snprintf(temporary, sizeof(temporary), "%s.%d", path, (int)getpid());
+    FILE *f = fopen(temporary, "wb");
+    bool written = f && fwrite(data, sizeof(ShaderBinaryHeader) + length, 1, f) == 1;
+    if (f && fclose(f) != 0)
+        written = false;
+    if (!written || rename(temporary, path) != 0) {
+        fprintf(stderr, "Error: cannot write shader binary %s\n", path);
+        unlink(temporary);
+    }
+    free(data);
+}
+
+static void shader_rebuild(ShaderLibrary* library, ShaderProgram* target);
+
+static void shader_finish(ShaderLibrary* library, ShaderProgram* target,
+                          GLuint program) {
+    if (program && shader_check(library, program, target)) {
+        UniformTable uniforms;
+        uniform_table_build(&uniforms, program, &target->uniforms);
+        uniform_table_free(&target->uniforms);
+        target->uniforms = uniforms;
+        glDeleteProgram(target->program);
+        target->program = program;
+        shader_cache_store(library, target, program);
+        library->stats.reloads++;
+        library->stats.last_reload_ms = now_ms() - target->started;
+        printf("reloaded %s + %s in %.1f ms\n", target->vertex, target->fragment,
+               library->stats.last_reload_ms);
+    } else {
+        glDeleteProgram(program);
+        library->stats.failures++;
+    }
+    target->building = 0;
+    target->queued = false;
+    if (target->dirty) {
+        target->dirty = false;
+        shader_rebuild(library, target);
+    }
+}
+
+static void *shader_worker(void* arg) {
+    ShaderLibrary *library = (ShaderLibrary *)arg;
+    glfwMakeContextCurrent(library->worker_window);
+
+    pthread_mutex_lock(&library->lock);
+    for (;;) {
+        while (!library->stopping && library->queue_count == 0)
+            pthread_cond_wait(&library->has_work, &library->lock);
+        if (library->stopping)
+            break;
+        ShaderBuild *build = library->queue[0];
+        memmove(library->queue, library->queue + 1,
+                --library->queue_count * sizeof(ShaderBuild *));
+        bool retrievable = shader_caching(library);
+        pthread_mutex_unlock(&library->lock);
+
+        // The fence tells the main context when the shared program is done
+        build->program = shader_build(build->sources, retrievable);
+        build->fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        glFlush();
+
+        pthread_mutex_lock(&library->lock);
+        library->done[library->done_count++] = build;
+    }
+    pthread_mutex_unlock(&library->lock);
+
+    glfwMakeContextCurrent(NULL);
+    return NULL;
+}
+
+bool shader_library_init(ShaderLibrary* library, const char* directory,
+                         GLFWwindow* window) {
+    memset(library, 0, sizeof(*library));
+    snprintf(library->directory, sizeof(library->directory), "%s", directory);
+
+    library->inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (library->inotify_fd < 0 ||
+        inotify_add_watch(library->inotify_fd, directory, IN_CLOSE_WRITE | IN_MOVED_TO) < 0)
+        fprintf(stderr, "Error: cannot watch %s, shaders will not reload: %s\n",
+                directory, strerror(errno));
+
+    // Program binaries are core in 4.1, a 3.3 context only has them through
+    // the extension, which glad does not load
+    if (!glad_glGetProgramBinary && shader_has_extension("GL_ARB_get_program_binary")) {
+        glad_glGetProgramBinary =
+            (PFNGLGETPROGRAMBINARYPROC)glfwGetProcAddress("glGetProgramBinary");
+        glad_glProgramBinary = (PFNGLPROGRAMBINARYPROC)glfwGetProcAddress("glProgramBinary");
+        glad_glProgramParameteri =
+            (PFNGLPROGRAMPARAMETERIPROC)glfwGetProcAddress("glProgramParameteri");
+    }
+    GLint formats = 0;
+    if (glad_glGetProgramBinary && glad_glProgramBinary && glad_glProgramParameteri)
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+    library->binaries = formats > 0;
+
+    if (shader_has_extension("GL_KHR_parallel_shader_compile") ||
+        shader_has_extension("GL_ARB_parallel_shader_compile")) {
+        PFNGLMAXSHADERCOMPILERTHREADSKHRPROC max_threads =
+            (PFNGLMAXSHADERCOMPILERTHREADSKHRPROC)glfwGetProcAddress(
+                "glMaxShaderCompilerThreadsKHR");
+        if (!max_threads)
+            max_threads = (PFNGLMAXSHADERCOMPILERTHREADSKHRPROC)glfwGetProcAddress(
+                "glMaxShaderCompilerThreadsARB");
+        if (max_threads)
+            max_threads(0xFFFFFFFFu);
+        library->backend = SHADER_BACKEND_PARALLEL;
+        return true;
+    }
+
+    library->backend = SHADER_BACKEND_BLOCKING;
+    if (!window)
+        return true;
+    // Creating a window changes the current context
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+    library->worker_window = glfwCreateWindow(1, 1, "shader compiler", NULL, window);
+    glfwWindowHint(GLFW_VISIBLE, GLFW_TRUE);
+    glfwMakeContextCurrent(window);
+    if (!library->worker_window) {
+        fprintf(stderr, "Error: no shared context, shaders reload on the main thread\n");
+        return true;
+    }
+
+    library->build_capacity = SHADER_MAX_PROGRAMS;
+    library->queue = (ShaderBuild **)malloc(library->build_capacity * sizeof(ShaderBuild *));
+    library->done = (ShaderBuild **)malloc(library->build_capacity * sizeof(ShaderBuild *));
+    pthread_mutex_init(&library->lock, NULL);
+    pthread_cond_init(&library->has_work, NULL);
+    pthread_create(&library->worker, NULL, shader_worker, library);
+    library->backend = SHADER_BACKEND_WORKER;
+    return true;
+}
+
+bool shader_library_set_cache(ShaderLibrary* library, const char* directory) {
+    if (!library->binaries) {
+        fprintf(stderr, "Error: the driver cannot save program binaries\n");
+        return false;
+    }
+    if (mkdir(directory, 0755) != 0 && errno != EEXIST) {
+        fprintf(stderr, "Error: cannot create %s: %s\n", directory, strerror(errno));
+        return false;
+    }
+    // The worker reads this when it picks up a build
+    if (library->backend == SHADER_BACKEND_WORKER)
+        pthread_mutex_lock(&library->lock);
+    snprintf(library->cache_directory, sizeof(library->cache_directory), "%s", directory);
+    if (library->backend == SHADER_BACKEND_WORKER)
+        pthread_mutex_unlock(&library->lock);
+    return true;
+}
+
+static void shader_free_build(ShaderBuild* build) {
+    if (build->fence)
+        glDeleteSync(build->fence);
+    if (build->program)
+        glDeleteProgram(build->program);
+    shader_free_sources(build->sources);
+    free(build);
+}
+
+void shader_library_destroy(ShaderLibrary* library) {
+    if (library->backend == SHADER_BACKEND_WORKER) {
+        pthread_mutex_lock(&library->lock);
+        library->stopping = true;
+        pthread_cond_signal(&library->has_work);
+        pthread_mutex_unlock(&library->lock);
+        pthread_join(library->worker, NULL);
+        for (int i = 0; i < library->queue_count; i++)
+            shader_free_build(library->queue[i]);
+        for (int i = 0; i < library->done_count; i++)
+            shader_free_build(library->done[i]);
+        free(library->queue);
+        free(library->done);
+        pthread_cond_destroy(&library->has_work);
+        pthread_mutex_destroy(&library->lock);
+    }
+    if (library->worker_window)
+        glfwDestroyWindow(library->worker_window);
+    for (int i = 0; i < library->program_count; i++) {
+        uniform_table_free(&library->programs[i].uniforms);
+        glDeleteProgram(library->programs[i].program);
+        if (library->programs[i].building)
+            glDeleteProgram(library->programs[i].building);
+    }
+    if (library->inotify_fd >= 0)
+        close(library->inotify_fd);
+    memset(library, 0, sizeof(*library));
+}
+
+static void shader_describe(ShaderLibrary* library, ShaderProgram* target,
+                            const char* vertex, const char* fragment,
+                            uint32_t features) {
+    memset(target, 0, sizeof(*target));
+    snprintf(target->vertex, sizeof(target->vertex), "%s", vertex);
+    snprintf(target->fragment, sizeof(target->fragment), "%s", fragment);
+    target->features = features;
+    target->hash = shader_variant_hash(library, vertex, fragment, features);
+}
+
+ShaderProgram* shader_load_variant(ShaderLibrary* library, const char* vertex,
+                                   const char* fragment, uint32_t features) {
+    ShaderProgram *existing =
+        shader_find(library, shader_variant_hash(library, vertex, fragment, features));
+    if (existing)
+        return existing;
+    if (library->program_count == SHADER_MAX_PROGRAMS) {
+        fprintf(stderr, "Error: too many shader programs\n");
+        return NULL;
+    }
+    ShaderProgram *target = &library->programs[library->program_count];
+    shader_describe(library, target, vertex, fragment, features);
+
+    char *sources[3];
+    if (!shader_read_sources(library, target, sources))
+        return NULL;
+    GLuint program = shader_cache_load(library, target);
+    if (!program) {
+        program = shader_build(sources, shader_caching(library));
+        if (!shader_check(library, program, target)) {
+            glDeleteProgram(program);
+            shader_free_sources(sources);
+            return NULL;
+        }
+        shader_cache_store(library, target, program);
+    }
+    shader_free_sources(sources);
+    target->program = program;
+    uniform_table_build(&target->uniforms, program, NULL);
+    library->program_count++;
+    return target;
+}
+
+ShaderProgram* shader_load(ShaderLibrary* library, const char* vertex,
+                           const char* fragment) {
+    return shader_load_variant(library, vertex, fragment, 0);
+}
+
+int shader_prewarm(ShaderLibrary* library, const ShaderVariantDesc* variants,
+                   int count) {
+    double start = now_ms();
+    ShaderProgram *pending = (ShaderProgram *)calloc(count, sizeof(ShaderProgram));
+    bool *cached = (bool *)calloc(count, sizeof(bool));
+    int ready = 0, loaded = 0, from_cache = 0;
+
+    // Everything is issued first; only then is any link status read, which
+    // is the call that would wait on the compiler
+    for (int i = 0; i < count; i++) {
+        ShaderProgram *target = &pending[i];
+        shader_describe(library, target, variants[i].vertex, variants[i].fragment,
+                        variants[i].features);
+        bool duplicate = shader_find(library, target->hash) != NULL;
+        for (int j = 0; j < i && !duplicate; j++)
+            duplicate = pending[j].hash == target->hash;
+        if (duplicate) {
+            target->hash = 0;
+            ready++;
+            continue;
+        }
+
+        char *sources[3];
+        if (!shader_read_sources(library, target, sources))
+            continue;
+        target->program = shader_cache_load(library, target);
+        cached[i] = target->program != 0;
+        if (!cached[i])
+            target->program = shader_build(sources, shader_caching(library));
+        shader_free_sources(sources);
+    }
+
+    for (int i = 0; i < count; i++) {
+        ShaderProgram *target = &pending[i];
+        if (!target->program)
+            continue;
+        if (!cached[i] && !shader_check(library, target->program, target)) {
+            glDeleteProgram(target->program);
+            continue;
+        }
+        if (library->program_count == SHADER_MAX_PROGRAMS) {
+            fprintf(stderr, "Error: too many shader programs\n");
+            glDeleteProgram(target->program);
+            continue;
+        }
+        if (!cached[i])
+            shader_cache_store(library, target, target->program);
+        ShaderProgram *stored = &library->programs[library->program_count++];
+        *stored = *target;
+        uniform_table_build(&stored->uniforms, stored->program, NULL);
+        from_cache += cached[i];
+        loaded++;
+        ready++;
+    }
+    free(cached);
+    free(pending);
+
+    library->stats.prewarmed += loaded;
+    library->stats.prewarm_ms = now_ms() - start;
+    printf("prewarmed %d shader variants in %.1f ms, %d from the binary cache\n", loaded,
+           library->stats.prewarm_ms, from_cache);
+    return ready;
+}
+
+ShaderProgram* shader_variant(ShaderLibrary* library, const char* vertex,
+                              const char* fragment, uint32_t features) {
+    ShaderProgram *target =
+        shader_find(library, shader_variant_hash(library, vertex, fragment, features));
+    if (target)
+        return target;
+
+    double start = now_ms();
+    target = shader_load_variant(library, vertex, fragment, features);
+    char label[256];
+    shader_label(library, features, label, sizeof(label));
+    fprintf(stderr, "Warning: %s + %s [%s] was not prewarmed, compiling it stalled "
+            "the frame for %.1f ms\n", vertex, fragment, label, now_ms() - start);
+    library->stats.hitches++;
+    return target;
+}
+
+static void shader_rebuild(ShaderLibrary* library, ShaderProgram* target) {
+    // Edits landing mid-build are picked up when that build finishes
+    if (target->building || target->queued) {
+        target->dirty = true;
+        return;
+    }
+    char *sources[3];
+    if (!shader_read_sources(library, target, sources)) {
+        library->stats.failures++;
+        return;
+    }
+    target->started = now_ms();
+
+    if (library->backend == SHADER_BACKEND_WORKER) {
+        ShaderBuild *build = (ShaderBuild *)calloc(1, sizeof(ShaderBuild));
+        build->target = target;
+        memcpy(build->sources, sources, sizeof(sources));
+        target->queued = true;
+        pthread_mutex_lock(&library->lock);
+        library->queue[library->queue_count++] = build;
+        pthread_cond_signal(&library->has_work);
+        pthread_mutex_unlock(&library->lock);
+        return;
+    }
+
+    GLuint program = shader_build(sources, shader_caching(library));
+    shader_free_sources(sources);
+    if (library->backend == SHADER_BACKEND_PARALLEL)
+        target->building = program;
+    else
+        shader_finish(library, target, program);
+}
+
+void shader_library_stop_watching(ShaderLibrary* library) {
+    if (library->inotify_fd >= 0)
+        close(library->inotify_fd);
+    library->inotify_fd = -1;
+}
+
+static void shader_read_events(ShaderLibrary* library) {
+    char buffer[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    for (;;) {
+        ssize_t length = read(library->inotify_fd, buffer, sizeof(buffer));
+        if (length <= 0)
+            break;
+        for (char *p = buffer; p < buffer + length;) {
+            const struct inotify_event *event = (const struct inotify_event *)p;
+            p += sizeof(struct inotify_event) + event->len;
+            if (event->len == 0)
+                continue;
+            for (int i = 0; i < library->program_count; i++) {
+                ShaderProgram *target = &library->programs[i];
+                if (strcmp(event->name, target->vertex) == 0 ||
+                    strcmp(event->name, target->fragment) == 0)
+                    shader_rebuild(library, target);
+            }
+        }
+    }
+}
+
+void shader_library_poll(ShaderLibrary* library) {
+    if (library->inotify_fd >= 0)
+        shader_read_events(library);
+
+    if (library->backend == SHADER_BACKEND_PARALLEL) {
+        for (int i = 0; i < library->program_count; i++) {
+            ShaderProgram *target = &library->programs[i];
+            GLint complete = 0;
+            if (target->building) {
+                glGetProgramiv(target->building, GL_COMPLETION_STATUS_KHR, &complete);
+                if (complete)
+                    shader_finish(library, target, target->building);
+            }
+        }
+    } else if (library->backend == SHADER_BACKEND_WORKER) {
+        pthread_mutex_lock(&library->lock);
+        for (int i = 0; i < library->done_count;) {
+            ShaderBuild *build = library->done[i];
+            GLenum wait = glClientWaitSync(build->fence, 0, 0);
+            if (wait == GL_TIMEOUT_EXPIRED) {
+                i++;
+                continue;
+            }
+            library->done[i] = library->done[--library->done_count];
+            pthread_mutex_unlock(&library->lock);
+
+            // A failed wait says nothing about the program, so the build
+            // counts as failed. A rebuild started by shader_finish takes the
+            // lock itself.
+            GLuint program = 0;
+            if (wait == GL_ALREADY_SIGNALED || wait == GL_CONDITION_SATISFIED) {
+                program = build->program;
+                build->program = 0;
+            } else {
+                fprintf(stderr, "Error: waiting for %s + %s to build failed\n",
+                        build->target->vertex, build->target->fragment);
+            }
+            shader_finish(library, build->target, program);
+            shader_free_build(build);
+
+            pthread_mutex_lock(&library->lock);
+        }
+        pthread_mutex_unlock(&library->lock);
+    }
+}
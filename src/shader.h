@@ -0,0 +1,148 @@
+#ifndef SHADER_H
+#define SHADER_H
+
+#include <glad/gl.h>
+#define GLFW_INCLUDE_NONE
+#include <GLFW/glfw3.h>
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "uniform.h"
+
+#define SHADER_MAX_PROGRAMS 128
+#define SHADER_MAX_FEATURES 32
+#define SHADER_MAX_NAME 64
+#define SHADER_MAX_PATH 256
+
+typedef enum ShaderBackend {
+  SHADER_BACKEND_BLOCKING,
+  SHADER_BACKEND_PARALLEL,
+  SHADER_BACKEND_WORKER
+} ShaderBackend;
+
+// `program` is what callers draw with. A rebuild happens off to the side in
+// `building` and replaces it only once it has linked, so a broken edit
+// leaves the last good program in place. The GL name changes on every
+// swap, which is how callers know to look up uniform locations again.
+// Variants of the same files differ in `features`, each set bit turning
+// into a #define after the #version line. `uniforms` is rebuilt by
+// reflection on every swap and keeps the values set so far.
+typedef struct ShaderProgram {
+  GLuint program;
+  UniformTable uniforms;
+  char vertex[SHADER_MAX_NAME];
+  char fragment[SHADER_MAX_NAME];
+  uint32_t features;
+  uint64_t hash;
+  uint64_t source_hash;
+  GLuint building;
+  bool queued;
+  bool dirty;
+  double started;
+} ShaderProgram;
+
+// Sources are the vertex text, the fragment text and the defines
+typedef struct ShaderBuild {
+  ShaderProgram* target;
+  char* sources[3];
+  GLuint program;
+  GLsync fence;
+} ShaderBuild;
+
+// Hitches count variants compiled on demand at draw time, each one a
+// stall that a prewarm list should have covered
+typedef struct ShaderStats {
+  int reloads;
+  int failures;
+  double last_reload_ms;
+  int prewarmed;
+  double prewarm_ms;
+  int cache_hits;
+  int cache_misses;
+  int hitches;
+} ShaderStats;
+
+typedef struct ShaderVariantDesc {
+  const char* vertex;
+  const char* fragment;
+  uint32_t features;
+} ShaderVariantDesc;
+
+// Programs built from GLSL files in `directory`, rebuilt when inotify sees
+// them change. With KHR_parallel_shader_compile the driver compiles on its
+// own threads and the library polls for completion; otherwise a worker
+// thread with a context shared with the window does the compiling.
+typedef struct ShaderLibrary {
+  char directory[SHADER_MAX_PATH];
+  ShaderProgram programs[SHADER_MAX_PROGRAMS];
+  int program_count;
+  ShaderBackend backend;
+  int inotify_fd;
+  char features[SHADER_MAX_FEATURES][SHADER_MAX_NAME];
+  int feature_count;
+  char cache_directory[SHADER_MAX_PATH];
+  bool binaries;
+
+  GLFWwindow* worker_window;
+  pthread_t worker;
+  pthread_mutex_t lock;
+  pthread_cond_t has_work;
+  ShaderBuild** queue;
+  int queue_count;
+  ShaderBuild** done;
+  int done_count;
+  int build_capacity;
+  bool stopping;
+
+  ShaderStats stats;
+} ShaderLibrary;
+
+// `window` is the main window, its context must be current. NULL disables
+// the worker thread.
+bool shader_library_init(ShaderLibrary* library, const char* directory,
+                         GLFWwindow* window);
+void shader_library_destroy(ShaderLibrary* library);
+
+// Keeps linked program binaries in `directory`, keyed by variant hash and
+// checked against the sources and driver before use
+bool shader_library_set_cache(ShaderLibrary* library, const char* directory);
+
+// Bit for a feature define, registered on first use. 0 when the table is
+// full.
+uint32_t shader_feature(ShaderLibrary* library, const char* define);
+
+// Depends only on the file names and define names, not on the order the
+// features were registered in, so it is the same from run to run
+uint64_t shader_variant_hash(const ShaderLibrary* library, const char* vertex,
+                             const char* fragment, uint32_t features);
+
+// Builds synchronously from two files relative to the directory. Returns
+// NULL if either does not compile or the program does not link. Loading a
+// variant that already exists returns it.
+ShaderProgram* shader_load(ShaderLibrary* library, const char* vertex,
+                           const char* fragment);
+ShaderProgram* shader_load_variant(ShaderLibrary* library, const char* vertex,
+                                   const char* fragment, uint32_t features);
+
+// Builds every listed variant up front. All compiles are issued before any
+// result is read back, so drivers that compile in parallel get to. Returns
+// how many are ready.
+int shader_prewarm(ShaderLibrary* library, const ShaderVariantDesc* variants,
+                   int count);
+
+// Draw time lookup. A variant that was not prewarmed is still built, but
+// that stalls the frame, so it is counted and reported.
+ShaderProgram* shader_variant(ShaderLibrary* library, const char* vertex,
+                              const char* fragment, uint32_t features);
+
+// Stops rebuilding programs when their files change, for runs that have to
+// draw the same frames every time
+void shader_library_stop_watching(ShaderLibrary* library);
+
+// Picks up file changes and swaps in programs that finished building.
+// Call once per frame on the main thread; it never waits on the compiler.
+void shader_library_poll(ShaderLibrary* library);
+
+#endif
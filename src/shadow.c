@@ -0,0 +1,159 @@
+#include "shadow.h"
+
+#include <stdio.h>
+#include <string.h>
+
+static GLuint create_depth_target(int size, GLuint* texture) {
+    glGenTextures(1, texture);
+    glBindTexture(GL_TEXTURE_2D, *texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT24, size, size, 0,
+                 GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_MODE,
+                    GL_COMPARE_REF_TO_TEXTURE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+
+    GLuint fbo;
+    glGenFramebuffers(1, &fbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D,
+                           *texture, 0);
+    glDrawBuffer(GL_NONE);
+    glReadBuffer(GL_NONE);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+        fprintf(stderr, "Error: shadow atlas framebuffer incomplete\n");
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    return fbo;
+}
+
+void shadow_atlas_init(ShadowAtlas* atlas, int size, int tile_size) {
+    memset(atlas, 0, sizeof(*atlas));
+    atlas->size = size;
+    atlas->tile_size = tile_size;
+    atlas->static_fbo = create_depth_target(size, &atlas->static_depth);
+    atlas->fbo = create_depth_target(size, &atlas->depth);
+}
+
+void shadow_atlas_destroy(ShadowAtlas* atlas) {
+    glDeleteFramebuffers(1, &atlas->static_fbo);
+    glDeleteFramebuffers(1, &atlas->fbo);
+    glDeleteTextures(1, &atlas->static_depth);
+    glDeleteTextures(1, &atlas->depth);
+}
+
+int shadow_atlas_alloc(ShadowAtlas* atlas) {
+    int per_row = atlas->size / atlas->tile_size;
+    if (atlas->tile_count >= SHADOW_MAX_TILES ||
+        atlas->tile_count >= per_row * per_row)
+        return -1;
+
+    int id = atlas->tile_count++;
+    ShadowTile *tile = &atlas->tiles[id];
+    tile->x = (id % per_row) * atlas->tile_size;
+    tile->y = (id / per_row) * atlas->tile_size;
+    tile->size = atlas->tile_size;
+    tile->static_dirty = true;
+    mat4x4_identity(tile->view_proj);
+    frustum_from_matrix(&tile->frustum, tile->view_proj);
+    return id;
+}
+
+void shadow_atlas_set_light(ShadowAtlas* atlas, int id, mat4x4 view_proj) {
+    ShadowTile *tile = &atlas->tiles[id];
+    if (memcmp(tile->view_proj, view_proj, sizeof(mat4x4)) == 0)
+        return;
+
+    mat4x4_dup(tile->view_proj, view_proj);
+    frustum_from_matrix(&tile->frustum, view_proj);
+    tile->static_dirty = true;
+}
+
+void shadow_atlas_invalidate_static(ShadowAtlas* atlas, const vec3 center, float radius) {
+    for (int i = 0; i < atlas->tile_count; i++) {
+        ShadowTile *tile = &atlas->tiles[i];
+        if (frustum_test_sphere(&tile->frustum, center, radius))
+            tile->static_dirty = true;
+    }
+}
+
+void shadow_atlas_touch_dynamic(ShadowAtlas* atlas, const vec3 center, float radius) {
+    for (int i = 0; i < atlas->tile_count; i++) {
+        ShadowTile *tile = &atlas->tiles[i];
+        if (frustum_test_sphere(&tile->frustum, center, radius))
+            tile->has_dynamic = true;
+    }
+}
+
+static void begin_tile(const ShadowTile* tile) {
+    glViewport(tile->x, tile->y, tile->size, tile->size);
+    glScissor(tile->x, tile->y, tile->size, tile->size);
+}
+
+void shadow_atlas_update(ShadowAtlas* atlas, ShadowDrawFn draw, void* user) {
+    GLint viewport[4];
+    glGetIntegerv(GL_VIEWPORT, viewport);
+    glEnable(GL_SCISSOR_TEST);
+    glEnable(GL_DEPTH_TEST);
+    glDepthMask(GL_TRUE);
+
+    memset(&atlas->stats, 0, sizeof(atlas->stats));
+
+    for (int i = 0; i < atlas->tile_count; i++) {
+        ShadowTile *tile = &atlas->tiles[i];
+        bool refreshed = tile->static_dirty;
+
+        if (tile->static_dirty) {
+            glBindFramebuffer(GL_FRAMEBUFFER, atlas->static_fbo);
+            begin_tile(tile);
+            glClear(GL_DEPTH_BUFFER_BIT);
+            draw(tile->view_proj, false, user);
+            tile->static_dirty = false;
+            atlas->stats.static_renders++;
+        }
+
+        // A tile that had dynamic casters last frame must be restored from the
+        // static cache even if nothing touches it now, otherwise stale shadows
+        // of moved objects would remain.
+        if (!refreshed && !tile->has_dynamic && !tile->had_dynamic) {
+            atlas->stats.clean_tiles++;
+            continue;
+        }
+
+        // Blits are scissored too, so the rect must be this tile's even when
+        // its static part was not re-rendered
+        begin_tile(tile);
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, atlas->static_fbo);
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, atlas->fbo);
+        glBlitFramebuffer(tile->x, tile->y, tile->x + tile->size,
+                          tile->y + tile->size, tile->x, tile->y,
+                          tile->x + tile->size, tile->y + tile->size,
+                          GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+        atlas->stats.composites++;
+
+        if (tile->has_dynamic) {
+            glBindFramebuffer(GL_FRAMEBUFFER, atlas->fbo);
+            begin_tile(tile);
+            draw(tile->view_proj, true, user);
+            atlas->stats.dynamic_renders++;
+        }
+
+        tile->had_dynamic = tile->has_dynamic;
+        tile->has_dynamic = false;
+    }
+
+    glDisable(GL_SCISSOR_TEST);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+}
+
+void shadow_atlas_tile_rect(const ShadowAtlas* atlas, int id, vec4 uv_rect) {
+    const ShadowTile *tile = &atlas->tiles[id];
+    float inv = 1.0f / (float)atlas->size;
+    uv_rect[0] = tile->x * inv;
+    uv_rect[1] = tile->y * inv;
+    uv_rect[2] = tile->size * inv;
+    uv_rect[3] = tile->size * inv;
+}
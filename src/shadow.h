@@ -0,0 +1,57 @@
+#ifndef SHADOW_H
+#define SHADOW_H
+
+#include <glad/gl.h>
+
+#include <stdbool.h>
+
+#include "frustum.h"
+#include "linmath.h"
+
+#define SHADOW_MAX_TILES 64
+
+// Called once per tile that needs re-rendering. When `dynamic` is false only
+// static casters should be drawn, otherwise only moving ones.
+typedef void (*ShadowDrawFn)(mat4x4 light_view_proj, bool dynamic, void* user);
+
+typedef struct ShadowTile {
+  int x, y, size;
+  mat4x4 view_proj;
+  Frustum frustum;
+  bool static_dirty;
+  bool has_dynamic;
+  bool had_dynamic;
+} ShadowTile;
+
+typedef struct ShadowStats {
+  int static_renders;
+  int dynamic_renders;
+  int composites;
+  int clean_tiles;
+} ShadowStats;
+
+// Static casters are rendered into `static_depth` once and kept there. The
+// sampled atlas `depth` is rebuilt per tile only when its static part changed
+// or when dynamic casters touch it (this frame or the previous one).
+typedef struct ShadowAtlas {
+  int size;
+  int tile_size;
+  int tile_count;
+  GLuint static_fbo, static_depth;
+  GLuint fbo, depth;
+  ShadowTile tiles[SHADOW_MAX_TILES];
+  ShadowStats stats;
+} ShadowAtlas;
+
+void shadow_atlas_init(ShadowAtlas* atlas, int size, int tile_size);
+void shadow_atlas_destroy(ShadowAtlas* atlas);
+
+int shadow_atlas_alloc(ShadowAtlas* atlas);
+void shadow_atlas_set_light(ShadowAtlas* atlas, int tile, mat4x4 view_proj);
+void shadow_atlas_invalidate_static(ShadowAtlas* atlas, const vec3 center, float radius);
+void shadow_atlas_touch_dynamic(ShadowAtlas* atlas, const vec3 center, float radius);
+
+void shadow_atlas_update(ShadowAtlas* atlas, ShadowDrawFn draw, void* user);
+void shadow_atlas_tile_rect(const ShadowAtlas* atlas, int tile, vec4 uv_rect);
+
+#endif
@@ -0,0 +1,244 @@
+#include "stream.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+static double stream_now_ms() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e3 + ts.tv_nsec * 1e-6;
+}
+
+static int stream_floor_div(float v) {
+    return (int)floorf(v / CHUNK_SIZE);
+}
+
+// Min-heap on priority, lower is more urgent
+static void heap_push(ChunkStreamer* streamer, ChunkRequest request) {
+    if (streamer->heap_count == streamer->heap_capacity) {
+        streamer->heap_capacity =
+            streamer->heap_capacity ? streamer->heap_capacity * 2 : 256;
+        streamer->heap = (ChunkRequest *)realloc(
+            streamer->heap, streamer->heap_capacity * sizeof(ChunkRequest));
+    }
+
+    int i = streamer->heap_count++;
+    while (i > 0) {
+        int parent = (i - 1) / 2;
+        if (streamer->heap[parent].priority <= request.priority)
+            break;
+        streamer->heap[i] = streamer->heap[parent];
+        i = parent;
+    }
+    streamer->heap[i] = request;
+}
+
+static ChunkRequest heap_pop(ChunkStreamer* streamer) {
+    ChunkRequest top = streamer->heap[0];
+    ChunkRequest last = streamer->heap[--streamer->heap_count];
+
+    int i = 0;
+    while (true) {
+        int child = i * 2 + 1;
+        if (child >= streamer->heap_count)
+            break;
+        if (child + 1 < streamer->heap_count &&
+            streamer->heap[child + 1].priority < streamer->heap[child].priority)
+            child++;
+        if (last.priority <= streamer->heap[child].priority)
+            break;
+        streamer->heap[i] = streamer->heap[child];
+        i = child;
+    }
+    if (streamer->heap_count > 0)
+        streamer->heap[i] = last;
+    return top;
+}
+
+static void stream_generate_job(void* arg) {
+    Chunk *chunk = (Chunk *)arg;
+    ChunkStreamer *streamer = (ChunkStreamer *)chunk->owner;
+    ChunkWorld *world = chunk->world;
+
+    streamer->generate(chunk, streamer->user);
+
+    pthread_mutex_lock(&world->lock);
+    chunk->state = CHUNK_EMPTY;
+    pthread_mutex_unlock(&world->lock);
+}
+
+void chunk_streamer_init(ChunkStreamer* streamer, ChunkWorld* world,
+                         ChunkGenerateFn generate, void* user) {
+    memset(streamer, 0, sizeof(*streamer));
+    streamer->world = world;
+    streamer->generate = generate;
+    streamer->user = user;
+    streamer->view_radius = 8;
+    streamer->min_y = 0;
+    streamer->max_y = 1;
+    streamer->max_in_flight = 2 * world->jobs->thread_count + 2;
+    streamer->uploads_per_frame = 4;
+    streamer->memory_cap = (size_t)512 * 1024 * 1024;
+    streamer->hitch_ms = 16.0;
+}
+
+void chunk_streamer_destroy(ChunkStreamer* streamer) {
+    job_wait(streamer->world->jobs);
+    free(streamer->heap);
+}
+
+size_t chunk_streamer_memory(const ChunkStreamer* streamer) {
+    const ChunkWorld *world = streamer->world;
+    return (size_t)world->chunk_count * sizeof(Chunk) +
+           (size_t)world->vertices.used * world->vertices.element_size +
+           (size_t)world->indices.used * world->indices.element_size;
+}
+
+static bool stream_neighbors_generated(ChunkStreamer* streamer, Chunk* chunk) {
+    for (int i = 0; i < 6; i++) {
+        Chunk *neighbor = chunk->neighbors[i];
+        if (neighbor) {
+            if (neighbor->state == CHUNK_GENERATING)
+                return false;
+            continue;
+        }
+        // Neighbours outside the vertical range never exist
+        bool vertical = i == CHUNK_NEG_Y || i == CHUNK_POS_Y;
+        int ny = chunk->y + (i == CHUNK_POS_Y) - (i == CHUNK_NEG_Y);
+        if (!vertical || (ny >= streamer->min_y && ny <= streamer->max_y))
+            return false;
+    }
+    return true;
+}
+
+static void stream_evict(ChunkStreamer* streamer, int cx, int cz) {
+    ChunkWorld *world = streamer->world;
+
+    // Chunks well outside the view radius are dropped regardless of memory so
+    // the world does not grow forever.
+    int keep = streamer->view_radius + 2;
+    for (int i = world->chunk_count - 1; i >= 0; i--) {
+        Chunk *chunk = world->chunks[i];
+        if (abs(chunk->x - cx) > keep || abs(chunk->z - cz) > keep) {
+            if (chunk_world_remove(world, chunk))
+                streamer->stats.evicted++;
+        }
+    }
+
+    while (chunk_streamer_memory(streamer) > streamer->memory_cap) {
+        Chunk *oldest = NULL;
+        for (int i = 0; i < world->chunk_count; i++) {
+            Chunk *chunk = world->chunks[i];
+            if (chunk->last_used == streamer->frame)
+                continue;
+            if (!oldest || chunk->last_used < oldest->last_used)
+                oldest = chunk;
+        }
+        if (!oldest || !chunk_world_remove(world, oldest))
+            break;
+        streamer->stats.evicted++;
+    }
+}
+
+void chunk_streamer_update(ChunkStreamer* streamer, const vec3 position,
+                           const vec3 front, double frame_ms) {
+    double start = stream_now_ms();
+    ChunkWorld *world = streamer->world;
+
+    // Stats still describe the previous frame, which is the one that hitched
+    if (frame_ms > streamer->stats.worst_frame_ms)
+        streamer->stats.worst_frame_ms = frame_ms;
+    if (frame_ms > streamer->hitch_ms) {
+        streamer->stats.hitches++;
+        fprintf(stderr,
+                "hitch: %.2f ms frame (streaming %.2f ms, %d uploads, "
+                "%d jobs in flight)\n",
+                frame_ms, streamer->stats.update_ms, streamer->stats.uploaded,
+                streamer->in_flight);
+    }
+
+    streamer->frame++;
+
+    int cx = stream_floor_div(position[0]);
+    int cz = stream_floor_div(position[2]);
+    int r = streamer->view_radius;
+
+    pthread_mutex_lock(&world->lock);
+    streamer->in_flight = 0;
+    for (int i = 0; i < world->chunk_count; i++) {
+        int state = world->chunks[i]->state;
+        streamer->in_flight += state == CHUNK_GENERATING || state == CHUNK_MESHING;
+    }
+    pthread_mutex_unlock(&world->lock);
+
+    // Collect what is missing or waiting for a mesh. Generation reaches one
+    // ring further than meshing so every meshed chunk has its neighbours.
+    // Distance is weighted by how far the chunk is from the view direction so
+    // what the camera looks at streams in first.
+    streamer->heap_count = 0;
+    int outer = r + 1;
+    for (int z = cz - outer; z <= cz + outer; z++) {
+        for (int x = cx - outer; x <= cx + outer; x++) {
+            int distance2 = (x - cx) * (x - cx) + (z - cz) * (z - cz);
+            if (distance2 > outer * outer)
+                continue;
+            bool inner = distance2 <= r * r;
+            for (int y = streamer->min_y; y <= streamer->max_y; y++) {
+                Chunk *chunk = chunk_world_find(world, x, y, z);
+                if (chunk) {
+                    chunk->last_used = streamer->frame;
+                    if (chunk->state != CHUNK_EMPTY || !inner)
+                        continue;
+                }
+
+                vec3 center = {(x + 0.5f) * CHUNK_SIZE, (y + 0.5f) * CHUNK_SIZE,
+                               (z + 0.5f) * CHUNK_SIZE};
+                vec3 to_chunk;
+                vec3_sub(to_chunk, center, position);
+                float distance = vec3_len(to_chunk);
+                float facing =
+                    distance > 0.0f ? vec3_mul_inner(to_chunk, front) / distance
+                                    : 1.0f;
+                ChunkRequest request = {x, y, z,
+                                        distance * (1.5f - 0.5f * facing)};
+                heap_push(streamer, request);
+            }
+        }
+    }
+
+    while (streamer->heap_count > 0 &&
+           streamer->in_flight < streamer->max_in_flight) {
+        ChunkRequest request = heap_pop(streamer);
+        Chunk *chunk = chunk_world_find(world, request.x, request.y, request.z);
+        if (!chunk) {
+            chunk = chunk_world_add(world, request.x, request.y, request.z);
+            chunk->owner = streamer;
+            chunk->last_used = streamer->frame;
+            chunk->state = CHUNK_GENERATING;
+            job_submit(world->jobs, stream_generate_job, chunk);
+            streamer->stats.generated++;
+            streamer->in_flight++;
+            continue;
+        }
+
+        pthread_mutex_lock(&world->lock);
+        bool ready = chunk->state == CHUNK_EMPTY &&
+                     stream_neighbors_generated(streamer, chunk);
+        pthread_mutex_unlock(&world->lock);
+        if (ready) {
+            chunk_world_remesh(world, chunk);
+            streamer->in_flight++;
+        }
+    }
+
+    streamer->stats.uploaded =
+        chunk_world_upload(world, streamer->uploads_per_frame);
+    stream_evict(streamer, cx, cz);
+
+    streamer->stats.resident = world->chunk_count;
+    streamer->stats.memory = chunk_streamer_memory(streamer);
+    streamer->stats.update_ms = stream_now_ms() - start;
+}
@@ -0,0 +1,61 @@
+#ifndef STREAM_H
+#define STREAM_H
+
+#include <stdint.h>
+
+#include "chunk.h"
+#include "linmath.h"
+
+// Runs on a worker thread and must only write `chunk->blocks`
+typedef void (*ChunkGenerateFn)(Chunk* chunk, void* user);
+
+typedef struct ChunkRequest {
+  int x, y, z;
+  float priority;
+} ChunkRequest;
+
+typedef struct ChunkStreamStats {
+  int resident;
+  int generated;
+  int uploaded;
+  int evicted;
+  int hitches;
+  double update_ms;
+  double worst_frame_ms;
+  size_t memory;
+} ChunkStreamStats;
+
+// Keeps the chunks within `view_radius` of the camera loaded. Missing chunks
+// are generated and meshed on the world's job system, nearest and most
+// in-view first. GPU uploads are capped per frame and chunks that have not
+// been in range for the longest time are evicted when over `memory_cap`.
+typedef struct ChunkStreamer {
+  ChunkWorld* world;
+  ChunkGenerateFn generate;
+  void* user;
+  int view_radius;
+  int min_y, max_y;
+  int max_in_flight;
+  int uploads_per_frame;
+  size_t memory_cap;
+  double hitch_ms;
+  int in_flight;
+  uint64_t frame;
+  ChunkRequest* heap;
+  int heap_count;
+  int heap_capacity;
+  ChunkStreamStats stats;
+} ChunkStreamer;
+
+void chunk_streamer_init(ChunkStreamer* streamer, ChunkWorld* world,
+                         ChunkGenerateFn generate, void* user);
+void chunk_streamer_destroy(ChunkStreamer* streamer);
+
+// `frame_ms` is the duration of the previous frame and is only used for
+// hitch reporting.
+void chunk_streamer_update(ChunkStreamer* streamer, const vec3 position,
+                           const vec3 front, double frame_ms);
+
+size_t chunk_streamer_memory(const ChunkStreamer* streamer);
+
+#endif
@@ -0,0 +1,261 @@
+#include "texture.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+
+#include "bcn.h"
+#include "ktx2.h"
+#include "mip.h"
+#include "vfs.h"
+
+// S3TC is an extension even in core profiles, glad only knows core enums
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#define GL_COMPRESSED_SRGB_S3TC_DXT1_EXT 0x8C4C
+#define GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT 0x8C4F
+
+static bool texture_has_extension(const char* name) {
+    GLint count = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+    for (GLint i = 0; i < count; i++) {
+        const char *extension = (const char *)glGetStringi(GL_EXTENSIONS, i);
+        if (extension && strcmp(extension, name) == 0)
+            return true;
+    }
+    return false;
+}
+
+// Compressed internal format for a cooked texture, 0 when the driver cannot
+// sample it and the blocks have to be decoded on the CPU
+static GLenum texture_compressed_format(BcnFormat format, bool srgb) {
+    static int s3tc = -1, s3tc_srgb = -1, bptc = -1;
+    if (s3tc < 0) {
+        s3tc = texture_has_extension("GL_EXT_texture_compression_s3tc");
+        s3tc_srgb = s3tc && (texture_has_extension("GL_EXT_texture_sRGB") ||
+                             texture_has_extension("GL_EXT_texture_compression_s3tc_srgb"));
+        bptc = GLAD_GL_VERSION_4_2 ||
+               texture_has_extension("GL_ARB_texture_compression_bptc");
+    }
+
+    switch (format) {
+    case BCN_BC1:
+        if (srgb)
+            return s3tc_srgb ? GL_COMPRESSED_SRGB_S3TC_DXT1_EXT : 0;
+        return s3tc ? GL_COMPRESSED_RGB_S3TC_DXT1_EXT : 0;
+    case BCN_BC3:
+        if (srgb)
+            return s3tc_srgb ? GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT : 0;
+        return s3tc ? GL_COMPRESSED_RGBA_S3TC_DXT5_EXT : 0;
+    case BCN_BC4:
+        return GL_COMPRESSED_RED_RGTC1;
+    case BCN_BC5:
+        return GL_COMPRESSED_RG_RGTC2;
+    case BCN_BC7:
+        if (!bptc)
+            return 0;
+        return srgb ? GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM : GL_COMPRESSED_RGBA_BPTC_UNORM;
+    default:
+        return 0;
+    }
+}
+
+static void texture_parameters(int level_count) {
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER,
+                    level_count > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, level_count - 1);
+}
+
+// Levels that fell off the bottom of a shorter chain are released with
+// zero sized images, they are past MAX_LEVEL and never sampled
+static void texture_release_levels(int first, int count) {
+    for (int level = first; level < count; level++)
+        glTexImage2D(GL_TEXTURE_2D, level, GL_RGBA8, 0, 0, 0, GL_RGBA, GL_UNSIGNED_BYTE,
+                     NULL);
+}
+
+static bool texture_decode_ktx2(const char* name, const unsigned char* data,
+                                size_t size, int base_level, TextureImage* image) {
+    Ktx2Texture ktx;
+    BcnFormat format;
+    bool srgb;
+    if (!ktx2_parse(&ktx, data, size) ||
+        !ktx2_bcn_format(ktx.vk_format, &format, &srgb)) {
+        fprintf(stderr, "Error: %s is not a supported KTX2 texture\n", name);
+        return false;
+    }
+    if (base_level >= ktx.level_count)
+        base_level = ktx.level_count - 1;
+
+    image->width = ktx.width;
+    image->height = ktx.height;
+    image->base_level = base_level;
+    image->srgb = srgb;
+    image->compressed = true;
+    image->bcn_format = format;
+    // Keep whatever prefix of the chain is intact so the texture stays complete
+    int level = base_level;
+    for (; level < ktx.level_count; level++) {
+        int w = ktx.width >> level > 0 ? ktx.width >> level : 1;
+        int h = ktx.height >> level > 0 ? ktx.height >> level : 1;
+        size_t bytes = bcn_image_size(format, w, h);
+        if (ktx.level_sizes[level] < bytes) {
+            fprintf(stderr, "Error: %s level %d is truncated\n", name, level);
+            break;
+        }
+        image->widths[level] = w;
+        image->heights[level] = h;
+        image->level_sizes[level] = bytes;
+        image->levels[level] = (unsigned char *)malloc(bytes);
+        memcpy(image->levels[level], ktx.levels[level], bytes);
+    }
+    if (level == base_level)
+        return false;
+    image->level_count = level;
+    return true;
+}
+
+bool texture_decode(const char* name, const unsigned char* encoded, size_t size,
+                    int base_level, TextureImage* image) {
+    memset(image, 0, sizeof(*image));
+    if (ktx2_is_ktx2(encoded, size))
+        return texture_decode_ktx2(name, encoded, size, base_level, image);
+
+    int width, height, channels;
+    unsigned char *data = stbi_load_from_memory(encoded, (int)size, &width,
+                                                &height, &channels, 4);
+    if (!data) {
+        fprintf(stderr, "Error: cannot decode %s: %s\n", name,
+                stbi_failure_reason());
+        return false;
+    }
+
+    // Mips are built on the CPU rather than with glGenerateMipmap, which
+    // stalls and filters differently on every driver. Colour images are
+    // assumed to be sRGB encoded.
+    MipChain chain;
+    mip_chain_build(&chain, data, width, height, 0, MIP_FILTER_KAISER,
+                    channels >= 3, NULL);
+    if (base_level >= chain.level_count)
+        base_level = chain.level_count - 1;
+
+    // The image takes over the chain's levels, and level 0 from stb_image
+    image->width = width;
+    image->height = height;
+    image->level_count = chain.level_count;
+    image->base_level = base_level;
+    image->channels = channels;
+    image->srgb = channels >= 3;
+    for (int level = 0; level < chain.level_count; level++) {
+        unsigned char *pixels = level == 0 ? data : chain.levels[level];
+        if (level < base_level) {
+            free(pixels);
+            continue;
+        }
+        image->widths[level] = chain.widths[level];
+        image->heights[level] = chain.heights[level];
+        image->levels[level] = pixels;
+        image->level_sizes[level] = (size_t)chain.widths[level] * chain.heights[level] * 4;
+    }
+    return true;
+}
+
+void texture_image_free(TextureImage* image) {
+    for (int level = 0; level < TEXTURE_MAX_LEVELS; level++)
+        free(image->levels[level]);
+    memset(image, 0, sizeof(*image));
+}
+
+GLuint texture_upload_image(GLuint texture, const char* name,
+                            const TextureImage* image, TextureInfo* info) {
+    int base_level = image->base_level;
+    BcnFormat bcn = (BcnFormat)image->bcn_format;
+    GLenum internal = image->compressed ? texture_compressed_format(bcn, image->srgb) : 0;
+    // stb_image expands every image to RGBA, so grey and grey + alpha keep
+    // all four channels too. Drivers pad RGB8 to four bytes a texel.
+    GLenum format = image->channels == 3 ? GL_RGB8 : GL_RGBA8;
+    const int texel_bytes = 4;
+
+    bool created = texture == 0;
+    if (created)
+        glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+
+    // Blocks the driver cannot sample are decoded here, it needs to know
+    unsigned char *rgba = NULL;
+    if (image->compressed && !internal)
+        rgba = (unsigned char *)malloc((size_t)image->widths[base_level] *
+                                       image->heights[base_level] * 4);
+    size_t bytes = 0;
+    int level = base_level;
+    for (; level < image->level_count; level++) {
+        int w = image->widths[level], h = image->heights[level];
+        if (!image->compressed) {
+            glTexImage2D(GL_TEXTURE_2D, level - base_level, format, w, h, 0, GL_RGBA,
+                         GL_UNSIGNED_BYTE, image->levels[level]);
+            bytes += (size_t)w * h * texel_bytes;
+        } else if (internal) {
+            glCompressedTexImage2D(GL_TEXTURE_2D, level - base_level, internal, w, h, 0,
+                                   (GLsizei)image->level_sizes[level],
+                                   image->levels[level]);
+            bytes += image->level_sizes[level];
+        } else if (bcn_decode_image(bcn, image->levels[level], w, h, rgba)) {
+            glTexImage2D(GL_TEXTURE_2D, level - base_level,
+                         image->srgb ? GL_SRGB8_ALPHA8 : GL_RGBA8, w, h, 0, GL_RGBA,
+                         GL_UNSIGNED_BYTE, rgba);
+            bytes += (size_t)w * h * 4;
+        } else {
+            fprintf(stderr, "Error: cannot decode %s level %d\n", name, level);
+            break;
+        }
+    }
+    free(rgba);
+
+    int uploaded = level - base_level;
+    if (uploaded == 0) {
+        if (created)
+            glDeleteTextures(1, &texture);
+        return 0;
+    }
+    if (!created)
+        texture_release_levels(uploaded, image->level_count);
+    texture_parameters(uploaded);
+    if (info) {
+        info->width = image->width;
+        info->height = image->height;
+        info->level_count = image->level_count;
+        info->base_level = base_level;
+        info->bytes = bytes;
+    }
+    return texture;
+}
+
+GLuint texture_upload(GLuint texture, const char* name, const unsigned char* encoded,
+                      size_t size, int base_level, TextureInfo* info) {
+    TextureImage image;
+    if (!texture_decode(name, encoded, size, base_level, &image))
+        return 0;
+    texture = texture_upload_image(texture, name, &image, info);
+    texture_image_free(&image);
+    return texture;
+}
+
+GLuint texture_from_memory(const char* name, const unsigned char* encoded,
+                           size_t size) {
+    return texture_upload(0, name, encoded, size, 0, NULL);
+}
+
+GLuint texture_load(const char* path) {
+    VfsFile file;
+    if (!vfs_open(&file, path))
+        return 0;
+    GLuint texture = texture_from_memory(path, file.data, file.size);
+    vfs_close(&file);
+    return texture;
+}
@@ -0,0 +1,59 @@
+#ifndef TEXTURE_H
+#define TEXTURE_H
+
+#include <glad/gl.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#define TEXTURE_MAX_LEVELS 16
+
+// Describes the full mip chain of a source image and what was uploaded
+typedef struct TextureInfo {
+  int width;
+  int height;
+  int level_count;
+  int base_level;
+  size_t bytes;
+} TextureInfo;
+
+// The chain of an image from `base_level` down, decoded on any thread and
+// uploaded later by texture_upload_image. Cooked KTX2 keeps its BCn blocks
+// (`bcn_format` is a BcnFormat), anything else is RGBA8 with mips built.
+typedef struct TextureImage {
+  int width;
+  int height;
+  int level_count;
+  int base_level;
+  int channels;
+  bool srgb;
+  bool compressed;
+  int bcn_format;
+  int widths[TEXTURE_MAX_LEVELS];
+  int heights[TEXTURE_MAX_LEVELS];
+  unsigned char* levels[TEXTURE_MAX_LEVELS];
+  size_t level_sizes[TEXTURE_MAX_LEVELS];
+} TextureImage;
+
+// Loads an image through the VFS into a mipmapped, repeating 2D texture.
+// KTX2 files cooked to BCn are uploaded compressed when the driver supports
+// the format and decoded on the CPU otherwise; anything else goes through
+// stb_image. Returns 0 when the file cannot be read or decoded.
+GLuint texture_load(const char* path);
+// Same for an encoded image already in memory, `name` is used in errors
+GLuint texture_from_memory(const char* name, const unsigned char* data,
+                           size_t size);
+// Uploads the chain from `base_level` down, so GL level 0 is source level
+// `base_level`, into `texture`, or a new texture when it is 0. Levels no
+// longer in the chain are released. Fills `info` when not NULL.
+GLuint texture_upload(GLuint texture, const char* name, const unsigned char* data,
+                      size_t size, int base_level, TextureInfo* info);
+
+// texture_upload split in two: the decode does no GL and may run on a job,
+// the upload must run on the GL thread
+bool texture_decode(const char* name, const unsigned char* data, size_t size,
+                    int base_level, TextureImage* image);
+GLuint texture_upload_image(GLuint texture, const char* name,
+                            const TextureImage* image, TextureInfo* info);
+void texture_image_free(TextureImage* image);
+
+#endif
@@ -0,0 +1,251 @@
+#include "texture_budget.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "vfs.h"
+
+void texture_budget_init(TextureBudget* budget, size_t bytes, AsyncIo* io,
+                         JobSystem* jobs) {
+    memset(budget, 0, sizeof(*budget));
+    budget->budget = bytes;
+    budget->min_size = 64;
+    budget->restore_frames = 2;
+    budget->restores_per_frame = 1;
+    budget->evictions_per_frame = 2;
+    budget->io = io;
+    budget->jobs = jobs;
+    pthread_mutex_init(&budget->lock, NULL);
+}
+
+static void texture_budget_free_change(BudgetChange* change) {
+    texture_image_free(&change->image);
+    free(change->data);
+    free(change->path);
+    free(change);
+}
+
+void texture_budget_destroy(TextureBudget* budget) {
+    // Decodes in flight write into the ready list
+    if (budget->jobs)
+        job_wait_counter(budget->jobs, &budget->decodes);
+    for (int i = 0; i < budget->ready_count; i++)
+        texture_budget_free_change(budget->ready[i]);
+    free(budget->ready);
+    for (int i = 0; i < budget->count; i++) {
+        glDeleteTextures(1, &budget->textures[i].texture);
+        free(budget->textures[i].path);
+    }
+    free(budget->textures);
+    pthread_mutex_destroy(&budget->lock);
+    memset(budget, 0, sizeof(*budget));
+}
+
+int texture_budget_load(TextureBudget* budget, const char* path) {
+    VfsFile file;
+    if (!vfs_open(&file, path))
+        return -1;
+    TextureInfo info;
+    GLuint name = texture_upload(0, path, file.data, file.size, 0, &info);
+    vfs_close(&file);
+    if (!name)
+        return -1;
+
+    if (budget->count == budget->capacity) {
+        budget->capacity = budget->capacity ? budget->capacity * 2 : 16;
+        budget->textures = (BudgetTexture *)realloc(
+            budget->textures, budget->capacity * sizeof(BudgetTexture));
+    }
+    BudgetTexture *texture = &budget->textures[budget->count];
+    memset(texture, 0, sizeof(*texture));
+    texture->texture = name;
+    texture->path = strdup(path);
+    texture->info = info;
+    texture->last_used = budget->frame;
+    budget->stats.usage += info.bytes;
+    budget->stats.full_usage += info.bytes;
+    return budget->count++;
+}
+
+GLuint texture_budget_use(TextureBudget* budget, int handle) {
+    if (handle < 0 || handle >= budget->count)
+        return 0;
+    BudgetTexture *texture = &budget->textures[handle];
+    texture->last_used = budget->frame;
+    return texture->texture;
+}
+
+static bool texture_budget_can_drop(const TextureBudget* budget,
+                                    const BudgetTexture* texture) {
+    int next = texture->info.base_level + 1;
+    int w = texture->info.width >> next, h = texture->info.height >> next;
+    return !texture->changing && next < texture->info.level_count &&
+           (w > h ? w : h) >= budget->min_size;
+}
+
+static void texture_budget_push_ready(TextureBudget* budget, BudgetChange* change) {
+    pthread_mutex_lock(&budget->lock);
+    if (budget->ready_count == budget->ready_capacity) {
+        budget->ready_capacity = budget->ready_capacity ? budget->ready_capacity * 2 : 16;
+        budget->ready = (BudgetChange **)realloc(
+            budget->ready, budget->ready_capacity * sizeof(BudgetChange *));
+    }
+    budget->ready[budget->ready_count++] = change;
+    pthread_mutex_unlock(&budget->lock);
+}
+
+// Runs on a worker when the budget has jobs. Without `io` the file is read
+// here too.
+static void texture_budget_decode_job(void* arg) {
+    BudgetChange *change = (BudgetChange *)arg;
+    if (change->data) {
+        change->ok = texture_decode(change->path, change->data, change->size,
+                                    change->base_level, &change->image);
+        free(change->data);
+        change->data = NULL;
+    } else {
+        VfsFile file;
+        if (vfs_open(&file, change->path)) {
+            change->ok = texture_decode(change->path, file.data, file.size,
+                                        change->base_level, &change->image);
+            vfs_close(&file);
+        }
+    }
+    texture_budget_push_ready(change->budget, change);
+}
+
+static void texture_budget_decode(TextureBudget* budget, BudgetChange* change) {
+    if (budget->jobs)
+        job_submit_counted(budget->jobs, texture_budget_decode_job, change,
+                           &budget->decodes);
+    else
+        texture_budget_decode_job(change);
+}
+
+static void texture_budget_on_read(AioResult* result) {
+    BudgetChange *change = (BudgetChange *)result->user;
+    if (result->status != AIO_DONE) {
+        free(result->data);
+        texture_budget_push_ready(change->budget, change);
+        return;
+    }
+    change->data = result->data;
+    change->size = result->size;
+    texture_budget_decode(change->budget, change);
+}
+
+static bool texture_budget_change(TextureBudget* budget, int handle, int base_level,
+                                  size_t releasing) {
+    BudgetTexture *texture = &budget->textures[handle];
+    BudgetChange *change = (BudgetChange *)calloc(1, sizeof(BudgetChange));
+    change->budget = budget;
+    change->handle = handle;
+    change->base_level = base_level;
+    change->path = strdup(texture->path);
+    change->releasing = releasing;
+    texture->changing = true;
+    budget->releasing += releasing;
+
+    if (!budget->io) {
+        texture_budget_decode(budget, change);
+    } else if (aio_read_file(budget->io, change->path, AIO_PRIORITY_LOW,
+                             texture_budget_on_read, change) == AIO_INVALID_HANDLE) {
+        texture->changing = false;
+        budget->releasing -= releasing;
+        texture_budget_free_change(change);
+        return false;
+    }
+    return true;
+}
+
+// Uploads the changes decoded since the last update
+static void texture_budget_apply(TextureBudget* budget) {
+    pthread_mutex_lock(&budget->lock);
+    BudgetChange **ready = budget->ready;
+    int count = budget->ready_count;
+    budget->ready = NULL;
+    budget->ready_count = 0;
+    budget->ready_capacity = 0;
+    pthread_mutex_unlock(&budget->lock);
+
+    for (int i = 0; i < count; i++) {
+        BudgetChange *change = ready[i];
+        BudgetTexture *texture = &budget->textures[change->handle];
+        TextureInfo info;
+        texture->changing = false;
+        budget->releasing -= change->releasing;
+        if (change->ok && texture_upload_image(texture->texture, texture->path,
+                                               &change->image, &info)) {
+            if (info.base_level > texture->info.base_level) {
+                budget->stats.evictions++;
+                budget->stats.total_evictions++;
+            } else {
+                budget->stats.restores++;
+                budget->stats.total_restores++;
+            }
+            budget->stats.usage = budget->stats.usage - texture->info.bytes + info.bytes;
+            texture->info = info;
+        }
+        texture_budget_free_change(change);
+    }
+    free(ready);
+}
+
+void texture_budget_update(TextureBudget* budget) {
+    budget->stats.evictions = 0;
+    budget->stats.restores = 0;
+    texture_budget_apply(budget);
+
+    // Textures drawn this frame are left alone even when over budget. A
+    // dropped level frees about three quarters of a texture, which counts
+    // as released while the smaller chain is still being decoded.
+    int evicting = 0;
+    while (budget->stats.usage > budget->budget + budget->releasing &&
+           evicting < budget->evictions_per_frame) {
+        int victim = -1;
+        for (int i = 0; i < budget->count; i++) {
+            BudgetTexture *texture = &budget->textures[i];
+            if (texture->last_used < budget->frame &&
+                texture_budget_can_drop(budget, texture) &&
+                (victim < 0 || texture->last_used < budget->textures[victim].last_used))
+                victim = i;
+        }
+        if (victim < 0)
+            break;
+        BudgetTexture *texture = &budget->textures[victim];
+        if (!texture_budget_change(budget, victim, texture->info.base_level + 1,
+                                   texture->info.bytes - texture->info.bytes / 4))
+            break;
+        evicting++;
+    }
+
+    // Bringing a level back roughly quadruples a texture, so a restore only
+    // starts when that still fits. Most recently used go first.
+    int started = 0;
+    size_t pending = 0;
+    while (started < budget->restores_per_frame) {
+        int best = -1;
+        for (int i = 0; i < budget->count; i++) {
+            BudgetTexture *texture = &budget->textures[i];
+            if (texture->info.base_level == 0 || texture->changing ||
+                texture->last_used + budget->restore_frames < budget->frame ||
+                budget->stats.usage + pending + texture->info.bytes * 3 > budget->budget)
+                continue;
+            if (best < 0 || texture->last_used > budget->textures[best].last_used)
+                best = i;
+        }
+        if (best < 0)
+            break;
+        BudgetTexture *texture = &budget->textures[best];
+        pending += texture->info.bytes * 3;
+        if (!texture_budget_change(budget, best, texture->info.base_level - 1, 0))
+            break;
+        started++;
+    }
+
+    budget->stats.degraded = 0;
+    for (int i = 0; i < budget->count; i++)
+        budget->stats.degraded += budget->textures[i].info.base_level > 0;
+    budget->frame++;
+}
@@ -0,0 +1,88 @@
+#ifndef TEXTURE_BUDGET_H
+#define TEXTURE_BUDGET_H
+
+#include <glad/gl.h>
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "aio.h"
+#include "job.h"
+#include "texture.h"
+
+typedef struct BudgetTexture {
+  GLuint texture;
+  char* path;
+  TextureInfo info;
+  uint64_t last_used;
+  bool changing;
+} BudgetTexture;
+
+// A texture moving to `base_level`, read and decoded away from the GL
+// thread and uploaded by the next texture_budget_update
+typedef struct BudgetChange {
+  struct TextureBudget* budget;
+  int handle;
+  int base_level;
+  char* path;
+  unsigned char* data;
+  size_t size;
+  size_t releasing;
+  bool ok;
+  TextureImage image;
+} BudgetChange;
+
+// Evictions and restores count levels changed over the last frame
+typedef struct TextureBudgetStats {
+  size_t usage;
+  size_t full_usage;
+  int degraded;
+  int evictions;
+  int restores;
+  long total_evictions;
+  long total_restores;
+} TextureBudgetStats;
+
+// Tracks the GPU memory of every texture it loads and keeps the total under
+// `budget` by dropping the top mip of the least recently used texture, one
+// level at a time. Textures used again are streamed back up a level per
+// update while there is room. Texture names stay the same throughout, only
+// their levels are respecified. Both directions re-read and decode the
+// file, so at most `evictions_per_frame` and `restores_per_frame` start per
+// update and the decode runs on the job system.
+typedef struct TextureBudget {
+  BudgetTexture* textures;
+  int count;
+  int capacity;
+  size_t budget;
+  int min_size;
+  int restore_frames;
+  int restores_per_frame;
+  int evictions_per_frame;
+  uint64_t frame;
+  AsyncIo* io;
+  JobSystem* jobs;
+  JobCounter decodes;
+  size_t releasing;
+  pthread_mutex_t lock;
+  BudgetChange** ready;
+  int ready_count;
+  int ready_capacity;
+  TextureBudgetStats stats;
+} TextureBudget;
+
+// With `io` files are read asynchronously; it must be destroyed before the
+// budget since its pending callbacks refer to it. With `jobs` the decode
+// runs there, otherwise on the GL thread.
+void texture_budget_init(TextureBudget* budget, size_t bytes, AsyncIo* io,
+                         JobSystem* jobs);
+void texture_budget_destroy(TextureBudget* budget);
+
+// Loads the full chain through the VFS, returns a handle or -1
+int texture_budget_load(TextureBudget* budget, const char* path);
+// Marks the texture as used this frame and returns its GL name
+GLuint texture_budget_use(TextureBudget* budget, int handle);
+// Call once per frame after drawing
+void texture_budget_update(TextureBudget* budget);
+
+#endif
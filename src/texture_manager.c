@@ -0,0 +1,246 @@
+#include "texture_manager.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "stb_image.h"
+
+#include "bcn.h"
+#include "ktx2.h"
+#include "mip.h"
+#include "vfs.h"
+
+// Atlas rectangles are placed on a grid this coarse so every kept mip of
+// every rectangle starts on a whole texel
+#define TEXTURE_ATLAS_ALIGN (1 << (TEXTURE_ATLAS_LEVELS - 1))
+
+void texture_manager_init(TextureManager* manager, int layers_per_array,
+                          int atlas_size, JobSystem* jobs) {
+    memset(manager, 0, sizeof(*manager));
+    GLint max_layers = 256;
+    glGetIntegerv(GL_MAX_ARRAY_TEXTURE_LAYERS, &max_layers);
+    manager->layers_per_array = layers_per_array < max_layers ? layers_per_array : max_layers;
+    manager->atlas_size = atlas_size;
+    manager->atlas_padding = TEXTURE_ATLAS_ALIGN;
+    manager->jobs = jobs;
+}
+
+void texture_manager_destroy(TextureManager* manager) {
+    for (int i = 0; i < manager->array_count; i++) {
+        TextureArray *array = &manager->arrays[i];
+        glDeleteTextures(1, &array->texture);
+        if (array->atlases) {
+            for (int l = 0; l < array->layers_used; l++)
+                atlas_destroy(&array->atlases[l]);
+            free(array->atlases);
+        }
+    }
+    free(manager->arrays);
+    memset(manager, 0, sizeof(*manager));
+}
+
+static TextureArray *texture_array_create(TextureManager* manager, int width,
+                                          int height, int level_count, bool atlas) {
+    if (manager->array_count == manager->array_capacity) {
+        manager->array_capacity = manager->array_capacity ? manager->array_capacity * 2 : 4;
+        manager->arrays = (TextureArray *)realloc(
+            manager->arrays, manager->array_capacity * sizeof(TextureArray));
+    }
+    TextureArray *array = &manager->arrays[manager->array_count++];
+    memset(array, 0, sizeof(*array));
+    array->width = width;
+    array->height = height;
+    array->level_count = level_count;
+    array->layer_count = manager->layers_per_array;
+    if (atlas)
+        array->atlases = (Atlas *)calloc(array->layer_count, sizeof(Atlas));
+
+    // Storage for every level and layer up front, layers fill in as added
+    glGenTextures(1, &array->texture);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, array->texture);
+    for (int level = 0; level < level_count; level++) {
+        int w = width >> level > 0 ? width >> level : 1;
+        int h = height >> level > 0 ? height >> level : 1;
+        glTexImage3D(GL_TEXTURE_2D_ARRAY, level, GL_RGBA8, w, h, array->layer_count, 0,
+                     GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+        manager->stats.bytes += (size_t)w * h * 4 * array->layer_count;
+    }
+    GLint wrap = atlas ? GL_CLAMP_TO_EDGE : GL_REPEAT;
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, wrap);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, wrap);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER,
+                    level_count > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, level_count - 1);
+    manager->stats.arrays++;
+    return array;
+}
+
+static void texture_array_upload(const TextureArray* array, const MipChain* chain,
+                                 int x, int y, int layer) {
+    glBindTexture(GL_TEXTURE_2D_ARRAY, array->texture);
+    for (int level = 0; level < chain->level_count && level < array->level_count; level++)
+        glTexSubImage3D(GL_TEXTURE_2D_ARRAY, level, x >> level, y >> level, layer,
+                        chain->widths[level], chain->heights[level], 1, GL_RGBA,
+                        GL_UNSIGNED_BYTE, chain->levels[level]);
+}
+
+static bool texture_manager_add_layer(TextureManager* manager, const uint8_t* rgba,
+                                      int width, int height, bool srgb,
+                                      TextureRegion* region) {
+    TextureArray *array = NULL;
+    for (int i = 0; i < manager->array_count && !array; i++) {
+        TextureArray *candidate = &manager->arrays[i];
+        if (!candidate->atlases && candidate->width == width &&
+            candidate->height == height && candidate->layers_used < candidate->layer_count)
+            array = candidate;
+    }
+    if (!array)
+        array = texture_array_create(manager, width, height,
+                                     mip_level_count(width, height), false);
+
+    MipChain chain;
+    mip_chain_build(&chain, rgba, width, height, array->level_count, MIP_FILTER_KAISER,
+                    srgb, manager->jobs);
+    int layer = array->layers_used++;
+    texture_array_upload(array, &chain, 0, 0, layer);
+    mip_chain_free(&chain);
+
+    float rect[4] = {0.0f, 0.0f, 1.0f, 1.0f};
+    memcpy(region->rect, rect, sizeof(rect));
+    region->layer = (float)layer;
+    region->texture = array->texture;
+    return true;
+}
+
+static bool texture_manager_add_atlased(TextureManager* manager, const uint8_t* rgba,
+                                        int width, int height, bool srgb,
+                                        TextureRegion* region) {
+    // The gutter repeats the edge texels so filtering and the kept mips
+    // never reach a neighbour
+    int pad = manager->atlas_padding;
+    int padded_width = (width + 2 * pad + TEXTURE_ATLAS_ALIGN - 1) / TEXTURE_ATLAS_ALIGN *
+                       TEXTURE_ATLAS_ALIGN;
+    int padded_height = (height + 2 * pad + TEXTURE_ATLAS_ALIGN - 1) / TEXTURE_ATLAS_ALIGN *
+                        TEXTURE_ATLAS_ALIGN;
+    int cells_w = padded_width / TEXTURE_ATLAS_ALIGN, cells_h = padded_height / TEXTURE_ATLAS_ALIGN;
+
+    TextureArray *array = NULL;
+    int layer = -1, cell_x = 0, cell_y = 0;
+    for (int i = 0; i < manager->array_count && !array; i++) {
+        TextureArray *candidate = &manager->arrays[i];
+        if (!candidate->atlases)
+            continue;
+        for (int l = 0; l < candidate->layers_used && !array; l++) {
+            if (atlas_pack(&candidate->atlases[l], cells_w, cells_h, &cell_x, &cell_y)) {
+                array = candidate;
+                layer = l;
+            }
+        }
+        if (!array && candidate->layers_used < candidate->layer_count) {
+            array = candidate;
+            layer = -1;
+        }
+    }
+    if (!array)
+        array = texture_array_create(manager, manager->atlas_size, manager->atlas_size,
+                                     TEXTURE_ATLAS_LEVELS, true);
+    if (layer < 0) {
+        layer = array->layers_used++;
+        int cells = manager->atlas_size / TEXTURE_ATLAS_ALIGN;
+        atlas_init(&array->atlases[layer], cells, cells);
+        if (!atlas_pack(&array->atlases[layer], cells_w, cells_h, &cell_x, &cell_y))
+            return false;
+    }
+
+    uint8_t *padded = (uint8_t *)malloc((size_t)padded_width * padded_height * 4);
+    for (int y = 0; y < padded_height; y++) {
+        int sy = y - pad < 0 ? 0 : y - pad >= height ? height - 1 : y - pad;
+        for (int x = 0; x < padded_width; x++) {
+            int sx = x - pad < 0 ? 0 : x - pad >= width ? width - 1 : x - pad;
+            memcpy(&padded[((size_t)y * padded_width + x) * 4],
+                   &rgba[((size_t)sy * width + sx) * 4], 4);
+        }
+    }
+    MipChain chain;
+    mip_chain_build(&chain, padded, padded_width, padded_height, TEXTURE_ATLAS_LEVELS,
+                    MIP_FILTER_KAISER, srgb, manager->jobs);
+    int x = cell_x * TEXTURE_ATLAS_ALIGN, y = cell_y * TEXTURE_ATLAS_ALIGN;
+    texture_array_upload(array, &chain, x, y, layer);
+    mip_chain_free(&chain);
+    free(padded);
+
+    float size = (float)manager->atlas_size;
+    region->rect[0] = (x + pad) / size;
+    region->rect[1] = (y + pad) / size;
+    region->rect[2] = width / size;
+    region->rect[3] = height / size;
+    region->layer = (float)layer;
+    region->texture = array->texture;
+    manager->stats.atlased++;
+    return true;
+}
+
+bool texture_manager_add(TextureManager* manager, const uint8_t* rgba, int width,
+                         int height, bool srgb, TextureRegion* region) {
+    if (width <= 0 || height <= 0)
+        return false;
+    int limit = manager->atlas_size / 4;
+    bool ok = width <= limit && height <= limit
+                  ? texture_manager_add_atlased(manager, rgba, width, height, srgb, region)
+                  : texture_manager_add_layer(manager, rgba, width, height, srgb, region);
+    if (ok)
+        manager->stats.textures++;
+    return ok;
+}
+
+bool texture_manager_load(TextureManager* manager, const char* path,
+                          TextureRegion* region) {
+    VfsFile file;
+    if (!vfs_open(&file, path))
+        return false;
+
+    bool ok = false;
+    if (ktx2_is_ktx2(file.data, file.size)) {
+        Ktx2Texture ktx;
+        BcnFormat format;
+        bool srgb;
+        if (ktx2_parse(&ktx, file.data, file.size) &&
+            ktx2_bcn_format(ktx.vk_format, &format, &srgb) &&
+            ktx.level_sizes[0] >= bcn_image_size(format, ktx.width, ktx.height)) {
+            uint8_t *rgba = (uint8_t *)malloc((size_t)ktx.width * ktx.height * 4);
+            if (bcn_decode_image(format, ktx.levels[0], ktx.width, ktx.height, rgba))
+                ok = texture_manager_add(manager, rgba, ktx.width, ktx.height, srgb,
+                                         region);
+            free(rgba);
+        }
+        if (!ok)
+            fprintf(stderr, "Error: %s is not a supported KTX2 texture\n", path);
+    } else {
+        int width, height, channels;
+        unsigned char *data = stbi_load_from_memory(file.data, (int)file.size, &width,
+                                                    &height, &channels, 4);
+        if (data) {
+            ok = texture_manager_add(manager, data, width, height, channels >= 3, region);
+            stbi_image_free(data);
+        } else {
+            fprintf(stderr, "Error: cannot decode %s: %s\n", path, stbi_failure_reason());
+        }
+    }
+    vfs_close(&file);
+    return ok;
+}
+
+void texture_region_attributes(GLuint vao, GLuint location, GLsizei stride,
+                               size_t offset) {
+    glBindVertexArray(vao);
+    glVertexAttribPointer(location, 4, GL_FLOAT, GL_FALSE, stride,
+                          (void *)(offset + offsetof(TextureRegion, rect)));
+    glVertexAttribPointer(location + 1, 1, GL_FLOAT, GL_FALSE, stride,
+                          (void *)(offset + offsetof(TextureRegion, layer)));
+    for (GLuint i = 0; i < 2; i++) {
+        glEnableVertexAttribArray(location + i);
+        glVertexAttribDivisor(location + i, 1);
+    }
+}
@@ -0,0 +1,74 @@
+#ifndef TEXTURE_MANAGER_H
+#define TEXTURE_MANAGER_H
+
+#include <glad/gl.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "atlas.h"
+#include "job.h"
+
+// Atlas layers keep this many mips, enough for the padding to stop bleeding
+#define TEXTURE_ATLAS_LEVELS 4
+
+// Where a texture lives: a layer of `texture`, a GL_TEXTURE_2D_ARRAY, and the
+// part of that layer it covers. `rect` and `layer` are laid out to be copied
+// straight into per-instance data; shaders sample with
+//     texture(textures, vec3(rect.xy + fract(uv) * rect.zw, layer))
+// so instances with different materials in one array share a draw call.
+typedef struct TextureRegion {
+  float rect[4];
+  float layer;
+  GLuint texture;
+} TextureRegion;
+
+// Same-sized textures share an array with full mip chains, small ones are
+// packed into atlas layers with a clamped gutter around each
+typedef struct TextureArray {
+  GLuint texture;
+  int width;
+  int height;
+  int level_count;
+  int layer_count;
+  int layers_used;
+  Atlas* atlases;
+} TextureArray;
+
+typedef struct TextureManagerStats {
+  int textures;
+  int atlased;
+  int arrays;
+  size_t bytes;
+} TextureManagerStats;
+
+typedef struct TextureManager {
+  TextureArray* arrays;
+  int array_count;
+  int array_capacity;
+  int layers_per_array;
+  int atlas_size;
+  int atlas_padding;
+  JobSystem* jobs;
+  TextureManagerStats stats;
+} TextureManager;
+
+// Textures no larger than a quarter of `atlas_size` on either side are
+// atlased. `jobs` may be NULL to build mips on the calling thread.
+void texture_manager_init(TextureManager* manager, int layers_per_array,
+                          int atlas_size, JobSystem* jobs);
+void texture_manager_destroy(TextureManager* manager);
+
+bool texture_manager_add(TextureManager* manager, const uint8_t* rgba, int width,
+                         int height, bool srgb, TextureRegion* region);
+// Loads through the VFS; cooked KTX2 textures are decoded back to RGBA8
+bool texture_manager_load(TextureManager* manager, const char* path,
+                          TextureRegion* region);
+
+// Sets up a per-instance TextureRegion at `location` (rect) and
+// `location + 1` (layer) of `vao`, reading the buffer bound to
+// GL_ARRAY_BUFFER at `offset` with `stride` bytes between instances
+void texture_region_attributes(GLuint vao, GLuint location, GLsizei stride,
+                               size_t offset);
+
+#endif
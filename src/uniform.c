@@ -0,0 +1,233 @@
+#include "uniform.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+UniformId uniform_id(const char* name) {
+    // FNV-1a
+    uint32_t hash = 2166136261u;
+    for (const unsigned char *c = (const unsigned char *)name; *c; c++) {
+        hash ^= *c;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+static bool uniform_is_sampler(GLenum type) {
+    switch (type) {
+    case GL_SAMPLER_1D: case GL_SAMPLER_2D: case GL_SAMPLER_3D: case GL_SAMPLER_CUBE:
+    case GL_SAMPLER_2D_SHADOW: case GL_SAMPLER_2D_ARRAY: case GL_SAMPLER_2D_ARRAY_SHADOW:
+    case GL_SAMPLER_CUBE_SHADOW: case GL_SAMPLER_2D_MULTISAMPLE: case GL_SAMPLER_BUFFER:
+    case GL_INT_SAMPLER_2D: case GL_INT_SAMPLER_2D_ARRAY: case GL_INT_SAMPLER_BUFFER:
+    case GL_UNSIGNED_INT_SAMPLER_2D: case GL_UNSIGNED_INT_SAMPLER_2D_ARRAY:
+    case GL_UNSIGNED_INT_SAMPLER_BUFFER:
+        return true;
+    default:
+        return false;
+    }
+}
+
+// Bytes per element, 0 for types the table does not handle
+static int uniform_type_size(GLenum type) {
+    if (uniform_is_sampler(type))
+        return 4;
+    switch (type) {
+    case GL_FLOAT: case GL_INT: case GL_UNSIGNED_INT: case GL_BOOL:
+        return 4;
+    case GL_FLOAT_VEC2: case GL_INT_VEC2: case GL_UNSIGNED_INT_VEC2: case GL_BOOL_VEC2:
+        return 8;
+    case GL_FLOAT_VEC3: case GL_INT_VEC3: case GL_UNSIGNED_INT_VEC3: case GL_BOOL_VEC3:
+        return 12;
+    case GL_FLOAT_VEC4: case GL_INT_VEC4: case GL_UNSIGNED_INT_VEC4: case GL_BOOL_VEC4:
+    case GL_FLOAT_MAT2:
+        return 16;
+    case GL_FLOAT_MAT2x3: case GL_FLOAT_MAT3x2:
+        return 24;
+    case GL_FLOAT_MAT2x4: case GL_FLOAT_MAT4x2:
+        return 32;
+    case GL_FLOAT_MAT3:
+        return 36;
+    case GL_FLOAT_MAT3x4: case GL_FLOAT_MAT4x3:
+        return 48;
+    case GL_FLOAT_MAT4:
+        return 64;
+    default:
+        return 0;
+    }
+}
+
+void uniform_table_build(UniformTable* table, GLuint program,
+                         const UniformTable* previous) {
+    memset(table, 0, sizeof(*table));
+    GLint active = 0, max_length = 0;
+    glGetProgramiv(program, GL_ACTIVE_UNIFORMS, &active);
+    glGetProgramiv(program, GL_ACTIVE_UNIFORM_MAX_LENGTH, &max_length);
+    if (active == 0)
+        return;
+
+    char *name = (char *)malloc(max_length + 1);
+    table->uniforms = (Uniform *)malloc(active * sizeof(Uniform));
+    for (GLint i = 0; i < active; i++) {
+        Uniform *uniform = &table->uniforms[table->count];
+        glGetActiveUniform(program, i, max_length + 1, NULL, &uniform->count,
+                           &uniform->type, name);
+        // Members of uniform blocks have no location
+        uniform->location = glGetUniformLocation(program, name);
+        uniform->size = uniform_type_size(uniform->type);
+        if (uniform->location < 0 || uniform->size == 0)
+            continue;
+        // Arrays are reported as "name[0]" and set as a whole
+        char *bracket = strchr(name, '[');
+        if (bracket)
+            *bracket = '\0';
+        uniform->id = uniform_id(name);
+        uniform->offset = table->value_size;
+        uniform->dirty = false;
+        table->value_size += uniform->size * uniform->count;
+        table->count++;
+    }
+    free(name);
+
+    int capacity = 8;
+    while (capacity < table->count * 2)
+        capacity *= 2;
+    table->slot_mask = capacity - 1;
+    table->slots = (uint16_t *)calloc(capacity, sizeof(uint16_t));
+    table->values = (unsigned char *)calloc(table->value_size > 0 ? table->value_size : 1, 1);
+    for (int i = 0; i < table->count; i++) {
+        Uniform *uniform = &table->uniforms[i];
+        if (uniform_find(table, uniform->id)) {
+            fprintf(stderr, "Error: uniform id collision in program %u\n", program);
+            continue;
+        }
+        int slot = uniform->id & table->slot_mask;
+        while (table->slots[slot])
+            slot = (slot + 1) & table->slot_mask;
+        table->slots[slot] = (uint16_t)(i + 1);
+
+        int *units = (int *)(table->values + uniform->offset);
+        if (uniform_is_sampler(uniform->type)) {
+            for (int j = 0; j < uniform->count; j++)
+                units[j] = table->sampler_count++;
+            uniform->dirty = true;
+            continue;
+        }
+        const Uniform *old = previous ? uniform_find(previous, uniform->id) : NULL;
+        if (old && old->type == uniform->type) {
+            int bytes = uniform->size * (uniform->count < old->count ? uniform->count : old->count);
+            memcpy(table->values + uniform->offset, previous->values + old->offset, bytes);
+            uniform->dirty = true;
+        }
+    }
+    for (int i = 0; i < table->count; i++)
+        table->dirty_count += table->uniforms[i].dirty;
+}
+
+void uniform_table_free(UniformTable* table) {
+    free(table->uniforms);
+    free(table->slots);
+    free(table->values);
+    memset(table, 0, sizeof(*table));
+}
+
+Uniform* uniform_find(const UniformTable* table, UniformId id) {
+    if (!table->slots)
+        return NULL;
+    for (int slot = id & table->slot_mask; table->slots[slot];
+         slot = (slot + 1) & table->slot_mask) {
+        Uniform *uniform = &table->uniforms[table->slots[slot] - 1];
+        if (uniform->id == id)
+            return uniform;
+    }
+    return NULL;
+}
+
+int uniform_texture_unit(const UniformTable* table, UniformId id) {
+    const Uniform *uniform = uniform_find(table, id);
+    if (!uniform || !uniform_is_sampler(uniform->type))
+        return -1;
+    return *(const int *)(table->values + uniform->offset);
+}
+
+void uniform_set(UniformTable* table, UniformId id, const void* data, size_t size) {
+    Uniform *uniform = uniform_find(table, id);
+    if (!uniform)
+        return;
+    size_t capacity = (size_t)uniform->size * uniform->count;
+    if (size > capacity)
+        size = capacity;
+    unsigned char *value = table->values + uniform->offset;
+    if (memcmp(value, data, size) == 0)
+        return;
+    memcpy(value, data, size);
+    if (!uniform->dirty) {
+        uniform->dirty = true;
+        table->dirty_count++;
+    }
+}
+
+void uniform_set_int(UniformTable* table, UniformId id, int value) {
+    uniform_set(table, id, &value, sizeof(value));
+}
+
+void uniform_set_float(UniformTable* table, UniformId id, float value) {
+    uniform_set(table, id, &value, sizeof(value));
+}
+
+void uniform_set_vec3(UniformTable* table, UniformId id, const float* value) {
+    uniform_set(table, id, value, 3 * sizeof(float));
+}
+
+void uniform_set_vec4(UniformTable* table, UniformId id, const float* value) {
+    uniform_set(table, id, value, 4 * sizeof(float));
+}
+
+void uniform_set_mat4(UniformTable* table, UniformId id, const float* value) {
+    uniform_set(table, id, value, 16 * sizeof(float));
+}
+
+static void uniform_upload(const Uniform* uniform, const void* value) {
+    const GLfloat *f = (const GLfloat *)value;
+    const GLint *i = (const GLint *)value;
+    const GLuint *u = (const GLuint *)value;
+    GLint location = uniform->location, count = uniform->count;
+    switch (uniform->type) {
+    case GL_FLOAT: glUniform1fv(location, count, f); break;
+    case GL_FLOAT_VEC2: glUniform2fv(location, count, f); break;
+    case GL_FLOAT_VEC3: glUniform3fv(location, count, f); break;
+    case GL_FLOAT_VEC4: glUniform4fv(location, count, f); break;
+    case GL_INT_VEC2: case GL_BOOL_VEC2: glUniform2iv(location, count, i); break;
+    case GL_INT_VEC3: case GL_BOOL_VEC3: glUniform3iv(location, count, i); break;
+    case GL_INT_VEC4: case GL_BOOL_VEC4: glUniform4iv(location, count, i); break;
+    case GL_UNSIGNED_INT: glUniform1uiv(location, count, u); break;
+    case GL_UNSIGNED_INT_VEC2: glUniform2uiv(location, count, u); break;
+    case GL_UNSIGNED_INT_VEC3: glUniform3uiv(location, count, u); break;
+    case GL_UNSIGNED_INT_VEC4: glUniform4uiv(location, count, u); break;
+    case GL_FLOAT_MAT2: glUniformMatrix2fv(location, count, GL_FALSE, f); break;
+    case GL_FLOAT_MAT3: glUniformMatrix3fv(location, count, GL_FALSE, f); break;
+    case GL_FLOAT_MAT4: glUniformMatrix4fv(location, count, GL_FALSE, f); break;
+    case GL_FLOAT_MAT2x3: glUniformMatrix2x3fv(location, count, GL_FALSE, f); break;
+    case GL_FLOAT_MAT3x2: glUniformMatrix3x2fv(location, count, GL_FALSE, f); break;
+    case GL_FLOAT_MAT2x4: glUniformMatrix2x4fv(location, count, GL_FALSE, f); break;
+    case GL_FLOAT_MAT4x2: glUniformMatrix4x2fv(location, count, GL_FALSE, f); break;
+    case GL_FLOAT_MAT3x4: glUniformMatrix3x4fv(location, count, GL_FALSE, f); break;
+    case GL_FLOAT_MAT4x3: glUniformMatrix4x3fv(location, count, GL_FALSE, f); break;
+    // int, bool and every sampler type
+    default: glUniform1iv(location, count, i); break;
+    }
+}
+
+void uniform_table_upload(UniformTable* table) {
+    if (table->dirty_count == 0)
+        return;
+    for (int i = 0; i < table->count; i++) {
+        Uniform *uniform = &table->uniforms[i];
+        if (!uniform->dirty)
+            continue;
+        uniform_upload(uniform, table->values + uniform->offset);
+        uniform->dirty = false;
+        table->uploads++;
+    }
+    table->dirty_count = 0;
+}
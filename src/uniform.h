@@ -0,0 +1,63 @@
+#ifndef UNIFORM_H
+#define UNIFORM_H
+
+#include <glad/gl.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Hash of a uniform name, computed once and kept instead of the string
+typedef uint32_t UniformId;
+
+typedef struct Uniform {
+  UniformId id;
+  GLint location;
+  GLenum type;
+  GLint count;
+  int offset;
+  int size;
+  bool dirty;
+} Uniform;
+
+// What a linked program exposes, found by reflection. `values` mirrors
+// what was last set on the CPU side; only uniforms whose value changed
+// since the last upload are sent to GL. Samplers get texture units in
+// declaration order, uploaded with the first upload.
+typedef struct UniformTable {
+  Uniform* uniforms;
+  int count;
+  uint16_t* slots;
+  int slot_mask;
+  unsigned char* values;
+  int value_size;
+  int dirty_count;
+  int sampler_count;
+  long uploads;
+} UniformTable;
+
+UniformId uniform_id(const char* name);
+
+// Reflects `program`, which must be linked. Values of uniforms that also
+// exist in `previous` carry over, so a reloaded program keeps its state.
+void uniform_table_build(UniformTable* table, GLuint program,
+                         const UniformTable* previous);
+void uniform_table_free(UniformTable* table);
+
+// NULL for names the program does not use, which is not an error since the
+// compiler strips unused uniforms
+Uniform* uniform_find(const UniformTable* table, UniformId id);
+// Texture unit a sampler was given, -1 if the program has no such sampler
+int uniform_texture_unit(const UniformTable* table, UniformId id);
+
+// Copies `size` bytes into the uniform, marking it dirty if they differ
+void uniform_set(UniformTable* table, UniformId id, const void* data, size_t size);
+void uniform_set_int(UniformTable* table, UniformId id, int value);
+void uniform_set_float(UniformTable* table, UniformId id, float value);
+void uniform_set_vec3(UniformTable* table, UniformId id, const float* value);
+void uniform_set_vec4(UniformTable* table, UniformId id, const float* value);
+void uniform_set_mat4(UniformTable* table, UniformId id, const float* value);
+
+// Sends the dirty values to GL; the table's program must be in use
+void uniform_table_upload(UniformTable* table);
+
+#endif
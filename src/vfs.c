@@ -0,0 +1,96 @@
+#include "vfs.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "pak.h"
+
+static Pak mounts[VFS_MAX_MOUNTS];
+static int mount_count = 0;
+
+bool vfs_mount(const char* path) {
+    if (mount_count == VFS_MAX_MOUNTS) {
+        fprintf(stderr, "Error: too many paks mounted\n");
+        return false;
+    }
+    if (!pak_open(&mounts[mount_count], path))
+        return false;
+    mount_count++;
+    return true;
+}
+
+void vfs_unmount_all() {
+    for (int i = 0; i < mount_count; i++)
+        pak_close(&mounts[i]);
+    mount_count = 0;
+}
+
+static const PakEntry *vfs_find(const char* path, const Pak** pak) {
+    for (int i = mount_count - 1; i >= 0; i--) {
+        const PakEntry *entry = pak_find(&mounts[i], path);
+        if (entry) {
+            *pak = &mounts[i];
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+bool vfs_exists(const char* path) {
+    const Pak *pak;
+    return vfs_find(path, &pak) || access(path, R_OK) == 0;
+}
+
+bool vfs_locate(const char* path, VfsLocation* location) {
+    const Pak *pak;
+    const PakEntry *entry = vfs_find(path, &pak);
+    if (!entry)
+        return false;
+    location->fd = pak->file.fd;
+    location->offset = entry->offset;
+    location->stored_size = entry->stored_size;
+    location->size = entry->size;
+    location->lz4 = (entry->flags & PAK_ENTRY_LZ4) != 0;
+    return true;
+}
+
+bool vfs_open(VfsFile* file, const char* path) {
+    memset(file, 0, sizeof(*file));
+    file->file.fd = -1;
+
+    const Pak *pak;
+    const PakEntry *entry = vfs_find(path, &pak);
+    if (!entry) {
+        if (!file_map(&file->file, path))
+            return false;
+        file->data = file->file.data;
+        file->size = file->file.size;
+        return true;
+    }
+
+    file->size = entry->size;
+    pak_prefetch(pak, entry);
+    if (entry->flags & PAK_ENTRY_LZ4) {
+        file->heap = (unsigned char *)malloc(entry->size > 0 ? entry->size : 1);
+        if (!pak_decompress(pak, entry, file->heap)) {
+            vfs_close(file);
+            return false;
+        }
+        file->data = file->heap;
+        return true;
+    }
+
+    // Zero copy, uncompressed entries are used straight from the mapping
+    file->data = pak_entry_data(pak, entry);
+    return true;
+}
+
+void vfs_close(VfsFile* file) {
+    free(file->heap);
+    if (file->file.data)
+        file_unmap(&file->file);
+    memset(file, 0, sizeof(*file));
+    file->file.fd = -1;
+}
@@ -0,0 +1,43 @@
+#ifndef VFS_H
+#define VFS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "file.h"
+
+#define VFS_MAX_MOUNTS 8
+
+// Read-only view of an asset. `data` points into a pak mapping for
+// uncompressed entries, into a heap buffer for compressed ones and into a
+// private mapping for loose files.
+typedef struct VfsFile {
+  const unsigned char* data;
+  size_t size;
+  unsigned char* heap;
+  MappedFile file;
+} VfsFile;
+
+// Where a pak entry lives, for callers doing their own reads. `fd` belongs
+// to the mounted pak and stays open until vfs_unmount_all.
+typedef struct VfsLocation {
+  int fd;
+  uint64_t offset;
+  size_t stored_size;
+  size_t size;
+  bool lz4;
+} VfsLocation;
+
+// Paks mounted later shadow earlier ones; paths not found in any pak fall
+// back to loose files. Mount and unmount before loaders run on other threads.
+bool vfs_mount(const char* path);
+void vfs_unmount_all();
+
+bool vfs_exists(const char* path);
+// False when the path is not in any mounted pak
+bool vfs_locate(const char* path, VfsLocation* location);
+bool vfs_open(VfsFile* file, const char* path);
+void vfs_close(VfsFile* file);
+
+#endif
@@ -0,0 +1,512 @@
+#include "vtex.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// Mip level and page lookup shared by the feedback and shading passes, so
+// both agree on which page a fragment needs
+#define VTEX_GLSL_PAGE                                                        \
+    "uniform vec4 vtex_size; // pages x, pages y, page size, levels\n"       \
+    "\n"                                                                      \
+    "float vtex_level(vec2 uv)\n"                                             \
+    "{\n"                                                                     \
+    "    vec2 texels = uv * vtex_size.xy * vtex_size.z;\n"                    \
+    "    vec2 dx = dFdx(texels), dy = dFdy(texels);\n"                        \
+    "    return 0.5 * log2(max(max(dot(dx, dx), dot(dy, dy)), 1e-8));\n"      \
+    "}\n"                                                                     \
+    "\n"                                                                      \
+    "ivec2 vtex_page(vec2 uv, int level)\n"                                   \
+    "{\n"                                                                     \
+    "    ivec2 pages = max(ivec2(vtex_size.xy) >> level, ivec2(1));\n"       \
+    "    return clamp(ivec2(uv * vec2(pages)), ivec2(0), pages - 1);\n"       \
+    "}\n"
+
+const char* VTEX_GLSL =
+    VTEX_GLSL_PAGE
+    "\n"
+    "uniform sampler2D vtex_table;\n"
+    "uniform sampler2D vtex_cache;\n"
+    "uniform vec4 vtex_cache_size; // width, height, slot size, border\n"
+    "\n"
+    "vec4 vtex_sample(vec2 uv)\n"
+    "{\n"
+    "    int level = int(clamp(vtex_level(uv), 0.0, vtex_size.w - 1.0));\n"
+    "    vec4 entry = texelFetch(vtex_table, vtex_page(uv, level), level) * 255.0;\n"
+    "    int resident = int(entry.b + 0.5);\n"
+    "    vec2 pages = vec2(max(ivec2(vtex_size.xy) >> resident, ivec2(1)));\n"
+    "    vec2 in_page = fract(clamp(uv, 0.0, 0.99999) * pages);\n"
+    "    vec2 texel = floor(entry.rg + 0.5) * vtex_cache_size.z + vtex_cache_size.w +\n"
+    "                 in_page * vtex_size.z;\n"
+    "    return textureLod(vtex_cache, texel / vtex_cache_size.xy, 0.0);\n"
+    "}\n";
+
+static const char *vtex_feedback_text =
+    "#version 330 core\n"
+    "in vec2 TexCoord;\n"
+    "out vec4 FragColor;\n"
+    "uniform float vtex_feedback_bias;\n"
+    "\n" VTEX_GLSL_PAGE
+    "\n"
+    "void main()\n"
+    "{\n"
+    "    float lod = vtex_level(TexCoord) + vtex_feedback_bias;\n"
+    "    int level = int(clamp(lod, 0.0, vtex_size.w - 1.0));\n"
+    "    ivec2 page = vtex_page(TexCoord, level);\n"
+    "    FragColor = vec4(page.x & 255, page.y & 255,\n"
+    "                     (page.x >> 8) | ((page.y >> 8) << 4), level) / 255.0;\n"
+    "}\n";
+
+typedef struct VtexRequest {
+  int level;
+  int x, y;
+} VtexRequest;
+
+static double now_ms() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e3 + ts.tv_nsec * 1e-6;
+}
+
+static int vtex_width(const VirtualTexture* vt, int level) {
+    return vt->pages_x >> level > 0 ? vt->pages_x >> level : 1;
+}
+
+static int vtex_height(const VirtualTexture* vt, int level) {
+    return vt->pages_y >> level > 0 ? vt->pages_y >> level : 1;
+}
+
+static VtexPage *vtex_page(VirtualTexture* vt, int level, int x, int y) {
+    return &vt->pages[level][y * vtex_width(vt, level) + x];
+}
+
+// A free slot, otherwise the least recently seen one that is neither part
+// of the pinned top level nor needed this frame; -1 if there is none
+static int vtex_find_slot(VirtualTexture* vt) {
+    int best = -1;
+    for (int i = 0; i < vt->slot_count; i++) {
+        VtexSlot *slot = &vt->slots[i];
+        if (slot->level < 0)
+            return i;
+        if (slot->level == vt->level_count - 1 || slot->last_used >= vt->frame)
+            continue;
+        if (best < 0 || slot->last_used < vt->slots[best].last_used)
+            best = i;
+    }
+    return best;
+}
+
+static bool vtex_upload(VirtualTexture* vt, int level, int x, int y,
+                        const uint8_t* pixels) {
+    int index = vtex_find_slot(vt);
+    VtexPage *page = vtex_page(vt, level, x, y);
+    if (index < 0) {
+        page->state = VTEX_PAGE_ABSENT;
+        return false;
+    }
+
+    VtexSlot *slot = &vt->slots[index];
+    if (slot->level >= 0) {
+        VtexPage *evicted = vtex_page(vt, slot->level, slot->x, slot->y);
+        evicted->state = VTEX_PAGE_ABSENT;
+        evicted->slot = -1;
+        vt->stats.evictions++;
+        vt->stats.total_evictions++;
+        vt->stats.resident--;
+    }
+    slot->level = level;
+    slot->x = x;
+    slot->y = y;
+    slot->last_used = vt->frame;
+    page->state = VTEX_PAGE_RESIDENT;
+    page->slot = index;
+
+    glBindTexture(GL_TEXTURE_2D, vt->cache);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, index % vt->cache_x * vt->slot_size,
+                    index / vt->cache_x * vt->slot_size, vt->slot_size, vt->slot_size,
+                    GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+    vt->table_dirty = true;
+    vt->stats.uploads++;
+    vt->stats.total_uploads++;
+    vt->stats.resident++;
+    return true;
+}
+
+// Coarsest level first so every page can fall back to its parent's entry
+static void vtex_upload_table(VirtualTexture* vt) {
+    for (int level = vt->level_count - 1; level >= 0; level--) {
+        int w = vtex_width(vt, level), h = vtex_height(vt, level);
+        for (int y = 0; y < h; y++) {
+            for (int x = 0; x < w; x++) {
+                VtexPage *page = vtex_page(vt, level, x, y);
+                uint8_t *entry = &vt->table[level][(y * w + x) * 4];
+                if (page->state == VTEX_PAGE_RESIDENT) {
+                    entry[0] = (uint8_t)(page->slot % vt->cache_x);
+                    entry[1] = (uint8_t)(page->slot / vt->cache_x);
+                    entry[2] = (uint8_t)level;
+                    entry[3] = 255;
+                } else if (level + 1 < vt->level_count) {
+                    int parent_w = vtex_width(vt, level + 1);
+                    memcpy(entry, &vt->table[level + 1][((y / 2) * parent_w + x / 2) * 4], 4);
+                } else {
+                    memset(entry, 0, 4);
+                }
+            }
+        }
+        glBindTexture(GL_TEXTURE_2D, vt->page_table);
+        glTexSubImage2D(GL_TEXTURE_2D, level, 0, 0, w, h, GL_RGBA, GL_UNSIGNED_BYTE,
+                        vt->table[level]);
+    }
+    vt->table_dirty = false;
+}
+
+bool vtex_init(VirtualTexture* vt, int pages_x, int pages_y, int page_size,
+               int cache_x, int cache_y, int feedback_width, int feedback_height,
+               JobSystem* jobs, VtexPageFn load, void* user) {
+    memset(vt, 0, sizeof(*vt));
+    if (pages_x <= 0 || pages_y <= 0 || (pages_x & (pages_x - 1)) ||
+        (pages_y & (pages_y - 1)) || pages_x > 4096 || pages_y > 4096 ||
+        cache_x > 256 || cache_y > 256) {
+        fprintf(stderr, "Error: unsupported virtual texture of %dx%d pages\n", pages_x,
+                pages_y);
+        return false;
+    }
+    vt->pages_x = pages_x;
+    vt->pages_y = pages_y;
+    vt->page_size = page_size;
+    vt->slot_size = page_size + 2 * VTEX_BORDER;
+    vt->level_count = 1;
+    while (vtex_width(vt, vt->level_count - 1) > 1 || vtex_height(vt, vt->level_count - 1) > 1)
+        vt->level_count++;
+    vt->cache_x = cache_x;
+    vt->cache_y = cache_y;
+    vt->slot_count = cache_x * cache_y;
+    int top = vt->level_count - 1;
+    if (vt->level_count > VTEX_MAX_LEVELS ||
+        vtex_width(vt, top) * vtex_height(vt, top) >= vt->slot_count) {
+        fprintf(stderr, "Error: virtual texture cache of %d pages is too small\n",
+                vt->slot_count);
+        return false;
+    }
+    vt->jobs = jobs;
+    vt->load = load;
+    vt->user = user;
+    vt->max_in_flight = jobs ? jobs->thread_count * 4 : 4;
+    vt->uploads_per_frame = 8;
+    pthread_mutex_init(&vt->lock, NULL);
+
+    for (int level = 0; level < vt->level_count; level++) {
+        int count = vtex_width(vt, level) * vtex_height(vt, level);
+        vt->pages[level] = (VtexPage *)calloc(count, sizeof(VtexPage));
+        for (int i = 0; i < count; i++)
+            vt->pages[level][i].slot = -1;
+        vt->table[level] = (uint8_t *)calloc(count, 4);
+    }
+    vt->slots = (VtexSlot *)malloc(vt->slot_count * sizeof(VtexSlot));
+    for (int i = 0; i < vt->slot_count; i++) {
+        VtexSlot slot = {-1, 0, 0, 0};
+        vt->slots[i] = slot;
+    }
+
+    glGenTextures(1, &vt->cache);
+    glBindTexture(GL_TEXTURE_2D, vt->cache);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, cache_x * vt->slot_size,
+                 cache_y * vt->slot_size, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+
+    glGenTextures(1, &vt->page_table);
+    glBindTexture(GL_TEXTURE_2D, vt->page_table);
+    for (int level = 0; level < vt->level_count; level++)
+        glTexImage2D(GL_TEXTURE_2D, level, GL_RGBA8, vtex_width(vt, level),
+                     vtex_height(vt, level), 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, vt->level_count - 1);
+
+    vt->feedback_width = feedback_width;
+    vt->feedback_height = feedback_height;
+    glGenRenderbuffers(1, &vt->feedback_color);
+    glBindRenderbuffer(GL_RENDERBUFFER, vt->feedback_color);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, feedback_width, feedback_height);
+    glGenRenderbuffers(1, &vt->feedback_depth);
+    glBindRenderbuffer(GL_RENDERBUFFER, vt->feedback_depth);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, feedback_width,
+                          feedback_height);
+    glGenFramebuffers(1, &vt->feedback_fbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, vt->feedback_fbo);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER,
+                              vt->feedback_color);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER,
+                              vt->feedback_depth);
+    bool complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    if (!complete) {
+        fprintf(stderr, "Error: virtual texture feedback framebuffer is incomplete\n");
+        vtex_destroy(vt);
+        return false;
+    }
+
+    glGenBuffers(2, vt->feedback_pbo);
+    for (int i = 0; i < 2; i++) {
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, vt->feedback_pbo[i]);
+        glBufferData(GL_PIXEL_PACK_BUFFER, (GLsizeiptr)feedback_width * feedback_height * 4,
+                     NULL, GL_STREAM_READ);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    // The pinned top level is loaded up front so every lookup resolves
+    uint8_t *pixels = (uint8_t *)malloc((size_t)vt->slot_size * vt->slot_size * 4);
+    for (int y = 0; y < vtex_height(vt, top); y++) {
+        for (int x = 0; x < vtex_width(vt, top); x++) {
+            if (!load(top, x, y, pixels, vt->slot_size, user))
+                memset(pixels, 0, (size_t)vt->slot_size * vt->slot_size * 4);
+            vtex_upload(vt, top, x, y, pixels);
+        }
+    }
+    free(pixels);
+    vtex_upload_table(vt);
+    memset(&vt->stats, 0, sizeof(vt->stats));
+    vt->stats.resident = vtex_width(vt, top) * vtex_height(vt, top);
+    return true;
+}
+
+void vtex_destroy(VirtualTexture* vt) {
+    // Loads in flight write into the ready list
+    if (vt->jobs && vt->stats.in_flight > 0)
+        job_wait(vt->jobs);
+    for (int i = 0; i < vt->ready_count; i++) {
+        free(vt->ready[i]->pixels);
+        free(vt->ready[i]);
+    }
+    free(vt->ready);
+    for (int i = 0; i < 2; i++)
+        if (vt->feedback_fence[i])
+            glDeleteSync(vt->feedback_fence[i]);
+    glDeleteBuffers(2, vt->feedback_pbo);
+    glDeleteFramebuffers(1, &vt->feedback_fbo);
+    glDeleteRenderbuffers(1, &vt->feedback_color);
+    glDeleteRenderbuffers(1, &vt->feedback_depth);
+    if (vt->feedback_program)
+        glDeleteProgram(vt->feedback_program);
+    glDeleteTextures(1, &vt->page_table);
+    glDeleteTextures(1, &vt->cache);
+    for (int level = 0; level < VTEX_MAX_LEVELS; level++) {
+        free(vt->pages[level]);
+        free(vt->table[level]);
+    }
+    free(vt->slots);
+    if (vt->load)
+        pthread_mutex_destroy(&vt->lock);
+    memset(vt, 0, sizeof(*vt));
+}
+
+bool vtex_feedback_program(VirtualTexture* vt, GLuint vertex_shader) {
+    GLuint fragment_shader = glCreateShader(GL_FRAGMENT_SHADER);
+    glShaderSource(fragment_shader, 1, &vtex_feedback_text, NULL);
+    glCompileShader(fragment_shader);
+
+    GLuint program = glCreateProgram();
+    glAttachShader(program, vertex_shader);
+    glAttachShader(program, fragment_shader);
+    glLinkProgram(program);
+    glDeleteShader(fragment_shader);
+
+    GLint linked = 0;
+    glGetProgramiv(program, GL_LINK_STATUS, &linked);
+    if (!linked) {
+        char log[512];
+        glGetProgramInfoLog(program, sizeof(log), NULL, log);
+        fprintf(stderr, "Error: virtual texture feedback program: %s\n", log);
+        glDeleteProgram(program);
+        return false;
+    }
+    if (vt->feedback_program)
+        glDeleteProgram(vt->feedback_program);
+    vt->feedback_program = program;
+    vt->feedback_bias_loc = glGetUniformLocation(program, "vtex_feedback_bias");
+    return true;
+}
+
+GLuint vtex_begin_feedback(VirtualTexture* vt, int screen_width) {
+    glGetIntegerv(GL_VIEWPORT, vt->saved_viewport);
+    glGetFloatv(GL_COLOR_CLEAR_VALUE, vt->saved_clear);
+    glBindFramebuffer(GL_FRAMEBUFFER, vt->feedback_fbo);
+    glViewport(0, 0, vt->feedback_width, vt->feedback_height);
+    // Alpha 255 marks texels no virtual textured surface covered
+    glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+    // The smaller target has larger derivatives, which would ask for pages
+    // that are too coarse
+    glUseProgram(vt->feedback_program);
+    glUniform1f(vt->feedback_bias_loc,
+                -log2f((float)screen_width / vt->feedback_width));
+    glUniform4f(glGetUniformLocation(vt->feedback_program, "vtex_size"),
+                (float)vt->pages_x, (float)vt->pages_y, (float)vt->page_size,
+                (float)vt->level_count);
+    return vt->feedback_program;
+}
+
+void vtex_end_feedback(VirtualTexture* vt) {
+    int index = vt->frame & 1;
+    if (vt->feedback_fence[index])
+        glDeleteSync(vt->feedback_fence[index]);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, vt->feedback_pbo[index]);
+    glReadPixels(0, 0, vt->feedback_width, vt->feedback_height, GL_RGBA,
+                 GL_UNSIGNED_BYTE, NULL);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    vt->feedback_fence[index] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glViewport(vt->saved_viewport[0], vt->saved_viewport[1], vt->saved_viewport[2],
+               vt->saved_viewport[3]);
+    glClearColor(vt->saved_clear[0], vt->saved_clear[1], vt->saved_clear[2],
+                 vt->saved_clear[3]);
+}
+
+static void vtex_load_job(void* arg) {
+    VtexLoad *load = (VtexLoad *)arg;
+    VirtualTexture *vt = load->vt;
+    load->pixels = (uint8_t *)malloc((size_t)vt->slot_size * vt->slot_size * 4);
+    load->ok = vt->load(load->level, load->x, load->y, load->pixels, vt->slot_size,
+                        vt->user);
+
+    pthread_mutex_lock(&vt->lock);
+    if (vt->ready_count == vt->ready_capacity) {
+        vt->ready_capacity = vt->ready_capacity ? vt->ready_capacity * 2 : 16;
+        vt->ready = (VtexLoad **)realloc(vt->ready, vt->ready_capacity * sizeof(VtexLoad *));
+    }
+    vt->ready[vt->ready_count++] = load;
+    pthread_mutex_unlock(&vt->lock);
+}
+
+static int vtex_compare_requests(const void* a, const void* b) {
+    return ((const VtexRequest *)b)->level - ((const VtexRequest *)a)->level;
+}
+
+// Marks every page the feedback saw as used, along with the ancestors
+// standing in for it, and collects the missing ones
+static int vtex_read_feedback(VirtualTexture* vt, const uint8_t* texels,
+                              VtexRequest* requests) {
+    int count = 0;
+    for (int i = 0; i < vt->feedback_width * vt->feedback_height; i++) {
+        const uint8_t *t = &texels[i * 4];
+        int level = t[3];
+        if (level >= vt->level_count)
+            continue;
+        int x = t[0] | (t[2] & 15) << 8, y = t[1] | (t[2] >> 4) << 8;
+        if (x >= vtex_width(vt, level) || y >= vtex_height(vt, level))
+            continue;
+        VtexPage *page = vtex_page(vt, level, x, y);
+        if (page->seen == vt->frame + 1)
+            continue;
+        page->seen = vt->frame + 1;
+
+        if (page->state == VTEX_PAGE_ABSENT) {
+            VtexRequest request = {level, x, y};
+            requests[count++] = request;
+        }
+        for (int l = level; l < vt->level_count; l++) {
+            VtexPage *p = vtex_page(vt, l, x >> (l - level), y >> (l - level));
+            if (p->state == VTEX_PAGE_RESIDENT)
+                vt->slots[p->slot].last_used = vt->frame;
+        }
+    }
+    return count;
+}
+
+void vtex_update(VirtualTexture* vt) {
+    double start = now_ms();
+    vt->stats.faults = 0;
+    vt->stats.uploads = 0;
+    vt->stats.evictions = 0;
+
+    // Oldest finished readback first; one still in flight, or whose wait
+    // failed, is left for vtex_end_feedback to replace
+    for (int n = 1; n <= 2; n++) {
+        int index = (vt->frame + n) & 1;
+        GLsync fence = vt->feedback_fence[index];
+        if (!fence)
+            continue;
+        GLenum wait = glClientWaitSync(fence, 0, 0);
+        if (wait != GL_ALREADY_SIGNALED && wait != GL_CONDITION_SATISFIED)
+            continue;
+        glDeleteSync(fence);
+        vt->feedback_fence[index] = 0;
+
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, vt->feedback_pbo[index]);
+        size_t size = (size_t)vt->feedback_width * vt->feedback_height * 4;
+        const uint8_t *texels = (const uint8_t *)glMapBufferRange(
+            GL_PIXEL_PACK_BUFFER, 0, (GLsizeiptr)size, GL_MAP_READ_BIT);
+        if (texels) {
+            VtexRequest *requests = (VtexRequest *)malloc(
+                (size_t)vt->feedback_width * vt->feedback_height * sizeof(VtexRequest));
+            int count = vtex_read_feedback(vt, texels, requests);
+            glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+            vt->stats.faults += count;
+            vt->stats.total_faults += count;
+
+            // Coarse pages first, they cover the most screen per load
+            qsort(requests, count, sizeof(VtexRequest), vtex_compare_requests);
+            for (int i = 0; i < count && vt->stats.in_flight < vt->max_in_flight; i++) {
+                VtexLoad *load = (VtexLoad *)calloc(1, sizeof(VtexLoad));
+                load->vt = vt;
+                load->level = requests[i].level;
+                load->x = requests[i].x;
+                load->y = requests[i].y;
+                vtex_page(vt, load->level, load->x, load->y)->state = VTEX_PAGE_LOADING;
+                vt->stats.in_flight++;
+                if (vt->jobs)
+                    job_submit(vt->jobs, vtex_load_job, load);
+                else
+                    vtex_load_job(load);
+            }
+            free(requests);
+        }
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    }
+
+    pthread_mutex_lock(&vt->lock);
+    while (vt->ready_count > 0 && vt->stats.uploads < vt->uploads_per_frame) {
+        VtexLoad *load = vt->ready[--vt->ready_count];
+        pthread_mutex_unlock(&vt->lock);
+
+        vt->stats.in_flight--;
+        if (load->ok)
+            vtex_upload(vt, load->level, load->x, load->y, load->pixels);
+        else
+            vtex_page(vt, load->level, load->x, load->y)->state = VTEX_PAGE_ABSENT;
+        free(load->pixels);
+        free(load);
+
+        pthread_mutex_lock(&vt->lock);
+    }
+    pthread_mutex_unlock(&vt->lock);
+
+    if (vt->table_dirty)
+        vtex_upload_table(vt);
+    vt->frame++;
+    vt->stats.update_ms = now_ms() - start;
+}
+
+void vtex_bind(VirtualTexture* vt, GLuint program, int unit) {
+    glActiveTexture(GL_TEXTURE0 + unit);
+    glBindTexture(GL_TEXTURE_2D, vt->page_table);
+    glActiveTexture(GL_TEXTURE0 + unit + 1);
+    glBindTexture(GL_TEXTURE_2D, vt->cache);
+    glActiveTexture(GL_TEXTURE0);
+
+    glUniform1i(glGetUniformLocation(program, "vtex_table"), unit);
+    glUniform1i(glGetUniformLocation(program, "vtex_cache"), unit + 1);
+    glUniform4f(glGetUniformLocation(program, "vtex_size"), (float)vt->pages_x,
+                (float)vt->pages_y, (float)vt->page_size, (float)vt->level_count);
+    glUniform4f(glGetUniformLocation(program, "vtex_cache_size"),
+                (float)(vt->cache_x * vt->slot_size), (float)(vt->cache_y * vt->slot_size),
+                (float)vt->slot_size, (float)VTEX_BORDER);
+}
@@ -0,0 +1,133 @@
+#ifndef VTEX_H
+#define VTEX_H
+
+#include <glad/gl.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "job.h"
+
+#define VTEX_MAX_LEVELS 13
+#define VTEX_BORDER 4
+
+// Runs on a worker thread. Fills a `size` x `size` RGBA8 page: the page
+// content plus VTEX_BORDER texels of its neighbours on every side so
+// bilinear filtering does not need the adjacent page. Returns false if the
+// page cannot be produced.
+typedef bool (*VtexPageFn)(int level, int page_x, int page_y, uint8_t* rgba,
+                           int size, void* user);
+
+typedef enum VtexPageState {
+  VTEX_PAGE_ABSENT,
+  VTEX_PAGE_LOADING,
+  VTEX_PAGE_RESIDENT
+} VtexPageState;
+
+typedef struct VtexPage {
+  uint8_t state;
+  int slot;
+  uint64_t seen;
+} VtexPage;
+
+typedef struct VtexSlot {
+  int level;
+  int x, y;
+  uint64_t last_used;
+} VtexSlot;
+
+typedef struct VtexLoad {
+  int level;
+  int x, y;
+  bool ok;
+  uint8_t* pixels;
+  struct VirtualTexture* vt;
+} VtexLoad;
+
+// Counts are for the last vtex_update, totals since init
+typedef struct VtexStats {
+  int resident;
+  int in_flight;
+  int faults;
+  int uploads;
+  int evictions;
+  long total_faults;
+  long total_uploads;
+  long total_evictions;
+  double update_ms;
+} VtexStats;
+
+// A texture far larger than VRAM split into square pages per mip level.
+// Only pages the feedback pass saw are kept in the physical cache; the page
+// table maps every virtual page to the cache slot of itself or its nearest
+// resident ancestor, so missing pages show blurrier data rather than holes.
+// The coarsest level is always resident.
+typedef struct VirtualTexture {
+  int pages_x, pages_y;
+  int page_size;
+  int slot_size;
+  int level_count;
+  int cache_x, cache_y;
+  GLuint page_table;
+  GLuint cache;
+
+  GLuint feedback_fbo;
+  GLuint feedback_color;
+  GLuint feedback_depth;
+  GLuint feedback_program;
+  GLint feedback_bias_loc;
+  int feedback_width, feedback_height;
+  GLuint feedback_pbo[2];
+  GLsync feedback_fence[2];
+  GLint saved_viewport[4];
+  GLfloat saved_clear[4];
+  uint64_t frame;
+
+  VtexPage* pages[VTEX_MAX_LEVELS];
+  uint8_t* table[VTEX_MAX_LEVELS];
+  bool table_dirty;
+  VtexSlot* slots;
+  int slot_count;
+
+  JobSystem* jobs;
+  VtexPageFn load;
+  void* user;
+  int max_in_flight;
+  int uploads_per_frame;
+  pthread_mutex_t lock;
+  VtexLoad** ready;
+  int ready_count;
+  int ready_capacity;
+  VtexStats stats;
+} VirtualTexture;
+
+// `pages_x` and `pages_y` must be powers of two, the cache holds
+// `cache_x` x `cache_y` pages of `page_size` texels plus borders
+bool vtex_init(VirtualTexture* vt, int pages_x, int pages_y, int page_size,
+               int cache_x, int cache_y, int feedback_width, int feedback_height,
+               JobSystem* jobs, VtexPageFn load, void* user);
+void vtex_destroy(VirtualTexture* vt);
+
+// GLSL declaring vtex_sample(uv) for the shading pass, to be passed to
+// glShaderSource after the #version line and before the shader's own code
+extern const char* VTEX_GLSL;
+
+// Builds the feedback program from the scene's vertex shader, which has to
+// write the virtual texture coordinate to `out vec2 TexCoord`
+bool vtex_feedback_program(VirtualTexture* vt, GLuint vertex_shader);
+
+// Renders into the feedback target with the feedback program bound and
+// returned, so the caller can set its transforms and draw the scene. The
+// readback finishes asynchronously and is consumed a frame later.
+GLuint vtex_begin_feedback(VirtualTexture* vt, int screen_width);
+void vtex_end_feedback(VirtualTexture* vt);
+
+// Reads the last finished feedback, requests missing pages, uploads loaded
+// ones and refreshes the page table. Call once per frame before shading.
+void vtex_update(VirtualTexture* vt);
+
+// Binds the page table and cache to texture units `unit` and `unit + 1` and
+// sets the vtex_ uniforms of `program`, which must be in use
+void vtex_bind(VirtualTexture* vt, GLuint program, int unit);
+
+#endif
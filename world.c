@@ -0,0 +1,358 @@
+#define GLAD_GL_IMPLEMENTATION
+#include <glad/gl.h>
+#define GLFW_INCLUDE_NONE
+#include <GLFW/glfw3.h>
+
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "camera.h"
+#include "chunk.h"
+#include "job.h"
+#include "linmath.h"
+#include "stream.h"
+#include "texture_budget.h"
+#include "vfs.h"
+#include "vtex.h"
+#include "window.h"
+
+// The ground colour is a virtual texture of 256x256 pages of 128 texels
+// draped over the middle 4096x4096 blocks, 8 texels per block at level 0
+#define TERRAIN_PAGES 256
+#define TERRAIN_PAGE_SIZE 128
+#define TERRAIN_EXTENT 4096.0f
+
+static const char *vertex_shader_text =
+    "#version 330 core\n"
+    "layout (location = 0) in vec3 aPos;      // Vertex position\n"
+    "layout (location = 1) in vec3 aNormal;   // Normal\n"
+    "layout (location = 2) in vec2 aTexCoord; // Texture coordinate\n"
+    "\n"
+    "out vec2 TexCoord;   // Virtual texture coordinate\n"
+    "out vec2 BlockCoord;\n"
+    "out vec3 Normal;\n"
+    "uniform mat4 view;\n"
+    "uniform mat4 projection;\n"
+    "uniform float terrainExtent;\n"
+    "\n"
+    "void main()\n"
+    "{\n"
+    "    gl_Position = projection * view * vec4(aPos, 1.0);\n"
+    "    TexCoord = aPos.xz / terrainExtent + 0.5;\n"
+    "    BlockCoord = aTexCoord;\n"
+    "    Normal = aNormal;\n"
+    "}\n";
+
+// Goes after the #version line and VTEX_GLSL
+static const char *fragment_shader_text =
+    "out vec4 FragColor;\n"
+    "in vec2 TexCoord;\n"
+    "in vec2 BlockCoord;\n"
+    "in vec3 Normal;\n"
+    "\n"
+    "uniform sampler2D texture1;\n"
+    "uniform vec3 lightDir;\n"
+    "\n"
+    "void main()\n"
+    "{\n"
+    "    float diffuse = max(dot(normalize(Normal), -lightDir), 0.0);\n"
+    "    vec4 color = mix(texture(texture1, BlockCoord), vtex_sample(TexCoord), 0.7);\n"
+    "    FragColor = color * (0.3 + 0.7 * diffuse);\n"
+    "}\n";
+
+static void error_callback(int error, const char *description) {
+    fprintf(stderr, "Error: %s\n", description);
+}
+
+static void key_callback(GLFWwindow *window, int key, int scancode, int action,
+                         int mods) {
+    if (key == GLFW_KEY_Q && action == GLFW_PRESS)
+        glfwSetWindowShouldClose(window, GLFW_TRUE);
+}
+
+float last_x = -1.0;
+float last_y = -1.0;
+float yaw = 280.0f, pitch = 20.0f;
+static void cursor_callback(GLFWwindow *window, double xpos, double ypos) {
+    if (last_x < 0)
+        last_x = xpos;
+    if (last_y < 0)
+        last_y = ypos;
+    float offset_x = xpos - last_x;
+    float offset_y = ypos - last_y;
+    last_x = xpos;
+    last_y = ypos;
+
+    yaw += offset_x;
+    pitch += offset_y;
+
+    if (pitch > 89.0f)
+        pitch = 89.0f;
+    if (pitch < -89.0f)
+        pitch = -89.0f;
+}
+
+void processInput(GLFWwindow *window, float delta_time, vec3 pos, vec3 front,
+                  vec3 up) {
+    const float speed = 20.0f * delta_time;
+    vec3 tmp_front, tmp_cross, tmp_norm;
+    if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS) {
+        vec3_scale(tmp_front, front, speed);
+        vec3_add(pos, pos, tmp_front);
+    }
+    if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS) {
+        vec3_scale(tmp_front, front, -speed);
+        vec3_add(pos, pos, tmp_front);
+    }
+    if (glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS) {
+        vec3_mul_cross(tmp_cross, front, up);
+        vec3_norm(tmp_norm, tmp_cross);
+        vec3_scale(tmp_front, tmp_norm, -speed);
+        vec3_add(pos, pos, tmp_front);
+    }
+    if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS) {
+        vec3_mul_cross(tmp_cross, front, up);
+        vec3_norm(tmp_norm, tmp_cross);
+        vec3_scale(tmp_front, tmp_norm, speed);
+        vec3_add(pos, pos, tmp_front);
+    }
+}
+
+// Rolling hills made of stone with a layer of dirt and grass on top
+void generate_terrain(Chunk *chunk, void *user) {
+    for (int z = 0; z < CHUNK_SIZE; z++) {
+        for (int x = 0; x < CHUNK_SIZE; x++) {
+            float wx = (float)(chunk->x * CHUNK_SIZE + x);
+            float wz = (float)(chunk->z * CHUNK_SIZE + z);
+            int height = 24 + (int)(8.0f * sinf(wx * 0.05f) * cosf(wz * 0.07f) +
+                                    4.0f * sinf((wx + wz) * 0.11f));
+            for (int y = 0; y < CHUNK_SIZE; y++) {
+                int wy = chunk->y * CHUNK_SIZE + y;
+                Block block = BLOCK_AIR;
+                if (wy < height - 3)
+                    block = 1;
+                else if (wy < height - 1)
+                    block = 2;
+                else if (wy < height)
+                    block = 3;
+                chunk_set_block(chunk, x, y, z, block);
+            }
+        }
+    }
+}
+
+// Meadow colours varying per block, computed from the world position so
+// every level shows the same ground the finer ones do
+bool generate_terrain_page(int level, int page_x, int page_y, uint8_t *rgba,
+                           int size, void *user) {
+    const float texel = (float)(1 << level) * TERRAIN_EXTENT /
+                        (TERRAIN_PAGES * TERRAIN_PAGE_SIZE);
+    for (int y = 0; y < size; y++) {
+        for (int x = 0; x < size; x++) {
+            float wx = (page_x * TERRAIN_PAGE_SIZE + x - VTEX_BORDER + 0.5f) * texel -
+                       TERRAIN_EXTENT * 0.5f;
+            float wz = (page_y * TERRAIN_PAGE_SIZE + y - VTEX_BORDER + 0.5f) * texel -
+                       TERRAIN_EXTENT * 0.5f;
+            float meadow = 0.5f + 0.5f * sinf(wx * 0.013f) * cosf(wz * 0.017f);
+            float patches = 0.5f + 0.5f * sinf((wx - wz) * 0.09f) * sinf(wz * 0.05f);
+            uint32_t hash = ((uint32_t)(int)floorf(wx) * 73856093u) ^
+                            ((uint32_t)(int)floorf(wz) * 19349663u);
+            float noise = (float)(hash % 64) / 640.0f;
+
+            uint8_t *out = &rgba[((size_t)y * size + x) * 4];
+            out[0] = (uint8_t)(255.0f * (0.25f + 0.3f * patches * (1.0f - meadow) + noise));
+            out[1] = (uint8_t)(255.0f * (0.35f + 0.35f * meadow + noise));
+            out[2] = (uint8_t)(255.0f * (0.15f + 0.1f * patches + noise));
+            out[3] = 255;
+        }
+    }
+    return true;
+}
+
+// The feedback program of `terrain` is built from the same vertex shader
+GLuint init_shaders(VirtualTexture *terrain) {
+    const GLuint vertex_shader = glCreateShader(GL_VERTEX_SHADER);
+    glShaderSource(vertex_shader, 1, &vertex_shader_text, NULL);
+    glCompileShader(vertex_shader);
+
+    const char *fragment_sources[3] = {"#version 330 core\n", VTEX_GLSL,
+                                       fragment_shader_text};
+    const GLuint fragment_shader = glCreateShader(GL_FRAGMENT_SHADER);
+    glShaderSource(fragment_shader, 3, fragment_sources, NULL);
+    glCompileShader(fragment_shader);
+
+    const GLuint program = glCreateProgram();
+    glAttachShader(program, vertex_shader);
+    glAttachShader(program, fragment_shader);
+    glLinkProgram(program);
+    vtex_feedback_program(terrain, vertex_shader);
+
+    glDeleteShader(fragment_shader);
+    glDeleteShader(vertex_shader);
+    return program;
+}
+
+int main(void) {
+    glfwSetErrorCallback(error_callback);
+
+    if (!glfwInit())
+        exit(EXIT_FAILURE);
+
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+
+    GLFWwindow *window = window_init();
+
+    glfwSetKeyCallback(window, key_callback);
+    glfwSetCursorPosCallback(window, cursor_callback);
+
+    JobSystem jobs;
+    job_system_init(&jobs, 0);
+
+    VirtualTexture terrain;
+    if (!vtex_init(&terrain, TERRAIN_PAGES, TERRAIN_PAGES, TERRAIN_PAGE_SIZE, 16, 16,
+                   256, 144, &jobs, generate_terrain_page, NULL))
+        exit(EXIT_FAILURE);
+
+    GLuint program = init_shaders(&terrain);
+    if (vfs_exists("assets.pak"))
+        vfs_mount("assets.pak");
+    // Textures share a VRAM budget and lose top mips when unused
+    TextureBudget textures;
+    texture_budget_init(&textures, (size_t)64 * 1024 * 1024, NULL, &jobs);
+    int texture = texture_budget_load(&textures, "container.jpg");
+    GLint viewLoc = glGetUniformLocation(program, "view");
+    GLint projectionLoc = glGetUniformLocation(program, "projection");
+    GLint lightDirLoc = glGetUniformLocation(program, "lightDir");
+    GLint extentLoc = glGetUniformLocation(program, "terrainExtent");
+    GLint feedbackViewLoc = glGetUniformLocation(terrain.feedback_program, "view");
+    GLint feedbackProjectionLoc =
+        glGetUniformLocation(terrain.feedback_program, "projection");
+    GLint feedbackExtentLoc =
+        glGetUniformLocation(terrain.feedback_program, "terrainExtent");
+
+    ChunkWorld world;
+    chunk_world_init(&world, &jobs, 4 * 1024 * 1024, 6 * 1024 * 1024);
+
+    ChunkStreamer streamer;
+    chunk_streamer_init(&streamer, &world, generate_terrain, NULL);
+    streamer.view_radius = 10;
+    streamer.min_y = 0;
+    streamer.max_y = 1;
+    streamer.memory_cap = (size_t)256 * 1024 * 1024;
+    float last_report = 0.0f;
+
+    glEnable(GL_DEPTH_TEST);
+    glEnable(GL_CULL_FACE);
+    glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+
+    Camera camera = camera_init();
+    camera.position[0] = 0.0f;
+    camera.position[1] = 48.0f;
+    camera.position[2] = 0.0f;
+    vec3 up = {0.0f, 1.0f, 0.0f};
+    vec3 light_dir = {-0.4f, -0.8f, -0.3f};
+    vec3_norm(light_dir, light_dir);
+    float delta_time = 0.0f, last_frame = 0.0f;
+    mat4x4 view, projection;
+
+    glClearColor(0.5f, 0.7f, 0.9f, 1.0f);
+    while (!glfwWindowShouldClose(window)) {
+        int width, height;
+        glfwGetFramebufferSize(window, &width, &height);
+        glViewport(0, 0, width, height);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+        float current_frame = glfwGetTime();
+        delta_time = current_frame - last_frame;
+        last_frame = current_frame;
+
+        float mult = 3.1415f / 180.0f;
+        float radian_yaw = yaw * mult;
+        float radian_pitch = -pitch * mult;
+        camera.direction[0] = cos(radian_yaw) * cos(radian_pitch);
+        camera.direction[1] = sin(radian_pitch);
+        camera.direction[2] = sin(radian_yaw) * cos(radian_pitch);
+        vec3 front, tmp;
+        vec3_norm(front, camera.direction);
+
+        processInput(window, delta_time, camera.position, front, up);
+        chunk_streamer_update(&streamer, camera.position, front,
+                              delta_time * 1e3);
+        if (current_frame - last_report > 2.0f) {
+            const ChunkStreamStats *stream_stats = &streamer.stats;
+            const ChunkWorldStats *stats = &world.stats;
+            printf("chunks: %d resident, %d generated, %d evicted, %.1f MB, "
+                   "%d hitches (worst %.2f ms)\n",
+                   stream_stats->resident, stream_stats->generated,
+                   stream_stats->evicted, stream_stats->memory / 1048576.0,
+                   stream_stats->hitches, stream_stats->worst_frame_ms);
+            if (stats->chunks_meshed > 0)
+                printf("meshing: %d chunks, %.2f ms cpu per chunk, triangles "
+                       "%ld per-cube, %ld face-culled, %ld greedy\n",
+                       stats->chunks_meshed,
+                       stats->mesh_seconds * 1e3 / stats->chunks_meshed,
+                       stats->solid_blocks * 12, stats->visible_faces * 2,
+                       stats->quads * 2);
+            const TextureBudgetStats *texture_stats = &textures.stats;
+            printf("textures: %.1f of %.1f MB (%.1f MB at full size), %d degraded, "
+                   "%ld evictions, %ld restores\n",
+                   texture_stats->usage / 1048576.0, textures.budget / 1048576.0,
+                   texture_stats->full_usage / 1048576.0, texture_stats->degraded,
+                   texture_stats->total_evictions, texture_stats->total_restores);
+            const VtexStats *vtex_stats = &terrain.stats;
+            printf("virtual texture: %d pages resident, %d loading, %ld faults, "
+                   "%ld uploads, %ld evictions, %.2f ms update\n",
+                   vtex_stats->resident, vtex_stats->in_flight,
+                   vtex_stats->total_faults, vtex_stats->total_uploads,
+                   vtex_stats->total_evictions, vtex_stats->update_ms);
+            last_report = current_frame;
+        }
+
+        vec3_add(tmp, camera.position, front);
+        mat4x4_look_at(view, camera.position, tmp, up);
+        mat4x4_perspective(projection, 1.0f, width / (float)height, 0.1f,
+                           1000.0f);
+
+        // Pages seen here are requested by the vtex_update of a later frame
+        vtex_begin_feedback(&terrain, width);
+        glUniformMatrix4fv(feedbackViewLoc, 1, GL_FALSE, (const GLfloat *)view);
+        glUniformMatrix4fv(feedbackProjectionLoc, 1, GL_FALSE,
+                           (const GLfloat *)projection);
+        glUniform1f(feedbackExtentLoc, TERRAIN_EXTENT);
+        chunk_world_draw(&world);
+        vtex_end_feedback(&terrain);
+        vtex_update(&terrain);
+
+        glUseProgram(program);
+        glUniformMatrix4fv(viewLoc, 1, GL_FALSE, (const GLfloat *)view);
+        glUniformMatrix4fv(projectionLoc, 1, GL_FALSE,
+                           (const GLfloat *)projection);
+        glUniform3f(lightDirLoc, light_dir[0], light_dir[1], light_dir[2]);
+        glUniform1f(extentLoc, TERRAIN_EXTENT);
+        vtex_bind(&terrain, program, 1);
+        glBindTexture(GL_TEXTURE_2D, texture_budget_use(&textures, texture));
+        chunk_world_draw(&world);
+        texture_budget_update(&textures);
+
+        glfwSwapBuffers(window);
+        glfwPollEvents();
+    }
+
+    chunk_streamer_destroy(&streamer);
+    chunk_world_destroy(&world);
+    vtex_destroy(&terrain);
+    texture_budget_destroy(&textures);
+    job_system_destroy(&jobs);
+    glDeleteProgram(program);
+
+    glfwDestroyWindow(window);
+
+    vfs_unmount_all();
+    glfwTerminate();
+    exit(EXIT_SUCCESS);
+}